@@ -24,6 +24,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
 #include <set>
 #include <sstream>
 
@@ -145,16 +146,41 @@ TruthValuePtr Atom::getTruthValue() const
 /// If the value is a null pointer, then the key is removed.
 void Atom::setValue(const Handle& key, const ValuePtr& value)
 {
-	std::lock_guard<std::mutex> lck(_mtx);
+	std::lock_guard<AtomLock> lck(_mtx);
 	if (nullptr != value)
 	{
-		_values[key] = value;
+		if (nullptr == _value_key or content_eq(_value_key, key))
+		{
+			_value_key = key;
+			_value = value;
+			return;
+		}
+		if (nullptr == _more_values) _more_values.reset(new ValueMap());
+		(*_more_values)[key] = value;
+		return;
+	}
+
+	// If the value is a null pointer, then the value at
+	// this key should be blanked out, i.e. unset.
+	if (nullptr == _value_key) return;
+	if (not content_eq(_value_key, key))
+	{
+		if (_more_values) _more_values->erase(key);
+		return;
+	}
+
+	// Keep the in-atom slot filled, if there is anything left.
+	if (_more_values and not _more_values->empty())
+	{
+		auto it = _more_values->begin();
+		_value_key = it->first;
+		_value = it->second;
+		_more_values->erase(it);
 	}
 	else
 	{
-		// If the value is a null pointer, then the value at
-		// this key should be blanked out, i.e. unset.
-		_values.erase(key);
+		_value_key = Handle::UNDEFINED;
+		_value = nullptr;
 	}
 }
 
@@ -172,17 +198,23 @@ ValuePtr Atom::getValue(const Handle& key) const
     // Furthermore, we must make a copy while holding the lock! Got that?
 
     ValuePtr pap;
-    std::lock_guard<std::mutex> lck(_mtx);
-    auto pr = _values.find(key);
-    if (_values.end() != pr) pap = pr->second;
+    std::lock_guard<AtomLock> lck(_mtx);
+    if (nullptr == _value_key) return pap;
+    if (content_eq(_value_key, key)) return _value;
+    if (nullptr == _more_values) return pap;
+    auto pr = _more_values->find(key);
+    if (_more_values->end() != pr) pap = pr->second;
     return pap;
 }
 
 HandleSet Atom::getKeys() const
 {
     HandleSet keyset;
-    std::lock_guard<std::mutex> lck(_mtx);
-    for (const auto& pr : _values)
+    std::lock_guard<AtomLock> lck(_mtx);
+    if (nullptr == _value_key) return keyset;
+    keyset.insert(_value_key);
+    if (nullptr == _more_values) return keyset;
+    for (const auto& pr : *_more_values)
         keyset.insert(pr.first);
 
     return keyset;
@@ -289,26 +321,116 @@ void Atom::keep_incoming_set()
 void Atom::drop_incoming_set()
 {
     if (nullptr == _incoming_set) return;
-    std::lock_guard<std::mutex> lck (_mtx);
+    std::lock_guard<AtomLock> lck (_mtx);
     _incoming_set->_iset.clear();
     _incoming_set = nullptr;
 }
 
-/// Add an atom to the incoming set.
-void Atom::insert_atom(const LinkPtr& a)
+// Buckets with more links than this get a hash index; below this,
+// a linear search of the bucket is faster anyway.
+#define INSET_INDEX_THRESHOLD 16
+
+/// Return the position of the link in the bucket, or the size of
+/// the bucket, if it is not there.
+size_t Atom::InSet::Bucket::position(const LinkPtr& l) const
 {
-    if (nullptr == _incoming_set) return;
-    std::lock_guard<std::mutex> lck (_mtx);
+    size_t sz = links.size();
+    if (where)
+    {
+        auto it = where->find(l.get());
+        if (it != where->end() and it->second < sz and
+            links[it->second].is(l))
+            return it->second;
+        return sz;
+    }
+
+    for (size_t i = 0; i < sz; i++)
+        if (links[i].is(l)) return i;
+    return sz;
+}
 
-    Type at = a->get_type();
-    auto bucket = _incoming_set->_iset.find(at);
-    if (bucket == _incoming_set->_iset.end())
+void Atom::InSet::Bucket::insert(const LinkPtr& l)
+{
+    if (position(l) < links.size()) return;
+
+    // Before growing, drop the links that expired without being
+    // removed. Done only when the vector is full, so the cost is
+    // amortized over the inserts.
+    if (links.size() == links.capacity()) compact();
+
+    if (where) (*where)[l.get()] = links.size();
+    links.emplace_back(l);
+
+    if (nullptr == where and INSET_INDEX_THRESHOLD < links.size())
+        build_index();
+}
+
+bool Atom::InSet::Bucket::remove(const LinkPtr& l)
+{
+    size_t pos = position(l);
+    size_t last = links.size();
+    if (last <= pos) return false;
+    last--;
+
+    if (where) where->erase(l.get());
+
+    // Move the last link into the hole.
+    if (pos != last)
     {
-        auto pr = _incoming_set->_iset.emplace(
-                   std::make_pair(at, WincomingSet()));
-        bucket = pr.first;
+        links[pos] = std::move(links[last]);
+        if (where) (*where)[links[pos].link] = pos;
     }
-    bucket->second.insert(a);
+    links.pop_back();
+    return true;
+}
+
+void Atom::InSet::Bucket::compact(void)
+{
+    links.erase(std::remove_if(links.begin(), links.end(),
+                    [](const Edge& e) { return e.wink.expired(); }),
+                links.end());
+    if (where) build_index();
+}
+
+void Atom::InSet::Bucket::build_index(void)
+{
+    where.reset(new std::unordered_map<const Link*, size_t>());
+    where->reserve(2 * links.size());
+    for (size_t i = 0; i < links.size(); i++)
+        if (not links[i].wink.expired()) (*where)[links[i].link] = i;
+}
+
+const Atom::InSet::Bucket* Atom::InSet::find(Type t) const
+{
+    auto it = std::lower_bound(_iset.begin(), _iset.end(), t);
+    if (it == _iset.end() or it->type != t) return nullptr;
+    return &(*it);
+}
+
+void Atom::InSet::insert(const LinkPtr& l)
+{
+    Type t = l->get_type();
+    auto it = std::lower_bound(_iset.begin(), _iset.end(), t);
+    if (it == _iset.end() or it->type != t)
+        it = _iset.emplace(it, t);
+    it->insert(l);
+}
+
+void Atom::InSet::remove(const LinkPtr& l)
+{
+    Type t = l->get_type();
+    auto it = std::lower_bound(_iset.begin(), _iset.end(), t);
+    if (it == _iset.end() or it->type != t) return;
+    it->remove(l);
+    if (it->links.empty()) _iset.erase(it);
+}
+
+/// Add an atom to the incoming set.
+void Atom::insert_atom(const LinkPtr& a)
+{
+    if (nullptr == _incoming_set) return;
+    std::lock_guard<AtomLock> lck (_mtx);
+    _incoming_set->insert(a);
 
 #ifdef INCOMING_SET_SIGNALS
     _incoming_set->_addAtomSignal(shared_from_this(), a);
@@ -319,14 +441,11 @@ void Atom::insert_atom(const LinkPtr& a)
 void Atom::remove_atom(const LinkPtr& a)
 {
     if (nullptr == _incoming_set) return;
-    std::lock_guard<std::mutex> lck (_mtx);
+    std::lock_guard<AtomLock> lck (_mtx);
 #ifdef INCOMING_SET_SIGNALS
     _incoming_set->_removeAtomSignal(shared_from_this(), a);
 #endif /* INCOMING_SET_SIGNALS */
-    Type at = a->get_type();
-    auto bucket = _incoming_set->_iset.find(at);
-    if (bucket != _incoming_set->_iset.end())
-        bucket->second.erase(a);
+    _incoming_set->remove(a);
 }
 
 /// Remove old, and add new, atomically, so that every user
@@ -335,24 +454,13 @@ void Atom::remove_atom(const LinkPtr& a)
 void Atom::swap_atom(const LinkPtr& old, const LinkPtr& neu)
 {
     if (nullptr == _incoming_set) return;
-    std::lock_guard<std::mutex> lck (_mtx);
+    std::lock_guard<AtomLock> lck (_mtx);
 
 #ifdef INCOMING_SET_SIGNALS
     _incoming_set->_removeAtomSignal(shared_from_this(), old);
 #endif /* INCOMING_SET_SIGNALS */
-    Type ot = old->get_type();
-    auto bucket = _incoming_set->_iset.find(ot);
-    bucket->second.erase(old);
-
-    Type nt = neu->get_type();
-    bucket = _incoming_set->_iset.find(nt);
-    if (bucket == _incoming_set->_iset.end())
-    {
-        auto pr = _incoming_set->_iset.emplace(
-                   std::make_pair(nt, WincomingSet()));
-        bucket = pr.first;
-    }
-    bucket->second.insert(neu);
+    _incoming_set->remove(old);
+    _incoming_set->insert(neu);
 
 #ifdef INCOMING_SET_SIGNALS
     _incoming_set->_addAtomSignal(shared_from_this(), neu);
@@ -365,11 +473,11 @@ void Atom::remove() {}
 size_t Atom::getIncomingSetSize() const
 {
     if (nullptr == _incoming_set) return 0;
-    std::lock_guard<std::mutex> lck (_mtx);
+    std::lock_guard<AtomLock> lck (_mtx);
 
     size_t cnt = 0;
-    for (const auto& pr : _incoming_set->_iset)
-        cnt += pr.second.size();
+    for (const auto& bucket : _incoming_set->_iset)
+        cnt += bucket.links.size();
     return cnt;
 }
 
@@ -385,28 +493,31 @@ IncomingSet Atom::getIncomingSet(AtomSpace* as) const
     if (as) {
         const AtomTable *atab = &as->get_atomtable();
         // Prevent update of set while a copy is being made.
-        std::lock_guard<std::mutex> lck (_mtx);
+        // Links in other atomspaces are rejected before being made
+        // strong.
+        std::lock_guard<AtomLock> lck (_mtx);
         IncomingSet iset;
         for (const auto& bucket : _incoming_set->_iset)
         {
-            for (const WinkPtr& w : bucket.second)
+            for (const InSet::Edge& e : bucket.links)
             {
-                LinkPtr l(w.lock());
-                if (l and atab->in_environ(l))
-                    iset.emplace_back(l);
+                if (e.wink.expired() or not atab->in_environ(e.link))
+                    continue;
+                LinkPtr l(e.wink.lock());
+                if (l) iset.emplace_back(l);
             }
         }
         return iset;
     }
 
     // Prevent update of set while a copy is being made.
-    std::lock_guard<std::mutex> lck (_mtx);
+    std::lock_guard<AtomLock> lck (_mtx);
     IncomingSet iset;
     for (const auto& bucket : _incoming_set->_iset)
     {
-        for (const WinkPtr& w : bucket.second)
+        for (const InSet::Edge& e : bucket.links)
         {
-            LinkPtr l(w.lock());
+            LinkPtr l(e.wink.lock());
             if (l) iset.emplace_back(l);
         }
     }
@@ -422,14 +533,14 @@ IncomingSet Atom::getIncomingSetByType(Type type) const
     // Handle.  The primary issue is that casting from Handle back
     // to LinkPtr is slowwwwwww.  So we avoid that, here.
     if (nullptr == _incoming_set) return result;
-    std::lock_guard<std::mutex> lck(_mtx);
+    std::lock_guard<AtomLock> lck(_mtx);
 
-    const auto bucket = _incoming_set->_iset.find(type);
-    if (bucket == _incoming_set->_iset.cend()) return result;
+    const InSet::Bucket* bucket = _incoming_set->find(type);
+    if (nullptr == bucket) return result;
 
-    for (const WinkPtr& w : bucket->second)
+    for (const InSet::Edge& e : bucket->links)
     {
-        LinkPtr h(w.lock());
+        LinkPtr h(e.wink.lock());
         if (h) result.emplace_back(h);
     }
     return result;
@@ -438,20 +549,27 @@ IncomingSet Atom::getIncomingSetByType(Type type) const
 size_t Atom::getIncomingSetSizeByType(Type type) const
 {
     if (nullptr == _incoming_set) return 0;
-    std::lock_guard<std::mutex> lck(_mtx);
+    std::lock_guard<AtomLock> lck(_mtx);
 
-    const auto bucket = _incoming_set->_iset.find(type);
-    if (bucket == _incoming_set->_iset.cend()) return 0;
+    const InSet::Bucket* bucket = _incoming_set->find(type);
+    if (nullptr == bucket) return 0;
 
     size_t cnt = 0;
-    for (const WinkPtr& w : bucket->second)
-    {
-        LinkPtr h(w.lock());
-        if (h) cnt++;
-    }
+    for (const InSet::Edge& e : bucket->links)
+        if (not e.wink.expired()) cnt++;
     return cnt;
 }
 
+size_t Atom::getIncomingSetSizeHint(Type type) const
+{
+    if (nullptr == _incoming_set) return 0;
+    std::lock_guard<AtomLock> lck(_mtx);
+
+    const InSet::Bucket* bucket = _incoming_set->find(type);
+    if (nullptr == bucket) return 0;
+    return bucket->links.size();
+}
+
 std::string Atom::id_to_string() const
 {
     return
@@ -27,11 +27,16 @@
 #ifndef _OPENCOG_ATOM_H
 #define _OPENCOG_ATOM_H
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <opencog/util/empty_string.h>
 #include <opencog/util/sigslot.h>
@@ -90,8 +95,37 @@ typedef std::size_t Arity;
 typedef std::vector<LinkPtr> IncomingSet; // use vector; see below.
 typedef SigSlot<AtomPtr, LinkPtr> AtomPairSignal;
 
-// typedef std::unordered_set<WinkPtr> WincomingSet;
-typedef std::set<WinkPtr, std::owner_less<WinkPtr> > WincomingSet;
+/**
+ * A one-byte spin lock, used as the per-atom lock. It fits into
+ * padding in the Atom, where a std::mutex would cost 40 bytes.
+ * The sections it guards are short: a lookup or update of the values
+ * or of the incoming set. A waiter spins on a read, so as not to
+ * bounce the cache line, and yields the CPU if that goes on for long.
+ */
+class AtomLock
+{
+private:
+    std::atomic<bool> _held;
+
+public:
+    AtomLock(void) : _held(false) {}
+
+    void lock(void)
+    {
+        while (_held.exchange(true, std::memory_order_acquire))
+        {
+            int spins = 0;
+            while (_held.load(std::memory_order_relaxed))
+                if (64 < ++spins) std::this_thread::yield();
+        }
+    }
+    bool try_lock(void)
+    {
+        return not _held.load(std::memory_order_relaxed) and
+               not _held.exchange(true, std::memory_order_acquire);
+    }
+    void unlock(void) { _held.store(false, std::memory_order_release); }
+};
 
 /**
  * Atoms are the basic implementational unit in the system that
@@ -103,6 +137,7 @@ class Atom
     : public Value
 {
     friend class AtomTable;       // Needs to call MarkedForRemoval()
+    friend class AtomSlots;       // Needs to set _type_index_slot
     friend class AtomSpace;       // Needs to call getAtomTable()
     friend class Link;            // Needs to call install_atom()
     friend class StateLink;       // Needs to call swap_atom()
@@ -120,21 +155,30 @@ protected:
     // Place this first, so that is shares a word with Type.
     mutable char _flags;
 
+    // Lock, used to serialize changes to the values and the incoming
+    // set. This is a lock-per-atom, since a single global lock sees
+    // too much contention; it fits in the padding after _flags.
+    mutable AtomLock _mtx;
+
+    // Position of this atom in the type index of the AtomTable that
+    // holds it. This fits in the padding after _flags, and so does not
+    // make the atom any bigger.
+    uint32_t _type_index_slot;
+
     /// Merkle-tree hash of the atom contents. Generically useful
     /// for indexing and comparison operations.
     mutable ContentHash _content_hash;
 
     AtomSpace *_atom_space;
 
-    /// All of the values on the atom, including the TV.
-    mutable std::map<const Handle, ValuePtr> _values;
-
-    // Lock, used to serialize changes.
-    // This costs 40 bytes per atom.  Tried using a single, global lock,
-    // but there seemed to be too much contention for it, so instead,
-    // we are using a lock-per-atom, even though this makes the atom
-    // kind-of fat.
-    mutable std::mutex _mtx;
+    /// All of the values on the atom, including the TV. Most atoms
+    /// hold at most one value, usually the TV, so the first key and
+    /// value are kept in the atom itself. Any more spill over into a
+    /// hash map, which is only allocated when it is needed.
+    typedef std::unordered_map<Handle, ValuePtr> ValueMap;
+    mutable Handle _value_key;
+    mutable ValuePtr _value;
+    mutable std::unique_ptr<ValueMap> _more_values;
 
     /**
      * Constructor for this class. Protected; no user should call this
@@ -145,6 +189,7 @@ protected:
     Atom(Type t)
       : Value(t),
         _flags(0),
+        _type_index_slot(UINT32_MAX),
         _content_hash(Handle::INVALID_HASH),
         _atom_space(nullptr)
     {}
@@ -152,9 +197,9 @@ protected:
     // The incoming set is not tracked by the garbage collector;
     // this is required, in order to avoid cyclic references.
     // That is, we use weak pointers here, not strong ones.
-    // std::set<ptr> uses 48 bytes (per atom).  See the README file
-    // in this directory for a slightly longer explanation for why
-    // weak pointers are needed, and why bdwgc cannot be used.
+    // See the README file in this directory for a slightly longer
+    // explanation for why weak pointers are needed, and why bdwgc
+    // cannot be used.
     struct InSet
     {
         // We want five things:
@@ -166,16 +211,68 @@ protected:
         //    cause an atom to get inserted multiple times.  This is
         //    arguably a bug, though.
         //
-        // In order to get b), we have to store atoms in buckets, each
-        // bucket holding only one type.  To satisfy d), the buckets
-        // need to be either hash tables or rb-trees. Scanning for
-        // uniqueness in a vector is prohibitavely slow.  Note that
-        // incoming sets containing 10K atoms are not unusual, and can
-        // be the source of bottlnecks.  Note that an atomspace can
-        // contain a hundred-million atoms, so the solution has to be
-        // small. This rules out using a vector to store the
-        // buckets (I tried).
-        std::map<Type, WincomingSet> _iset;
+        // In order to get b) and c), we store links in buckets, each
+        // bucket holding only one type; the buckets are kept in a
+        // vector, sorted by type, since most atoms have incoming links
+        // of only a few types.  Each bucket is a plain vector of
+        // edges: 24 bytes per edge, and no allocation per edge.
+        // It used to be std::map<Type, std::set<WinkPtr>>, which
+        // costs several allocations, and 80+ bytes, per edge, and is
+        // slow to iterate.
+        //
+        // For d) and e), small buckets are searched linearly. Incoming
+        // sets containing 10K atoms are not unusual, so big buckets
+        // get a hash index from link to position. Removal swaps the
+        // last entry into the hole.  Links that expired without being
+        // removed are compacted away the next time the bucket grows.
+        //
+        // Each edge keeps a bare pointer next to the weak pointer, so
+        // that foreach_incoming() can look at the links without
+        // touching their reference counts. The bare pointer is valid
+        // only while the weak pointer has not expired. Links are
+        // removed from the incoming set (under the atom lock) before
+        // their AtomTable lets go of them; so, while the lock is held,
+        // an edge that has not expired will not expire.
+        struct Edge
+        {
+            Link* link;
+            WinkPtr wink;
+
+            Edge(const LinkPtr& l) : link(l.get()), wink(l) {}
+
+            // No two live links share an address; so an edge with the
+            // same address is this link, unless it has expired.
+            bool is(const LinkPtr& l) const
+            {
+                return link == l.get() and not wink.expired();
+            }
+        };
+        struct Bucket
+        {
+            Type type;
+            std::vector<Edge> links;
+
+            // Position of each link in `links`. Built only for big
+            // buckets, where a linear search would be too slow.
+            // Entries for expired links may be stale.
+            std::unique_ptr<std::unordered_map<const Link*, size_t>> where;
+
+            Bucket(Type t) : type(t) {}
+            bool operator<(Type t) const { return type < t; }
+
+            size_t position(const LinkPtr&) const;
+            void insert(const LinkPtr&);
+            bool remove(const LinkPtr&);
+            void compact(void);
+            void build_index(void);
+        };
+
+        // Sorted by type.
+        std::vector<Bucket> _iset;
+
+        const Bucket* find(Type) const;
+        void insert(const LinkPtr&);
+        void remove(const LinkPtr&);
 
 #ifdef INCOMING_SET_SIGNALS
         // Some people want to know if the incoming set has changed...
@@ -317,12 +414,12 @@ public:
     getIncomingSet(OutputIterator result) const
     {
         if (nullptr == _incoming_set) return result;
-        std::lock_guard<std::mutex> lck(_mtx);
+        std::lock_guard<AtomLock> lck(_mtx);
         for (const auto& bucket : _incoming_set->_iset)
         {
-            for (const WinkPtr& w : bucket.second)
+            for (const InSet::Edge& e : bucket.links)
             {
-                Handle h(std::static_pointer_cast<Atom>(w.lock()));
+                Handle h(std::static_pointer_cast<Atom>(e.wink.lock()));
                 if (h) { *result = h; result ++; }
             }
         }
@@ -345,6 +442,41 @@ public:
         return false;
     }
 
+    //! Walk the incoming set in place, calling `cb(Link*)` on each
+    //! link in it, until the callback returns true; then stop, and
+    //! return true. Return false if the callback never returned true.
+    //!
+    //! Unlike the above, this makes no copy of the incoming set: the
+    //! walk is done with the atom lock held. Nothing is allocated,
+    //! and no reference counts are touched; a callback that wants to
+    //! keep a link should take `l->get_handle()`. The link pointer is
+    //! valid only for the duration of the callback. The callback must
+    //! not add or remove links that contain this atom, nor walk the
+    //! incoming set of this atom; that would deadlock.
+    template <typename Callable>
+    bool foreach_incoming(Callable cb) const
+    {
+        if (nullptr == _incoming_set) return false;
+        std::lock_guard<AtomLock> lck(_mtx);
+        for (const auto& bucket : _incoming_set->_iset)
+            for (const InSet::Edge& e : bucket.links)
+                if (not e.wink.expired() and cb(e.link)) return true;
+        return false;
+    }
+
+    //! As above, but visit only the links of type `type`.
+    template <typename Callable>
+    bool foreach_incoming(Type type, Callable cb) const
+    {
+        if (nullptr == _incoming_set) return false;
+        std::lock_guard<AtomLock> lck(_mtx);
+        const InSet::Bucket* bucket = _incoming_set->find(type);
+        if (nullptr == bucket) return false;
+        for (const InSet::Edge& e : bucket->links)
+            if (not e.wink.expired() and cb(e.link)) return true;
+        return false;
+    }
+
     /**
      * Return all atoms of type `type` that contain this atom.
      * That is, return all atoms that contain this atom, and are
@@ -357,14 +489,14 @@ public:
     getIncomingSetByType(OutputIterator result, Type type) const
     {
         if (nullptr == _incoming_set) return result;
-        std::lock_guard<std::mutex> lck(_mtx);
+        std::lock_guard<AtomLock> lck(_mtx);
 
-        const auto bucket = _incoming_set->_iset.find(type);
-        if (bucket == _incoming_set->_iset.cend()) return result;
+        const InSet::Bucket* bucket = _incoming_set->find(type);
+        if (nullptr == bucket) return result;
 
-        for (const WinkPtr& w : bucket->second)
+        for (const InSet::Edge& e : bucket->links)
         {
-            Handle h(std::static_pointer_cast<Atom>(w.lock()));
+            Handle h(std::static_pointer_cast<Atom>(e.wink.lock()));
             if (h) { *result = h; result ++; }
         }
         return result;
@@ -376,6 +508,13 @@ public:
     /** Return the size of the incoming set, for the given type. */
     size_t getIncomingSetSizeByType(Type type) const;
 
+    /**
+     * As above, but in constant time, and so only approximately: links
+     * that have expired, but have not yet been compacted away, are also
+     * counted. Good enough for search-cost estimates.
+     */
+    size_t getIncomingSetSizeHint(Type type) const;
+
     /** Returns a string representation of the node. */
     virtual std::string to_string(const std::string& indent) const = 0;
     virtual std::string to_short_string(const std::string& indent) const = 0;
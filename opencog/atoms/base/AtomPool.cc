@@ -0,0 +1,319 @@
+/*
+ * opencog/atoms/base/AtomPool.cc
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+#include "AtomPool.h"
+
+using namespace opencog;
+
+namespace {
+
+const size_t NCLASSES = AtomPool::MAX_SIZE / AtomPool::GRAIN;
+
+// Slabs are aligned on their size, so that the slab of a block is
+// found by masking its address.
+const size_t SLAB_SIZE = AtomPool::SLAB_SIZE;
+
+struct Cache;
+
+struct Block
+{
+	Block* next;
+};
+
+// The header at the start of each slab; the blocks follow it.
+//
+// A slab is either owned by one thread, which allocates from it,
+// or is unowned. The owner pushes and pops blocks on the free list
+// without any lock. Other threads return blocks to an owned slab
+// through the remote list, and to an unowned slab straight onto the
+// free list; either way, holding the lock of the size class. The
+// owner changes only with that lock held, too.
+//
+// An unowned slab with free blocks is on the partial list of its
+// class, where threads that need a new slab look first. An unowned
+// slab with no blocks in use is given back to the system.
+struct Slab
+{
+	size_t cls;
+	size_t nblocks;
+	std::atomic<size_t> used;
+	std::atomic<Cache*> owner;
+	Block* free;
+	std::atomic<Block*> remote;
+
+	// Links of the partial list.
+	Slab* prev;
+	Slab* next;
+	bool partial;
+};
+
+struct SizeClass
+{
+	std::mutex mtx;
+	Slab* partial = nullptr;
+};
+
+struct Shared
+{
+	SizeClass classes[NCLASSES];
+	std::atomic<size_t> slab_bytes{0};
+};
+
+// Never destroyed, so that atoms released during static destruction
+// can still be freed.
+Shared& shared(void)
+{
+	static Shared* s = new Shared;
+	return *s;
+}
+
+// Trivially destructible, so that it is still usable after the
+// thread's CacheGuard is gone.
+struct Cache
+{
+	Slab* slab[NCLASSES];
+	bool dead;
+};
+
+thread_local Cache cache;
+
+inline size_t block_size(size_t cls)
+{
+	return (cls + 1) * AtomPool::GRAIN;
+}
+
+inline Slab* slab_of(void* p)
+{
+	return reinterpret_cast<Slab*>(
+		reinterpret_cast<uintptr_t>(p) & ~(uintptr_t) (SLAB_SIZE - 1));
+}
+
+// Get a fresh slab from the system, and carve it into blocks.
+Slab* new_slab(size_t cls)
+{
+	void* mem;
+	if (posix_memalign(&mem, SLAB_SIZE, SLAB_SIZE))
+		throw std::bad_alloc();
+	shared().slab_bytes += SLAB_SIZE;
+
+	Slab* s = static_cast<Slab*>(mem);
+	size_t bsz = block_size(cls);
+	size_t start = (sizeof(Slab) + bsz - 1) / bsz * bsz;
+	s->cls = cls;
+	s->nblocks = (SLAB_SIZE - start) / bsz;
+	s->used = 0;
+	s->owner = nullptr;
+	s->remote = nullptr;
+	s->prev = s->next = nullptr;
+	s->partial = false;
+
+	char* blk = static_cast<char*>(mem) + start;
+	for (size_t i = 0; i + 1 < s->nblocks; i++)
+		reinterpret_cast<Block*>(blk + i * bsz)->next =
+			reinterpret_cast<Block*>(blk + (i + 1) * bsz);
+	reinterpret_cast<Block*>(blk + (s->nblocks - 1) * bsz)->next = nullptr;
+	s->free = reinterpret_cast<Block*>(blk);
+	return s;
+}
+
+// Give the slab back to the system. Must hold the class lock, and
+// the slab must be unowned, with no blocks in use.
+void release_slab(SizeClass& sc, Slab* s)
+{
+	if (s->partial)
+	{
+		if (s->prev) s->prev->next = s->next;
+		else sc.partial = s->next;
+		if (s->next) s->next->prev = s->prev;
+	}
+	shared().slab_bytes -= SLAB_SIZE;
+	::free(s);
+}
+
+// Put an unowned slab that has free blocks on the partial list.
+// Must hold the class lock.
+void add_partial(SizeClass& sc, Slab* s)
+{
+	if (s->partial) return;
+	s->partial = true;
+	s->prev = nullptr;
+	s->next = sc.partial;
+	if (sc.partial) sc.partial->prev = s;
+	sc.partial = s;
+}
+
+// Take a slab with free blocks off the partial list, or get a fresh
+// one. Must hold the class lock.
+Slab* take_slab(SizeClass& sc, size_t cls)
+{
+	Slab* s = sc.partial;
+	if (nullptr == s) return new_slab(cls);
+
+	sc.partial = s->next;
+	if (sc.partial) sc.partial->prev = nullptr;
+	s->partial = false;
+	return s;
+}
+
+// Move the blocks that other threads returned onto the free list.
+// Only the owner may do this, or anyone holding the class lock, if
+// the slab is unowned.
+void collect_remote(Slab* s)
+{
+	Block* b = s->remote.exchange(nullptr, std::memory_order_acquire);
+	while (b)
+	{
+		Block* next = b->next;
+		b->next = s->free;
+		s->free = b;
+		b = next;
+	}
+}
+
+// Stop owning the slab: give it back, put it on the partial list,
+// or leave it, when full, for the next free to find.
+void disown(size_t cls, Slab* s)
+{
+	SizeClass& sc = shared().classes[cls];
+	std::lock_guard<std::mutex> lck(sc.mtx);
+	collect_remote(s);
+	s->owner = nullptr;
+	if (0 == s->used)
+		release_slab(sc, s);
+	else if (s->free)
+		add_partial(sc, s);
+}
+
+// Give up the thread's slabs when the thread exits, so that they can
+// be used by the others, or given back once their atoms are freed.
+struct CacheGuard
+{
+	~CacheGuard()
+	{
+		for (size_t cls = 0; cls < NCLASSES; cls++)
+		{
+			if (cache.slab[cls]) disown(cls, cache.slab[cls]);
+			cache.slab[cls] = nullptr;
+		}
+		cache.dead = true;
+	}
+};
+
+thread_local CacheGuard guard;
+
+// Allocate for a thread that has no cache any more; the slab is not
+// kept, but goes straight back onto the partial list.
+void* allocate_unowned(size_t cls)
+{
+	SizeClass& sc = shared().classes[cls];
+	std::lock_guard<std::mutex> lck(sc.mtx);
+	Slab* s = take_slab(sc, cls);
+	Block* b = s->free;
+	s->free = b->next;
+	s->used++;
+	if (s->free) add_partial(sc, s);
+	return b;
+}
+
+} // anonymous namespace
+
+void* AtomPool::allocate(size_t sz)
+{
+	if (0 == sz or MAX_SIZE < sz) return ::operator new(sz);
+	size_t cls = (sz - 1) / GRAIN;
+
+	if (cache.dead) return allocate_unowned(cls);
+
+	Slab* s = cache.slab[cls];
+	if (s and nullptr == s->free)
+		collect_remote(s);
+
+	if (nullptr == s or nullptr == s->free)
+	{
+		// Touch the guard, so that its destructor runs at thread exit.
+		(void) &guard;
+		if (s) disown(cls, s);
+
+		SizeClass& sc = shared().classes[cls];
+		std::lock_guard<std::mutex> lck(sc.mtx);
+		s = take_slab(sc, cls);
+		s->owner = &cache;
+		collect_remote(s);
+		cache.slab[cls] = s;
+	}
+
+	Block* b = s->free;
+	s->free = b->next;
+	s->used.fetch_add(1, std::memory_order_relaxed);
+	return b;
+}
+
+void AtomPool::deallocate(void* p, size_t sz)
+{
+	if (nullptr == p) return;
+	if (0 == sz or MAX_SIZE < sz) { ::operator delete(p); return; }
+
+	Block* b = static_cast<Block*>(p);
+	Slab* s = slab_of(p);
+
+	// Only this thread can make it stop owning the slab, so there is
+	// no race here.
+	if (not cache.dead and
+	    s->owner.load(std::memory_order_relaxed) == &cache)
+	{
+		b->next = s->free;
+		s->free = b;
+		s->used.fetch_sub(1, std::memory_order_relaxed);
+		return;
+	}
+
+	SizeClass& sc = shared().classes[s->cls];
+	std::lock_guard<std::mutex> lck(sc.mtx);
+	if (s->owner)
+	{
+		Block* head = s->remote.load(std::memory_order_relaxed);
+		do b->next = head;
+		while (not s->remote.compare_exchange_weak(head, b,
+		             std::memory_order_release, std::memory_order_relaxed));
+		s->used.fetch_sub(1, std::memory_order_relaxed);
+		return;
+	}
+
+	b->next = s->free;
+	s->free = b;
+	if (0 == --s->used)
+		release_slab(sc, s);
+	else
+		add_partial(sc, s);
+}
+
+size_t AtomPool::slab_bytes(void)
+{
+	return shared().slab_bytes;
+}
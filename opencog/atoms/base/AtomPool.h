@@ -0,0 +1,97 @@
+/*
+ * opencog/atoms/base/AtomPool.h
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_ATOM_POOL_H
+#define _OPENCOG_ATOM_POOL_H
+
+#include <cstddef>
+
+namespace opencog
+{
+/** \addtogroup grp_atomspace
+ *  @{
+ */
+
+/**
+ * A size-class pool for the memory of Nodes and Links.
+ *
+ * Requests are rounded up to a multiple of GRAIN bytes, and served
+ * from 64 KB slabs that are carved into blocks of that size. Each
+ * thread allocates from a slab of its own, one for each size, and
+ * returns blocks to it, without taking any lock. Blocks freed by
+ * other threads are handed back to the owner under the lock of the
+ * size class; so are slabs, when a thread is done with them.
+ *
+ * A slab is given back to the system as soon as all of its blocks
+ * are free and no thread is allocating from it. Thus, the memory of
+ * a transient AtomSpace, or of any other bunch of atoms created
+ * together, is released once they are all gone; the Handles that
+ * still point at some of them merely keep their slabs. Each thread
+ * holds on to at most one slab of each size. Requests larger than
+ * MAX_SIZE go to the global operator new.
+ */
+class AtomPool
+{
+public:
+	static const size_t GRAIN = 16;
+	static const size_t MAX_SIZE = 512;
+	static const size_t SLAB_SIZE = 64 * 1024;
+
+	static void* allocate(size_t);
+	static void deallocate(void*, size_t);
+
+	/// Bytes of the slabs currently obtained from the system.
+	static size_t slab_bytes(void);
+};
+
+/**
+ * Allocator adapter, for std::allocate_shared(). The control block
+ * of the shared_ptr and the atom then share a single pool block.
+ */
+template<class T>
+struct PoolAllocator
+{
+	typedef T value_type;
+
+	PoolAllocator(void) noexcept {}
+	template<class U>
+	PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+	T* allocate(size_t n)
+	{
+		return static_cast<T*>(AtomPool::allocate(n * sizeof(T)));
+	}
+	void deallocate(T* p, size_t n) noexcept
+	{
+		AtomPool::deallocate(p, n * sizeof(T));
+	}
+
+	template<class U>
+	bool operator==(const PoolAllocator<U>&) const noexcept { return true; }
+	template<class U>
+	bool operator!=(const PoolAllocator<U>&) const noexcept { return false; }
+};
+
+/** @}*/
+} // namespace opencog
+
+#endif // _OPENCOG_ATOM_POOL_H
@@ -28,6 +28,7 @@
 
 #include <opencog/atoms/atom_types/NameServer.h>
 #include <opencog/atoms/base/Node.h>
+#include <opencog/atoms/base/hash.h>
 #include <opencog/atomspace/AtomTable.h>
 
 #include <boost/range/algorithm.hpp>
@@ -163,19 +164,10 @@ bool Link::operator<(const Atom& other) const
 /// chains the hash values of the child atoms, as well.
 ContentHash Link::compute_hash() const
 {
-	// 1<<44 - 377 is prime
-	ContentHash hsh = ((1UL<<44) - 377) * get_type();
-	for (const Handle& h: _outgoing)
-	{
-		hsh += (hsh <<5) ^ (353 * h->get_hash()); // recursive!
-
-		// Bit-mixing copied from murmur64. Yes, this is needed.
-		hsh ^= hsh >> 33;
-		hsh *= 0xff51afd7ed558ccdL;
-		hsh ^= hsh >> 33;
-		hsh *= 0xc4ceb9fe1a85ec53L;
-		hsh ^= hsh >> 33;
-	}
+	// One pass over the outgoing set, in order; the type is the seed.
+	ContentHash hsh = hash_words(_outgoing.begin(), _outgoing.size(),
+		get_type(),
+		[](const Handle& h) { return h->get_hash(); }); // recursive!
 
 	// Links will always have the MSB set.
 	ContentHash mask = ((ContentHash) 1UL) << (8*sizeof(ContentHash) - 1);
@@ -28,6 +28,7 @@
 
 #include <opencog/util/oc_assert.h>
 #include <opencog/atoms/base/Atom.h>
+#include <opencog/atoms/base/AtomPool.h>
 #include <opencog/atoms/base/ClassServer.h>
 
 namespace opencog
@@ -246,7 +247,7 @@ template< class... Args >
 Handle createLink( Args&&... args )
 {
 	// Do we need to say (std::forward<Args>(args)...) instead ???
-	LinkPtr tmp(std::make_shared<Link>(args ...));
+	LinkPtr tmp(std::allocate_shared<Link>(PoolAllocator<Link>(), args ...));
 	return classserver().factory(tmp->get_handle());
 }
 
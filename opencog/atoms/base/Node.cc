@@ -26,6 +26,7 @@
 #include <opencog/util/Logger.h>
 #include <opencog/atoms/atom_types/NameServer.h>
 #include <opencog/atoms/base/Link.h>
+#include <opencog/atoms/base/hash.h>
 
 #include "Node.h"
 
@@ -103,10 +104,10 @@ bool Node::operator<(const Atom& other) const
 
 ContentHash Node::compute_hash() const
 {
-	ContentHash hsh = std::hash<std::string>()(get_name());
-
-	// 1<<43 - 369 is a prime number.
-	hsh += (hsh<<5) + ((1UL<<43)-369) * get_type();
+	// The type is the seed, so that nodes of different types, with
+	// the same name, get unrelated hashes.
+	const std::string& name = get_name();
+	ContentHash hsh = hash_bytes(name.data(), name.size(), get_type());
 
 	// Nodes will never have the MSB set.
 	ContentHash mask = ~(((ContentHash) 1UL) << (8*sizeof(ContentHash) - 1));
@@ -28,6 +28,7 @@
 
 #include <opencog/util/oc_assert.h>
 #include <opencog/atoms/base/Atom.h>
+#include <opencog/atoms/base/AtomPool.h>
 #include <opencog/atoms/base/ClassServer.h>
 
 namespace opencog
@@ -129,7 +130,7 @@ template< class... Args >
 Handle createNode( Args&&... args )
 {
    // Do we need to say (std::forward<Args>(args)...) instead ???
-   NodePtr tmp(std::make_shared<Node>(args ...));
+   NodePtr tmp(std::allocate_shared<Node>(PoolAllocator<Node>(), args ...));
    return classserver().factory(tmp->get_handle());
 }
 
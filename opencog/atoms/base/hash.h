@@ -1,6 +1,9 @@
 #ifndef _OPENCOG_HASH_H
 #define _OPENCOG_HASH_H
 
+#include <cstdint>
+#include <cstring>
+
 #include <opencog/atoms/base/Handle.h>
 
 namespace opencog {
@@ -61,6 +64,115 @@ typename std::enable_if<sizeof(ContentHash) < sizeof(T), ContentHash>::type fnv1
 	return hval;
 }
 
+// ---------------------------------------------------------------
+// Multiply-and-fold hashing, after wyhash by Wang Yi (public domain):
+// https://github.com/wangyi-fudan/wyhash
+// Each step is a single 64x64->128 bit multiply, whose two halves
+// are xor-ed together. This mixes as well as the murmur64 finalizer,
+// in one multiply instead of two, and takes two 64-bit words per step.
+
+const uint64_t HASH_SECRET_0 = 0xa0761d6478bd642full;
+const uint64_t HASH_SECRET_1 = 0xe7037ed1a0b428dbull;
+const uint64_t HASH_SECRET_2 = 0x8ebc6af09c88c6e3ull;
+const uint64_t HASH_SECRET_3 = 0x589965cc75374cc3ull;
+
+/// Multiply to 128 bits; return the low and high halves in a and b.
+static inline void hash_mum(uint64_t& a, uint64_t& b)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t) a * b;
+	a = (uint64_t) r;
+	b = (uint64_t) (r >> 64);
+#else
+	uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t) a, lb = (uint32_t) b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32);
+	uint64_t c = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+	a = lo;
+#endif
+}
+
+/// Multiply to 128 bits, and fold the halves together.
+static inline uint64_t hash_mix(uint64_t a, uint64_t b)
+{
+	hash_mum(a, b);
+	return a ^ b;
+}
+
+static inline uint64_t hash_read8(const uint8_t* p)
+{
+	uint64_t v; memcpy(&v, p, 8); return v;
+}
+
+static inline uint64_t hash_read4(const uint8_t* p)
+{
+	uint32_t v; memcpy(&v, p, 4); return v;
+}
+
+/// Hash a string of bytes. Strings of up to 16 bytes, which is most
+/// atom names, take two multiplies and no loop.
+static inline uint64_t hash_bytes(const void* key, size_t len, uint64_t seed)
+{
+	const uint8_t* p = (const uint8_t*) key;
+	seed ^= hash_mix(seed ^ HASH_SECRET_0, HASH_SECRET_1);
+
+	uint64_t a, b;
+	if (len <= 16)
+	{
+		if (4 <= len)
+		{
+			// Overlapping reads cover all of the bytes.
+			size_t off = (len >> 3) << 2;
+			a = (hash_read4(p) << 32) | hash_read4(p + off);
+			b = (hash_read4(p + len - 4) << 32) | hash_read4(p + len - 4 - off);
+		}
+		else if (0 < len)
+		{
+			a = (((uint64_t) p[0]) << 16) | (((uint64_t) p[len >> 1]) << 8) |
+			    p[len - 1];
+			b = 0;
+		}
+		else a = b = 0;
+	}
+	else
+	{
+		size_t i = len;
+		for (; 16 < i; i -= 16, p += 16)
+			seed = hash_mix(hash_read8(p) ^ HASH_SECRET_1,
+			                hash_read8(p + 8) ^ seed);
+		a = hash_read8(p + i - 16);
+		b = hash_read8(p + i - 8);
+	}
+
+	a ^= HASH_SECRET_1;
+	b ^= seed;
+	hash_mum(a, b);
+	return hash_mix(a ^ HASH_SECRET_0 ^ len, b ^ HASH_SECRET_1);
+}
+
+/// Hash a sequence of 64-bit words, such as the hashes of the atoms
+/// in an outgoing set, in order. Two words are taken per multiply,
+/// so a sequence of n words costs n/2 + 2 multiplies.
+template<typename Iter, typename Get>
+static inline uint64_t hash_words(Iter begin, size_t len, uint64_t seed,
+                                  Get get)
+{
+	seed ^= hash_mix(seed ^ HASH_SECRET_0, HASH_SECRET_1);
+	Iter it = begin;
+	size_t i = len;
+	for (; 1 < i; i -= 2)
+	{
+		uint64_t a = get(*it); ++it;
+		uint64_t b = get(*it); ++it;
+		seed = hash_mix(a ^ HASH_SECRET_1, b ^ seed);
+	}
+	if (i) { seed = hash_mix(get(*it) ^ HASH_SECRET_2, seed ^ HASH_SECRET_1); }
+	return hash_mix(seed ^ HASH_SECRET_3 ^ len, HASH_SECRET_1);
+}
+
 } // namespace opencog
 
 #endif // _OPENCOG_HASH_H
@@ -40,23 +40,19 @@ void UniqueLink::init(bool allow_open)
 	}
 
 	const Handle& alias = _outgoing[0];
-	IncomingSet defs = alias->getIncomingSetByType(_type);
-	for (const LinkPtr& def : defs)
+	bool redefined = alias->foreach_incoming(_type, [&](Link* def)
 	{
-		if (def->getOutgoingAtom(0) == alias)
-		{
-			size_t sz = _outgoing.size();
-			for (size_t i=1; i<sz; i++)
-			{
-				if (def->getOutgoingAtom(i) != _outgoing[i])
-				{
-					throw InvalidParamException(TRACE_INFO,
-					      "Already defined: %s\n",
-					       alias->to_string().c_str());
-				}
-			}
-		}
-	}
+		if (def->getOutgoingAtom(0) != alias) return false;
+		size_t sz = _outgoing.size();
+		for (size_t i=1; i<sz; i++)
+			if (def->getOutgoingAtom(i) != _outgoing[i]) return true;
+		return false;
+	});
+
+	if (redefined)
+		throw InvalidParamException(TRACE_INFO,
+		      "Already defined: %s\n",
+		       alias->to_string().c_str());
 }
 
 UniqueLink::UniqueLink(const HandleSeq& oset, Type type)
@@ -104,22 +100,22 @@ Handle UniqueLink::get_unique(const Handle& alias, Type type,
 	// Get all UniqueLinks associated with the alias. Be aware that
 	// the incoming set will also include those UniqueLinks which
 	// have the alias in a position other than the first.
-	IncomingSet defs = alias->getIncomingSetByType(type);
-
 	// Return the first (supposedly unique) definition that has no
-	// variables in it.
-	for (const LinkPtr& defl : defs)
+	// variables in it.  The incoming set is walked in place; only
+	// the definition that is found gets a handle made for it.
+	Handle def;
+	alias->foreach_incoming(type, [&](Link* defl)
 	{
-		if (defl->getOutgoingAtom(0) == alias)
+		if (defl->getOutgoingAtom(0) != alias) return false;
+		if (allow_open)
 		{
-			if (allow_open)
-			{
-				UniqueLinkPtr ulp(UniqueLinkCast(defl));
-				if (0 < ulp->get_vars().varseq.size()) continue;
-			}
-			return defl->get_handle();
+			UniqueLink* ulp = dynamic_cast<UniqueLink*>(defl);
+			if (0 < ulp->get_vars().varseq.size()) return false;
 		}
-	}
+		def = defl->get_handle();
+		return true;
+	});
+	if (def) return def;
 
 	// There is no definition for the alias.
 	throw InvalidParamException(TRACE_INFO,
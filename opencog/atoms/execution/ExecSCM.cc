@@ -8,12 +8,20 @@
 #ifdef HAVE_GUILE
 
 #include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <libguile.h>
+
 #include <opencog/atoms/base/Link.h>
 #include <opencog/atomspace/AtomSpace.h>
 #include <opencog/atoms/execution/EvaluationLink.h>
 #include <opencog/atoms/execution/Instantiator.h>
 #include <opencog/atoms/reduct/FoldLink.h>
+#include <opencog/atoms/value/StringValue.h>
 #include <opencog/guile/SchemeModule.h>
+#include <opencog/query/QueryProfile.h>
+#include <opencog/query/ResultStream.h>
 
 #include "ExecSCM.h"
 
@@ -43,6 +51,104 @@ static TruthValuePtr ss_evaluate(AtomSpace* atomspace, const Handle& h)
 	return EvaluationLink::do_evaluate(atomspace, h);
 }
 
+/**
+ * cog-explain! runs a query, and reports how the search was done.
+ */
+static ValuePtr ss_explain(AtomSpace* atomspace, const Handle& h)
+{
+	return createStringValue(explain_query(atomspace, h));
+}
+
+// ========================================================
+
+// The open result streams, one per query, in each atomspace.
+typedef std::pair<AtomSpace*, Handle> StreamKey;
+static std::mutex stream_mtx;
+static std::map<StreamKey, std::shared_ptr<ResultStream>> streams;
+
+static std::shared_ptr<ResultStream> get_stream(AtomSpace* as,
+                                                const Handle& h)
+{
+	std::lock_guard<std::mutex> lck(stream_mtx);
+	auto it = streams.find(StreamKey(as, h));
+	if (streams.end() == it) return nullptr;
+	return it->second;
+}
+
+/**
+ * cog-stream-open! starts running a query in the background, and
+ * returns the query. Its results are then taken one at a time with
+ * cog-stream-next!. Opening a query that is already open starts it
+ * over again.
+ */
+static Handle ss_stream_open(AtomSpace* atomspace, const Handle& h)
+{
+	std::shared_ptr<ResultStream> rs(
+		std::make_shared<ResultStream>(atomspace, h));
+
+	std::shared_ptr<ResultStream> old;
+	{
+		std::lock_guard<std::mutex> lck(stream_mtx);
+		std::shared_ptr<ResultStream>& slot(streams[StreamKey(atomspace, h)]);
+		old.swap(slot);
+		slot = rs;
+	}
+	if (old) old->cancel();
+	return h;
+}
+
+static void* wait_next(void* data)
+{
+	std::pair<ResultStream*, ValuePtr>* rv =
+		(std::pair<ResultStream*, ValuePtr>*) data;
+	rv->second = rv->first->next();
+	return nullptr;
+}
+
+/**
+ * cog-stream-next! returns the next result of an open query, waiting
+ * for it if need be, or the empty list, once there are no more. The
+ * query is then closed.
+ */
+static ValuePtr ss_stream_next(AtomSpace* atomspace, const Handle& h)
+{
+	std::shared_ptr<ResultStream> rs(get_stream(atomspace, h));
+	if (nullptr == rs)
+		throw InvalidParamException(TRACE_INFO,
+			"No open stream for %s", h->to_short_string().c_str());
+
+	// Leave guile while waiting, so that the search thread, and the
+	// garbage collector, can run scheme code in the meantime.
+	std::pair<ResultStream*, ValuePtr> rv(rs.get(), nullptr);
+	scm_without_guile(wait_next, &rv);
+
+	if (nullptr == rv.second)
+	{
+		std::lock_guard<std::mutex> lck(stream_mtx);
+		auto it = streams.find(StreamKey(atomspace, h));
+		if (streams.end() != it and it->second == rs)
+			streams.erase(it);
+	}
+	return rv.second;
+}
+
+/**
+ * cog-stream-close! stops an open query, and drops its results.
+ */
+static Handle ss_stream_close(AtomSpace* atomspace, const Handle& h)
+{
+	std::shared_ptr<ResultStream> rs;
+	{
+		std::lock_guard<std::mutex> lck(stream_mtx);
+		auto it = streams.find(StreamKey(atomspace, h));
+		if (streams.end() == it) return h;
+		rs.swap(it->second);
+		streams.erase(it);
+	}
+	rs->cancel();
+	return h;
+}
+
 // ========================================================
 
 // XXX HACK ALERT This needs to be static, in order for python to
@@ -67,6 +173,18 @@ void ExecSCM::init(void)
 
 	_binders->push_back(new FunctionWrap(ss_evaluate,
 	                   "cog-evaluate!", "exec"));
+
+	_binders->push_back(new FunctionWrap(ss_explain,
+	                   "cog-explain!", "exec"));
+
+	_binders->push_back(new FunctionWrap(ss_stream_open,
+	                   "cog-stream-open!", "exec"));
+
+	_binders->push_back(new FunctionWrap(ss_stream_next,
+	                   "cog-stream-next!", "exec"));
+
+	_binders->push_back(new FunctionWrap(ss_stream_close,
+	                   "cog-stream-close!", "exec"));
 }
 
 ExecSCM::~ExecSCM()
@@ -25,6 +25,7 @@
 #define _OPENCOG_PATTERN_H
 
 #include <map>
+#include <memory>
 #include <set>
 #include <stack>
 #include <unordered_map>
@@ -37,6 +38,8 @@
 
 namespace opencog {
 
+struct SearchPlan;
+
 /** \addtogroup grp_atomspace
  *  @{
  */
@@ -131,6 +134,11 @@ struct Pattern
 
 	ConnectTermMap   connected_terms_map;  // setup by make_term_trees()
 
+	/// The search strategy chosen by the pattern matcher the last time
+	/// this pattern was run; see query/SearchPlan.h.  Created on first
+	/// use; shared by copies of the pattern.
+	mutable std::shared_ptr<SearchPlan> search_plan;
+
 	std::string to_string(const std::string& indent) const;
 };
 
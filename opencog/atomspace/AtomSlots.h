@@ -0,0 +1,181 @@
+/*
+ * opencog/atomspace/AtomSlots.h
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_ATOM_SLOTS_H
+#define _OPENCOG_ATOM_SLOTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include <opencog/atoms/base/Atom.h>
+
+namespace opencog
+{
+/** \addtogroup grp_atomspace
+ *  @{
+ */
+
+/**
+ * A dense, unordered collection of Atom pointers, used by the
+ * TypeIndex to hold all of the atoms of one type.
+ *
+ * The atoms are kept in a single vector of slots, so that a scan
+ * walks contiguous memory instead of hopping from one hash-bucket
+ * node to the next.  Each atom remembers which slot it occupies, so
+ * that removal does not need to search. A removed atom leaves a
+ * tombstone (a null slot) behind; tombstones are put on a free list,
+ * and re-used by the next insertions. If too many tombstones pile up,
+ * the vector is compacted.
+ *
+ * An atom can be held in at most one AtomSlots at a time, since the
+ * slot number is stored in the atom.  This is the case for the
+ * TypeIndex: an atom belongs to only one AtomTable, and has only
+ * one type.
+ *
+ * This offers the subset of the std::unordered_set API that the
+ * TypeIndex uses. Like the unordered_set, insertion and removal
+ * invalidate iterators.
+ */
+class AtomSlots
+{
+private:
+	// Null entries are tombstones.
+	std::vector<Atom*> _slots;
+	std::vector<uint32_t> _free;
+	size_t _size;
+
+	bool holds(const Atom* a) const
+	{
+		return a->_type_index_slot < _slots.size() and
+			_slots[a->_type_index_slot] == a;
+	}
+
+	/// Squeeze out all of the tombstones.
+	void compact(void)
+	{
+		size_t j = 0;
+		for (Atom* a : _slots)
+		{
+			if (nullptr == a) continue;
+			a->_type_index_slot = j;
+			_slots[j++] = a;
+		}
+		_slots.resize(j);
+		_free.clear();
+	}
+
+public:
+	AtomSlots(void) : _size(0) {}
+
+	class const_iterator
+	{
+		friend class AtomSlots;
+	private:
+		Atom* const* _p;
+		Atom* const* _end;
+
+		const_iterator(Atom* const* p, Atom* const* e) : _p(p), _end(e)
+		{
+			while (_p != _end and nullptr == *_p) _p++;
+		}
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef Atom* value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef Atom* const* pointer;
+		typedef Atom* const& reference;
+
+		const_iterator(void) : _p(nullptr), _end(nullptr) {}
+
+		Atom* operator*(void) const { return *_p; }
+		const_iterator& operator++(void)
+		{
+			do { _p++; } while (_p != _end and nullptr == *_p);
+			return *this;
+		}
+		const_iterator operator++(int)
+		{
+			const_iterator it(*this); operator++(); return it;
+		}
+		bool operator==(const const_iterator& v) const { return _p == v._p; }
+		bool operator!=(const const_iterator& v) const { return _p != v._p; }
+	};
+	typedef const_iterator iterator;
+
+	const_iterator begin(void) const
+	{
+		return const_iterator(_slots.data(), _slots.data() + _slots.size());
+	}
+	const_iterator end(void) const
+	{
+		Atom* const* e = _slots.data() + _slots.size();
+		return const_iterator(e, e);
+	}
+
+	size_t size(void) const { return _size; }
+	bool empty(void) const { return 0 == _size; }
+	void reserve(size_t n) { _slots.reserve(n); }
+
+	void insert(Atom* a)
+	{
+		if (holds(a)) return;
+		if (_free.empty())
+		{
+			a->_type_index_slot = _slots.size();
+			_slots.push_back(a);
+		}
+		else
+		{
+			a->_type_index_slot = _free.back();
+			_free.pop_back();
+			_slots[a->_type_index_slot] = a;
+		}
+		_size++;
+	}
+
+	size_t erase(Atom* a)
+	{
+		if (not holds(a)) return 0;
+		_slots[a->_type_index_slot] = nullptr;
+		_free.push_back(a->_type_index_slot);
+		a->_type_index_slot = UINT32_MAX;
+		_size--;
+
+		// Don't let a scan wade through mostly empty slots.
+		if (_size < _free.size() and 64 < _free.size()) compact();
+		return 1;
+	}
+
+	void clear(void)
+	{
+		_slots.clear();
+		_free.clear();
+		_size = 0;
+	}
+};
+
+/** @}*/
+} //namespace opencog
+
+#endif // _OPENCOG_ATOM_SLOTS_H
@@ -240,6 +240,25 @@ bool AtomSpace::operator!=(const AtomSpace& other) const
     return not operator==(other);
 }
 
+/// The fan-outs of the tables are combined by weighting each with the
+/// number of links it was taken over; that is the fan-out that a
+/// single table holding all of the links would have, if no atom is
+/// held by links in more than one of them.
+double AtomSpace::get_fan_out(Type t, size_t pos) const
+{
+    double squares = 0.0;
+    size_t links = 0;
+    for (const AtomSpace* as = this; as; as = as->get_environ())
+    {
+        std::pair<size_t, double> fan(as->_atom_table.getFanOut(t, pos));
+        if (0 == fan.first) continue;
+        squares += fan.second * fan.first;
+        links += fan.first;
+    }
+    if (0 == links) return 0.0;
+    return squares / links;
+}
+
 
 // ====================================================================
 
@@ -55,6 +55,7 @@ class AtomSpace
 {
     friend class Atom;               // Needs to call get_atomtable()
     friend class BackingStore;
+    friend class SnapshotStorage;    // Needs to call get_atomtable()
     friend class SQLAtomStorage;     // Needs to call get_atomtable()
     friend class ZMQPersistSCM;
     friend class ::AtomTableUTest;
@@ -128,6 +129,35 @@ public:
         { return _atom_table.getNumAtomsOfType(type, subclass); }
     inline UUID get_uuid(void) const { return _atom_table.get_uuid(); }
 
+    /**
+     * Statistics about the shape of the contents of this atomspace
+     * (not counting its parents), for query planning; see
+     * AtomStatistics.h.
+     */
+    inline const AtomStatistics& get_statistics() const
+        { return _atom_table.getStatistics(); }
+
+    /**
+     * The fan-out of links of type `t` at position `pos`, as in
+     * AtomStatistics::get_fan_out(), but over this atomspace and all
+     * of its parents. Zero if none of them hold any such links, that
+     * is, if the fan-out is not known.
+     */
+    double get_fan_out(Type t, size_t pos) const;
+
+    /**
+     * Pre-size the space for `total` atoms, and optionally the type
+     * index for the given number of atoms of each type, so that
+     * loading that many atoms does not rehash over and over.
+     * See AtomTable::reserve() for details.
+     */
+    void reserve(size_t total, const std::map<Type, size_t>& per_type = {})
+        { _atom_table.reserve(total, per_type); }
+    inline double get_load_factor() const
+        { return _atom_table.getLoadFactor(); }
+    inline size_t get_rehash_count() const
+        { return _atom_table.getRehashCount(); }
+
     //! Clear the atomspace, extract all atoms. Does NOT clear the
     //! attached backingstore.
     void clear()
@@ -231,6 +261,19 @@ public:
         if (_backing_store) _backing_store->barrier();
     }
 
+    /**
+     * Bracket a large load of atoms. Between these two calls, added
+     * atoms are de-duplicated and returned as usual, but they are not
+     * added to the incoming sets or to the type index, and the add
+     * signal is not emitted, until end_bulk() is called; end_bulk()
+     * then does all of that at once, in parallel.  The `expected`
+     * number of atoms, if known, is used to pre-size the table.
+     * See AtomTable::begin_bulk() for details, and AtomTable::BulkLoad
+     * for a guard that ends the load if an exception is thrown.
+     */
+    void begin_bulk(size_t expected=0) { _atom_table.begin_bulk(expected); }
+    void end_bulk(void) { _atom_table.end_bulk(); }
+
     /**
      * Unconditionally fetch an atom from the backingstore.
      *
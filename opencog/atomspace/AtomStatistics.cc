@@ -0,0 +1,188 @@
+/*
+ * opencog/atomspace/AtomStatistics.cc
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <algorithm>
+
+#include <opencog/atoms/base/Link.h>
+#include <opencog/atoms/atom_types/atom_types.h>
+
+#include "AtomStatistics.h"
+
+using namespace opencog;
+
+AtomStatistics::AtomStatistics() :
+    _nameserver(nameserver())
+{
+    for (auto& cnt : _degree) cnt = 0;
+    resize(_nameserver.getNumberOfClasses());
+}
+
+void AtomStatistics::resize(size_t num_types)
+{
+    size_t new_size = num_types * MAX_POSITION;
+    std::vector<std::atomic<long>> links(new_size);
+    std::vector<std::atomic<long>> squares(new_size);
+    for (size_t i = 0; i < new_size; i++)
+    {
+        bool old = i < _links.size();
+        links[i] = old ? _links[i].load() : 0;
+        squares[i] = old ? _squares[i].load() : 0;
+    }
+    _links.swap(links);
+    _squares.swap(squares);
+}
+
+void AtomStatistics::clear()
+{
+    for (auto& cnt : _links) cnt = 0;
+    for (auto& cnt : _squares) cnt = 0;
+    for (auto& cnt : _degree) cnt = 0;
+}
+
+size_t AtomStatistics::slot(Type t, size_t pos) const
+{
+    if (_nameserver.isA(t, UNORDERED_LINK)) pos = 0;
+    else if (MAX_POSITION <= pos) pos = MAX_POSITION - 1;
+    return t * MAX_POSITION + pos;
+}
+
+size_t AtomStatistics::degree_bucket(size_t degree)
+{
+    size_t bucket = 0;
+    while (degree and bucket < DEGREE_BUCKETS - 1)
+    {
+        degree >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void AtomStatistics::move_degree(size_t from, size_t to)
+{
+    size_t bfrom = degree_bucket(from);
+    size_t bto = degree_bucket(to);
+    if (bfrom == bto) return;
+    _degree[bfrom]--;
+    _degree[bto]++;
+}
+
+/* ================================================================ */
+
+void AtomStatistics::add_node(const Atom* node)
+{
+    _degree[degree_bucket(node->getIncomingSetSize())]++;
+}
+
+void AtomStatistics::remove_node(const Atom* node)
+{
+    _degree[degree_bucket(node->getIncomingSetSize())]--;
+}
+
+// If the count of links of type t holding an atom goes from c-1 to
+// c, the sum of the squares of the counts goes up by 2c-1.
+void AtomStatistics::add_link(const Atom* link, const AtomSpace* as,
+                              bool degrees)
+{
+    Type t = link->get_type();
+    const HandleSeq& oset = link->getOutgoingSet();
+    size_t arity = oset.size();
+    for (size_t i = 0; i < arity; i++)
+    {
+        const Handle& h = oset[i];
+        size_t cnt = std::max((size_t) 1, h->getIncomingSetSizeHint(t));
+        size_t s = slot(t, i);
+        _links[s]++;
+        _squares[s] += 2 * cnt - 1;
+
+        // The link is in the incoming set of a repeated atom only once.
+        if (not degrees) continue;
+        if (not h->is_node() or h->getAtomSpace() != as) continue;
+        if (std::find(oset.begin(), oset.begin() + i, h) != oset.begin() + i)
+            continue;
+        size_t degree = h->getIncomingSetSize();
+        if (0 < degree) move_degree(degree - 1, degree);
+    }
+}
+
+void AtomStatistics::remove_link(const Atom* link, const AtomSpace* as)
+{
+    Type t = link->get_type();
+    const HandleSeq& oset = link->getOutgoingSet();
+    size_t arity = oset.size();
+    for (size_t i = 0; i < arity; i++)
+    {
+        const Handle& h = oset[i];
+        size_t cnt = std::max((size_t) 1, h->getIncomingSetSizeHint(t));
+        size_t s = slot(t, i);
+        _links[s]--;
+        _squares[s] -= 2 * cnt - 1;
+
+        if (not h->is_node() or h->getAtomSpace() != as) continue;
+        if (std::find(oset.begin(), oset.begin() + i, h) != oset.begin() + i)
+            continue;
+        size_t degree = h->getIncomingSetSize();
+        if (0 < degree) move_degree(degree, degree - 1);
+    }
+}
+
+void AtomStatistics::uncount_degrees(const std::vector<const Atom*>& nodes)
+{
+    for (const Atom* node : nodes)
+        _degree[degree_bucket(node->getIncomingSetSize())]--;
+}
+
+void AtomStatistics::count_degrees(const std::vector<const Atom*>& nodes)
+{
+    for (const Atom* node : nodes)
+        _degree[degree_bucket(node->getIncomingSetSize())]++;
+}
+
+/* ================================================================ */
+
+size_t AtomStatistics::get_num_links(Type t, size_t pos) const
+{
+    size_t s = slot(t, pos);
+    if (_links.size() <= s) return 0;
+    long n = _links[s];
+    return 0 < n ? n : 0;
+}
+
+double AtomStatistics::get_fan_out(Type t, size_t pos) const
+{
+    size_t s = slot(t, pos);
+    if (_links.size() <= s) return 0.0;
+    long n = _links[s];
+    if (n <= 0) return 0.0;
+    double fan = (double) _squares[s] / n;
+    return fan < 1.0 ? 1.0 : fan;
+}
+
+std::vector<size_t> AtomStatistics::get_degree_histogram(void) const
+{
+    std::vector<size_t> hist(DEGREE_BUCKETS);
+    for (size_t i = 0; i < DEGREE_BUCKETS; i++)
+    {
+        long n = _degree[i];
+        hist[i] = 0 < n ? n : 0;
+    }
+    return hist;
+}
@@ -0,0 +1,136 @@
+/*
+ * opencog/atomspace/AtomStatistics.h
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_ATOM_STATISTICS_H
+#define _OPENCOG_ATOM_STATISTICS_H
+
+#include <atomic>
+#include <vector>
+
+#include <opencog/atoms/base/Atom.h>
+#include <opencog/atoms/atom_types/NameServer.h>
+
+namespace opencog
+{
+class AtomSpace;
+
+/** \addtogroup grp_atomspace
+ *  @{
+ */
+
+/**
+ * Statistics about the shape of the contents of an AtomTable, kept up
+ * to date as atoms are added and removed, for use by query planners.
+ * The number of atoms of each type is kept by the AtomTable itself;
+ * this class keeps the rest:
+ *
+ * -- For each link type and position, the number of links of that
+ *    type holding some atom at that position, and the "fan-out": the
+ *    number of links of that type that hold the same atom, averaged
+ *    over those links.  That is, if the atom at some position of a
+ *    link of that type is known, then the fan-out is the expected
+ *    number of links that have to be looked at, to find them all.
+ *    The fan-out is the sum of the squares of the per-atom counts,
+ *    divided by the sum of the counts; the per-atom count used is
+ *    that of the links of the given type, in any position.
+ *
+ * -- A histogram of the size of the incoming sets of the nodes in
+ *    the table. Bucket 0 counts nodes with an empty incoming set;
+ *    bucket k counts those with between 2^(k-1) and 2^k - 1 links.
+ *
+ * The counts are exact for atoms added and removed one at a time by
+ * a single thread. Concurrent writers, and the bulk-load mode of the
+ * AtomTable, can make them drift by a small factor. They are meant
+ * for cost estimates, and not for anything that has to be exact.
+ *
+ * The AtomTable calls the update methods while holding the lock on
+ * the segment that the changed atom lives in; resize() and clear()
+ * are called with all of the segments locked. resize() reallocates
+ * the counts, and so also holds a lock that readers share; see
+ * AtomTable::getFanOut().
+ */
+class AtomStatistics
+{
+public:
+    /// Positions past this one are lumped together. Positions in
+    /// unordered links are all lumped into position zero.
+    static const size_t MAX_POSITION = 4;
+
+    static const size_t DEGREE_BUCKETS = 33;
+
+private:
+    NameServer& _nameserver;
+
+    // Indexed by type * MAX_POSITION + position. All of the counts
+    // are signed, so that a miscount by concurrent writers cannot
+    // wrap around.
+    std::vector<std::atomic<long>> _links;
+    std::vector<std::atomic<long>> _squares;
+    std::atomic<long> _degree[DEGREE_BUCKETS];
+
+    size_t slot(Type, size_t pos) const;
+    static size_t degree_bucket(size_t);
+    void move_degree(size_t from, size_t to);
+
+public:
+    AtomStatistics();
+
+    void resize(size_t num_types);
+    void clear();
+
+    /// To be called after the node has been added.
+    void add_node(const Atom*);
+    /// To be called before the node is removed.
+    void remove_node(const Atom*);
+
+    /// To be called after the link has been placed into the
+    /// incoming sets of its outgoing atoms. The `as` is that of the
+    /// table: only nodes held by it are counted in the histogram.
+    /// If `degrees` is false, the histogram is left alone.
+    void add_link(const Atom*, const AtomSpace* as, bool degrees=true);
+    /// To be called before the link is taken out of the incoming sets.
+    void remove_link(const Atom*, const AtomSpace* as);
+
+    /// For many links added at once: to be called with the nodes that
+    /// they hold, before and after the links are placed into the
+    /// incoming sets; each node is then moved to its new bucket only
+    /// once. The links themselves are given to add_link(), without
+    /// the degrees.
+    void uncount_degrees(const std::vector<const Atom*>& nodes);
+    void count_degrees(const std::vector<const Atom*>& nodes);
+
+    /// The number of links of type `t` with some atom at position `pos`.
+    size_t get_num_links(Type t, size_t pos) const;
+
+    /// The expected number of links of type `t` that hold the atom
+    /// found at position `pos` of one of them. One or more, if there
+    /// are any such links, else zero.
+    double get_fan_out(Type t, size_t pos) const;
+
+    /// Histogram of the incoming-set sizes of the nodes, as above.
+    std::vector<size_t> get_degree_histogram(void) const;
+};
+
+/** @}*/
+} // namespace opencog
+
+#endif // _OPENCOG_ATOM_STATISTICS_H
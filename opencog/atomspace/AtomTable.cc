@@ -33,6 +33,7 @@
 #include <iterator>
 #include <mutex>
 #include <set>
+#include <unordered_set>
 
 #include <stdlib.h>
 
@@ -54,7 +55,9 @@
 //
 // Atom hash collision is unavoidable in principle but should be rare,
 // this code may be useful for discovering pathological hash
-// collisions. If enable, any hash collision should be warn logged.
+// collisions. If enable, any hash collision should be warn logged,
+// and counted in getHashCollisions(). This can also be set with
+// -DCHECK_ATOM_HASH_COLLISION on the compiler command line.
 // #define CHECK_ATOM_HASH_COLLISION
 
 // If CHECK_ATOM_HASH_COLLISION is enabled, uncomment the following to
@@ -82,12 +85,13 @@ AtomTable::AtomTable(AtomTable* parent, AtomSpace* holder, bool transient) :
     _environ = parent;
     if (_environ) _environ->_num_nested++;
     _num_nested = 0;
+    _bulk_depth = 0;
+    _hash_collisions = 0;
     _uuid = _id_pool.fetch_add(1, std::memory_order_relaxed);
-    _size = 0;
-    _num_nodes = 0;
-    _num_links = 0;
     size_t ntypes = _nameserver.getNumberOfClasses();
-    _size_by_type.resize(ntypes);
+    std::vector<std::atomic<size_t>> sbt(ntypes);
+    for (auto& cnt : sbt) cnt = 0;
+    _size_by_type.swap(sbt);
     _transient = transient;
 
     // Connect signal to find out about type additions
@@ -142,10 +146,7 @@ void AtomTable::clear_transient()
 
 void AtomTable::clear_all_atoms()
 {
-    // Reset the size to zero.
-    _size = 0;
-    _num_nodes = 0;
-    _num_links = 0;
+    AllShardsLock lck(*this);
 
     // Clear the by-type size cache.
     Type total_types = _size_by_type.size();
@@ -154,20 +155,30 @@ void AtomTable::clear_all_atoms()
 
     // Clear the type-index
     if (not _transient) typeIndex.clear();
+    _stats.clear();
 
-    // Clear the atoms in the set.
-    for (auto& pr : _atom_store) {
-        Handle& atom_to_clear = pr.second;
-        atom_to_clear->_atom_space = nullptr;
+    for (Shard& sh : _shards)
+    {
+        // Reset the size to zero.
+        sh.size = 0;
+        sh.pending.clear();
+        sh.num_nodes = 0;
+        sh.num_links = 0;
+
+        // Clear the atoms in the set.
+        sh.atom_store.foreach([](const Handle& atom_to_clear)
+        {
+            atom_to_clear->_atom_space = nullptr;
 
-        // We installed the incoming set; we remove it too.
-        atom_to_clear->remove();
-    }
+            // We installed the incoming set; we remove it too.
+            atom_to_clear->remove();
+        });
 
-    // Clear the atom store. This will delete all the atoms since
-    // this will be the last shared_ptr referecence, and set the
-    // size of the set to 0.
-    _atom_store.clear();
+        // Clear the atom store. This will delete all the atoms since
+        // this will be the last shared_ptr referecence, and set the
+        // size of the set to 0.
+        sh.atom_store.clear();
+    }
 }
 
 void AtomTable::clear()
@@ -190,22 +201,14 @@ Handle AtomTable::getHandle(Type t, const HandleSeq& seq) const
 
 /// Find an equivalent atom that is exactly the same as the arg. If
 /// such an atom is in the table, it is returned, else the return
-/// is the bad handle.
+/// is the bad handle. No locks are taken: the store supports
+/// concurrent lookups.
 Handle AtomTable::lookupHandle(const AtomPtr& a) const
 {
     if (nullptr == a) return Handle::UNDEFINED;
 
-    ContentHash ch = a->get_hash();
-    std::lock_guard<std::recursive_mutex> lck(_mtx);
-
-    auto range = _atom_store.equal_range(ch);
-    auto bkt = range.first;
-    auto end = range.second;
-    for (; bkt != end; bkt++) {
-        if (*((AtomPtr) bkt->second) == *a) {
-            return bkt->second;
-        }
-    }
+    Handle h(get_shard(a->get_hash()).atom_store.find(a));
+    if (h) return h;
 
     if (_environ)
         return _environ->lookupHandle(a);
@@ -280,37 +283,50 @@ Handle AtomTable::add(AtomPtr atom, bool async, bool force)
 
     // Lock before checking to see if this kind of atom is already in
     // the atomspace.  Lock, to prevent two different threads from
-    // trying to add exactly the same atom.
-    std::unique_lock<std::recursive_mutex> lck(_mtx);
-    if (not force) {
-        Handle hcheck(getHandle(orig));
+    // trying to add exactly the same atom. Only the segment that the
+    // atom hashes to is locked; adds of other atoms proceed in
+    // parallel.
+    Shard& sh = get_shard(hash);
+    std::unique_lock<std::mutex> lck(sh.mtx);
+
+    // Look in this table first, and then in the parent environments.
+    Handle hcheck(sh.atom_store.find(atom));
+    if (hcheck) return hcheck;
+
+    // If force-adding, we're looking for the atom in this table, and
+    // not some other table; so don't look in the parents.
+    if (not force and _environ) {
+        hcheck = _environ->lookupHandle(atom);
         if (hcheck) return hcheck;
-    } else {
-
-        // If force-adding, we have to be more careful.  We're looking
-        // for the atom in this table, and not some other table.
-        Handle hcheck(lookupHandle(orig));
-        if (hcheck and hcheck->getAtomSpace() == _as) return hcheck;
     }
 
+    // In bulk-load mode, installing into the incoming sets and the
+    // type index is deferred. But not for UniqueLinks: creating one
+    // checks the incoming set of its alias for an earlier definition,
+    // which must be there to be found; and installing a StateLink
+    // replaces the previous state, and so must be done in order.
+    bool defer = sh.bulk and
+        not _nameserver.isA(atom->get_type(), UNIQUE_LINK);
+
     atom->copyValues(orig);
-    atom->install();
+    if (not defer) atom->install();
+    if (not defer and not _transient) add_stats(atom.operator->());
     atom->keep_incoming_set();
     atom->setAtomSpace(_as);
 
-    _size++;
-    if (atom->is_node()) _num_nodes++;
-    if (atom->is_link()) _num_links++;
+    sh.size++;
+    if (atom->is_node()) sh.num_nodes++;
+    if (atom->is_link()) sh.num_links++;
     _size_by_type[atom->_type] ++;
 
     Handle h(atom->get_handle());
-    _atom_store.insert({hash, h});
+    sh.atom_store.insert(h);
 
 #ifdef CHECK_ATOM_HASH_COLLISION
-    auto its = _atom_store.equal_range(atom->get_hash());
-    for (auto it = its.first; it != its.second; ++it) {
-        AtomPtr a = it->second;
+    sh.atom_store.foreach_hash(hash, [&](const Handle& a)
+    {
         if (atom != a) {
+            _hash_collisions++;
             LAZY_LOG_WARN << "Hash collision between:" << std::endl
                           << atom->to_string() << "and:" << std::endl
                           << a->to_string();
@@ -321,15 +337,30 @@ Handle AtomTable::add(AtomPtr atom, bool async, bool force)
             abort();
 #endif
         }
-    }
+    });
 #endif
 
+    // In bulk-load mode, the rest is done by end_bulk().
+    if (defer)
+    {
+        sh.pending.push_back(atom.operator->());
+        return h;
+    }
+
+    // Update the type index while still holding the segment lock,
+    // so that the store and the index always agree.
     if (not _transient and not async)
-        put_atom_into_index(atom);
+        typeIndex.insertAtom(atom.operator->());
 
     // We can now unlock, since we are done.
     lck.unlock();
 
+    // Now that we are completely done, emit the added signal.
+    // The signals need to run unlocked, since they may result in
+    // more atom table additions.
+    if (not _transient and not async)
+        _addAtomSignal.emit(h);
+
     // Update the indexes asynchronously
     if (not _transient and async)
         _index_queue.enqueue(atom);
@@ -338,21 +369,24 @@ Handle AtomTable::add(AtomPtr atom, bool async, bool force)
     return h;
 }
 
+// Count an atom that has just been added, and placed into the
+// incoming sets of its outgoing set.
+void AtomTable::add_stats(const Atom* atom)
+{
+    if (atom->is_link()) _stats.add_link(atom, _as);
+    else _stats.add_node(atom);
+}
+
 void AtomTable::put_atom_into_index(const AtomPtr& atom)
 {
     if (_transient)
         throw RuntimeException(TRACE_INFO,
           "AtomTable - transient should not index atoms!");
 
-    std::unique_lock<std::recursive_mutex> lck(_mtx);
+    // The type index does its own locking.
     Atom* pat = atom.operator->();
     typeIndex.insertAtom(pat);
 
-    // We can now unlock, since we are done. In particular, the signals
-    // need to run unlocked, since they may result in more atom table
-    // additions.
-    lck.unlock();
-
     // Now that we are completely done, emit the added signal.
     // Don't emit signal until after the indexes are updated!
     _addAtomSignal.emit(atom->get_handle());
@@ -363,48 +397,236 @@ void AtomTable::barrier()
     _index_queue.flush_queue();
 }
 
+void AtomTable::begin_bulk(size_t expected)
+{
+    std::lock_guard<std::recursive_mutex> lck(_mtx);
+    if (0 < _bulk_depth++) return;
+
+    if (0 < expected) reserve(getSize() + expected);
+
+    AllShardsLock slck(*this);
+    size_t per_shard = expected / ATOMTABLE_SHARDS + 1;
+    for (Shard& sh : _shards)
+    {
+        sh.bulk = true;
+        if (0 < expected) sh.pending.reserve(per_shard);
+    }
+}
+
+void AtomTable::end_bulk()
+{
+    HandleSeq added;
+    {
+        std::lock_guard<std::recursive_mutex> lck(_mtx);
+        if (0 == _bulk_depth)
+            throw RuntimeException(TRACE_INFO,
+                "AtomTable - end_bulk() called without begin_bulk().");
+        if (0 < --_bulk_depth) return;
+
+        {
+            AllShardsLock slck(*this);
+            for (Shard& sh : _shards) sh.bulk = false;
+        }
+        added = flush_bulk();
+    }
+
+    // The signals need to run unlocked, since they may result in
+    // more atom table additions and removals.
+    for (const Handle& h : added)
+        _addAtomSignal.emit(h);
+}
+
+AtomTable::BulkLoad::~BulkLoad()
+{
+    if (nullptr == _table) return;
+    try
+    {
+        _table->end_bulk();
+    }
+    catch (const std::exception& ex)
+    {
+        logger().error("AtomTable - failed to end a bulk load: %s",
+                       ex.what());
+    }
+}
+
+void AtomTable::BulkLoad::end(void)
+{
+    AtomTable* table = _table;
+    _table = nullptr;
+    if (table) table->end_bulk();
+}
+
+/// Finish adding the atoms that were added in bulk-load mode: put
+/// them into the incoming sets of their outgoing atoms, and into the
+/// type index. The caller must hold _mtx, so that none of these atoms
+/// can be extracted half-way, and must then emit the add signals for
+/// the returned atoms, after releasing _mtx.
+HandleSeq AtomTable::flush_bulk()
+{
+    std::vector<Atom*> pending;
+    std::vector<const Atom*> nodes;
+    {
+        AllShardsLock slck(*this);
+        size_t npend = 0;
+        for (Shard& sh : _shards) npend += sh.pending.size();
+        if (0 == npend) return HandleSeq();
+
+        pending.reserve(npend);
+        for (Shard& sh : _shards)
+        {
+            pending.insert(pending.end(),
+                           sh.pending.begin(), sh.pending.end());
+            if (sh.bulk) sh.pending.clear();
+            else std::vector<Atom*>().swap(sh.pending);
+        }
+
+        // The incoming sets of the nodes are about to grow, maybe a
+        // lot; take them out of the degree statistics until they have.
+        if (not _transient)
+        {
+            std::unordered_set<const Atom*> seen;
+            for (Atom* pat : pending)
+            {
+                if (pat->is_node())
+                {
+                    _stats.add_node(pat);
+                    continue;
+                }
+                for (const Handle& h : pat->getOutgoingSet())
+                    if (h->is_node() and h->getAtomSpace() == _as)
+                        seen.insert(h.operator->());
+            }
+            nodes.assign(seen.begin(), seen.end());
+            _stats.uncount_degrees(nodes);
+        }
+    }
+
+    // Both the incoming sets and the type index do their own locking,
+    // and the statistics are updated under the lock of the segment of
+    // the atom, so this can be done in parallel. All of the work on an
+    // atom is done in one pass, while the atom is in the cache.
+    HandleSeq added;
+    if (not _transient) added.resize(pending.size());
+    opencog::setting_omp(opencog::num_threads(), 1);
+    OMP_ALGO::for_each(pending.begin(), pending.end(),
+        [&](Atom* const& pat)->void {
+            pat->install();
+            if (_transient) return;
+            if (pat->is_link())
+            {
+                Shard& sh = get_shard(pat->get_hash());
+                std::lock_guard<std::mutex> lck(sh.mtx);
+                _stats.add_link(pat, _as, false);
+            }
+            typeIndex.insertAtom(pat);
+            added[&pat - pending.data()] = pat->get_handle();
+        });
+    opencog::setting_omp(opencog::num_threads());
+
+    if (_transient) return added;
+    {
+        AllShardsLock slck(*this);
+        _stats.count_degrees(nodes);
+    }
+    return added;
+}
+
 size_t AtomTable::getSize() const
 {
     // No one except the unit tests ever worries about the atom table
     // size. This sanity check might be able to avoid unpleasant
     // surprises.
-    std::lock_guard<std::recursive_mutex> lck(_mtx);
-    if (_size != _atom_store.size())
+    AllShardsLock lck(*this);
+    size_t size = 0;
+    size_t store_size = 0;
+    size_t pending = 0;
+    for (const Shard& sh : _shards)
+    {
+        size += sh.size;
+        store_size += sh.atom_store.size();
+        pending += sh.pending.size();
+    }
+
+    if (size != store_size)
         throw RuntimeException(TRACE_INFO,
             "Internal Error: Inconsistent AtomTable hash size! %lu vs. %lu",
-            _size, _atom_store.size());
+            size, store_size);
 
-    if (_size != typeIndex.size())
+    // Atoms added in bulk-load mode are not in the type index yet.
+    if (not _transient and size != typeIndex.size() + pending)
         throw RuntimeException(TRACE_INFO,
             "Internal Error: Inconsistent AtomTable typeIndex size! %lu vs. %lu",
-            _size, typeIndex.size());
+            size, typeIndex.size() + pending);
 
-    return _size;
+    return size;
 }
 
 size_t AtomTable::getNumNodes() const
 {
-    return _num_nodes;
+    size_t cnt = 0;
+    for (const Shard& sh : _shards) cnt += sh.num_nodes;
+    return cnt;
 }
 
 size_t AtomTable::getNumLinks() const
 {
-    return _num_links;
+    size_t cnt = 0;
+    for (const Shard& sh : _shards) cnt += sh.num_links;
+    return cnt;
 }
 
-size_t AtomTable::getNumAtomsOfType(Type type, bool subclass) const
+void AtomTable::reserve(size_t total, const std::map<Type, size_t>& per_type)
 {
-    std::lock_guard<std::recursive_mutex> lck(_mtx);
+    // The atoms are spread evenly over the shards, by hash.
+    size_t per_shard = total / ATOMTABLE_SHARDS + 1;
+    {
+        AllShardsLock slck(*this);
+        for (Shard& sh : _shards)
+            sh.atom_store.reserve(per_shard);
+    }
+
+    if (_transient) return;
+    for (const auto& tc : per_type)
+        typeIndex.reserve(tc.first, tc.second);
+}
 
-    size_t result = _size_by_type[type];
-    if (subclass)
+double AtomTable::getLoadFactor() const
+{
+    AllShardsLock slck(*this);
+    size_t size = 0, capacity = 0;
+    for (const Shard& sh : _shards)
     {
-        // Also count subclasses of this type, if need be.
-        Type ntypes = _size_by_type.size();
-        for (Type t = ATOM; t<ntypes; t++)
+        size += sh.atom_store.size();
+        capacity += sh.atom_store.capacity();
+    }
+    return (double) size / capacity;
+}
+
+size_t AtomTable::getRehashCount() const
+{
+    AllShardsLock slck(*this);
+    size_t cnt = 0;
+    for (const Shard& sh : _shards) cnt += sh.atom_store.rebuilds();
+    return cnt;
+}
+
+size_t AtomTable::getNumAtomsOfType(Type type, bool subclass) const
+{
+    size_t result = 0;
+    {
+        // The counts are reallocated by typeAdded().
+        std::shared_lock<std::shared_mutex> tlck(_types_mtx);
+        if (type < _size_by_type.size()) result = _size_by_type[type];
+        if (subclass)
         {
-            if (t != type and _nameserver.isA(type, t))
-                result += _size_by_type[t];
+            // Also count subclasses of this type, if need be.
+            Type ntypes = _size_by_type.size();
+            for (Type t = ATOM; t<ntypes; t++)
+            {
+                if (t != type and _nameserver.isA(type, t))
+                    result += _size_by_type[t];
+            }
         }
     }
 
@@ -414,23 +636,29 @@ size_t AtomTable::getNumAtomsOfType(Type type, bool subclass) const
     return result;
 }
 
+std::pair<size_t, double> AtomTable::getFanOut(Type t, size_t pos) const
+{
+    std::shared_lock<std::shared_mutex> tlck(_types_mtx);
+    return std::make_pair(_stats.get_num_links(t, pos),
+                          _stats.get_fan_out(t, pos));
+}
+
 Handle AtomTable::getRandom(RandGen *rng) const
 {
     size_t x = rng->randint(getSize());
 
-    Handle randy(Handle::UNDEFINED);
-
     // XXX TODO it would be considerably more efficient to go into the
     // the type index, and decrement x by the size of the index for
     // each type.  This would speed up the algo by about 100 (by about
     // the number of types that are in use...).
-    foreachHandleByType(
-        [&](Handle h)->void {
-            if (0 == x) randy = h;
-            x--;
-        },
-        ATOM, true);
-    return randy;
+    std::lock_guard<const TypeIndex> lck(typeIndex);
+    auto tit = typeIndex.begin(ATOM, true);
+    auto tend = typeIndex.end();
+    for (; tit != tend; tit++) {
+        if (0 == x) return *tit;
+        x--;
+    }
+    return Handle::UNDEFINED;
 }
 
 AtomPtrSet AtomTable::extract(Handle& handle, bool recursive)
@@ -456,10 +684,22 @@ AtomPtrSet AtomTable::extract(Handle& handle, bool recursive)
         return other->extract(handle, recursive);
     }
 
-    // Lock before fetching the incoming set. Since getting the
-    // incoming set also grabs a lock, we need this mutex to be
-    // recursive. We need to lock here to avoid confusion if multiple
-    // threads are trying to delete the same atom.
+    // Atoms added in bulk-load mode are not yet in the incoming sets;
+    // finish adding them, so that the checks below are correct. Their
+    // add signals are emitted before the lock below is taken.
+    HandleSeq added;
+    {
+        std::lock_guard<std::recursive_mutex> blck(_mtx);
+        if (0 < _bulk_depth) added = flush_bulk();
+    }
+    for (const Handle& h : added)
+        _addAtomSignal.emit(h);
+
+    // Lock before fetching the incoming set. Since the removal
+    // recurses, we need this mutex to be recursive. We need to lock
+    // here to avoid confusion if multiple threads are trying to delete
+    // the same atom. Adds do not take this lock; they synchronize with
+    // removal on the segment lock, below.
     std::unique_lock<std::recursive_mutex> lck(_mtx);
 
     if (atom->isMarkedForRemoval()) return result;
@@ -527,24 +767,25 @@ AtomPtrSet AtomTable::extract(Handle& handle, bool recursive)
     _removeAtomSignal.emit(atom);
     // lck.lock();
 
+    Shard& sh = get_shard(atom->get_hash());
+    std::unique_lock<std::mutex> slck(sh.mtx);
+
     // Decrements the size of the table
-    _size--;
-    if (atom->is_node()) _num_nodes--;
-    if (atom->is_link()) _num_links--;
+    sh.size--;
+    if (atom->is_node()) sh.num_nodes--;
+    if (atom->is_link()) sh.num_links--;
     _size_by_type[atom->_type] --;
-
-    auto range = _atom_store.equal_range(atom->get_hash());
-    auto bkt = range.first;
-    auto end = range.second;
-    for (; bkt != end; bkt++) {
-        if (handle == bkt->second) {
-            _atom_store.erase(bkt);
-            break;
-        }
+    if (not _transient)
+    {
+        if (atom->is_link()) _stats.remove_link(atom.operator->(), _as);
+        else _stats.remove_node(atom.operator->());
     }
 
+    sh.atom_store.erase(handle);
+
     Atom* pat = atom.operator->();
     typeIndex.removeAtom(pat);
+    slck.unlock();
 
     // Remove atom from other incoming sets.
     atom->remove();
@@ -558,10 +799,15 @@ AtomPtrSet AtomTable::extract(Handle& handle, bool recursive)
 // This is the resize callback, when a new type is dynamically added.
 void AtomTable::typeAdded(Type t)
 {
-    std::lock_guard<std::recursive_mutex> lck(_mtx);
+    AllShardsLock lck(*this);
+    std::unique_lock<std::shared_mutex> tlck(_types_mtx);
     //resize all Type-based indexes
     size_t new_size = _nameserver.getNumberOfClasses();
-    _size_by_type.resize(new_size);
+    std::vector<std::atomic<size_t>> sbt(new_size);
+    for (size_t i = 0; i < new_size; i++)
+        sbt[i] = (i < _size_by_type.size()) ? _size_by_type[i].load() : 0;
+    _size_by_type.swap(sbt);
+    _stats.resize(new_size);
     typeIndex.resize();
 }
 
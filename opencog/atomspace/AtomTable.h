@@ -27,7 +27,11 @@
 
 #include <atomic>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <set>
+#include <shared_mutex>
+#include <utility>
 #include <vector>
 
 #include <opencog/util/async_method_caller.h>
@@ -39,6 +43,8 @@
 
 #include <opencog/atoms/atom_types/NameServer.h>
 
+#include <opencog/atomspace/AtomStatistics.h>
+#include <opencog/atomspace/ContentHashTable.h>
 #include <opencog/atomspace/TypeIndex.h>
 
 class AtomSpaceUTest;
@@ -52,6 +58,10 @@ namespace opencog
 
 typedef std::set<AtomPtr> AtomPtrSet;
 
+// Number of independently-locked segments that the atom store is
+// split into.
+#define ATOMTABLE_SHARDS 16
+
 typedef SigSlot<const Handle&> AtomSignal;
 typedef SigSlot<const AtomPtr&> AtomPtrSignal;
 typedef SigSlot<const Handle&,
@@ -74,22 +84,70 @@ class AtomTable
 private:
     NameServer& _nameserver;
 
-    // Single, global mutex for locking the indexes.
-    // Its recursive because we need to lock twice during atom insertion
-    // and removal: we need to keep the indexes stable while we search
-    // them during add/remove.
+    // Mutex serializing atom extraction. Its recursive because
+    // extraction recurses through the incoming set, and the removal
+    // signal handlers may themselves remove atoms.
     mutable std::recursive_mutex _mtx;
 
-    // Cached count of the number of atoms in the table.
-    size_t _size;
-    size_t _num_nodes;
-    size_t _num_links;
+    // The atom store is split into ATOMTABLE_SHARDS segments, each
+    // with its own lock. An atom lives in the segment selected by its
+    // hash, so threads adding unrelated atoms do not serialize on a
+    // single lock. Each segment keeps its own cached counts; these
+    // are atomic, so that they can be read without the lock. The lock
+    // is taken only by writers; lookups in the store are lock-free.
+    struct Shard
+    {
+        std::mutex mtx;
+
+        // Index of the atoms in this segment, addressible by their hash.
+        ContentHashTable atom_store;
+
+        std::atomic<size_t> size;
+        std::atomic<size_t> num_nodes;
+        std::atomic<size_t> num_links;
+
+        // In bulk-load mode, atoms that have been put into the store,
+        // but not yet into the incoming sets or the type index.
+        bool bulk;
+        std::vector<Atom*> pending;
+
+        Shard() : size(0), num_nodes(0), num_links(0), bulk(false) {}
+    };
+    mutable Shard _shards[ATOMTABLE_SHARDS];
+
+    Shard& get_shard(ContentHash h) const
+    {
+        return _shards[h % ATOMTABLE_SHARDS];
+    }
+
+    // Lock all of the segments, always in the same order. Used by
+    // the (rare) operations that need a consistent view of the
+    // entire table.
+    struct AllShardsLock
+    {
+        const AtomTable& _table;
+        AllShardsLock(const AtomTable& t) : _table(t)
+        {
+            for (Shard& sh : _table._shards) sh.mtx.lock();
+        }
+        ~AllShardsLock()
+        {
+            for (Shard& sh : _table._shards) sh.mtx.unlock();
+        }
+    };
+
+    // Cached count of the number of atoms of each type. Atomic,
+    // because it is shared by all segments. Only resized while
+    // all segments are locked.
+    std::vector<std::atomic<size_t>> _size_by_type;
 
-    // Cached count of the number of atoms of each type.
-    std::vector<size_t> _size_by_type;
+    // Statistics for query planning. Not kept for transient tables.
+    AtomStatistics _stats;
 
-    // Index of all the atoms in the table, addressible by thier hash.
-    std::unordered_multimap<ContentHash, Handle> _atom_store;
+    // The two above are indexed by type, and reallocated when a type
+    // is added. Writers hold a segment lock; readers hold this one,
+    // shared, so that they do not have to take all of the segments.
+    mutable std::shared_mutex _types_mtx;
 
     //!@{
     //! Index for quick retrieval of certain kinds of atoms.
@@ -97,6 +155,7 @@ private:
 
     async_caller<AtomTable, AtomPtr> _index_queue;
     void put_atom_into_index(const AtomPtr&);
+    void add_stats(const Atom*);
     //!@}
 
     /**
@@ -137,6 +196,15 @@ private:
     AtomTable(const AtomTable&) = delete;
 
     void clear_all_atoms();
+
+    // Nesting depth of begin_bulk() calls. Protected by _mtx.
+    int _bulk_depth;
+    HandleSeq flush_bulk();
+
+    // Number of distinct atoms added with the same hash as an atom
+    // already in the table. Only counted if CHECK_ATOM_HASH_COLLISION
+    // is defined in AtomTable.cc.
+    std::atomic<size_t> _hash_collisions;
 public:
 
     /**
@@ -172,6 +240,11 @@ public:
      * simplest fix for just right now.
      */
     bool in_environ(const AtomPtr& atom) const
+    {
+        return in_environ(atom.get());
+    }
+
+    bool in_environ(const Atom* atom) const
     {
         if (nullptr == atom) return false;
         AtomTable* atab = atom->getAtomTable();
@@ -191,6 +264,51 @@ public:
     size_t getNumLinks() const;
     size_t getNumAtomsOfType(Type type, bool subclass=true) const;
 
+    /**
+     * Statistics about the atoms in this table (but not those in its
+     * environment), kept up to date as atoms are added and removed;
+     * see AtomStatistics.h. Always empty for transient tables.
+     * The statistics are resized when a new atom type is added; so
+     * reading them directly is safe only while no types are being
+     * added. getFanOut() takes the lock that makes it safe.
+     */
+    const AtomStatistics& getStatistics() const { return _stats; }
+
+    /**
+     * The number of links of type `t` in this table with an atom at
+     * position `pos`, and the fan-out of those links, as returned by
+     * AtomStatistics. Safe to call while types are being added.
+     */
+    std::pair<size_t, double> getFanOut(Type t, size_t pos) const;
+
+    /**
+     * Make room for `total` atoms, so that the content hash table
+     * does not have to be rebuilt as the table grows to that size.
+     * The optional `per_type` counts likewise pre-size the type
+     * index for each of the given types. This is only a hint; the
+     * table still grows past these sizes, if need be.
+     */
+    void reserve(size_t total,
+                 const std::map<Type, size_t>& per_type = {});
+
+    /**
+     * Fill statistics for the content hash table: the number of
+     * atoms held, divided by the number of slots, and the number of
+     * times it was rebuilt, either to grow it or to clear out the
+     * slots of removed atoms.
+     */
+    double getLoadFactor() const;
+    size_t getRehashCount() const;
+
+    /**
+     * Hash quality statistic: the number of times an atom was added
+     * whose 64-bit hash equals that of a different atom already in
+     * the table. This is always zero, unless the table was built
+     * with CHECK_ATOM_HASH_COLLISION defined in AtomTable.cc; see
+     * also tests/benchmark/HashBenchmark.
+     */
+    size_t getHashCollisions() const { return _hash_collisions; }
+
     /**
      * Returns the exact atom for the given name and type.
      * Note: Type must inherit from NODE. Otherwise, it returns
@@ -221,7 +339,7 @@ public:
                        bool subclass=false,
                        bool parent=true) const
     {
-        std::lock_guard<std::recursive_mutex> lck(_mtx);
+        std::lock_guard<const TypeIndex> lck(typeIndex);
         auto tit = typeIndex.begin(type, subclass);
         auto tend = typeIndex.end();
         while (tit != tend) { hset.insert(*tit); tit++; }
@@ -254,7 +372,7 @@ public:
         }
 
         // No parent ... avoid the copy above.
-        std::lock_guard<std::recursive_mutex> lck(_mtx);
+        std::lock_guard<const TypeIndex> lck(typeIndex);
         return std::copy(typeIndex.begin(type, subclass),
                          typeIndex.end(), result);
     }
@@ -279,10 +397,12 @@ public:
            return;
         }
 
-        // No parent ... avoid the copy above.
-        std::lock_guard<std::recursive_mutex> lck(_mtx);
-        std::for_each(typeIndex.begin(type, subclass),
-                      typeIndex.end(),
+        // No parent ... but we still copy, so that the callback runs
+        // with the index unlocked; the callback is then free to add
+        // and remove atoms.
+        HandleSeq hseq;
+        getHandlesByType(back_inserter(hseq), type, subclass, false);
+        std::for_each(hseq.begin(), hseq.end(),
              [&](const Handle& h)->void {
                   (func)(h);
              });
@@ -314,13 +434,15 @@ public:
            return;
         }
 
-        // No parent ... avoid the copy above.
-        std::lock_guard<std::recursive_mutex> lck(_mtx);
+        // No parent ... copy anyway, so that the index is not locked
+        // while the callbacks run.
+        HandleSeq hseq;
+        getHandlesByType(back_inserter(hseq), type, subclass, false);
+
         // Parallelize, always, no matter what!
         opencog::setting_omp(opencog::num_threads(), 1);
 
-        OMP_ALGO::for_each(typeIndex.begin(type, subclass),
-                      typeIndex.end(),
+        OMP_ALGO::for_each(hseq.begin(), hseq.end(),
              [&](const Handle& h)->void {
                   (func)(h);
              });
@@ -341,11 +463,9 @@ public:
      * lots of parallel adds.  The barrier() method can be used to
      * force synchronization.
      *
-     * XXX The async code path doesn't really do anything yet, since
-     * it also uses the big global lock, at the moment.  This needs
-     * fixing, mostly be creating a second mutex for the atom insertion,
-     * and also giving each index its own unique mutex, to avoid
-     * collisions.  So the API is here, but more work is still needed.
+     * Insertion only locks the segment of the atom store (and of the
+     * type index) that the atom hashes to, so that adds of unrelated
+     * atoms can proceed in parallel.
      *
      * The `force` flag forces the addtion of this atom into the
      * atomtable, even if it is already in a parent atomspace.
@@ -362,6 +482,50 @@ public:
      */
     void barrier(void);
 
+    /**
+     * Start a bulk load. Until the matching end_bulk(), atoms that
+     * are added are still de-duplicated against the table, and
+     * handed back as usual; but they are not yet put into the
+     * incoming sets of their outgoing atoms, nor into the type index,
+     * and no add signals are emitted for them. Thus, queries by type
+     * or by incoming set do not see them until the load is ended.
+     * (StateLinks and UniqueLinks are the exception; they are always
+     * added at once, as adding them depends on the incoming sets.)
+     * Removing an atom in the middle of a load first finishes adding
+     * the atoms loaded so far.
+     *
+     * The `expected` number of atoms, if known, is used to size the
+     * table up front, so that it is not rebuilt over and over as it
+     * grows. Calls may be nested; only the outermost end_bulk() does
+     * anything.
+     */
+    void begin_bulk(size_t expected=0);
+
+    /**
+     * End a bulk load: add all of the loaded atoms to the incoming
+     * sets and to the type index, in parallel, and then emit the add
+     * signal for each of them.
+     */
+    void end_bulk(void);
+
+    /**
+     * Begins a bulk load when constructed, and ends it when destroyed,
+     * so that an exception in the middle of a load does not leave the
+     * table in bulk-load mode. Call end() to end the load and get any
+     * error from it; the destructor can only log them.
+     */
+    class BulkLoad
+    {
+        AtomTable* _table;
+    public:
+        BulkLoad(AtomTable& table, size_t expected=0) : _table(&table)
+            { table.begin_bulk(expected); }
+        BulkLoad(const BulkLoad&) = delete;
+        BulkLoad& operator=(const BulkLoad&) = delete;
+        ~BulkLoad();
+        void end(void);
+    };
+
     /**
      * Return true if the atom table holds this handle, else return false.
      */
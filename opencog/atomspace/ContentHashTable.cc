@@ -0,0 +1,240 @@
+/*
+ * opencog/atomspace/ContentHashTable.cc
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <thread>
+
+#include "ContentHashTable.h"
+
+using namespace opencog;
+
+// Smallest number of slots in the table. Must be a power of two.
+#define MIN_CAPACITY 16
+
+ContentHashTable::Array::Array(size_t cap) :
+    capacity(cap)
+{
+    unsigned int lg = 0;
+    while ((((size_t) 1) << lg) < cap) lg++;
+    shift = 64 - lg;
+
+    slots = new Slot[capacity];
+    for (size_t i = 0; i < capacity; i++)
+    {
+        slots[i].hash.store(Handle::INVALID_HASH, std::memory_order_relaxed);
+        slots[i].atom.store(nullptr, std::memory_order_relaxed);
+    }
+    owners = new Handle[capacity];
+}
+
+ContentHashTable::Array::~Array()
+{
+    delete[] slots;
+    delete[] owners;
+}
+
+ContentHashTable::ContentHashTable(void) :
+    _array(new Array(MIN_CAPACITY)),
+    _size(0),
+    _used(0),
+    _rebuilds(0),
+    _epoch(0)
+{
+    _readers[0] = 0;
+    _readers[1] = 0;
+}
+
+ContentHashTable::~ContentHashTable()
+{
+    delete _array.load();
+}
+
+// ------------------------------------------------------------------
+// Reader registration.
+//
+// A reader increments the counter selected by the current epoch, and
+// then checks that the epoch did not change while it was doing so;
+// if it did, it retries.  A writer that wants to free something
+// first unlinks it from the table, then advances the epoch, and then
+// waits for the counter of the previous epoch to drop to zero. New
+// readers register on the other counter, so the wait cannot be
+// starved, and once it is over, no reader can still be holding a
+// pointer to what was unlinked.
+
+size_t ContentHashTable::read_lock(void) const
+{
+    while (true)
+    {
+        size_t e = _epoch.load() & 1;
+        _readers[e].fetch_add(1);
+        if ((_epoch.load() & 1) == e) return e;
+        _readers[e].fetch_sub(1);
+    }
+}
+
+void ContentHashTable::read_unlock(size_t e) const
+{
+    _readers[e].fetch_sub(1);
+}
+
+void ContentHashTable::synchronize(void)
+{
+    size_t e = _epoch.fetch_add(1) & 1;
+    while (0 < _readers[e].load())
+        std::this_thread::yield();
+}
+
+// ------------------------------------------------------------------
+
+Handle ContentHashTable::find(const AtomPtr& a) const
+{
+    ContentHash h = a->get_hash();
+    Handle result;
+
+    size_t rd = read_lock();
+    const Array* arr = _array.load();
+    size_t mask = arr->capacity - 1;
+    for (size_t i = home(arr, h); ; i = (i + 1) & mask)
+    {
+        Atom* pat = arr->slots[i].atom.load();
+        if (nullptr == pat) break;
+        if (tombstone() == pat) continue;
+        if (arr->slots[i].hash.load(std::memory_order_relaxed) != h)
+            continue;
+        if (*pat == *a)
+        {
+            result = pat->get_handle();
+            break;
+        }
+    }
+    read_unlock(rd);
+    return result;
+}
+
+void ContentHashTable::insert(const Handle& h)
+{
+    // Keep the table at most half full, counting tombstones; this
+    // keeps the probe sequences short, and guarantees that every
+    // probe sequence ends at an empty slot.
+    if (_array.load()->capacity < 2 * (_used + 1))
+    {
+        size_t cap = MIN_CAPACITY;
+        while (cap < 4 * (_size + 1)) cap *= 2;
+        rebuild(cap);
+    }
+
+    Array* arr = _array.load();
+    ContentHash ch = h->get_hash();
+    size_t mask = arr->capacity - 1;
+    size_t i = home(arr, ch);
+    while (true)
+    {
+        Atom* pat = arr->slots[i].atom.load(std::memory_order_relaxed);
+        if (nullptr == pat or tombstone() == pat) break;
+        i = (i + 1) & mask;
+    }
+
+    if (nullptr == arr->slots[i].atom.load(std::memory_order_relaxed))
+        _used++;
+    _size++;
+
+    // Fill in the slot, then publish it.
+    arr->owners[i] = h;
+    arr->slots[i].hash.store(ch, std::memory_order_relaxed);
+    arr->slots[i].atom.store(h.operator->(), std::memory_order_release);
+}
+
+bool ContentHashTable::erase(const Handle& h)
+{
+    Array* arr = _array.load();
+    ContentHash ch = h->get_hash();
+    size_t mask = arr->capacity - 1;
+    for (size_t i = home(arr, ch); ; i = (i + 1) & mask)
+    {
+        Atom* pat = arr->slots[i].atom.load(std::memory_order_relaxed);
+        if (nullptr == pat) return false;
+        if (h.operator->() != pat) continue;
+
+        arr->slots[i].atom.store(tombstone());
+        _size--;
+
+        // Concurrent lookups might still be comparing against this
+        // atom; wait for them before dropping our reference. (Swap,
+        // don't move: Handle does not have a move constructor.)
+        AtomPtr doomed;
+        doomed.swap(arr->owners[i]);
+        synchronize();
+        return true;
+    }
+}
+
+void ContentHashTable::clear(void)
+{
+    Array* old = _array.load();
+    _array.store(new Array(MIN_CAPACITY));
+    _size = 0;
+    _used = 0;
+
+    // Deleting the old array deletes the atoms, too.
+    synchronize();
+    delete old;
+}
+
+void ContentHashTable::reserve(size_t n)
+{
+    // Same fill limit as in insert(): at most half full.
+    size_t cap = _array.load()->capacity;
+    if (2 * (n + 1) <= cap) return;
+    while (cap < 2 * (n + 1)) cap *= 2;
+    rebuild(cap);
+}
+
+/// Copy all of the atoms into a new slot array with the given number
+/// of slots, dropping the tombstones.
+void ContentHashTable::rebuild(size_t cap)
+{
+    Array* old = _array.load();
+    Array* arr = new Array(cap);
+    size_t mask = cap - 1;
+
+    for (size_t i = 0; i < old->capacity; i++)
+    {
+        Atom* pat = old->slots[i].atom.load(std::memory_order_relaxed);
+        if (nullptr == pat or tombstone() == pat) continue;
+
+        ContentHash ch = old->slots[i].hash.load(std::memory_order_relaxed);
+        size_t j = home(arr, ch);
+        while (nullptr != arr->slots[j].atom.load(std::memory_order_relaxed))
+            j = (j + 1) & mask;
+
+        arr->slots[j].hash.store(ch, std::memory_order_relaxed);
+        arr->slots[j].atom.store(pat, std::memory_order_relaxed);
+        arr->owners[j].swap(old->owners[i]);
+    }
+    _used = _size;
+    _rebuilds++;
+
+    // Readers still using the old array will find the same atoms
+    // there; the atoms are now owned by the new array.
+    _array.store(arr);
+    synchronize();
+    delete old;
+}
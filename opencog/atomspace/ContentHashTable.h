@@ -0,0 +1,207 @@
+/*
+ * opencog/atomspace/ContentHashTable.h
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_CONTENT_HASH_TABLE_H
+#define _OPENCOG_CONTENT_HASH_TABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <opencog/atoms/base/Atom.h>
+#include <opencog/atoms/base/Handle.h>
+
+namespace opencog
+{
+/** \addtogroup grp_atomspace
+ *  @{
+ */
+
+/**
+ * Open-addressing hash table holding atoms, keyed by their content
+ * hash. This is the de-duplication store of the AtomTable: given an
+ * atom, it finds the (unique) atom in the table that has the same
+ * content.
+ *
+ * The table is a single flat array of slots, probed linearly; hash
+ * collisions are resolved in the table itself, so that an insert does
+ * not allocate, and a lookup touches one or two cache lines instead of
+ * chasing bucket-list pointers.
+ *
+ * Concurrency: lookups (find()) never take a lock, and can run at the
+ * same time as a writer.  Writers (insert(), erase(), clear()) must be
+ * serialized by the caller; the AtomTable does this with its segment
+ * locks. A new entry is published with a single atomic store of the
+ * atom pointer, after the rest of the slot has been written, so that
+ * a concurrent lookup either sees the whole entry, or none of it.
+ *
+ * Memory that a concurrent lookup might still be looking at (removed
+ * atoms, and the old slot array after a resize) is released only
+ * after all lookups that were in progress have finished. Lookups
+ * announce themselves on one of two reader counters; the writer flips
+ * to the other counter and waits for the old one to drain. Since
+ * lookups are short, this wait is brief; it is what allows removed
+ * atoms to be deleted as soon as they are erased.
+ */
+class ContentHashTable
+{
+private:
+    struct Slot
+    {
+        // A cached copy of the atom hash, so that probes don't need
+        // to dereference the atom.
+        std::atomic<ContentHash> hash;
+
+        // Null if the slot was never used, tombstone() if the atom
+        // that was here has been erased.
+        std::atomic<Atom*> atom;
+    };
+
+    struct Array
+    {
+        size_t capacity;  // Always a power of two.
+        unsigned int shift;
+        Slot* slots;
+
+        // The table owns the atoms. Only writers touch this.
+        Handle* owners;
+
+        Array(size_t);
+        ~Array();
+    };
+
+    std::atomic<Array*> _array;
+
+    // Number of atoms in the table, and number of slots that are
+    // not empty (i.e. atoms plus tombstones). Writer-side only.
+    size_t _size;
+    size_t _used;
+
+    // Number of times the slot array was rebuilt. Writer-side only.
+    size_t _rebuilds;
+
+    // Reader registration, used to find out when memory can be freed.
+    std::atomic<size_t> _epoch;
+    mutable std::atomic<size_t> _readers[2];
+
+    static Atom* tombstone(void)
+    {
+        return reinterpret_cast<Atom*>(uintptr_t(1));
+    }
+
+    // The slot at which probing for the hash starts. Fibonacci
+    // hashing: the AtomTable selects its segment with the low bits
+    // of the hash, so the table must use the high bits.
+    static size_t home(const Array* arr, ContentHash h)
+    {
+        return (size_t)
+            ((((uint64_t) h) * 11400714819323198485ull) >> arr->shift);
+    }
+
+    size_t read_lock(void) const;
+    void read_unlock(size_t) const;
+    void synchronize(void);
+
+    void rebuild(size_t);
+
+    ContentHashTable(const ContentHashTable&) = delete;
+    ContentHashTable& operator=(const ContentHashTable&) = delete;
+
+public:
+    ContentHashTable(void);
+    ~ContentHashTable();
+
+    /**
+     * Return the atom in the table that has the same content as the
+     * argument, or Handle::UNDEFINED if there is none. Lock-free;
+     * may be called concurrently with a writer.
+     */
+    Handle find(const AtomPtr&) const;
+
+    /**
+     * Add the atom to the table. The caller must have checked that
+     * no atom with the same content is already in the table.
+     */
+    void insert(const Handle&);
+
+    /**
+     * Remove exactly this atom from the table. Returns false if the
+     * atom was not in the table.  Waits for any concurrent lookups
+     * to finish, before releasing the table's reference to the atom.
+     */
+    bool erase(const Handle&);
+
+    /** Remove all atoms from the table. */
+    void clear(void);
+
+    /**
+     * Make room for `n` atoms in total, so that the table does not
+     * have to be rebuilt while they are being inserted. Writer-side.
+     */
+    void reserve(size_t n);
+
+    size_t size(void) const { return _size; }
+
+    /** Number of slots in the table. */
+    size_t capacity(void) const { return _array.load()->capacity; }
+
+    /** Number of times the table was rebuilt, to grow it or to
+     *  clear out tombstones. */
+    size_t rebuilds(void) const { return _rebuilds; }
+
+    /** Call func on every atom in the table. Writer-side only. */
+    template <typename Function> void
+    foreach(Function func) const
+    {
+        const Array* arr = _array.load();
+        for (size_t i = 0; i < arr->capacity; i++)
+        {
+            Atom* a = arr->slots[i].atom.load(std::memory_order_relaxed);
+            if (nullptr != a and tombstone() != a)
+                func(arr->owners[i]);
+        }
+    }
+
+    /**
+     * Call func on every atom in the table having the given hash.
+     * Writer-side only.
+     */
+    template <typename Function> void
+    foreach_hash(ContentHash h, Function func) const
+    {
+        const Array* arr = _array.load();
+        size_t mask = arr->capacity - 1;
+        for (size_t i = home(arr, h); ; i = (i + 1) & mask)
+        {
+            Atom* a = arr->slots[i].atom.load(std::memory_order_relaxed);
+            if (nullptr == a) return;
+            if (tombstone() != a and
+                arr->slots[i].hash.load(std::memory_order_relaxed) == h)
+                func(arr->owners[i]);
+        }
+    }
+};
+
+/** @}*/
+} //namespace opencog
+
+#endif // _OPENCOG_CONTENT_HASH_TABLE_H
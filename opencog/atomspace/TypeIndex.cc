@@ -24,6 +24,33 @@
 
 using namespace opencog;
 
+// The subtype lists depend only on the type hierarchy, and so are
+// shared by all of the indexes; they are recomputed only when new
+// types get added. Transient atomspaces are created and destroyed
+// very often, and should not pay for this.
+static std::mutex _subtype_mtx;
+static std::shared_ptr<const std::vector<std::vector<Type>>> _subtype_cache;
+
+static std::shared_ptr<const std::vector<std::vector<Type>>>
+get_subtypes(size_t ntypes)
+{
+	std::lock_guard<std::mutex> lck(_subtype_mtx);
+	if (_subtype_cache and _subtype_cache->size() == ntypes)
+		return _subtype_cache;
+
+	// A subclass of t is NEVER smaller than t, so the lists come
+	// out sorted, starting with t itself.
+	NameServer& ns = nameserver();
+	auto subs = std::make_shared<std::vector<std::vector<Type>>>(ntypes);
+	for (Type t = 0; t < ntypes; t++)
+		for (Type s = t; s < ntypes; s++)
+			if (s == t or ns.isA(s, t))
+				(*subs)[t].push_back(s);
+
+	_subtype_cache = subs;
+	return _subtype_cache;
+}
+
 TypeIndex::TypeIndex(void)
 {
 	resize();
@@ -31,15 +58,41 @@ TypeIndex::TypeIndex(void)
 
 void TypeIndex::resize(void)
 {
+	std::lock_guard<TypeIndex> lck(*this);
 	_num_types = nameserver().getNumberOfClasses();
-	_idx.resize(_num_types + 1);
+	_subtypes = get_subtypes(_num_types);
+
+	// Only resize the segments that are in use; the others
+	// will be sized when the first atom is inserted into them.
+	for (Shard& sh : _shards)
+		if (0 < sh.idx.size())
+			sh.idx.resize(_num_types + 1);
+}
+
+void TypeIndex::reserve(Type t, size_t n)
+{
+#ifndef REPRODUCIBLE_ATOMSPACE
+	if (_num_types < t) return;
+
+	// The atoms are spread evenly over the segments, by hash.
+	size_t per_shard = n / TYPE_INDEX_SHARDS + 1;
+	for (Shard& sh : _shards)
+	{
+		std::lock_guard<std::mutex> lck(sh.mtx);
+		if (sh.idx.size() <= _num_types)
+			sh.idx.resize(_num_types + 1);
+		sh.idx[t].reserve(sh.idx[t].size() + per_shard);
+	}
+#endif // REPRODUCIBLE_ATOMSPACE: std::set cannot be pre-sized.
 }
 
 bool TypeIndex::contains_duplicate() const
 {
-	for (const AtomSet& atoms : _idx)
-		if (contains_duplicate(atoms))
-			return true;
+	std::lock_guard<const TypeIndex> lck(*this);
+	for (const Shard& sh : _shards)
+		for (const AtomSet& atoms : sh.idx)
+			if (contains_duplicate(atoms))
+				return true;
 	return false;
 }
 
@@ -57,48 +110,20 @@ bool TypeIndex::contains_duplicate(const AtomSet& atoms) const
 TypeIndex::iterator TypeIndex::begin(Type t, bool sub) const
 {
 	iterator it(t, sub);
-	it.send = _idx.end();
-
-	// A subclass of t is NEVER smaller than t.
-	// Thus, we can start our search there.
-	it.s = _idx.begin();
-	it.s += t;
+	it.tidx = this;
+	it.shard = 0;
 	it.currtype = t;
-	it.se = it.s->begin();
-
-	// If its not empty, then go for it.
-	if (it.se != it.s->end()) return it;
-
-	// If its the emptyset, and we are not subclassing, then we're done.
-	if (not sub)
-	{
-		it.s = it.send;
-		return it;
-	}
-
-	// Find the first type which is a subtype, and is not empty.
-	++it.s;
-	it.currtype++;
-	while (it.s != it.send)
-	{
-		if (nameserver().isA(it.currtype, it.type))
-		{
-			it.se = it.s->begin();
-			if (it.se != it.s->end()) return it;
-		}
-		it.currtype++;
-		++it.s;
-	}
-
+	if (t < _subtypes->size())
+		it.types = &(*_subtypes)[t];
+	it.seek();
 	return it;
 }
 
 TypeIndex::iterator TypeIndex::end(void) const
 {
 	iterator it(_num_types, false);
-	it.se = _idx.at(_num_types).end();
-	it.s = _idx.end();
-	it.send = _idx.end();
+	it.tidx = this;
+	it.shard = TYPE_INDEX_SHARDS;
 	it.currtype = _num_types;
 	return it;
 }
@@ -107,36 +132,70 @@ TypeIndex::iterator::iterator(Type t, bool sub)
 {
 	type = t;
 	subclass = sub;
+	tidx = nullptr;
+	shard = TYPE_INDEX_SHARDS;
+	currtype = t;
+	types = nullptr;
+	tpos = 0;
 }
 
 TypeIndex::iterator& TypeIndex::iterator::operator=(iterator v)
 {
-	s = v.s;
-	send = v.send;
+	tidx = v.tidx;
+	shard = v.shard;
 	se = v.se;
 	currtype = v.currtype;
 	type = v.type;
 	subclass = v.subclass;
+	types = v.types;
+	tpos = v.tpos;
 	return *this;
 }
 
 Handle TypeIndex::iterator::operator*(void)
 {
-	if (s == send) return Handle::UNDEFINED;
+	if (at_end()) return Handle::UNDEFINED;
 	return (*se)->get_handle();
 }
 
 bool TypeIndex::iterator::operator==(iterator v)
 {
-	if ((v.s == v.send) && (s == send)) return true;
+	if (v.at_end() and at_end()) return true;
+	if (v.at_end() or at_end()) return false;
 	return v.se == se;
 }
 
 bool TypeIndex::iterator::operator!=(iterator v)
 {
-	if ((v.s == v.send) && (s != send)) return v.se != se;
-	if ((v.s != v.send) && (s == send)) return v.se != se;
-	return false;
+	return not operator==(v);
+}
+
+/// Position the iterator on the first atom at, or after, the current
+/// (shard, tpos) location. Only the types in the precomputed subtype
+/// list are visited; if we are not subclassing, only the first one.
+void TypeIndex::iterator::seek(void)
+{
+	size_t ntypes = 0;
+	if (types) ntypes = subclass ? types->size() : 1;
+
+	while (shard < TYPE_INDEX_SHARDS)
+	{
+		const std::vector<AtomSet>& idx(tidx->_shards[shard].idx);
+		while (tpos < ntypes)
+		{
+			currtype = (*types)[tpos];
+
+			// The list is sorted, so the remaining types are
+			// not in this segment, either.
+			if (idx.size() <= currtype) break;
+
+			se = idx[currtype].begin();
+			if (se != idx[currtype].end()) return;
+			tpos++;
+		}
+		shard++;
+		tpos = 0;
+	}
 }
 
 TypeIndex::iterator& TypeIndex::iterator::operator++()
@@ -147,33 +206,15 @@ TypeIndex::iterator& TypeIndex::iterator::operator++()
 // XXX this is broken, for i != 1 ... FIXME.
 TypeIndex::iterator& TypeIndex::iterator::operator++(int i)
 {
-	if (s == send) return *this;
+	if (at_end()) return *this;
 
 	++se;
-	if (se == s->end())
-	{
-		// If we are not subclassing, then we are really really done.
-		if (not subclass)
-		{
-			s = send;
-			return *this;
-		}
-
-		// Otherwise, move on to the next type.
-		do
-		{
-			++s;
-			currtype++;
-
-			// Find the first type which is a subtype, and start iteration there.
-			if (nameserver().isA(currtype, type))
-			{
-				se = s->begin();
-				if (se != s->end()) return *this;
-			}
-		} while (s != send);
-	}
+	if (se != tidx->_shards[shard].idx[currtype].end()) return *this;
 
+	// Move on to the next type; seek() moves on to the next
+	// segment, when this one is done.
+	tpos++;
+	seek();
 	return *this;
 }
 
@@ -22,12 +22,15 @@
 #ifndef _OPENCOG_TYPEINDEX_H
 #define _OPENCOG_TYPEINDEX_H
 
+#include <memory>
+#include <mutex>
 #include <set>
 #include <vector>
 
 #include <opencog/atoms/base/Atom.h>
 #include <opencog/atoms/base/Handle.h>
 #include <opencog/atoms/atom_types/types.h>
+#include <opencog/atomspace/AtomSlots.h>
 
 class AtomSpaceUTest;
 
@@ -39,63 +42,135 @@ namespace opencog
 
 // This is very costly and only used to get deterministic behavior
 #ifdef REPRODUCIBLE_ATOMSPACE
-typedef std::set<Atom*, content_based_atom_ptr_less> AtomSet
-#else
+typedef std::set<Atom*, content_based_atom_ptr_less> AtomSet;
+#elif defined(TYPE_INDEX_HASH_SETS)
+// The older backend: one hash table per type.  Inserts and removes
+// are about as fast as with AtomSlots, but scans are much slower.
 typedef std::unordered_set<Atom*> AtomSet;
+#else
+typedef AtomSlots AtomSet;
 #endif
 
+// Number of independently-locked segments that the index is split
+// into. Atoms are assigned to a segment by thier hash, so that threads
+// inserting unrelated atoms (even atoms of the same type) will almost
+// never contend for the same lock.
+#define TYPE_INDEX_SHARDS 16
+
 /**
- * Implements a vector of AtomSets; each AtomSet is a hash table of
- * Atom pointers.  Thus, given an Atom Type, this can quickly find
- * all of the Atoms of that Type.
+ * Implements a vector of AtomSets; each AtomSet is a dense array of
+ * Atom pointers (see AtomSlots).  Thus, given an Atom Type, this can
+ * quickly find all of the Atoms of that Type.
+ *
+ * The index is split into TYPE_INDEX_SHARDS segments, each with its
+ * own lock; insertion and removal lock only the segment that the atom
+ * hashes to.
  *
  * The primary interface for this is an iterator, and that is because
  * the index will typically contain millions of atoms, and this is far
  * too much to try to copy into some temporary array.  Iterating is much
  * faster.
  *
- * @todo The iterator is NOT thread-safe against the insertion or
- * removal of atoms!  Either inserting or removing an atom will cause
- * the iterator references to be freed, leading to mystery crashes!
+ * The iterator is NOT thread-safe against the insertion or removal of
+ * atoms!  Either inserting or removing an atom will cause the iterator
+ * references to be freed, leading to mystery crashes!  Users must hold
+ * the index lock (see lock() and unlock() below) while iterating.
  */
 class TypeIndex
 {
 	friend class ::AtomSpaceUTest;
 
 	private:
-		std::vector<AtomSet> _idx;
+		struct Shard
+		{
+			std::mutex mtx;
+			std::vector<AtomSet> idx;
+		};
+		mutable Shard _shards[TYPE_INDEX_SHARDS];
 		size_t _num_types;
+
+		// For each type, the list of that type and all of its
+		// subtypes, in increasing order. Used by the iterator, so
+		// that it does not have to test every type with isA().
+		// Shared by all of the indexes.
+		typedef std::vector<std::vector<Type>> SubtypeLists;
+		std::shared_ptr<const SubtypeLists> _subtypes;
+
+		Shard& get_shard(const Atom* a) const
+		{
+			return _shards[a->get_hash() % TYPE_INDEX_SHARDS];
+		}
+
 	public:
 		TypeIndex(void);
 		void resize(void);
 		void insertAtom(Atom* a)
 		{
-			AtomSet& s(_idx.at(a->get_type()));
-			s.insert(a);
+			Shard& sh(get_shard(a));
+			std::lock_guard<std::mutex> lck(sh.mtx);
+
+			// Segments are sized lazily, so that the index of a
+			// transient atomspace costs almost nothing.
+			if (sh.idx.size() <= _num_types)
+				sh.idx.resize(_num_types + 1);
+			sh.idx[a->get_type()].insert(a);
 		}
 		void removeAtom(Atom* a)
 		{
-			AtomSet& s(_idx.at(a->get_type()));
-			s.erase(a);
+			Shard& sh(get_shard(a));
+			std::lock_guard<std::mutex> lck(sh.mtx);
+			if (sh.idx.size() <= a->get_type()) return;
+			sh.idx[a->get_type()].erase(a);
 		}
 
-		size_t size(Type t)
+		/// Make room for `n` atoms of type `t`, so that the index
+		/// does not have to grow while they are inserted.
+		void reserve(Type t, size_t n);
+
+		size_t size(Type t) const
 		{
-			AtomSet& s(_idx.at(t));
-			return s.size();
+			size_t cnt = 0;
+			for (Shard& sh : _shards)
+			{
+				std::lock_guard<std::mutex> lck(sh.mtx);
+				if (t < sh.idx.size())
+					cnt += sh.idx[t].size();
+			}
+			return cnt;
 		}
 
 		size_t size(void) const
 		{
 			size_t cnt = 0;
-			for (const auto& s : _idx)
-				cnt += s.size();
+			for (Shard& sh : _shards)
+			{
+				std::lock_guard<std::mutex> lck(sh.mtx);
+				for (const auto& s : sh.idx)
+					cnt += s.size();
+			}
 			return cnt;
 		}
 
 		void clear(void)
 		{
-			for (auto& s : _idx) s.clear();
+			for (Shard& sh : _shards)
+			{
+				std::lock_guard<std::mutex> lck(sh.mtx);
+				for (auto& s : sh.idx) s.clear();
+			}
+		}
+
+		/// Lock (unlock) every segment of the index. Hold this lock
+		/// while iterating; it makes TypeIndex usable with
+		/// std::lock_guard. Do NOT insert or remove atoms while
+		/// holding it; that will deadlock.
+		void lock(void) const
+		{
+			for (Shard& sh : _shards) sh.mtx.lock();
+		}
+		void unlock(void) const
+		{
+			for (Shard& sh : _shards) sh.mtx.unlock();
 		}
 
 		// Return true if there exists some index containing duplicated
@@ -118,10 +193,18 @@ class TypeIndex
 			private:
 				Type type;
 				bool subclass;
-				std::vector<AtomSet>::const_iterator s;
-				std::vector<AtomSet>::const_iterator send;
+				const TypeIndex* tidx;
+				size_t shard;
 				Type currtype;
 				AtomSet::const_iterator se;
+
+				// Position in the list of types to visit.
+				const std::vector<Type>* types;
+				size_t tpos;
+
+				bool at_end(void) const
+				{ return TYPE_INDEX_SHARDS <= shard; }
+				void seek(void);
 		};
 
 		iterator begin(Type, bool) const;
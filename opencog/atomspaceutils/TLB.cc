@@ -163,8 +163,8 @@ void TLB::removeAtom(UUID uuid)
     auto pr = _uuid_map.find(uuid);
     if (_uuid_map.end() == pr) return;
 
-    _uuid_map.erase(uuid);
     _handle_map.erase(pr->second);
+    _uuid_map.erase(pr);
 }
 
 UUID TLB::getUUID(const Handle& h)
@@ -3,6 +3,7 @@
 #include <opencog/atomspace/AtomSpace.h>
 #include <opencog/atoms/execution/Instantiator.h>
 #include <opencog/atoms/value/Value.h>
+#include <opencog/query/QueryProfile.h>
 
 #include "BindlinkStub.h"
 
@@ -16,3 +17,8 @@ ValuePtr opencog::do_execute(AtomSpace* atomspace, Handle h)
 		return atomspace->add_atom(HandleCast(pap));
 	return pap;
 }
+
+std::string opencog::do_explain(AtomSpace* atomspace, Handle h)
+{
+	return explain_query(atomspace, h);
+}
@@ -27,6 +27,7 @@
 namespace opencog {
 
 ValuePtr do_execute(AtomSpace*, Handle);
+std::string do_explain(AtomSpace*, Handle);
 
 } // namespace opencog
 
@@ -1,3 +1,4 @@
+from libcpp.string cimport string
 from opencog.atomspace cimport cValuePtr, cHandle, tv_ptr, cAtomSpace
 
 ctypedef size_t cSize
@@ -7,3 +8,11 @@ cdef extern from "opencog/atoms/execution/EvaluationLink.h" namespace "opencog":
 
 cdef extern from "opencog/cython/opencog/BindlinkStub.h" namespace "opencog":
     cdef cValuePtr c_execute_atom "do_execute"(cAtomSpace*, cHandle) except +
+    cdef string c_explain_atom "do_explain"(cAtomSpace*, cHandle) except +
+
+cdef extern from "opencog/query/ResultStream.h" namespace "opencog" nogil:
+    cdef cppclass cResultStream "opencog::ResultStream":
+        cResultStream(cAtomSpace*, cHandle, size_t) except +
+        cValuePtr next() except +
+        void cancel()
+        size_t get_num_results()
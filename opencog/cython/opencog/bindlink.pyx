@@ -13,6 +13,51 @@ def execute_atom(AtomSpace atomspace, Atom atom):
                                            deref(atom.handle))
     return create_python_value_from_c_value(c_value_ptr, atomspace)
 
+def explain_atom(AtomSpace atomspace, Atom atom):
+    if atom == None: raise ValueError("explain_atom atom is: None")
+    cdef string report = c_explain_atom(atomspace.atomspace,
+                                        deref(atom.handle))
+    return report.decode('UTF-8')
+
+cdef class ResultStream:
+    """
+    Iterate over the results of a GetLink or a BindLink, as the query
+    finds them. The query runs in a thread of its own, which stops
+    once `capacity` results are waiting to be taken.
+    """
+    cdef cResultStream* c_stream
+    cdef AtomSpace atomspace
+
+    def __cinit__(self, AtomSpace atomspace not None, Atom query not None,
+                  size_t capacity = 64):
+        self.atomspace = atomspace
+        self.c_stream = new cResultStream(atomspace.atomspace,
+                                          deref(query.handle), capacity)
+
+    def __dealloc__(self):
+        # Waits for the search thread, which may need the GIL.
+        if self.c_stream != NULL:
+            with nogil:
+                del self.c_stream
+
+    def __iter__(self):
+        return self
+
+    def __next__(self):
+        cdef cValuePtr c_value_ptr
+        with nogil:
+            c_value_ptr = self.c_stream.next()
+        if c_value_ptr.get() == NULL:
+            raise StopIteration
+        return create_python_value_from_c_value(c_value_ptr, self.atomspace)
+
+    def cancel(self):
+        self.c_stream.cancel()
+
+    property num_results:
+        def __get__(self):
+            return self.c_stream.get_num_results()
+
 
 
 def evaluate_atom(AtomSpace atomspace, Atom atom):
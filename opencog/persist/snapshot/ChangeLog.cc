@@ -0,0 +1,1071 @@
+/*
+ * opencog/persist/snapshot/ChangeLog.cc
+ * Append-only log of the changes made to an AtomSpace.
+ *
+ * Copyright (c) 2019 OpenCog Foundation
+ *
+ * LICENSE:
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+#include <opencog/util/Logger.h>
+#include <opencog/atoms/atom_types/NameServer.h>
+#include <opencog/atoms/base/Link.h>
+#include <opencog/atoms/base/Node.h>
+#include <opencog/atoms/value/FloatValue.h>
+#include <opencog/atoms/value/LinkValue.h>
+#include <opencog/atoms/value/StringValue.h>
+#include <opencog/atomspace/AtomSpace.h>
+
+#include "ChangeLog.h"
+
+using namespace opencog;
+
+/* ================================================================ */
+/*
+ * The log file is a ChangeLogHeader, followed by records. Each record
+ * is a uint32_t payload size, the uint32_t CRC-32 of the payload, and
+ * the payload. A record that is cut short, or that fails its CRC, ends
+ * the log; it is what is left of the write that was under way when
+ * the system went down.
+ *
+ * The payload is an opcode byte, followed by:
+ *
+ * LOG_RESET  -- nothing. Forget all of the atom and type numbers.
+ *               Written at the start of each session, so that the
+ *               numbers need not carry over from one to the next.
+ * LOG_TYPE   -- uint16_t type number, uint32_t length, the type name.
+ * LOG_ADD    -- an atom.
+ * LOG_REMOVE -- an atom.
+ * LOG_VALUE  -- an atom, the key atom, a value.
+ * LOG_TV     -- an atom, a truth value.
+ *
+ * An atom is a tag byte, followed by:
+ *
+ * ATOM_REF   -- uint32_t atom number.
+ * ATOM_NODE  -- uint16_t type number, uint32_t length, the name.
+ * ATOM_LINK  -- uint16_t type number, uint32_t arity, the atoms of
+ *               the outgoing set.
+ *
+ * The first time an atom is written in a session, it is written in
+ * full, and it is given the next atom number (after the atoms in its
+ * outgoing set). After that, only its number is written.
+ *
+ * Values are written as in the snapshot values section, see
+ * SnapshotFormat.h, except that their types are type numbers of the
+ * log. All numbers are in the byte order of the machine.
+ */
+
+#define CHANGELOG_MAGIC "OCLOG\0\0\0"
+#define CHANGELOG_VERSION 1
+
+struct ChangeLogHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+};
+
+enum : uint8_t
+{
+	LOG_RESET = 1,
+	LOG_TYPE,
+	LOG_ADD,
+	LOG_REMOVE,
+	LOG_VALUE,
+	LOG_TV,
+};
+
+enum : uint8_t
+{
+	ATOM_REF = 1,
+	ATOM_NODE,
+	ATOM_LINK,
+};
+
+// Changes wait for the commit thread, once this much is pending.
+#define MAX_PENDING (64 << 20)
+
+/// CRC-32, as in zlib and ethernet.
+static uint32_t log_crc32(const char* p, size_t n)
+{
+	static const std::vector<uint32_t> table = []()
+	{
+		std::vector<uint32_t> tbl(256);
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+			tbl[i] = c;
+		}
+		return tbl;
+	}();
+
+	uint32_t crc = 0xffffffff;
+	for (size_t i = 0; i < n; i++)
+		crc = table[(crc ^ (uint8_t) p[i]) & 0xff] ^ (crc >> 8);
+	return crc ^ 0xffffffff;
+}
+
+/* ================================================================ */
+
+ChangeLog::ChangeLog(const std::string& path) :
+	_path(path),
+	_as(nullptr),
+	_added_conn(0),
+	_removed_conn(0),
+	_tv_conn(0),
+	_next_id(0),
+	_sync(false),
+	_fd(-1),
+	_appended(0),
+	_durable(0),
+	_interval(10),
+	_stop(false),
+	_hurry(false),
+	_num_records(0),
+	_num_commits(0)
+{
+}
+
+ChangeLog::~ChangeLog()
+{
+	try
+	{
+		if (_as) detach();
+	}
+	catch (const std::exception& ex)
+	{
+		logger().error("ChangeLog: %s", ex.what());
+	}
+}
+
+/* ================================================================ */
+// Encoding
+
+template<typename T>
+static void put(std::vector<char>& buf, const T& v)
+{
+	const char* p = (const char*) &v;
+	buf.insert(buf.end(), p, p + sizeof(v));
+}
+
+static void put_string(std::vector<char>& buf, const std::string& str)
+{
+	put<uint32_t>(buf, str.size());
+	buf.insert(buf.end(), str.begin(), str.end());
+}
+
+/// Write out a record, straight from the given payload.
+void ChangeLog::frame(const std::vector<char>& payload)
+{
+	put<uint32_t>(_pending, payload.size());
+	put<uint32_t>(_pending, log_crc32(payload.data(), payload.size()));
+	_pending.insert(_pending.end(), payload.begin(), payload.end());
+	_appended += 2 * sizeof(uint32_t) + payload.size();
+	_num_records++;
+}
+
+/// Put the number of the type into the record being encoded. Types
+/// are defined, in a record of their own, on first use.
+void ChangeLog::encode_type(Type t)
+{
+	auto it = _tindex.find(t);
+	if (_tindex.end() != it)
+	{
+		put<uint16_t>(_rec, it->second);
+		return;
+	}
+
+	uint16_t idx = _tindex.size();
+	_tindex.emplace(t, idx);
+
+	std::vector<char> def;
+	put<uint8_t>(def, LOG_TYPE);
+	put<uint16_t>(def, idx);
+	put_string(def, nameserver().getTypeName(t));
+	frame(def);
+
+	put<uint16_t>(_rec, idx);
+}
+
+void ChangeLog::encode_atom(const Handle& h)
+{
+	auto it = _ids.find(h);
+	if (_ids.end() != it)
+	{
+		put<uint8_t>(_rec, ATOM_REF);
+		put<uint32_t>(_rec, it->second);
+		return;
+	}
+
+	if (h->is_node())
+	{
+		put<uint8_t>(_rec, ATOM_NODE);
+		encode_type(h->get_type());
+		put_string(_rec, h->get_name());
+	}
+	else
+	{
+		put<uint8_t>(_rec, ATOM_LINK);
+		encode_type(h->get_type());
+		put<uint32_t>(_rec, h->get_arity());
+		for (const Handle& ho : h->getOutgoingSet())
+			encode_atom(ho);
+	}
+	_ids.emplace(h, _next_id++);
+}
+
+/// The value must be storable.
+void ChangeLog::encode_value(const ValuePtr& v)
+{
+	Type t = v->get_type();
+	encode_type(t);
+	put<uint16_t>(_rec, 0);
+
+	if (nameserver().isA(t, FLOAT_VALUE))
+	{
+		const std::vector<double>& flts = FloatValueCast(v)->value();
+		put<uint32_t>(_rec, flts.size());
+		const char* p = (const char*) flts.data();
+		_rec.insert(_rec.end(), p, p + flts.size() * sizeof(double));
+	}
+	else if (nameserver().isA(t, STRING_VALUE))
+	{
+		const std::vector<std::string>& strs = StringValueCast(v)->value();
+		put<uint32_t>(_rec, strs.size());
+		for (const std::string& str : strs)
+			put_string(_rec, str);
+	}
+	else
+	{
+		const std::vector<ValuePtr>& vals = LinkValueCast(v)->value();
+		put<uint32_t>(_rec, vals.size());
+		for (const ValuePtr& vp : vals)
+			encode_value(vp);
+	}
+}
+
+/// Append the record that was encoded; with the lock held.
+void ChangeLog::append(std::unique_lock<std::mutex>& lck)
+{
+	frame(_rec);
+	_rec.clear();
+
+	if (_sync or (size_t) MAX_PENDING < _pending.size())
+		wait_durable(lck, _appended);
+}
+
+/// Start a new session; with the lock held.
+void ChangeLog::reset(void)
+{
+	_ids.clear();
+	_next_id = 0;
+	_tindex.clear();
+
+	std::vector<char> rst;
+	put<uint8_t>(rst, LOG_RESET);
+	frame(rst);
+}
+
+/* ================================================================ */
+// The signal handlers
+
+void ChangeLog::atom_added(const Handle& h)
+{
+	std::unique_lock<std::mutex> lck(_mtx);
+	if (_ex) return;
+	put<uint8_t>(_rec, LOG_ADD);
+	encode_atom(h);
+	append(lck);
+
+	// The values that the atom came with.
+	for (const Handle& key : h->getKeys())
+	{
+		if (_ex) return;
+		ValuePtr v = h->getValue(key);
+		if (nullptr == v or not SnapshotStorage::storable(v)) continue;
+
+		put<uint8_t>(_rec, LOG_VALUE);
+		encode_atom(h);
+		encode_atom(key);
+		encode_value(v);
+		append(lck);
+	}
+}
+
+void ChangeLog::atom_removed(const AtomPtr& atom)
+{
+	Handle h(atom->get_handle());
+	std::unique_lock<std::mutex> lck(_mtx);
+	if (_ex) return;
+	put<uint8_t>(_rec, LOG_REMOVE);
+	encode_atom(h);
+	_ids.erase(h);
+	append(lck);
+}
+
+void ChangeLog::tv_changed(const Handle& h, const TruthValuePtr& oldtv,
+                           const TruthValuePtr& newtv)
+{
+	std::unique_lock<std::mutex> lck(_mtx);
+	if (_ex) return;
+	put<uint8_t>(_rec, LOG_TV);
+	encode_atom(h);
+	encode_value(ValueCast(newtv));
+	append(lck);
+}
+
+/* ================================================================ */
+// Group commit
+
+static void write_fd(int fd, const std::string& path,
+                     const void* buf, size_t n)
+{
+	const char* p = (const char*) buf;
+	while (0 < n)
+	{
+		ssize_t rc = write(fd, p, n);
+		if (rc < 0 and EINTR == errno) continue;
+		if (rc < 0)
+			throw IOException(TRACE_INFO,
+				"ChangeLog: Unable to write %s: %s",
+				path.c_str(), strerror(errno));
+		p += rc;
+		n -= rc;
+	}
+}
+
+static void sync_fd(int fd, const std::string& path)
+{
+	if (0 != fdatasync(fd))
+		throw IOException(TRACE_INFO,
+			"ChangeLog: Unable to sync %s: %s", path.c_str(), strerror(errno));
+}
+
+/**
+ * The length of the good part of the log open on fd: up to the end
+ * of the last whole record whose CRC checks out. Zero if the file is
+ * too short to hold the header. Throws if it is not a change log.
+ */
+static size_t good_length(int fd, const std::string& path)
+{
+	struct stat st;
+	if (0 != fstat(fd, &st))
+		throw IOException(TRACE_INFO,
+			"ChangeLog: Unable to stat %s: %s", path.c_str(), strerror(errno));
+
+	size_t size = st.st_size;
+	if (size < sizeof(ChangeLogHeader)) return 0;
+
+	void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (MAP_FAILED == addr)
+		throw IOException(TRACE_INFO,
+			"ChangeLog: Unable to map %s: %s", path.c_str(), strerror(errno));
+	madvise(addr, size, MADV_SEQUENTIAL);
+	const char* map = (const char*) addr;
+
+	ChangeLogHeader hdr;
+	memcpy(&hdr, map, sizeof(hdr));
+	if (memcmp(hdr.magic, CHANGELOG_MAGIC, sizeof(hdr.magic)) or
+	    SNAPSHOT_BYTE_ORDER != hdr.byte_order or
+	    CHANGELOG_VERSION != hdr.version)
+	{
+		munmap(addr, size);
+		throw IOException(TRACE_INFO,
+			"ChangeLog: %s is not a change log of this version "
+			"and byte order", path.c_str());
+	}
+
+	size_t pos = sizeof(hdr);
+	while (2 * sizeof(uint32_t) <= size - pos)
+	{
+		uint32_t len, crc;
+		memcpy(&len, map + pos, sizeof(len));
+		memcpy(&crc, map + pos + sizeof(len), sizeof(crc));
+		const char* payload = map + pos + 2 * sizeof(uint32_t);
+		if (size - pos - 2 * sizeof(uint32_t) < len) break;
+		if (log_crc32(payload, len) != crc) break;
+		pos += 2 * sizeof(uint32_t) + len;
+	}
+	munmap(addr, size);
+	return pos;
+}
+
+/**
+ * Cut off whatever follows the last good record of the log, so that
+ * the records appended next can be read back. Writes the header, if
+ * the log is new. A new log is also made durable in its directory.
+ */
+static void trim_log(int fd, const std::string& path)
+{
+	struct stat st;
+	if (0 != fstat(fd, &st))
+		throw IOException(TRACE_INFO,
+			"ChangeLog: Unable to stat %s: %s", path.c_str(), strerror(errno));
+
+	size_t good = good_length(fd, path);
+	if (0 < good and good == (size_t) st.st_size) return;
+
+	if (0 < good)
+		logger().warn("ChangeLog: Dropping %zu damaged bytes at the end of %s",
+			st.st_size - good, path.c_str());
+	if (0 != ftruncate(fd, good))
+		throw IOException(TRACE_INFO,
+			"ChangeLog: Unable to truncate %s: %s",
+			path.c_str(), strerror(errno));
+
+	if (0 == good)
+	{
+		ChangeLogHeader hdr;
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, CHANGELOG_MAGIC, sizeof(hdr.magic));
+		hdr.version = CHANGELOG_VERSION;
+		hdr.byte_order = SNAPSHOT_BYTE_ORDER;
+		write_fd(fd, path, &hdr, sizeof(hdr));
+	}
+	sync_fd(fd, path);
+	if (0 == good) SnapshotStorage::sync_dir(path);
+}
+
+void ChangeLog::open_log(void)
+{
+	_fd = open(_path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+	if (_fd < 0)
+		throw IOException(TRACE_INFO,
+			"ChangeLog: Unable to open %s: %s", _path.c_str(), strerror(errno));
+
+	try
+	{
+		trim_log(_fd, _path);
+	}
+	catch (...)
+	{
+		close_log();
+		throw;
+	}
+}
+
+void ChangeLog::close_log(void)
+{
+	if (0 <= _fd) close(_fd);
+	_fd = -1;
+}
+
+/**
+ * Write out, and sync, everything pending. Called with the lock held;
+ * the lock is dropped during the write, so that changes can continue
+ * to be appended. The I/O lock is taken before the lock is dropped,
+ * so that the commits are written in order.
+ */
+void ChangeLog::commit(std::unique_lock<std::mutex>& lck)
+{
+	std::unique_lock<std::mutex> io(_io_mtx);
+	std::vector<char> buf;
+	buf.swap(_pending);
+	uint64_t target = _appended;
+	lck.unlock();
+
+	std::exception_ptr ex;
+	try
+	{
+		write_fd(_fd, _path, buf.data(), buf.size());
+		sync_fd(_fd, _path);
+	}
+	catch (...)
+	{
+		ex = std::current_exception();
+	}
+	io.unlock();
+
+	lck.lock();
+	if (ex)
+	{
+		// Part of the buffer may be on disk, and the records after it
+		// refer to atoms and types defined in it; so nothing more is
+		// logged, until the log is detached.
+		if (nullptr == _ex)
+		{
+			_ex = ex;
+			logger().error("ChangeLog: Logging to %s has stopped; "
+				"the changes from now on are not logged", _path.c_str());
+		}
+		_pending.clear();
+	}
+	else
+	{
+		if (_durable < target) _durable = target;
+		_num_commits++;
+	}
+	_durable_cv.notify_all();
+}
+
+/// Wait until everything up to pos is on disk, or the commits fail.
+void ChangeLog::wait_durable(std::unique_lock<std::mutex>& lck, uint64_t pos)
+{
+	_hurry = true;
+	_commit_cv.notify_one();
+	_durable_cv.wait(lck, [&]{ return pos <= _durable or _ex; });
+}
+
+void ChangeLog::commit_loop(void)
+{
+	std::unique_lock<std::mutex> lck(_mtx);
+	while (not _stop)
+	{
+		_commit_cv.wait_for(lck, std::chrono::milliseconds(_interval),
+			[&]{ return _stop or _hurry; });
+		_hurry = false;
+		if (not _pending.empty() and not _ex) commit(lck);
+	}
+	if (not _pending.empty() and not _ex) commit(lck);
+}
+
+/// Throw the error that stopped the log, if any. It stays in effect,
+/// and is thrown again, until the log is detached.
+void ChangeLog::rethrow(void)
+{
+	if (_ex) std::rethrow_exception(_ex);
+}
+
+void ChangeLog::barrier(void)
+{
+	std::unique_lock<std::mutex> lck(_mtx);
+	if (not _pending.empty() and not _ex) commit(lck);
+	rethrow();
+}
+
+void ChangeLog::set_commit_interval(unsigned int msec)
+{
+	std::lock_guard<std::mutex> lck(_mtx);
+	_interval = std::max(1u, msec);
+}
+
+void ChangeLog::set_sync(bool sync)
+{
+	std::lock_guard<std::mutex> lck(_mtx);
+	_sync = sync;
+}
+
+/* ================================================================ */
+
+/**
+ * Start logging the changes made to the AtomSpace. Changes that were
+ * made before this are not in the log; replay() the log, or load a
+ * snapshot, first.
+ */
+void ChangeLog::attach(AtomSpace* as)
+{
+	if (_as)
+		throw RuntimeException(TRACE_INFO,
+			"ChangeLog: Already attached to an AtomSpace");
+
+	{
+		std::unique_lock<std::mutex> lck(_mtx);
+		std::lock_guard<std::mutex> io(_io_mtx);
+		open_log();
+		_ex = nullptr;
+		_stop = false;
+		_pending.clear();
+		_durable = _appended;
+		reset();
+	}
+
+	_as = as;
+	_commit_thread = std::thread(&ChangeLog::commit_loop, this);
+
+	using namespace std::placeholders;
+	_added_conn = _as->atomAddedSignal().connect(
+		std::bind(&ChangeLog::atom_added, this, _1));
+	_removed_conn = _as->atomRemovedSignal().connect(
+		std::bind(&ChangeLog::atom_removed, this, _1));
+	_tv_conn = _as->TVChangedSignal().connect(
+		std::bind(&ChangeLog::tv_changed, this, _1, _2, _3));
+}
+
+/// Stop logging, once all of the changes logged so far are on disk.
+void ChangeLog::detach(void)
+{
+	if (nullptr == _as) return;
+
+	_as->atomAddedSignal().disconnect(_added_conn);
+	_as->atomRemovedSignal().disconnect(_removed_conn);
+	_as->TVChangedSignal().disconnect(_tv_conn);
+	_as = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lck(_mtx);
+		_stop = true;
+	}
+	_commit_cv.notify_one();
+	_commit_thread.join();
+
+	std::unique_lock<std::mutex> lck(_mtx);
+	{
+		std::lock_guard<std::mutex> io(_io_mtx);
+		close_log();
+	}
+	std::exception_ptr ex = _ex;
+	_ex = nullptr;
+	if (ex) std::rethrow_exception(ex);
+}
+
+/**
+ * Write a snapshot, and drop the changes that it holds from the log.
+ *
+ * The log is first set aside, as path.prev, and a new log is started;
+ * then the snapshot is written, and only once it, and its directory
+ * entry, are on disk, is path.prev deleted. If the system goes down
+ * part-way, the old snapshot, path.prev and the new log hold
+ * everything. Changes made while the snapshot is
+ * written go to the new log, and may also be in the snapshot;
+ * replaying them again does no harm.
+ */
+void ChangeLog::compact(SnapshotStorage& snap)
+{
+	if (nullptr == _as)
+		throw RuntimeException(TRACE_INFO,
+			"ChangeLog: Not attached to an AtomSpace");
+
+	std::string prev = _path + ".prev";
+	{
+		std::unique_lock<std::mutex> lck(_mtx);
+		if (not _pending.empty()) commit(lck);
+		rethrow();
+
+		std::lock_guard<std::mutex> io(_io_mtx);
+		close_log();
+
+		// A path.prev left over from an earlier compaction is still
+		// needed; add this log to the end of it.
+		try
+		{
+			struct stat st;
+			if (0 == stat(prev.c_str(), &st))
+				append_file(_path, prev);
+			else if (0 != rename(_path.c_str(), prev.c_str()))
+				throw IOException(TRACE_INFO,
+					"ChangeLog: Unable to rename %s: %s",
+					_path.c_str(), strerror(errno));
+			unlink(_path.c_str());
+		}
+		catch (...)
+		{
+			// Keep on logging to the old log.
+			open_log();
+			throw;
+		}
+
+		open_log();
+		reset();
+	}
+
+	// storeAtomSpace() syncs the snapshot and its directory before
+	// it returns, and throws if it cannot.
+	snap.storeAtomSpace(_as);
+	unlink(prev.c_str());
+}
+
+/// Add the records of one log to the end of another. Only the good
+/// records are copied, and a damaged end of the other log is cut off
+/// first, so that all of them can be read back. Synced once, at the
+/// end.
+void ChangeLog::append_file(const std::string& from, const std::string& to)
+{
+	int ifd = open(from.c_str(), O_RDONLY);
+	if (ifd < 0) return;
+
+	int ofd = open(to.c_str(), O_RDWR | O_APPEND);
+	if (ofd < 0)
+	{
+		close(ifd);
+		throw IOException(TRACE_INFO,
+			"ChangeLog: Unable to open %s: %s", to.c_str(), strerror(errno));
+	}
+
+	try
+	{
+		trim_log(ofd, to);
+
+		size_t end = good_length(ifd, from);
+		size_t pos = std::min(end, sizeof(ChangeLogHeader));
+		std::vector<char> buf(1 << 20);
+		while (pos < end)
+		{
+			ssize_t rc = pread(ifd, buf.data(),
+			                   std::min(buf.size(), end - pos), pos);
+			if (rc < 0 and EINTR == errno) continue;
+			if (rc <= 0)
+				throw IOException(TRACE_INFO,
+					"ChangeLog: Unable to read %s: %s",
+					from.c_str(), rc ? strerror(errno) : "short file");
+			write_fd(ofd, to, buf.data(), rc);
+			pos += rc;
+		}
+		sync_fd(ofd, to);
+	}
+	catch (...)
+	{
+		close(ofd);
+		close(ifd);
+		throw;
+	}
+	close(ofd);
+	close(ifd);
+}
+
+/* ================================================================ */
+// Replay
+
+namespace {
+
+/// Decoder for the records of one log.
+class LogReader
+{
+	private:
+		const std::string& _path;
+		const char* _p;
+		const char* _end;
+
+		std::vector<Type> _types;
+		HandleSeq _atoms;
+
+		void corrupt(void)
+		{
+			throw IOException(TRACE_INFO,
+				"ChangeLog: Corrupt record in %s", _path.c_str());
+		}
+
+		void get(void* v, size_t n)
+		{
+			if ((size_t) (_end - _p) < n) corrupt();
+			memcpy(v, _p, n);
+			_p += n;
+		}
+
+		template<typename T> T get(void)
+		{
+			T v;
+			get(&v, sizeof(v));
+			return v;
+		}
+
+		std::string get_string(void)
+		{
+			uint32_t len = get<uint32_t>();
+			if ((size_t) (_end - _p) < len) corrupt();
+			std::string str(_p, len);
+			_p += len;
+			return str;
+		}
+
+		Type get_type(void)
+		{
+			uint16_t idx = get<uint16_t>();
+			if (_types.size() <= idx) corrupt();
+			return _types[idx];
+		}
+
+	public:
+		LogReader(const std::string& path) : _path(path) {}
+
+		void start(const char* p, const char* end)
+		{
+			_p = p;
+			_end = end;
+		}
+
+		bool done(void) const { return _p == _end; }
+
+		uint8_t op(void) { return get<uint8_t>(); }
+
+		void reset(void)
+		{
+			_types.clear();
+			_atoms.clear();
+		}
+
+		void define_type(void)
+		{
+			uint16_t idx = get<uint16_t>();
+			std::string name = get_string();
+			if (idx != _types.size()) corrupt();
+
+			Type t = nameserver().getType(name);
+			if (NOTYPE == t)
+				throw IOException(TRACE_INFO,
+					"ChangeLog: %s has unknown type %s",
+					_path.c_str(), name.c_str());
+			_types.push_back(t);
+		}
+
+		Handle atom(void)
+		{
+			uint8_t tag = get<uint8_t>();
+			if (ATOM_REF == tag)
+			{
+				uint32_t id = get<uint32_t>();
+				if (_atoms.size() <= id) corrupt();
+				return _atoms[id];
+			}
+
+			Type t = get_type();
+			Handle h;
+			if (ATOM_NODE == tag)
+			{
+				if (not nameserver().isA(t, NODE)) corrupt();
+				h = createNode(t, get_string());
+			}
+			else if (ATOM_LINK == tag)
+			{
+				if (not nameserver().isA(t, LINK)) corrupt();
+				uint32_t arity = get<uint32_t>();
+				HandleSeq oset;
+				for (uint32_t i = 0; i < arity; i++)
+					oset.emplace_back(atom());
+				h = createLink(std::move(oset), t);
+			}
+			else corrupt();
+
+			_atoms.push_back(h);
+			return h;
+		}
+
+		ValuePtr value(void)
+		{
+			Type vtype = get_type();
+			get<uint16_t>();
+			uint32_t size = get<uint32_t>();
+
+			if (vtype == FLOAT_VALUE or nameserver().isA(vtype, TRUTH_VALUE))
+			{
+				if ((size_t) (_end - _p) / sizeof(double) < size) corrupt();
+				std::vector<double> fltarr(size);
+				get(fltarr.data(), size * sizeof(double));
+
+				if (vtype == FLOAT_VALUE)
+					return createFloatValue(fltarr);
+				return ValueCast(TruthValue::factory(vtype, fltarr));
+			}
+
+			if (vtype == STRING_VALUE)
+			{
+				std::vector<std::string> strarr;
+				for (uint32_t i = 0; i < size; i++)
+					strarr.emplace_back(get_string());
+				return createStringValue(strarr);
+			}
+
+			if (vtype == LINK_VALUE)
+			{
+				std::vector<ValuePtr> lnkarr;
+				for (uint32_t i = 0; i < size; i++)
+					lnkarr.emplace_back(value());
+				return createLinkValue(lnkarr);
+			}
+
+			throw IOException(TRACE_INFO,
+				"ChangeLog: Unexpected value type=%d", vtype);
+		}
+};
+
+} // namespace
+
+/**
+ * Apply the records of one log to the AtomSpace. If truncate is set,
+ * a damaged record at the end is cut off, so that new records can be
+ * appended after the good ones. Returns the number of records.
+ */
+size_t ChangeLog::replay_file(const std::string& path, AtomSpace* as,
+                              bool truncate)
+{
+	int fd = open(path.c_str(), truncate ? O_RDWR : O_RDONLY);
+	if (fd < 0)
+	{
+		if (ENOENT == errno) return 0;
+		throw IOException(TRACE_INFO,
+			"ChangeLog: Unable to open %s: %s", path.c_str(), strerror(errno));
+	}
+
+	struct stat st;
+	if (0 != fstat(fd, &st) or 0 == st.st_size)
+	{
+		close(fd);
+		return 0;
+	}
+
+	size_t size = st.st_size;
+	void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (MAP_FAILED == addr)
+	{
+		int err = errno;
+		close(fd);
+		throw IOException(TRACE_INFO,
+			"ChangeLog: Unable to map %s: %s", path.c_str(), strerror(err));
+	}
+	madvise(addr, size, MADV_SEQUENTIAL);
+	const char* map = (const char*) addr;
+
+	auto cleanup = [&]() { munmap(addr, size); close(fd); };
+
+	ChangeLogHeader hdr;
+	if (size < sizeof(hdr))
+	{
+		cleanup();
+		throw IOException(TRACE_INFO,
+			"ChangeLog: %s is not a change log", path.c_str());
+	}
+	memcpy(&hdr, map, sizeof(hdr));
+	if (memcmp(hdr.magic, CHANGELOG_MAGIC, sizeof(hdr.magic)) or
+	    SNAPSHOT_BYTE_ORDER != hdr.byte_order or
+	    CHANGELOG_VERSION != hdr.version)
+	{
+		cleanup();
+		throw IOException(TRACE_INFO,
+			"ChangeLog: %s is not a change log of this version "
+			"and byte order", path.c_str());
+	}
+
+	LogReader rdr(path);
+	size_t nrecs = 0;
+	size_t pos = sizeof(hdr);
+	try
+	{
+		while (2 * sizeof(uint32_t) <= size - pos)
+		{
+			uint32_t len, crc;
+			memcpy(&len, map + pos, sizeof(len));
+			memcpy(&crc, map + pos + sizeof(len), sizeof(crc));
+			const char* payload = map + pos + 2 * sizeof(uint32_t);
+			if (size - pos - 2 * sizeof(uint32_t) < len) break;
+			if (log_crc32(payload, len) != crc) break;
+
+			rdr.start(payload, payload + len);
+			switch (rdr.op())
+			{
+				case LOG_RESET:
+					rdr.reset();
+					break;
+				case LOG_TYPE:
+					rdr.define_type();
+					break;
+				case LOG_ADD:
+					as->add_atom(rdr.atom());
+					break;
+				case LOG_REMOVE:
+				{
+					Handle h(as->get_atom(rdr.atom()));
+					if (h) as->remove_atom(h, false);
+					break;
+				}
+				case LOG_VALUE:
+				{
+					Handle h(as->get_atom(rdr.atom()));
+					Handle key(rdr.atom());
+					ValuePtr v(rdr.value());
+					if (h) h->setValue(key, v);
+					break;
+				}
+				case LOG_TV:
+				{
+					Handle h(as->get_atom(rdr.atom()));
+					ValuePtr v(rdr.value());
+					if (h) h->setTruthValue(TruthValueCast(v));
+					break;
+				}
+				default:
+					throw IOException(TRACE_INFO,
+						"ChangeLog: Unknown record in %s", path.c_str());
+			}
+			if (not rdr.done())
+				throw IOException(TRACE_INFO,
+					"ChangeLog: Corrupt record in %s", path.c_str());
+
+			pos += 2 * sizeof(uint32_t) + len;
+			nrecs++;
+		}
+	}
+	catch (...)
+	{
+		cleanup();
+		throw;
+	}
+
+	if (pos < size)
+	{
+		logger().warn("ChangeLog: Dropping %zu damaged bytes at the end of %s",
+			size - pos, path.c_str());
+		if (truncate and 0 != ftruncate(fd, pos))
+		{
+			int err = errno;
+			cleanup();
+			throw IOException(TRACE_INFO,
+				"ChangeLog: Unable to truncate %s: %s",
+				path.c_str(), strerror(err));
+		}
+	}
+	cleanup();
+	return nrecs;
+}
+
+/**
+ * Apply the log to the AtomSpace, as well as what is left of the log
+ * of a compaction that did not complete.
+ */
+size_t ChangeLog::replay(AtomSpace* as)
+{
+	if (_as)
+		throw RuntimeException(TRACE_INFO,
+			"ChangeLog: Cannot replay while attached");
+
+	time_t start = time(0);
+	size_t nrecs = replay_file(_path + ".prev", as, false);
+	nrecs += replay_file(_path, as, true);
+
+	printf("Replayed %zu changes from %s in %d seconds\n",
+		nrecs, _path.c_str(), (int) (time(0) - start));
+	return nrecs;
+}
+
+/* ================================================================ */
+
+void ChangeLog::print_stats(void)
+{
+	std::lock_guard<std::mutex> lck(_mtx);
+	printf("change log: %s\n", _path.c_str());
+	printf("records=%zu commits=%zu avg records per commit=%f\n",
+		_num_records, _num_commits,
+		_num_commits ? ((double) _num_records) / _num_commits : 0.0);
+	printf("bytes appended=%lu on disk=%lu pending=%zu\n",
+		(unsigned long) _appended, (unsigned long) _durable,
+		_pending.size());
+}
+
+/* ============================= END OF FILE ================= */
@@ -0,0 +1,177 @@
+/*
+ * opencog/persist/snapshot/ChangeLog.h
+ *
+ * Copyright (c) 2019 OpenCog Foundation
+ *
+ * LICENSE:
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_CHANGE_LOG_H
+#define _OPENCOG_CHANGE_LOG_H
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <opencog/atoms/base/Handle.h>
+#include <opencog/atoms/truthvalue/TruthValue.h>
+#include <opencog/atoms/value/Value.h>
+
+#include "SnapshotStorage.h"
+
+namespace opencog
+{
+/** \addtogroup grp_persist
+ *  @{
+ */
+
+class AtomSpace;
+
+/**
+ * An append-only log of the changes made to an AtomSpace: the atoms
+ * that are added and removed, and the truth values that are set. The
+ * changes are picked up from the AtomSpace signals, encoded, and
+ * appended to a buffer in RAM; a commit thread writes out the buffer,
+ * and syncs it to disk, every few milliseconds. All of the changes
+ * made during one interval thus share one write and one sync (group
+ * commit), and a change costs its encoding and a copy, not a disk
+ * write.
+ *
+ * The log is meant to be used together with a snapshot, as follows:
+ *
+ *    snapshot.loadAtomSpace(as);   // The state as of the last compact()
+ *    log.replay(as);               // The changes since then
+ *    log.attach(as);               // Log the changes from now on
+ *    ...
+ *    log.compact(snapshot);        // Write a snapshot; empty the log
+ *
+ * A crash loses at most the changes of the last commit interval. A
+ * partly-written record at the end of the log is dropped on replay,
+ * and cut off before anything more is appended.
+ *
+ * If a write fails, logging stops: the records after the failed
+ * write could not be decoded without it. The changes are no longer
+ * logged, and barrier(), compact() and detach() throw the error. To
+ * go on, detach() the log, and attach() and compact() it again.
+ *
+ * Only the changes that the AtomSpace signals are logged. The values
+ * that an atom has when it is added are logged with it, as are
+ * changes of its truth value; other values, set later, are not, as
+ * there is no signal for them. Compaction picks them up.
+ *
+ * The file format is described in ChangeLog.cc.
+ */
+class ChangeLog
+{
+	private:
+		std::string _path;
+		AtomSpace* _as;
+		int _added_conn;
+		int _removed_conn;
+		int _tv_conn;
+
+		// Encoding state: the atoms and types already written to the
+		// log. These are referred to by number, after that.
+		std::mutex _mtx;
+		std::unordered_map<Handle, uint32_t> _ids;
+		uint32_t _next_id;
+		std::unordered_map<Type, uint16_t> _tindex;
+		std::vector<char> _rec;
+		std::vector<char> _pending;
+		bool _sync;
+
+		void frame(const std::vector<char>&);
+		void encode_type(Type);
+		void encode_atom(const Handle&);
+		void encode_value(const ValuePtr&);
+		void append(std::unique_lock<std::mutex>&);
+		void reset(void);
+
+		void atom_added(const Handle&);
+		void atom_removed(const AtomPtr&);
+		void tv_changed(const Handle&, const TruthValuePtr&,
+		                const TruthValuePtr&);
+
+		// Group commit. The positions count the bytes appended, and
+		// the bytes that are on disk.
+		int _fd;
+		uint64_t _appended;
+		uint64_t _durable;
+		unsigned int _interval;
+		bool _stop;
+		bool _hurry;
+		std::exception_ptr _ex;
+		std::condition_variable _commit_cv;
+		std::condition_variable _durable_cv;
+		std::thread _commit_thread;
+		std::mutex _io_mtx;
+
+		void commit_loop(void);
+		void commit(std::unique_lock<std::mutex>&);
+		void wait_durable(std::unique_lock<std::mutex>&, uint64_t);
+		void rethrow(void);
+		void open_log(void);
+		void close_log(void);
+		void append_file(const std::string&, const std::string&);
+
+		// Replay
+		size_t replay_file(const std::string&, AtomSpace*, bool truncate);
+
+		// Statistics
+		size_t _num_records;
+		size_t _num_commits;
+
+	public:
+		ChangeLog(const std::string& path);
+		ChangeLog(const ChangeLog&) = delete;
+		ChangeLog& operator=(const ChangeLog&) = delete;
+		~ChangeLog();
+
+		const std::string& get_path(void) const { return _path; }
+
+		/// Apply the changes in the log to the AtomSpace.
+		size_t replay(AtomSpace*);
+
+		/// Start, and stop, logging the changes to the AtomSpace.
+		void attach(AtomSpace*);
+		void detach(void);
+
+		/// Write the entire AtomSpace to the snapshot, and then
+		/// drop the changes that it holds from the log.
+		void compact(SnapshotStorage&);
+
+		/// Wait until all changes logged so far are on disk.
+		void barrier(void);
+
+		/// How often the changes are written out and synced.
+		void set_commit_interval(unsigned int msec);
+
+		/// If set, each change waits for its commit, before
+		/// returning. Concurrent changes still share their commits.
+		void set_sync(bool);
+
+		void print_stats(void);
+};
+
+/** @}*/
+} // namespace opencog
+
+#endif // _OPENCOG_CHANGE_LOG_H
@@ -0,0 +1,116 @@
+/*
+ * opencog/persist/snapshot/SnapshotFormat.h
+ *
+ * Copyright (c) 2019 OpenCog Foundation
+ *
+ * LICENSE:
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_SNAPSHOT_FORMAT_H
+#define _OPENCOG_SNAPSHOT_FORMAT_H
+
+#include <stdint.h>
+
+namespace opencog
+{
+/** \addtogroup grp_persist
+ *  @{
+ */
+
+/**
+ * The layout of a snapshot file. It is meant to be mapped into
+ * memory and used in place, and so it is in the byte order of the
+ * machine that wrote it; a snapshot from a machine of the other byte
+ * order is refused. Every section starts on an 8-byte boundary.
+ *
+ * In the order in which they are written, the sections are:
+ *
+ * levels     -- uint64_t[max_height+2]; the index of the first atom
+ *               of each height, and then the number of atoms. All
+ *               atoms of one height refer only to lower atoms, and
+ *               so each height can be reconstructed in parallel.
+ * atoms      -- SnapshotAtom[num_atoms], by height.
+ * outgoing   -- uint32_t atom indexes; the outgoing sets of the links.
+ * strings    -- the names of the nodes, not NUL-terminated.
+ * values     -- the valuations, each one a SnapshotValuation followed
+ *               by its value. A value is a SnapshotValue, followed by
+ *               its size doubles, or its size strings (each a uint32_t
+ *               length and the bytes), or its size values, for a
+ *               LinkValue. These are not aligned.
+ * valuations -- uint64_t[num_valuations]; the offset of each
+ *               valuation in the values section.
+ * types      -- the type table; num_types type names, each a uint32_t
+ *               length and the bytes. Atoms and values refer to types
+ *               by their index in this table, so that a snapshot
+ *               survives the renumbering of the types.
+ */
+
+#define SNAPSHOT_MAGIC "OCSNAP\0\0"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+// Set in the height of the atoms that are not in the AtomSpace, but
+// are only used as the keys of values.
+#define SNAPSHOT_KEY_ONLY 0x8000
+
+struct SnapshotHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t file_size;
+
+	uint32_t num_types;
+	uint32_t max_height;
+	uint64_t num_atoms;
+	uint64_t num_valuations;
+
+	// Offsets of the sections, from the start of the file.
+	uint64_t levels;
+	uint64_t atoms;
+	uint64_t outgoing;
+	uint64_t strings;
+	uint64_t values;
+	uint64_t valuations;
+	uint64_t types;
+};
+
+struct SnapshotAtom
+{
+	uint16_t type;      // Index into the type table
+	uint16_t height;    // Zero for nodes; or SNAPSHOT_KEY_ONLY
+	uint32_t size;      // Length of the name, or the arity
+	uint64_t offset;    // Into the strings, or the outgoing indexes
+};
+
+struct SnapshotValuation
+{
+	uint32_t key;       // Atom indexes
+	uint32_t atom;
+};
+
+struct SnapshotValue
+{
+	uint16_t type;      // Index into the type table
+	uint16_t pad;
+	uint32_t size;      // Number of doubles, strings or values
+};
+
+/** @}*/
+} // namespace opencog
+
+#endif // _OPENCOG_SNAPSHOT_FORMAT_H
@@ -0,0 +1,432 @@
+/*
+ * opencog/persist/snapshot/SnapshotLoad.cc
+ * Mapping and reconstruction of AtomSpace snapshots.
+ *
+ * Copyright (c) 2019 OpenCog Foundation
+ *
+ * LICENSE:
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+#include <opencog/util/oc_omp.h>
+#include <opencog/atoms/atom_types/NameServer.h>
+#include <opencog/atoms/base/Link.h>
+#include <opencog/atoms/base/Node.h>
+#include <opencog/atoms/value/FloatValue.h>
+#include <opencog/atoms/value/LinkValue.h>
+#include <opencog/atoms/value/StringValue.h>
+#include <opencog/atoms/truthvalue/TruthValue.h>
+#include <opencog/atomspace/AtomSpace.h>
+
+#include "SnapshotStorage.h"
+
+using namespace opencog;
+
+/* ================================================================ */
+// Mapping
+
+void SnapshotStorage::map(void)
+{
+	if (_map) return;
+
+	_fd = open(_path.c_str(), O_RDONLY);
+	if (_fd < 0)
+		throw IOException(TRACE_INFO,
+			"Snapshot: Unable to open %s: %s", _path.c_str(), strerror(errno));
+
+	struct stat st;
+	if (0 != fstat(_fd, &st) or st.st_size < (off_t) sizeof(SnapshotHeader))
+	{
+		unmap();
+		throw IOException(TRACE_INFO,
+			"Snapshot: %s is not a snapshot", _path.c_str());
+	}
+	_map_size = st.st_size;
+
+	void* addr = mmap(nullptr, _map_size, PROT_READ, MAP_PRIVATE, _fd, 0);
+	if (MAP_FAILED == addr)
+	{
+		int err = errno;
+		unmap();
+		throw IOException(TRACE_INFO,
+			"Snapshot: Unable to map %s: %s", _path.c_str(), strerror(err));
+	}
+
+	// Everything will be read, more or less in order; have the
+	// kernel start on it now.
+	madvise(addr, _map_size, MADV_WILLNEED);
+	_map = (const char*) addr;
+	_header = (const SnapshotHeader*) addr;
+
+	try
+	{
+		check();
+	}
+	catch (...)
+	{
+		unmap();
+		throw;
+	}
+}
+
+void SnapshotStorage::unmap(void)
+{
+	if (_map) munmap((void*) _map, _map_size);
+	if (0 <= _fd) close(_fd);
+	_fd = -1;
+	_map = nullptr;
+	_map_size = 0;
+	_header = nullptr;
+	_types.clear();
+}
+
+#define CORRUPT(...) \
+	throw IOException(TRACE_INFO, "Snapshot: Corrupt snapshot %s: %s", \
+		_path.c_str(), __VA_ARGS__)
+
+/**
+ * Check the header, and everything in the sections that the
+ * reconstruction relies on, so that it cannot stray outside of the
+ * map. Also translate the type table.
+ */
+void SnapshotStorage::check(void)
+{
+	const SnapshotHeader& hdr = *_header;
+	if (memcmp(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic)))
+		throw IOException(TRACE_INFO,
+			"Snapshot: %s is not a snapshot", _path.c_str());
+	if (SNAPSHOT_BYTE_ORDER != hdr.byte_order)
+		throw IOException(TRACE_INFO,
+			"Snapshot: %s was written on a machine of another byte order",
+			_path.c_str());
+	if (SNAPSHOT_VERSION != hdr.version)
+		throw IOException(TRACE_INFO,
+			"Snapshot: %s has unsupported version %u",
+			_path.c_str(), hdr.version);
+	if (hdr.file_size != _map_size)
+		CORRUPT("truncated");
+
+	// The sections are in order, and each one is big enough. The
+	// counts come from the file, and so the sizes are checked by
+	// division, lest they overflow.
+	auto fits = [](uint64_t off, uint64_t n, uint64_t size, uint64_t limit)
+	{
+		return off <= limit and n <= (limit - off) / size;
+	};
+	uint64_t nlevels = (uint64_t) hdr.max_height + 2;
+	if (not (sizeof(hdr) <= hdr.levels and
+	         fits(hdr.levels, nlevels, sizeof(uint64_t), hdr.atoms) and
+	         fits(hdr.atoms, hdr.num_atoms, sizeof(SnapshotAtom), hdr.outgoing) and
+	         hdr.outgoing <= hdr.strings and
+	         hdr.strings <= hdr.values and
+	         hdr.values <= hdr.valuations and
+	         fits(hdr.valuations, hdr.num_valuations, sizeof(uint64_t), hdr.types) and
+	         hdr.types <= _map_size and
+	         0 == hdr.levels % 8 and 0 == hdr.atoms % 8 and
+	         0 == hdr.outgoing % 8 and 0 == hdr.valuations % 8))
+		CORRUPT("bad section offsets");
+
+	// The type table.
+	const char* p = _map + hdr.types;
+	const char* end = _map + _map_size;
+	for (uint32_t i = 0; i < hdr.num_types; i++)
+	{
+		uint32_t len;
+		if (end - p < (ptrdiff_t) sizeof(len)) CORRUPT("bad type table");
+		memcpy(&len, p, sizeof(len));
+		p += sizeof(len);
+		if (end - p < (ptrdiff_t) len) CORRUPT("bad type table");
+
+		std::string name(p, len);
+		p += len;
+		Type t = nameserver().getType(name);
+		if (NOTYPE == t)
+			throw IOException(TRACE_INFO,
+				"Snapshot: %s has unknown type %s",
+				_path.c_str(), name.c_str());
+		_types.push_back(t);
+	}
+
+	// The levels, and the atoms on each.
+	const uint64_t* lv = levels();
+	if (0 != lv[0] or hdr.num_atoms != lv[nlevels-1])
+		CORRUPT("bad levels");
+
+	const SnapshotAtom* sa = atoms();
+	const uint32_t* out = outgoing();
+	uint64_t nstrings = hdr.values - hdr.strings;
+	uint64_t noutgoing = (hdr.strings - hdr.outgoing) / sizeof(uint32_t);
+	for (uint64_t hei = 0; hei+1 < nlevels; hei++)
+	{
+		if (lv[hei+1] < lv[hei]) CORRUPT("bad levels");
+		for (uint64_t i = lv[hei]; i < lv[hei+1]; i++)
+		{
+			const SnapshotAtom& a = sa[i];
+			if (hdr.num_types <= a.type or
+			    hei != (a.height & ~SNAPSHOT_KEY_ONLY))
+				CORRUPT("bad atom");
+
+			Type t = _types[a.type];
+			if (0 == hei)
+			{
+				if (not nameserver().isA(t, NODE) or
+				    a.offset > nstrings or a.size > nstrings - a.offset)
+					CORRUPT("bad node");
+				continue;
+			}
+
+			if (not nameserver().isA(t, LINK) or
+			    a.offset > noutgoing or a.size > noutgoing - a.offset)
+				CORRUPT("bad link");
+
+			// Links refer only to atoms below them.
+			for (uint32_t k = 0; k < a.size; k++)
+				if (lv[hei] <= out[a.offset + k])
+					CORRUPT("bad outgoing set");
+		}
+	}
+
+	const uint64_t* voffs = valuations();
+	uint64_t nvalues = hdr.valuations - hdr.values;
+	for (uint64_t i = 0; i < hdr.num_valuations; i++)
+		if (voffs[i] > nvalues or
+		    nvalues - voffs[i] < sizeof(SnapshotValuation))
+			CORRUPT("bad valuation");
+}
+
+/* ================================================================ */
+// Reconstruction
+
+// The atoms, and the valuations, are handed out to the threads in
+// blocks of this many.
+#define BLOCK 4096
+
+/// Call f(first, last) on the blocks of [begin, end), in parallel.
+/// The first exception thrown is rethrown once all blocks are done.
+template<typename F>
+static void parallel_blocks(size_t begin, size_t end, F f)
+{
+	std::vector<size_t> starts;
+	for (size_t i = begin; i < end; i += BLOCK)
+		starts.push_back(i);
+
+	std::mutex mtx;
+	std::exception_ptr ex;
+	OMP_ALGO::for_each(starts.begin(), starts.end(),
+		[&](size_t first)
+	{
+		try
+		{
+			f(first, std::min(end, first + BLOCK));
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lck(mtx);
+			if (nullptr == ex) ex = std::current_exception();
+		}
+	});
+	if (ex) std::rethrow_exception(ex);
+}
+
+/// Reconstruct all of the atoms, height by height. If a table is
+/// given, the atoms are added to it.
+void SnapshotStorage::make_atoms(HandleSeq& hs, AtomTable* table)
+{
+	const SnapshotHeader& hdr = *_header;
+	const SnapshotAtom* sa = atoms();
+	const uint32_t* out = outgoing();
+	const uint64_t* lv = levels();
+	const char* strings = _map + hdr.strings;
+
+	hs.clear();
+	hs.resize(hdr.num_atoms);
+	for (uint32_t hei = 0; hei <= hdr.max_height; hei++)
+	{
+		parallel_blocks(lv[hei], lv[hei+1],
+			[&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+			{
+				const SnapshotAtom& a = sa[i];
+				Type t = _types[a.type];
+
+				Handle h;
+				if (0 == hei)
+				{
+					h = createNode(t, std::string(strings + a.offset, a.size));
+				}
+				else
+				{
+					HandleSeq oset;
+					oset.reserve(a.size);
+					for (uint32_t k = 0; k < a.size; k++)
+						oset.emplace_back(hs[out[a.offset + k]]);
+					h = createLink(std::move(oset), t);
+				}
+
+				if (table and not (a.height & SNAPSHOT_KEY_ONLY))
+					h = table->add(h, false);
+				hs[i] = h;
+			}
+		});
+
+		if (table)
+			printf("Loaded %lu atoms at height %u\n",
+				(unsigned long) (lv[hei+1] - lv[hei]), hei);
+	}
+}
+
+/// Attach the values to the reconstructed atoms.
+void SnapshotStorage::make_values(const HandleSeq& hs)
+{
+	const SnapshotHeader& hdr = *_header;
+	const uint64_t* voffs = valuations();
+	const char* base = _map + hdr.values;
+	const char* end = _map + hdr.valuations;
+
+	parallel_blocks(0, hdr.num_valuations,
+		[&](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			const char* p = base + voffs[i];
+			SnapshotValuation svn;
+			memcpy(&svn, p, sizeof(svn));
+			p += sizeof(svn);
+			if (hs.size() <= svn.key or hs.size() <= svn.atom)
+				CORRUPT("bad valuation");
+
+			hs[svn.atom]->setValue(hs[svn.key], make_value(p, end));
+		}
+	});
+}
+
+/// Read one value, advancing the pointer past it.
+ValuePtr SnapshotStorage::make_value(const char*& p, const char* end)
+{
+	SnapshotValue sv;
+	if (end - p < (ptrdiff_t) sizeof(sv)) CORRUPT("bad value");
+	memcpy(&sv, p, sizeof(sv));
+	p += sizeof(sv);
+	if (_types.size() <= sv.type) CORRUPT("bad value");
+
+	// Convert to the C++ runtime type, as doUnpackValue() does in
+	// the SQL backend.
+	Type vtype = _types[sv.type];
+	if (vtype == FLOAT_VALUE or nameserver().isA(vtype, TRUTH_VALUE))
+	{
+		if ((uint64_t) (end - p) < sv.size * sizeof(double))
+			CORRUPT("bad value");
+		std::vector<double> fltarr(sv.size);
+		memcpy(fltarr.data(), p, sv.size * sizeof(double));
+		p += sv.size * sizeof(double);
+
+		if (vtype == FLOAT_VALUE)
+			return createFloatValue(fltarr);
+		return ValueCast(TruthValue::factory(vtype, fltarr));
+	}
+
+	if (vtype == STRING_VALUE)
+	{
+		std::vector<std::string> strarr;
+		for (uint32_t i = 0; i < sv.size; i++)
+		{
+			uint32_t len;
+			if (end - p < (ptrdiff_t) sizeof(len)) CORRUPT("bad value");
+			memcpy(&len, p, sizeof(len));
+			p += sizeof(len);
+			if (end - p < (ptrdiff_t) len) CORRUPT("bad value");
+			strarr.emplace_back(p, len);
+			p += len;
+		}
+		return createStringValue(strarr);
+	}
+
+	if (vtype == LINK_VALUE)
+	{
+		std::vector<ValuePtr> lnkarr;
+		for (uint32_t i = 0; i < sv.size; i++)
+			lnkarr.emplace_back(make_value(p, end));
+		return createLinkValue(lnkarr);
+	}
+
+	throw IOException(TRACE_INFO, "Snapshot: Unexpected value type=%d",
+		vtype);
+}
+
+/* ================================================================ */
+
+/**
+ * Load the entire snapshot into the table. The atoms of each height
+ * are reconstructed in parallel, straight from the map, and then all
+ * of the values are attached, also in parallel.
+ */
+void SnapshotStorage::load(AtomTable& table)
+{
+	std::lock_guard<std::mutex> lck(_index_mtx);
+	time_t start = time(0);
+	map();
+
+	unsigned int nthreads = std::thread::hardware_concurrency();
+	if (0 == nthreads) nthreads = 8;
+	opencog::setting_omp(nthreads, nthreads);
+
+	printf("Loading %lu atoms from %s; max height=%u\n",
+		(unsigned long) _header->num_atoms, _path.c_str(),
+		_header->max_height);
+
+	table.begin_bulk(_header->num_atoms);
+	try
+	{
+		HandleSeq hs;
+		make_atoms(hs, &table);
+		make_values(hs);
+	}
+	catch (...)
+	{
+		table.end_bulk();
+		throw;
+	}
+	table.end_bulk();
+
+	// synchrnonize!
+	table.barrier();
+
+	printf("Finished loading %lu atoms and %lu values in %d seconds\n",
+		(unsigned long) _header->num_atoms,
+		(unsigned long) _header->num_valuations,
+		(int) (time(0) - start));
+}
+
+void SnapshotStorage::loadAtomSpace(AtomSpace* atomspace)
+{
+	load(atomspace->get_atomtable());
+}
+
+/* ============================= END OF FILE ================= */
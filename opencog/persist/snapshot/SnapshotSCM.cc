@@ -0,0 +1,217 @@
+/*
+ * opencog/persist/snapshot/SnapshotSCM.cc
+ *
+ * Copyright (c) 2019 OpenCog Foundation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_GUILE
+
+#include <opencog/atomspace/AtomSpace.h>
+#include <opencog/guile/SchemePrimitive.h>
+
+#include "SnapshotStorage.h"
+#include "SnapshotSCM.h"
+
+using namespace opencog;
+
+
+// =================================================================
+
+SnapshotSCM::SnapshotSCM(AtomSpace *as)
+{
+    _as = as;
+    _backing = nullptr;
+    _log = nullptr;
+
+    static bool is_init = false;
+    if (is_init) return;
+    is_init = true;
+    scm_with_guile(init_in_guile, this);
+}
+
+void* SnapshotSCM::init_in_guile(void* self)
+{
+    scm_c_define_module("opencog persist-snapshot", init_in_module, self);
+    scm_c_use_module("opencog persist-snapshot");
+    return NULL;
+}
+
+void SnapshotSCM::init_in_module(void* data)
+{
+   SnapshotSCM* self = (SnapshotSCM*) data;
+   self->init();
+}
+
+void SnapshotSCM::init(void)
+{
+    define_scheme_primitive("snapshot-open", &SnapshotSCM::do_open, this, "persist-snapshot");
+    define_scheme_primitive("snapshot-close", &SnapshotSCM::do_close, this, "persist-snapshot");
+    define_scheme_primitive("snapshot-load", &SnapshotSCM::do_load, this, "persist-snapshot");
+    define_scheme_primitive("snapshot-store", &SnapshotSCM::do_store, this, "persist-snapshot");
+    define_scheme_primitive("changelog-open", &SnapshotSCM::do_log_open, this, "persist-snapshot");
+    define_scheme_primitive("changelog-close", &SnapshotSCM::do_log_close, this, "persist-snapshot");
+    define_scheme_primitive("changelog-compact", &SnapshotSCM::do_log_compact, this, "persist-snapshot");
+    define_scheme_primitive("changelog-sync", &SnapshotSCM::do_log_sync, this, "persist-snapshot");
+    define_scheme_primitive("changelog-stats", &SnapshotSCM::do_log_stats, this, "persist-snapshot");
+}
+
+SnapshotSCM::~SnapshotSCM()
+{
+    if (_log) delete _log;
+    if (_backing) delete _backing;
+}
+
+void SnapshotSCM::do_open(const std::string& path)
+{
+    if (_backing)
+        throw RuntimeException(TRACE_INFO,
+             "snapshot-open: Error: Already opened a snapshot!");
+
+    // Unconditionally use the current atomspace, until the next close.
+    AtomSpace *as = SchemeSmob::ss_get_env_as("snapshot-open");
+    if (nullptr != as) _as = as;
+
+    if (nullptr == _as)
+        throw RuntimeException(TRACE_INFO,
+             "snapshot-open: Error: Can't find the atomspace!");
+
+    if (_as->isAttachedToBackingStore())
+        throw RuntimeException(TRACE_INFO,
+             "snapshot-open: Error: Atomspace connected to another storage backend!");
+
+    // The file is not touched until the first load, store or fetch;
+    // it need not exist yet.
+    _backing = new SnapshotStorage(path);
+    _backing->registerWith(_as);
+}
+
+void SnapshotSCM::do_close(void)
+{
+    if (nullptr == _backing)
+        throw RuntimeException(TRACE_INFO,
+             "snapshot-close: Error: Snapshot not open");
+
+    SnapshotStorage *backing = _backing;
+    _backing = nullptr;
+    backing->unregisterWith(_as);
+    delete backing;
+}
+
+void SnapshotSCM::do_load(void)
+{
+    if (nullptr == _backing)
+        throw RuntimeException(TRACE_INFO,
+            "snapshot-load: Error: Snapshot not open");
+
+    _backing->loadAtomSpace(_as);
+}
+
+void SnapshotSCM::do_store(void)
+{
+    if (nullptr == _backing)
+        throw RuntimeException(TRACE_INFO,
+            "snapshot-store: Error: Snapshot not open");
+
+    _backing->storeAtomSpace(_as);
+}
+
+// =================================================================
+
+void SnapshotSCM::do_log_open(const std::string& path)
+{
+    if (_log)
+        throw RuntimeException(TRACE_INFO,
+             "changelog-open: Error: Already opened a change log!");
+
+    AtomSpace *as = SchemeSmob::ss_get_env_as("changelog-open");
+    if (nullptr == as) as = _as;
+    if (nullptr == as)
+        throw RuntimeException(TRACE_INFO,
+             "changelog-open: Error: Can't find the atomspace!");
+
+    // Bring the atomspace up to date, and only then start logging.
+    ChangeLog *log = new ChangeLog(path);
+    try
+    {
+        log->replay(as);
+        log->attach(as);
+    }
+    catch (...)
+    {
+        delete log;
+        throw;
+    }
+    _log = log;
+}
+
+void SnapshotSCM::do_log_close(void)
+{
+    if (nullptr == _log)
+        throw RuntimeException(TRACE_INFO,
+             "changelog-close: Error: Change log not open");
+
+    ChangeLog *log = _log;
+    _log = nullptr;
+    try
+    {
+        log->detach();
+    }
+    catch (...)
+    {
+        delete log;
+        throw;
+    }
+    delete log;
+}
+
+void SnapshotSCM::do_log_compact(void)
+{
+    if (nullptr == _log)
+        throw RuntimeException(TRACE_INFO,
+             "changelog-compact: Error: Change log not open");
+    if (nullptr == _backing)
+        throw RuntimeException(TRACE_INFO,
+             "changelog-compact: Error: Snapshot not open");
+
+    _log->compact(*_backing);
+}
+
+void SnapshotSCM::do_log_sync(void)
+{
+    if (nullptr == _log)
+        throw RuntimeException(TRACE_INFO,
+             "changelog-sync: Error: Change log not open");
+
+    _log->barrier();
+}
+
+void SnapshotSCM::do_log_stats(void)
+{
+    if (nullptr == _log) {
+        printf("changelog-stats: Change log not open\n");
+        return;
+    }
+
+    _log->print_stats();
+}
+
+void opencog_persist_snapshot_init(void)
+{
+    static SnapshotSCM patty(NULL);
+}
+#endif // HAVE_GUILE
@@ -0,0 +1,74 @@
+/*
+ * opencog/persist/snapshot/SnapshotSCM.h
+ *
+ * Copyright (c) 2019 OpenCog Foundation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_SNAPSHOT_SCM_H
+#define _OPENCOG_SNAPSHOT_SCM_H
+
+#ifdef HAVE_GUILE
+
+#include <string>
+
+#include <opencog/atomspace/AtomSpace.h>
+#include <opencog/persist/snapshot/ChangeLog.h>
+#include <opencog/persist/snapshot/SnapshotStorage.h>
+
+namespace opencog
+{
+/** \addtogroup grp_persist
+ *  @{
+ */
+
+class SnapshotSCM
+{
+private:
+    static void* init_in_guile(void*);
+    static void init_in_module(void*);
+    void init(void);
+
+    SnapshotStorage *_backing;
+    ChangeLog *_log;
+    AtomSpace *_as;
+
+public:
+    SnapshotSCM(AtomSpace*);
+    ~SnapshotSCM();
+
+    void do_open(const std::string&);
+    void do_close(void);
+    void do_load(void);
+    void do_store(void);
+
+    void do_log_open(const std::string&);
+    void do_log_close(void);
+    void do_log_compact(void);
+    void do_log_sync(void);
+    void do_log_stats(void);
+}; // class
+
+/** @}*/
+}  // namespace
+
+extern "C" {
+void opencog_persist_snapshot_init(void);
+};
+#endif // HAVE_GUILE
+
+#endif // _OPENCOG_SNAPSHOT_SCM_H
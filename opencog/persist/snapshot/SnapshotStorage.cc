@@ -0,0 +1,222 @@
+/*
+ * opencog/persist/snapshot/SnapshotStorage.cc
+ * BackingStore queries against an AtomSpace snapshot.
+ *
+ * Copyright (c) 2019 OpenCog Foundation
+ *
+ * LICENSE:
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <opencog/atoms/atom_types/NameServer.h>
+#include <opencog/atoms/base/Link.h>
+#include <opencog/atoms/base/Node.h>
+
+#include "SnapshotStorage.h"
+
+using namespace opencog;
+
+SnapshotStorage::SnapshotStorage(const std::string& path) :
+	_path(path),
+	_fd(-1),
+	_map(nullptr),
+	_map_size(0),
+	_header(nullptr),
+	_indexed(false)
+{
+}
+
+SnapshotStorage::~SnapshotStorage()
+{
+	drop_index();
+	unmap();
+}
+
+/* ================================================================ */
+// Sections of the map
+
+const SnapshotAtom* SnapshotStorage::atoms(void) const
+{
+	return (const SnapshotAtom*) (_map + _header->atoms);
+}
+
+const uint32_t* SnapshotStorage::outgoing(void) const
+{
+	return (const uint32_t*) (_map + _header->outgoing);
+}
+
+const uint64_t* SnapshotStorage::levels(void) const
+{
+	return (const uint64_t*) (_map + _header->levels);
+}
+
+const uint64_t* SnapshotStorage::valuations(void) const
+{
+	return (const uint64_t*) (_map + _header->valuations);
+}
+
+/* ================================================================ */
+// The index
+
+/**
+ * Reconstruct all of the atoms in the snapshot, outside of any
+ * AtomSpace, and index them by content and by outgoing set. This is
+ * done on the first query, and kept until the snapshot is rewritten.
+ * Must be called with the _index_mtx held.
+ */
+void SnapshotStorage::make_index(void)
+{
+	if (_indexed) return;
+	map();
+
+	make_atoms(_atoms, nullptr);
+	make_values(_atoms);
+
+	_index.reserve(_atoms.size());
+	_incoming.resize(_atoms.size());
+	for (size_t i = 0; i < _atoms.size(); i++)
+	{
+		_index.emplace(_atoms[i], i);
+		if (not _atoms[i]->is_link()) continue;
+		for (const Handle& ho : _atoms[i]->getOutgoingSet())
+			_incoming[_index[ho]].push_back(i);
+	}
+	_indexed = true;
+}
+
+void SnapshotStorage::drop_index(void)
+{
+	_indexed = false;
+	_atoms.clear();
+	_index.clear();
+	_incoming.clear();
+}
+
+/// The index of the atom in the snapshot, or _atoms.size() if it
+/// is not in it.
+size_t SnapshotStorage::find(const Handle& h)
+{
+	auto it = _index.find(h);
+	if (_index.end() == it) return _atoms.size();
+	return it->second;
+}
+
+/// True if the atom is not in the AtomSpace that was stored, but is
+/// only the key of some value.
+bool SnapshotStorage::key_only(size_t i) const
+{
+	return atoms()[i].height & SNAPSHOT_KEY_ONLY;
+}
+
+/* ================================================================ */
+// BackingStore interface
+
+/// The atoms returned by getNode() and getLink() carry their values
+/// from the snapshot; but, since they are added to the AtomSpace by
+/// the caller, they do not replace the values of atoms that are
+/// already in it.
+Handle SnapshotStorage::getNode(Type t, const char * str)
+{
+	std::lock_guard<std::mutex> lck(_index_mtx);
+	make_index();
+	size_t i = find(createNode(t, str));
+	if (_atoms.size() == i) return Handle::UNDEFINED;
+	return _atoms[i];
+}
+
+Handle SnapshotStorage::getLink(Type t, const HandleSeq& hs)
+{
+	std::lock_guard<std::mutex> lck(_index_mtx);
+	make_index();
+	size_t i = find(createLink(hs, t));
+	if (_atoms.size() == i) return Handle::UNDEFINED;
+	return _atoms[i];
+}
+
+void SnapshotStorage::getIncomingSet(AtomTable& table, const Handle& h)
+{
+	getIncomingByType(table, h, ATOM);
+}
+
+void SnapshotStorage::getIncomingByType(AtomTable& table, const Handle& h,
+                                        Type t)
+{
+	std::lock_guard<std::mutex> lck(_index_mtx);
+	make_index();
+	size_t i = find(h);
+	if (_atoms.size() == i) return;
+
+	for (uint32_t li : _incoming[i])
+	{
+		const Handle& lnk = _atoms[li];
+		if (key_only(li)) continue;
+		if (ATOM == t or lnk->get_type() == t)
+			table.add(lnk, false);
+	}
+}
+
+void SnapshotStorage::getValuations(AtomTable& table,
+                                    const Handle& key, bool get_all)
+{
+	std::lock_guard<std::mutex> lck(_index_mtx);
+	make_index();
+
+	for (size_t i = 0; i < _atoms.size(); i++)
+	{
+		if (key_only(i)) continue;
+		const Handle& h = _atoms[i];
+		ValuePtr v = h->getValue(key);
+		if (nullptr == v) continue;
+
+		Handle ha = table.add(h, false);
+		if (get_all)
+		{
+			for (const Handle& k : h->getKeys())
+				ha->setValue(k, h->getValue(k));
+		}
+		else
+		{
+			ha->setValue(key, v);
+		}
+	}
+}
+
+void SnapshotStorage::loadType(AtomTable& table, Type t)
+{
+	std::lock_guard<std::mutex> lck(_index_mtx);
+	make_index();
+	for (size_t i = 0; i < _atoms.size(); i++)
+		if (not key_only(i) and _atoms[i]->get_type() == t)
+			table.add(_atoms[i], false);
+}
+
+void SnapshotStorage::storeAtom(const Handle& h, bool synchronous)
+{
+	throw IOException(TRACE_INFO,
+		"Snapshot: Snapshots are written whole; use store() instead");
+}
+
+/// The AtomSpace calls this for every atom removed from it, and so
+/// this cannot throw; the removal shows up in the next store().
+void SnapshotStorage::removeAtom(const Handle& h, bool recursive)
+{
+}
+
+void SnapshotStorage::barrier()
+{
+}
+
+/* ============================= END OF FILE ================= */
@@ -0,0 +1,130 @@
+/*
+ * opencog/persist/snapshot/SnapshotStorage.h
+ *
+ * Copyright (c) 2019 OpenCog Foundation
+ *
+ * LICENSE:
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_SNAPSHOT_STORAGE_H
+#define _OPENCOG_SNAPSHOT_STORAGE_H
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <opencog/atoms/base/Handle.h>
+#include <opencog/atoms/value/Value.h>
+#include <opencog/atomspace/AtomTable.h>
+#include <opencog/atomspace/BackingStore.h>
+
+#include "SnapshotFormat.h"
+
+namespace opencog
+{
+/** \addtogroup grp_persist
+ *  @{
+ */
+
+/**
+ * An AtomSpace snapshot in a single file: all of the atoms and their
+ * values, written in one sequential pass by store(), and read back by
+ * load(), straight out of a memory map of the file, reconstructing
+ * the atoms of each height in parallel. See SnapshotFormat.h for the
+ * layout.
+ *
+ * Attached to an AtomSpace, the snapshot can be queried like any
+ * other BackingStore; the atoms are reconstructed, and indexed, on
+ * the first query. A snapshot is always written whole, and so
+ * storeAtom() is not supported, and removeAtom() does nothing; the
+ * removals show up in the next store().
+ */
+class SnapshotStorage : public BackingStore
+{
+	private:
+		std::string _path;
+
+		// The mapped file, if it has been mapped.
+		int _fd;
+		const char* _map;
+		size_t _map_size;
+		const SnapshotHeader* _header;
+		std::vector<Type> _types;
+
+		void map(void);
+		void unmap(void);
+		void check(void);
+
+		const SnapshotAtom* atoms(void) const;
+		const uint32_t* outgoing(void) const;
+		const uint64_t* levels(void) const;
+		const uint64_t* valuations(void) const;
+
+		// Reconstruction
+		void make_atoms(HandleSeq&, AtomTable*);
+		void make_values(const HandleSeq&);
+		ValuePtr make_value(const char*&, const char*);
+
+		// The atoms of the snapshot, for the BackingStore queries.
+		std::mutex _index_mtx;
+		bool _indexed;
+		HandleSeq _atoms;
+		std::unordered_map<Handle, size_t> _index;
+		std::vector<std::vector<uint32_t>> _incoming;
+		void make_index(void);
+		void drop_index(void);
+		size_t find(const Handle&);
+		bool key_only(size_t) const;
+
+	public:
+		SnapshotStorage(const std::string& path);
+		SnapshotStorage(const SnapshotStorage&) = delete;
+		SnapshotStorage& operator=(const SnapshotStorage&) = delete;
+		virtual ~SnapshotStorage();
+
+		const std::string& get_path(void) const { return _path; }
+
+		// BackingStore interface
+		Handle getNode(Type, const char *);
+		Handle getLink(Type, const HandleSeq&);
+		void getIncomingSet(AtomTable&, const Handle&);
+		void getIncomingByType(AtomTable&, const Handle&, Type);
+		void getValuations(AtomTable&, const Handle&, bool get_all);
+		void storeAtom(const Handle&, bool synchronous = false);
+		void removeAtom(const Handle&, bool recursive);
+		void loadType(AtomTable&, Type);
+		void barrier();
+
+		// Whole snapshots
+		void load(AtomTable&);
+		void store(const AtomTable&);
+		void loadAtomSpace(AtomSpace*);
+		void storeAtomSpace(AtomSpace*);
+
+		/// True if the value is of a kind that is stored.
+		static bool storable(const ValuePtr&);
+
+		/// Sync the directory holding the file, so that a file
+		/// created or renamed there survives a crash.
+		static void sync_dir(const std::string& path);
+};
+
+/** @}*/
+} // namespace opencog
+
+#endif // _OPENCOG_SNAPSHOT_STORAGE_H
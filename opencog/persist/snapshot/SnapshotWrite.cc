@@ -0,0 +1,386 @@
+/*
+ * opencog/persist/snapshot/SnapshotWrite.cc
+ * Writing of AtomSpace snapshots.
+ *
+ * Copyright (c) 2019 OpenCog Foundation
+ *
+ * LICENSE:
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <unordered_map>
+
+#include <opencog/atoms/atom_types/NameServer.h>
+#include <opencog/atoms/base/Atom.h>
+#include <opencog/atoms/value/FloatValue.h>
+#include <opencog/atoms/value/LinkValue.h>
+#include <opencog/atoms/value/StringValue.h>
+#include <opencog/atoms/truthvalue/TruthValue.h>
+#include <opencog/atomspace/AtomSpace.h>
+
+#include "SnapshotStorage.h"
+
+using namespace opencog;
+
+/* ================================================================ */
+
+// Write in chunks of about this size.
+#define WRITE_BUFFER (1 << 22)
+
+namespace {
+
+/// Sequential writer for a snapshot file. The header is written last,
+/// once the sizes of all of the sections are known.
+class SnapshotWriter
+{
+	private:
+		std::string _path;
+		FILE* _fh;
+		uint64_t _pos;
+		std::vector<char> _buf;
+
+		// The type table, in the order in which the types are seen.
+		std::unordered_map<Type, uint16_t> _tindex;
+
+		void fail(const char* what)
+		{
+			throw IOException(TRACE_INFO,
+				"Snapshot: Unable to %s %s: %s",
+				what, _path.c_str(), strerror(errno));
+		}
+
+	public:
+		std::vector<Type> types;
+
+		SnapshotWriter(const std::string& path) :
+			_path(path), _pos(0), _buf(WRITE_BUFFER)
+		{
+			_fh = fopen(path.c_str(), "wb");
+			if (nullptr == _fh) fail("create");
+			setvbuf(_fh, _buf.data(), _IOFBF, _buf.size());
+		}
+
+		~SnapshotWriter()
+		{
+			if (_fh) fclose(_fh);
+		}
+
+		void write(const void* p, size_t n)
+		{
+			if (0 < n and 1 != fwrite(p, n, 1, _fh)) fail("write");
+			_pos += n;
+		}
+
+		template<typename T> void put(const T& v) { write(&v, sizeof(v)); }
+
+		void put_string(const std::string& str)
+		{
+			put<uint32_t>(str.size());
+			write(str.data(), str.size());
+		}
+
+		uint64_t align(void)
+		{
+			static const char zeros[8] = {0};
+			write(zeros, (8 - _pos % 8) % 8);
+			return _pos;
+		}
+
+		uint16_t type(Type t)
+		{
+			auto it = _tindex.find(t);
+			if (_tindex.end() != it) return it->second;
+
+			uint16_t idx = types.size();
+			_tindex.emplace(t, idx);
+			types.push_back(t);
+			return idx;
+		}
+
+		void finish(const SnapshotHeader& hdr)
+		{
+			if (0 != fflush(_fh)) fail("write");
+			if (0 != fseek(_fh, 0, SEEK_SET)) fail("seek in");
+			if (1 != fwrite(&hdr, sizeof(hdr), 1, _fh)) fail("write");
+			if (0 != fflush(_fh)) fail("write");
+			if (0 != fsync(fileno(_fh))) fail("sync");
+			int rc = fclose(_fh);
+			_fh = nullptr;
+			if (0 != rc) fail("close");
+		}
+};
+
+} // namespace
+
+/// Find the height of the atom, and of everything under it.
+static int snapshot_height(const Handle& h,
+                           std::unordered_map<Handle, int>& heights)
+{
+	auto it = heights.find(h);
+	if (heights.end() != it) return it->second;
+
+	int hei = 0;
+	if (h->is_link())
+	{
+		for (const Handle& ho : h->getOutgoingSet())
+		{
+			int heig = snapshot_height(ho, heights);
+			if (hei < heig) hei = heig;
+		}
+		hei ++;
+	}
+
+	heights.emplace(h, hei);
+	return hei;
+}
+
+/// Only the kinds of values that the SQL backend stores are stored.
+bool SnapshotStorage::storable(const ValuePtr& v)
+{
+	Type t = v->get_type();
+	if (nameserver().isA(t, FLOAT_VALUE)) return true;
+	if (nameserver().isA(t, STRING_VALUE)) return true;
+	if (not nameserver().isA(t, LINK_VALUE)) return false;
+
+	for (const ValuePtr& vp : LinkValueCast(v)->value())
+		if (not storable(vp)) return false;
+	return true;
+}
+
+void SnapshotStorage::sync_dir(const std::string& path)
+{
+	size_t slash = path.rfind('/');
+	std::string dir = std::string::npos == slash ? "." :
+		0 == slash ? "/" : path.substr(0, slash);
+
+	int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+	if (fd < 0 or 0 != fsync(fd))
+	{
+		int err = errno;
+		if (0 <= fd) close(fd);
+		throw IOException(TRACE_INFO,
+			"Snapshot: Unable to sync directory %s: %s",
+			dir.c_str(), strerror(err));
+	}
+	close(fd);
+}
+
+static void write_value(SnapshotWriter& out, const ValuePtr& v)
+{
+	Type t = v->get_type();
+	SnapshotValue sv;
+	sv.type = out.type(t);
+	sv.pad = 0;
+
+	if (nameserver().isA(t, FLOAT_VALUE))
+	{
+		const std::vector<double>& flts = FloatValueCast(v)->value();
+		sv.size = flts.size();
+		out.put(sv);
+		out.write(flts.data(), flts.size() * sizeof(double));
+	}
+	else if (nameserver().isA(t, STRING_VALUE))
+	{
+		const std::vector<std::string>& strs = StringValueCast(v)->value();
+		sv.size = strs.size();
+		out.put(sv);
+		for (const std::string& str : strs)
+			out.put_string(str);
+	}
+	else
+	{
+		const std::vector<ValuePtr>& vals = LinkValueCast(v)->value();
+		sv.size = vals.size();
+		out.put(sv);
+		for (const ValuePtr& vp : vals)
+			write_value(out, vp);
+	}
+}
+
+/* ================================================================ */
+
+/**
+ * Write all of the atoms in the table, and their values, to the
+ * snapshot file. The file is written front to back, in one pass,
+ * to a temporary file that replaces the snapshot once it is complete;
+ * a crash part-way leaves the old snapshot intact.
+ */
+void SnapshotStorage::store(const AtomTable& table)
+{
+	time_t start = time(0);
+
+	// Everything in the table, and the keys of their values, by
+	// height. The index of an atom is its position in this order.
+	std::unordered_map<Handle, int> heights;
+	UnorderedHandleSet in_table;
+	table.foreachHandleByType(
+		[&](const Handle& h)->void
+		{
+			in_table.insert(h);
+			snapshot_height(h, heights);
+			for (const Handle& key : h->getKeys())
+				snapshot_height(key, heights);
+		},
+		ATOM, true);
+
+	int max_height = 0;
+	for (const auto& pr : heights)
+		if (max_height < pr.second) max_height = pr.second;
+
+	if (SNAPSHOT_KEY_ONLY <= max_height)
+		throw IOException(TRACE_INFO,
+			"Snapshot: Atoms are too deep to store: height %d", max_height);
+	if (UINT32_MAX <= heights.size())
+		throw IOException(TRACE_INFO,
+			"Snapshot: Too many atoms to store: %zu", heights.size());
+
+	std::vector<HandleSeq> by_height(max_height+1);
+	for (const auto& pr : heights)
+		by_height[pr.second].push_back(pr.first);
+	heights.clear();
+
+	HandleSeq order;
+	std::vector<uint64_t> levels;
+	for (const HandleSeq& hs : by_height)
+	{
+		levels.push_back(order.size());
+		order.insert(order.end(), hs.begin(), hs.end());
+	}
+	levels.push_back(order.size());
+	by_height.clear();
+
+	std::unordered_map<Handle, uint32_t> index;
+	for (size_t i = 0; i < order.size(); i++)
+		index.emplace(order[i], i);
+
+	// The old snapshot stays mapped until the new one is complete.
+	std::string tmp = _path + ".tmp";
+	SnapshotWriter out(tmp);
+
+	SnapshotHeader hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	out.put(hdr);
+
+	hdr.levels = out.align();
+	out.write(levels.data(), levels.size() * sizeof(uint64_t));
+
+	hdr.atoms = out.align();
+	uint64_t soff = 0;
+	uint64_t ooff = 0;
+	for (size_t hei = 0; hei+1 < levels.size(); hei++)
+	{
+		for (size_t i = levels[hei]; i < levels[hei+1]; i++)
+		{
+			const Handle& h = order[i];
+			SnapshotAtom sa;
+			sa.type = out.type(h->get_type());
+			sa.height = hei;
+			if (0 == in_table.count(h)) sa.height |= SNAPSHOT_KEY_ONLY;
+			if (h->is_node())
+			{
+				sa.size = h->get_name().size();
+				sa.offset = soff;
+				soff += sa.size;
+			}
+			else
+			{
+				sa.size = h->get_arity();
+				sa.offset = ooff;
+				ooff += sa.size;
+			}
+			out.put(sa);
+		}
+	}
+
+	hdr.outgoing = out.align();
+	for (size_t i = levels[1]; i < order.size(); i++)
+		for (const Handle& ho : order[i]->getOutgoingSet())
+			out.put<uint32_t>(index[ho]);
+
+	hdr.strings = out.align();
+	for (size_t i = 0; i < levels[1]; i++)
+	{
+		const std::string& name = order[i]->get_name();
+		out.write(name.data(), name.size());
+	}
+
+	// Default TV's are not stored, just as in the SQL backend.
+	hdr.values = out.align();
+	std::vector<uint64_t> voffs;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const Handle& h = order[i];
+		for (const Handle& key : h->getKeys())
+		{
+			ValuePtr v = h->getValue(key);
+			if (nullptr == v or not storable(v)) continue;
+			if (nameserver().isA(v->get_type(), TRUTH_VALUE) and
+			    TruthValueCast(v)->isDefaultTV())
+				continue;
+
+			voffs.push_back(out.align() - hdr.values);
+			SnapshotValuation svn;
+			svn.key = index[key];
+			svn.atom = i;
+			out.put(svn);
+			write_value(out, v);
+		}
+	}
+
+	hdr.valuations = out.align();
+	out.write(voffs.data(), voffs.size() * sizeof(uint64_t));
+
+	hdr.types = out.align();
+	for (Type t : out.types)
+		out.put_string(nameserver().getTypeName(t));
+
+	memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+	hdr.version = SNAPSHOT_VERSION;
+	hdr.byte_order = SNAPSHOT_BYTE_ORDER;
+	hdr.file_size = out.align();
+	hdr.num_types = out.types.size();
+	hdr.max_height = max_height;
+	hdr.num_atoms = order.size();
+	hdr.num_valuations = voffs.size();
+	out.finish(hdr);
+
+	// Swap in the new snapshot.
+	std::lock_guard<std::mutex> lck(_index_mtx);
+	drop_index();
+	unmap();
+	if (0 != rename(tmp.c_str(), _path.c_str()))
+		throw IOException(TRACE_INFO,
+			"Snapshot: Unable to rename %s to %s: %s",
+			tmp.c_str(), _path.c_str(), strerror(errno));
+	sync_dir(_path);
+
+	printf("Wrote %zu atoms and %zu values to %s in %d seconds\n",
+		order.size(), voffs.size(), _path.c_str(), (int) (time(0) - start));
+}
+
+void SnapshotStorage::storeAtomSpace(AtomSpace* atomspace)
+{
+	store(atomspace->get_atomtable());
+}
+
+/* ============================= END OF FILE ================= */
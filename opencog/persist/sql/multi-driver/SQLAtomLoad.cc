@@ -36,19 +36,20 @@
 
 using namespace opencog;
 
-#define BUFSZ 250
-
 /* ================================================================ */
 /**
  * One-size-fits-all atom fetcher.
- * Given an SQL query string, this will return a single atom.
+ * Given an SQL query, this will return a single atom.
  * It does NOT fetch values.
  */
-SQLAtomStorage::PseudoPtr SQLAtomStorage::getAtom(const char * query, int height)
+SQLAtomStorage::PseudoPtr SQLAtomStorage::getAtom(const char * name,
+                                                  const char * stmt,
+                                                  const LLParams& params,
+                                                  int height)
 {
 	Response rp(conn_pool);
 	rp.uuid = TLB::INVALID_UUID;
-	rp.exec(query);
+	rp.exec(name, stmt, params);
 	rp.rs->foreach_row(&Response::create_atom_cb, &rp);
 
 	// Did we actually find anything?
@@ -63,10 +64,8 @@ SQLAtomStorage::PseudoPtr SQLAtomStorage::getAtom(const char * query, int height
 SQLAtomStorage::PseudoPtr SQLAtomStorage::petAtom(UUID uuid)
 {
 	setup_typemap();
-	char buff[BUFSZ];
-	snprintf(buff, BUFSZ, "SELECT * FROM Atoms WHERE uuid = %lu;", uuid);
-
-	return getAtom(buff, -1);
+	return getAtom("pet_atom", "SELECT * FROM Atoms WHERE uuid = $1;",
+	               LLParams().add_int8(uuid), -1);
 }
 
 /// Get the full outgoing set, recursively.
@@ -129,25 +128,13 @@ Handle SQLAtomStorage::doGetNode(Type t, const char * str)
 
 	// If we don't know it, then go get it's UUID.
 	setup_typemap();
-	char buff[4*BUFSZ];
-
-	// Use postgres $-quoting to make unicode strings easier to deal with.
-	int nc = snprintf(buff, 4*BUFSZ, "SELECT * FROM Atoms WHERE "
-		"type = %d AND name = $ocp$%s$ocp$ ;", storing_typemap[t], str);
-
-	if (4*BUFSZ-1 <= nc)
-	{
-		buff[4*BUFSZ-1] = 0x0;
-		throw IOException(TRACE_INFO,
-			"SQLAtomStorage::getNode: buffer overflow!\n"
-			"\tnc=%d buffer=>>%s<<\n", nc, buff);
-		return Handle();
-	}
 
 	// Performance stats
 	_num_get_nodes++;
 
-	PseudoPtr p(getAtom(buff, 0));
+	PseudoPtr p(getAtom("get_node",
+		"SELECT * FROM Atoms WHERE type = $1 AND name = $2;",
+		LLParams().add_int2(storing_typemap[t]).add_text(str), 0));
 	if (NULL == p) return Handle();
 
 	_num_got_nodes++;
@@ -177,10 +164,11 @@ Handle SQLAtomStorage::doGetLink(Type t, const HandleSeq& hseq)
 
 	// If the outgoing set is not yet known, then the link
 	// itself cannot possibly be known.
-	std::string ostr;
+	std::vector<UUID> oset;
 	try
 	{
-		ostr = oset_to_string(hseq);
+		for (const Handle& ho : hseq)
+			oset.push_back(get_uuid(ho));
 	}
 	catch (const NotFoundException& ex)
 	{
@@ -190,18 +178,11 @@ Handle SQLAtomStorage::doGetLink(Type t, const HandleSeq& hseq)
 	// If we don't know it, then go get it's UUID.
 	setup_typemap();
 
-	char buff[BUFSZ];
-	snprintf(buff, BUFSZ,
-		"SELECT * FROM Atoms WHERE type = %d AND outgoing = ",
-		storing_typemap[t]);
-
-	std::string qstr = buff;
-	qstr += ostr;
-	qstr += ";";
-
 	// Performance stats
 	_num_get_links++;
-	PseudoPtr p = getAtom(qstr.c_str(), 1);
+	PseudoPtr p = getAtom("get_link",
+		"SELECT * FROM Atoms WHERE type = $1 AND outgoing = $2;",
+		LLParams().add_int2(storing_typemap[t]).add_int8_array(oset), 1);
 	if (nullptr == p) return Handle();
 
 	_num_got_links++;
@@ -245,15 +226,7 @@ SQLAtomStorage::PseudoPtr SQLAtomStorage::makeAtom(Response &rp, UUID uuid)
 	}
 	else
 	{
-		char *p = (char *) rp.outlist;
-		while (p)
-		{
-			// Break if there are no more atoms in the outgoing set
-			// or if the outgoing set is empty in the first place.
-			if (*p == '}' or *p == '\0') break;
-			UUID out(strtoul(p+1, &p, 10));
-			atom->oset.emplace_back(out);
-		}
+		atom->oset = rp.outlist;
 	}
 
 	// Give the atom the correct UUID. The AtomTable will need this.
@@ -118,6 +118,13 @@ void SQLAtomStorage::init(const char * uri)
 	max_height = 0;
 	bulk_load = false;
 	bulk_store = false;
+	_copy_store = false;
+
+	// No batching, by default; see set_write_batch().
+	_batch_size = 1;
+	_batch_latency = std::chrono::milliseconds(50);
+	_batch_writers = 0;
+	_batch_stop = false;
 	clear_stats();
 
 	for (int i=0; i< TYPEMAP_SZ; i++)
@@ -167,6 +174,13 @@ SQLAtomStorage::~SQLAtomStorage()
 {
 	flushStoreQueue();
 
+	{
+		std::lock_guard<std::mutex> lck(_batch_mutex);
+		_batch_stop = true;
+	}
+	_batch_cond.notify_all();
+	if (_batch_timer.joinable()) _batch_timer.join();
+
 	while (not conn_pool.is_empty())
 	{
 		LLConnection* db_conn = conn_pool.pop();
@@ -243,6 +257,7 @@ void SQLAtomStorage::flushStoreQueue()
 {
 	rethrow();
 	_write_queue.barrier();
+	flush_batch();
 	rethrow();
 }
 
@@ -356,6 +371,27 @@ void SQLAtomStorage::set_stall_writers(bool stall)
 	_write_queue.stall(stall);
 }
 
+void SQLAtomStorage::set_copy_store(bool copy)
+{
+	_copy_store = copy;
+}
+
+/// Use binary parameters and results for the prepared statements, on
+/// the drivers that can. Waits for every connection to be returned
+/// to the pool.
+void SQLAtomStorage::set_binary_params(bool binary)
+{
+	std::vector<LLConnection*> conns;
+	for (int i=0; i<_initial_conn_pool_size; i++)
+		conns.push_back(conn_pool.pop());
+
+	for (LLConnection* db_conn : conns)
+	{
+		db_conn->set_binary_params(binary);
+		conn_pool.push(db_conn);
+	}
+}
+
 void SQLAtomStorage::clear_stats(void)
 {
 	_stats_time = time(0);
@@ -363,6 +399,8 @@ void SQLAtomStorage::clear_stats(void)
 	_store_count = 0;
 	_valuation_stores = 0;
 	_value_stores = 0;
+	_num_batches = 0;
+	_num_batched = 0;
 
 	_write_queue.clear_stats();
 
@@ -470,6 +508,13 @@ void SQLAtomStorage::print_stats(void)
 	       _write_queue._in_drain, _write_queue.get_busy_writers(),
 	       _write_queue.get_size());
 
+	size_t num_batches = _num_batches;
+	size_t num_batched = _num_batched;
+	frac = num_batched / ((double) num_batches);
+	printf("write batches=%zu atoms=%zu avg batch size=%f (max %zu, %d msec)\n",
+	       num_batches, num_batched, frac, _batch_size,
+	       (int) _batch_latency.count());
+
 	printf("current conn_pool free=%u of %d\n", conn_pool.size(),
 	       _initial_conn_pool_size);
 
@@ -26,9 +26,12 @@
 #define _OPENCOG_SQL_ATOM_STORAGE_H
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <set>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 // #include <opencog/util/async_method_caller.h>
@@ -93,7 +96,7 @@ class SQLAtomStorage : public BackingStore
 		typedef std::shared_ptr<PseudoAtom> PseudoPtr;
 		#define createPseudo std::make_shared<PseudoAtom>
 		PseudoPtr makeAtom(Response&, UUID);
-		PseudoPtr getAtom(const char *, int);
+		PseudoPtr getAtom(const char *, const char *, const LLParams&, int);
 		PseudoPtr petAtom(UUID);
 
 		Handle get_recursive_if_not_exists(PseudoPtr);
@@ -104,7 +107,8 @@ class SQLAtomStorage : public BackingStore
 		int getMaxObservedHeight(void);
 		int max_height;
 
-		void getIncoming(AtomTable&, const char *);
+		void getIncoming(AtomTable&, const char *, const char *,
+		                 const LLParams&);
 		// --------------------------
 		// Storing of atoms
 		std::mutex _store_mutex;
@@ -115,11 +119,42 @@ class SQLAtomStorage : public BackingStore
 
 		bool not_yet_stored(const Handle&);
 		std::string oset_to_string(const HandleSeq&);
+		static int atom_height(const Handle&,
+		                       std::unordered_map<Handle, int>&);
 
 		bool bulk_load;
 		bool bulk_store;
 		time_t bulk_start;
 
+		// Bulk store with COPY, instead of INSERT.
+		bool _copy_store;
+		bool copy_store(const AtomTable&);
+
+		// Batched stores from the write queue, if turned on with
+		// set_write_batch(). The writer threads gather the queued
+		// atoms into batches, and each batch is written with a few
+		// multi-row INSERT's. A batch is written when it is full, or
+		// when its oldest atom has waited for longer than the latency;
+		// the timer thread looks after the latter, when the queue
+		// goes quiet.
+		std::mutex _batch_mutex;
+		std::condition_variable _batch_cond;
+		HandleSeq _batch;
+		std::chrono::steady_clock::time_point _batch_start;
+		size_t _batch_size;
+		std::chrono::milliseconds _batch_latency;
+		int _batch_writers;
+		bool _batch_stop;
+		std::thread _batch_timer;
+
+		void batch_timer_loop(void);
+		void write_batch(const HandleSeq&);
+		void flush_batch(void);
+		void store_batch(const HandleSeq&);
+		void store_batch_atoms(Response&, const HandleSeq&, int,
+		                       std::vector<UUID>&);
+		void store_batch_values(const HandleSeq&);
+
 		// --------------------------
 		// Atom removal
 		void removeAtom(Response&, UUID, bool recursive);
@@ -140,7 +175,7 @@ class SQLAtomStorage : public BackingStore
 		typedef unsigned long VUID;
 
 		ValuePtr doUnpackValue(Response&);
-		ValuePtr doGetValue(const char *);
+		ValuePtr doGetValue(const char *, const char *, const LLParams&);
 
 		VUID storeValue(const ValuePtr&);
 		ValuePtr getValue(VUID);
@@ -156,9 +191,7 @@ class SQLAtomStorage : public BackingStore
 		void deleteValuation(Response&, UUID, UUID);
 		void deleteAllValuations(Response&, UUID);
 
-		std::string float_to_string(const FloatValuePtr&);
-		std::string string_to_string(const StringValuePtr&);
-		std::string link_to_string(const LinkValuePtr&);
+		void value_params(LLParams&, const ValuePtr&);
 
 		Handle tvpred; // the key to a very special valuation.
 
@@ -186,6 +219,9 @@ class SQLAtomStorage : public BackingStore
 
 			// Issue an unused UUID
 			UUID get_uuid(void);
+
+			// Reserve blocks of unused UUID's, enough for n of them.
+			std::vector<UUID> get_blocks(size_t n);
 		};
 		UUID_manager _uuid_manager;
 		UUID_manager _vuid_manager;
@@ -208,6 +244,8 @@ class SQLAtomStorage : public BackingStore
 		std::atomic<size_t> _store_count;
 		std::atomic<size_t> _valuation_stores;
 		std::atomic<size_t> _value_stores;
+		std::atomic<size_t> _num_batches;
+		std::atomic<size_t> _num_batched;
 		time_t _stats_time;
 
 		// -------------------------------
@@ -275,6 +313,9 @@ class SQLAtomStorage : public BackingStore
 		void clear_stats(void); // reset stats counters.
 		void set_hilo_watermarks(int, int);
 		void set_stall_writers(bool);
+		void set_copy_store(bool);
+		void set_write_batch(int, int);
+		void set_binary_params(bool);
 };
 
 
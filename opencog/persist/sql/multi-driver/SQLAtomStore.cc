@@ -110,17 +110,45 @@ int SQLAtomStorage::do_store_atom(const Handle& h)
 	return lheight;
 }
 
-void SQLAtomStorage::vdo_store_atom(const Handle& h)
+/// Find the height of the atom, and of everything under it. The
+/// atoms are checked against the limits of the Atoms table, as
+/// do_store_single_atom() does. Used for the stores that write
+/// many atoms at once, with COPY, or in batches.
+int SQLAtomStorage::atom_height(const Handle& h,
+                                std::unordered_map<Handle, int>& heights)
 {
-	try
+	auto it = heights.find(h);
+	if (heights.end() != it) return it->second;
+
+	int hei = 0;
+	if (h->is_node())
 	{
-		if (not_yet_stored(h)) do_store_atom(h);
-		store_atom_values(h);
+		if (2700 < h->get_name().size())
+		{
+			throw IOException(TRACE_INFO,
+				"Error: atom_height: Maxiumum Node name size is 2700.\n");
+		}
 	}
-	catch (...)
+	else
 	{
-		_async_write_queue_exception = std::current_exception();
+		if (330 < h->get_arity())
+		{
+			throw IOException(TRACE_INFO,
+				"Error: atom_height: Maxiumum Link size is 330. "
+				"Atom was: %s\n", h->to_string().c_str());
+		}
+
+		// One more than the tallest atom in the outgoing set.
+		for (const Handle& ho : h->getOutgoingSet())
+		{
+			int heig = atom_height(ho, heights);
+			if (hei < heig) hei = heig;
+		}
+		hei ++;
 	}
+
+	heights.emplace(h, hei);
+	return hei;
 }
 
 /* ================================================================ */
@@ -0,0 +1,471 @@
+/*
+ * SQLBatch.cc
+ * Batched store of atoms and their values, from the write queue.
+ *
+ * Copyright (c) 2019 OpenCog Foundation
+ *
+ * LICENSE:
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+#include <opencog/atoms/base/Atom.h>
+#include <opencog/atoms/truthvalue/TruthValue.h>
+#include <opencog/atomspace/AtomSpace.h>
+#include <opencog/atomspaceutils/TLB.h>
+
+#include "SQLAtomStorage.h"
+#include "SQLResponse.h"
+
+using namespace opencog;
+
+/* ================================================================ */
+
+// Postgres allows at most 65535 parameters in one statement; this
+// keeps the multi-row INSERT's well below that.
+#define MAX_BATCH_ROWS 1000
+
+// The multi-row INSERT's are prepared for these numbers of rows only,
+// so that there are a few prepared statements, and not one for every
+// size of batch. A batch is split into statements of these sizes,
+// largest first.
+static const size_t BATCH_ROWS[] = {MAX_BATCH_ROWS, 100, 10, 1};
+
+/// The number of rows of the next statement, for n rows to go.
+static size_t batch_rows(size_t n)
+{
+	for (size_t rows : BATCH_ROWS)
+		if (rows <= n) return rows;
+	return 1;
+}
+
+/**
+ * Add an atom from the write queue to the current batch. The batch
+ * is written by whichever writer thread fills it, or finds it too
+ * old; the others go straight back to the queue. Unless batching was
+ * asked for, with set_write_batch(), each atom is stored on its own.
+ */
+void SQLAtomStorage::vdo_store_atom(const Handle& h)
+{
+	HandleSeq batch;
+	{
+		std::unique_lock<std::mutex> lck(_batch_mutex);
+		if (_batch_size <= 1 and _batch.empty())
+		{
+			lck.unlock();
+			try
+			{
+				if (not_yet_stored(h)) do_store_atom(h);
+				store_atom_values(h);
+			}
+			catch (...)
+			{
+				_async_write_queue_exception = std::current_exception();
+			}
+			return;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (_batch.empty()) _batch_start = now;
+		_batch.push_back(h);
+
+		if (_batch.size() < _batch_size and
+		    now - _batch_start < _batch_latency)
+			return;
+
+		batch.swap(_batch);
+		_batch_writers++;
+	}
+	write_batch(batch);
+}
+
+/// Write the batch, taken by the caller from _batch. Exceptions are
+/// handed to the user thread, the same way as for the write queue.
+void SQLAtomStorage::write_batch(const HandleSeq& batch)
+{
+	try
+	{
+		if (not batch.empty()) store_batch(batch);
+	}
+	catch (...)
+	{
+		_async_write_queue_exception = std::current_exception();
+	}
+
+	std::lock_guard<std::mutex> lck(_batch_mutex);
+	_batch_writers--;
+	_batch_cond.notify_all();
+}
+
+/// Write whatever is in the current batch, and wait for the batches
+/// that other threads are writing. Once the write queue is drained,
+/// this completes the barrier.
+void SQLAtomStorage::flush_batch(void)
+{
+	HandleSeq batch;
+	{
+		std::lock_guard<std::mutex> lck(_batch_mutex);
+		batch.swap(_batch);
+		_batch_writers++;
+	}
+	write_batch(batch);
+
+	std::unique_lock<std::mutex> lck(_batch_mutex);
+	_batch_cond.wait(lck, [this]{ return 0 == _batch_writers; });
+}
+
+/// Write out the current batch, once it is older than the latency.
+/// Without this, the last few atoms would sit in the batch until the
+/// next store, or the next barrier.
+void SQLAtomStorage::batch_timer_loop(void)
+{
+	std::unique_lock<std::mutex> lck(_batch_mutex);
+	while (not _batch_stop)
+	{
+		_batch_cond.wait_for(lck, _batch_latency);
+		if (_batch.empty() or
+		    std::chrono::steady_clock::now() - _batch_start < _batch_latency)
+			continue;
+
+		HandleSeq batch;
+		batch.swap(_batch);
+		_batch_writers++;
+		lck.unlock();
+		write_batch(batch);
+		lck.lock();
+	}
+}
+
+void SQLAtomStorage::set_write_batch(int size, int msec)
+{
+	std::lock_guard<std::mutex> lck(_batch_mutex);
+	_batch_size = (1 < size) ? size : 1;
+	_batch_latency = std::chrono::milliseconds((1 < msec) ? msec : 1);
+	_batch_cond.notify_all();
+
+	// The timer is needed only once there are batches.
+	if (1 < _batch_size and not _batch_timer.joinable())
+		_batch_timer = std::thread(&SQLAtomStorage::batch_timer_loop, this);
+}
+
+/* ================================================================ */
+
+/// The VALUES list of a multi-row INSERT: ($1, $2), ($3, $4), ...
+static std::string value_rows(size_t nrows, size_t ncols)
+{
+	std::string rows;
+	size_t n = 1;
+	for (size_t i = 0; i < nrows; i++)
+	{
+		rows += (0 == i) ? "(" : ", (";
+		for (size_t j = 0; j < ncols; j++, n++)
+		{
+			if (0 < j) rows += ", ";
+			rows += "$" + std::to_string(n);
+		}
+		rows += ")";
+	}
+	return rows;
+}
+
+/**
+ * Store the atoms in the batch, everything under them, and the keys
+ * of their values; then all of their values. This does the same as
+ * calling do_store_atom() and store_atom_values() on each atom, but
+ * with a few multi-row INSERT's for all of the atoms of each height,
+ * instead of one INSERT for each atom.
+ *
+ * The atoms are stored in one transaction, and the values in a second
+ * one. The atoms must be committed before the _store_mutex is let go:
+ * their UUID's are in the TLB from then on, and another connection
+ * storing a valuation of one of them would otherwise fail the foreign
+ * key check on the Valuations table. Committing the values along
+ * with them would hold the _store_mutex, and so stall every other
+ * writer, for the whole of the batch.
+ */
+void SQLAtomStorage::store_batch(const HandleSeq& batch)
+{
+	setup_typemap();
+
+	// The async_buffer does not queue an atom twice, but the timer
+	// and the writers might still hand over overlapping batches.
+	HandleSeq atoms;
+	UnorderedHandleSet seen;
+	std::unordered_map<Handle, int> heights;
+	for (const Handle& h : batch)
+	{
+		if (not seen.insert(h).second) continue;
+		atoms.push_back(h);
+		atom_height(h, heights);
+		for (const Handle& key : h->getKeys())
+			atom_height(key, heights);
+	}
+
+	{
+		// Hold the lock, just like do_store_single_atom(), so that no
+		// one else sees a UUID before its atom is in the database.
+		std::lock_guard<std::mutex> create_lock(_store_mutex);
+
+		// Group the atoms that are not yet stored by height; atoms
+		// refer only to atoms lower than themselves.
+		std::map<int, HandleSeq> levels;
+		for (const auto& pr : heights)
+		{
+			if (TLB::INVALID_UUID == _tlbuf.getUUID(pr.first))
+				levels[pr.second].push_back(pr.first);
+		}
+
+		Response rp(conn_pool);
+		std::vector<UUID> fresh;
+		rp.exec("BEGIN;");
+		try
+		{
+			for (const auto& lvl : levels)
+			{
+				const HandleSeq& hs = lvl.second;
+				for (size_t i = 0; i < hs.size(); )
+				{
+					size_t n = batch_rows(hs.size() - i);
+					store_batch_atoms(rp,
+						HandleSeq(hs.begin() + i, hs.begin() + i + n),
+						lvl.first, fresh);
+					i += n;
+				}
+			}
+			rp.exec("COMMIT;");
+		}
+		catch (...)
+		{
+			// None of the atoms are in the database; so neither may
+			// their UUID's be in the TLB.
+			try { rp.exec("ROLLBACK;"); } catch (...) {}
+			for (UUID uuid : fresh)
+				_tlbuf.removeAtom(uuid);
+			throw;
+		}
+	}
+
+	store_batch_values(atoms);
+
+	_num_batches++;
+	_num_batched += atoms.size();
+}
+
+/// Store atoms of the given height, all in one INSERT, in the
+/// transaction open on rp. The UUID's issued are added to fresh. Must
+/// be called with the _store_mutex held.
+void SQLAtomStorage::store_batch_atoms(Response& rp, const HandleSeq& hs,
+                                       int height, std::vector<UUID>& fresh)
+{
+	LLParams params;
+	std::vector<UUID> uuids;
+	for (const Handle& h : hs)
+	{
+		// Issue a brand-spankin new UUID.
+		UUID uuid = _tlbuf.addAtom(h, TLB::INVALID_UUID);
+		uuids.push_back(uuid);
+		fresh.push_back(uuid);
+
+		// See do_store_single_atom() for the atomspace.
+		params.add_int8(uuid);
+		params.add_int8(h->getAtomSpace() ? 1 : 0);
+		params.add_int2(storing_typemap[h->get_type()]);
+		params.add_int2(height);
+
+		if (h->is_node())
+		{
+			params.add_text(h->get_name());
+			params.add_null(LLParams::INT8_ARRAY);
+		}
+		else
+		{
+			std::vector<uint64_t> oset;
+			for (const Handle& ho : h->getOutgoingSet())
+				oset.push_back(_tlbuf.getUUID(ho));
+			params.add_null(LLParams::TEXT);
+			params.add_int8_array(oset);
+		}
+	}
+
+	// In a multi-user scenario, some other user may have stored
+	// some of these atoms already. Those rows are skipped; only the
+	// UUID's of the rows that were inserted come back.
+	std::string stmt =
+		"INSERT INTO Atoms (uuid, space, type, height, name, outgoing) "
+		"VALUES " + value_rows(hs.size(), 6) +
+		" ON CONFLICT DO NOTHING RETURNING uuid;";
+	std::string name = "store_atoms_" + std::to_string(hs.size());
+
+	std::vector<UUID> inserted;
+	rp.uvec = &inserted;
+	rp.exec(name.c_str(), stmt.c_str(), params);
+	rp.rs->foreach_row(&Response::get_uuid_cb, &rp);
+	rp.uvec = nullptr;
+
+	// Use the UUID's that the winners got, henceforth.
+	if (inserted.size() < hs.size())
+	{
+		std::set<UUID> got(inserted.begin(), inserted.end());
+		for (size_t i = 0; i < hs.size(); i++)
+		{
+			if (got.end() != got.find(uuids[i])) continue;
+
+			const Handle& h = hs[i];
+			_tlbuf.removeAtom(uuids[i]);
+			Handle dbh = h->is_node() ?
+				doGetNode(h->get_type(), h->get_name().c_str()) :
+				doGetLink(h->get_type(), h->getOutgoingSet());
+			if (nullptr == dbh)
+				throw IOException(TRACE_INFO,
+					"Error: store_batch_atoms: Unable to store atom %s\n",
+					h->to_string().c_str());
+		}
+	}
+
+	if (0 == height)
+		_num_node_inserts += inserted.size();
+	else
+		_num_link_inserts += inserted.size();
+	if (max_height < height) max_height = height;
+
+	size_t before = _store_count.fetch_add(inserted.size());
+	if (bulk_store and before/100000 != _store_count/100000)
+	{
+		time_t secs = time(0) - bulk_start;
+		double rate = ((double) _store_count) / secs;
+		unsigned long kays = ((unsigned long) _store_count) / 1000;
+		printf("\tStored %luK atoms in %d seconds (%d per second)\n",
+			kays, (int) secs, (int) rate);
+	}
+}
+
+/**
+ * Store all of the values of the atoms, in one transaction. As in
+ * store_atom_values(), the default TV is not stored, but deleted,
+ * and, as in deleteValuation(), the link values that are replaced
+ * are deleted from the Values table.
+ */
+void SQLAtomStorage::store_batch_values(const HandleSeq& atoms)
+{
+	UUID tvuid = _tlbuf.getUUID(tvpred);
+
+	std::vector<std::tuple<UUID, UUID, ValuePtr>> rows;
+	std::vector<uint64_t> auids;
+	std::vector<uint64_t> defaults;
+	for (const Handle& h : atoms)
+	{
+		UUID auid = _tlbuf.getUUID(h);
+		auids.push_back(auid);
+
+		bool deftv = h->getTruthValue()->isDefaultTV();
+		if (deftv) defaults.push_back(auid);
+
+		for (const Handle& key : h->getKeys())
+		{
+			UUID kuid = _tlbuf.getUUID(key);
+			if (deftv and kuid == tvuid) continue;
+			rows.emplace_back(kuid, auid, h->getValue(key));
+		}
+	}
+
+	// Always update the rows in the same order, so that concurrent
+	// batches cannot deadlock on them.
+	std::sort(rows.begin(), rows.end(),
+		[](const std::tuple<UUID, UUID, ValuePtr>& a,
+		   const std::tuple<UUID, UUID, ValuePtr>& b)
+		{
+			return std::tie(std::get<1>(a), std::get<0>(a)) <
+			       std::tie(std::get<1>(b), std::get<0>(b));
+		});
+
+	// The parameters are built up first, as the members of link
+	// values are stored as they go.
+	std::vector<LLParams> chunks;
+	for (size_t i = 0, left = 0; i < rows.size(); i++, left--)
+	{
+		if (0 == left)
+		{
+			left = batch_rows(rows.size() - i);
+			chunks.emplace_back();
+		}
+		LLParams& params = chunks.back();
+		params.add_int8(std::get<0>(rows[i])).add_int8(std::get<1>(rows[i]));
+		value_params(params, std::get<2>(rows[i]));
+	}
+
+	Response rp(conn_pool);
+
+	// The link values that are about to be replaced.
+	std::map<std::pair<UUID, UUID>, std::vector<VUID>> oldlinks;
+	rp.lnkvals = &oldlinks;
+	rp.exec("get_batch_link_values",
+		"SELECT key, atom, linkvalue FROM Valuations "
+		"WHERE atom = ANY($1) AND linkvalue IS NOT NULL;",
+		LLParams().add_int8_array(auids));
+	rp.rs->foreach_row(&Response::get_link_values_cb, &rp);
+	rp.lnkvals = nullptr;
+
+	for (const auto& row : rows)
+	{
+		auto it = oldlinks.find(std::make_pair(std::get<0>(row),
+		                                       std::get<1>(row)));
+		if (oldlinks.end() == it) continue;
+		for (VUID vu : it->second)
+			deleteValue(vu);
+	}
+
+	// Use a transaction, so that other threads/users see the
+	// valuation updates atomically; see storeValuation().
+	rp.exec("BEGIN;");
+	try
+	{
+		if (not defaults.empty())
+		{
+			rp.exec("delete_default_tvs",
+				"DELETE FROM Valuations WHERE key = $1 AND atom = ANY($2);",
+				LLParams().add_int8(tvuid).add_int8_array(defaults));
+		}
+
+		for (const LLParams& params : chunks)
+		{
+			size_t nrows = params.params.size() / 6;
+			std::string stmt =
+				"INSERT INTO Valuations (key, atom, type, "
+				"floatvalue, stringvalue, linkvalue) "
+				"VALUES " + value_rows(nrows, 6) +
+				" ON CONFLICT (key, atom) DO UPDATE SET "
+				"type = EXCLUDED.type, "
+				"floatvalue = EXCLUDED.floatvalue, "
+				"stringvalue = EXCLUDED.stringvalue, "
+				"linkvalue = EXCLUDED.linkvalue;";
+			std::string name = "store_valuations_" + std::to_string(nrows);
+			rp.exec(name.c_str(), stmt.c_str(), params);
+		}
+		rp.exec("COMMIT;");
+	}
+	catch (...)
+	{
+		try { rp.exec("ROLLBACK;"); } catch (...) {}
+		throw;
+	}
+
+	_valuation_stores += rows.size();
+}
+
+/* ============================= END OF FILE ================= */
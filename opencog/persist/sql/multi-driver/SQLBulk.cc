@@ -43,19 +43,19 @@
 
 using namespace opencog;
 
-#define BUFSZ 120
 /* ================================================================ */
 /**
  * Retreive the incoming set of the indicated atom.
  */
-void SQLAtomStorage::getIncoming(AtomTable& table, const char *buff)
+void SQLAtomStorage::getIncoming(AtomTable& table, const char *name,
+                                 const char *stmt, const LLParams& params)
 {
 	std::vector<PseudoPtr> pset;
 	Response rp(conn_pool);
 	rp.store = this;
 	rp.height = -1;
 	rp.pvec = &pset;
-	rp.exec(buff);
+	rp.exec(name, stmt, params);
 	rp.rs->foreach_row(&Response::fetch_incoming_set_cb, &rp);
 
 	HandleSeq iset;
@@ -94,19 +94,15 @@ void SQLAtomStorage::getIncomingSet(AtomTable& table, const Handle& h)
 	UUID uuid = check_uuid(h);
 	if (TLB::INVALID_UUID == uuid) return;
 
-	char buff[BUFSZ];
-	snprintf(buff, BUFSZ,
-		"SELECT * FROM Atoms WHERE outgoing @> ARRAY[CAST(%lu AS BIGINT)];",
-		uuid);
-
 	// Note: "select * from atoms where outgoing@>array[556];" will
 	// return all links with atom 556 in the outgoing set -- i.e. the
 	// incoming set of 556.  We could also use && here instead of @>
 	// but I don't know if this one is faster.
-	// The cast to BIGINT is needed, as otherwise one gets
+	// The parameter is a BIGINT array, as otherwise one gets
 	// ERROR:  operator does not exist: bigint[] @> integer[]
-
-	getIncoming(table, buff);
+	getIncoming(table, "get_incoming_set",
+		"SELECT * FROM Atoms WHERE outgoing @> $1;",
+		LLParams().add_int8_array({uuid}));
 }
 
 /**
@@ -124,12 +120,9 @@ void SQLAtomStorage::getIncomingByType(AtomTable& table, const Handle& h, Type t
 
 	int dbtype = storing_typemap[t];
 
-	char buff[BUFSZ];
-	snprintf(buff, BUFSZ,
-		"SELECT * FROM Atoms WHERE type = %d AND outgoing @> ARRAY[CAST(%lu AS BIGINT)];",
-		dbtype, uuid);
-
-	getIncoming(table, buff);
+	getIncoming(table, "get_incoming_by_type",
+		"SELECT * FROM Atoms WHERE type = $1 AND outgoing @> $2;",
+		LLParams().add_int2(dbtype).add_int8_array({uuid}));
 }
 
 /* ================================================================ */
@@ -154,6 +147,9 @@ void SQLAtomStorage::load(AtomTable &table)
 	bulk_load = true;
 	bulk_start = time(0);
 
+	// Ends the bulk load, even if the load below throws.
+	AtomTable::BulkLoad bulk(table, max_nrec);
+
 	setup_typemap();
 
 #define NCHUNKS 300
@@ -180,12 +176,11 @@ void SQLAtomStorage::load(AtomTable &table)
 			Response rp(conn_pool);
 			rp.table = &table;
 			rp.store = this;
-			char buff[BUFSZ];
-			snprintf(buff, BUFSZ, "SELECT * FROM Atoms WHERE "
-			         "height = %d AND uuid > %lu AND uuid <= %lu;",
-			         hei, rec, rec+stepsize);
 			rp.height = hei;
-			rp.exec(buff);
+			rp.exec("load_atoms", "SELECT * FROM Atoms WHERE "
+			        "height = $1 AND uuid > $2 AND uuid <= $3;",
+			        LLParams().add_int2(hei).add_int8(rec)
+			                  .add_int8(rec+stepsize));
 			rp.rs->foreach_row(&Response::load_all_atoms_cb, &rp);
 		});
 		printf("Loaded %lu atoms at height %d\n", _load_count - cur, hei);
@@ -196,6 +191,7 @@ void SQLAtomStorage::load(AtomTable &table)
 	printf("Finished loading %zu atoms in total in %d seconds (%d per second)\n",
 		(_load_count - start_count), (int) secs, (int) rate);
 	bulk_load = false;
+	bulk.end();
 
 	// synchrnonize!
 	table.barrier();
@@ -242,12 +238,11 @@ void SQLAtomStorage::loadType(AtomTable &table, Type atom_type)
 			Response rp(conn_pool);
 			rp.table = &table;
 			rp.store = this;
-			char buff[BUFSZ];
-			snprintf(buff, BUFSZ, "SELECT * FROM Atoms WHERE type = %d "
-			         "AND height = %d AND uuid > %lu AND uuid <= %lu;",
-			         db_atom_type, hei, rec, rec+stepsize);
 			rp.height = hei;
-			rp.exec(buff);
+			rp.exec("load_type", "SELECT * FROM Atoms WHERE type = $1 "
+			        "AND height = $2 AND uuid > $3 AND uuid <= $4;",
+			        LLParams().add_int2(db_atom_type).add_int2(hei)
+			                  .add_int8(rec).add_int8(rec+stepsize));
 			rp.rs->foreach_row(&Response::load_if_not_exists_cb, &rp);
 		});
 		logger().debug("SQLAtomStorage::loadType: "
@@ -291,16 +286,22 @@ void SQLAtomStorage::store(const AtomTable &table)
 
 	bulk_start = time(0);
 
-	// Try to knock out the nodes first, then the links.
-	table.foreachHandleByType(
-		[&](const Handle& h)->void { storeAtom(h); },
-		NODE, true);
+	// If asked for, stream everything into an empty database with
+	// COPY, instead of one INSERT per atom; see set_copy_store().
+	// If the driver cannot COPY, fall back to the INSERT's.
+	if (not bulk_store or not _copy_store or not copy_store(table))
+	{
+		// Try to knock out the nodes first, then the links.
+		table.foreachHandleByType(
+			[&](const Handle& h)->void { storeAtom(h); },
+			NODE, true);
 
-	table.foreachHandleByType(
-		[&](const Handle& h)->void { storeAtom(h); },
-		LINK, true);
+		table.foreachHandleByType(
+			[&](const Handle& h)->void { storeAtom(h); },
+			LINK, true);
 
-	flushStoreQueue();
+		flushStoreQueue();
+	}
 	bulk_store = false;
 
 	time_t secs = time(0) - bulk_start;
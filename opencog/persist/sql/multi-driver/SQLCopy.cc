@@ -0,0 +1,333 @@
+/*
+ * SQLCopy.cc
+ * Bulk store of Atoms and Valuations, with COPY.
+ *
+ * Copyright (c) 2019 OpenCog Foundation
+ *
+ * LICENSE:
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <unordered_map>
+
+#include <opencog/atoms/base/Atom.h>
+#include <opencog/atoms/atom_types/NameServer.h>
+#include <opencog/atoms/value/FloatValue.h>
+#include <opencog/atoms/value/LinkValue.h>
+#include <opencog/atoms/value/StringValue.h>
+#include <opencog/atoms/truthvalue/TruthValue.h>
+#include <opencog/atomspace/AtomSpace.h>
+#include <opencog/atomspaceutils/TLB.h>
+
+#include "ll-pg-binary.h"
+#include "SQLAtomStorage.h"
+#include "SQLResponse.h"
+
+using namespace opencog;
+
+/* ================================================================ */
+
+// Send the rows to the server in chunks of about this size.
+#define COPY_CHUNK (1 << 20)
+
+/**
+ * Writer for the binary format of COPY ... FROM STDIN; see the
+ * postgres documentation for COPY. Each row is a field count,
+ * followed by the fields, each one a byte length (-1 for NULL)
+ * followed by the value, in the format of ll-pg-binary.h.
+ *
+ * The writer holds on to a connection from the pool while the COPY
+ * is in progress. If it is destroyed before finish(), because an
+ * exception was thrown, then the COPY is abandoned; nothing of it
+ * is stored.
+ */
+class CopyWriter
+{
+	private:
+		concurrent_stack<LLConnection*>& _pool;
+		LLConnection* _conn;
+		bool _open;
+		std::string _buf;
+		std::string _field;
+
+		void flush(void)
+		{
+			_conn->copy_put(_buf.data(), _buf.size());
+			_buf.clear();
+		}
+
+		void put_field(void)
+		{
+			pgbinary::put_int4(_buf, _field.size());
+			_buf += _field;
+			_field.clear();
+		}
+
+	public:
+		CopyWriter(concurrent_stack<LLConnection*>& pool) :
+			_pool(pool), _conn(nullptr), _open(false) {}
+
+		~CopyWriter()
+		{
+			if (_open)
+			{
+				try { _conn->copy_end(true); } catch (...) {}
+			}
+			if (_conn) _pool.push(_conn);
+		}
+
+		/// Return false if the driver cannot COPY.
+		bool begin(const char * stmt)
+		{
+			_conn = _pool.pop();
+			if (not _conn->copy_begin(stmt)) return false;
+			_open = true;
+
+			// Signature, flags, and header extension length.
+			_buf.reserve(COPY_CHUNK + COPY_CHUNK/8);
+			_buf.append("PGCOPY\n\377\r\n\0", 11);
+			pgbinary::put_int4(_buf, 0);
+			pgbinary::put_int4(_buf, 0);
+			return true;
+		}
+
+		void row(int16_t nfields)
+		{
+			if (COPY_CHUNK < _buf.size()) flush();
+			pgbinary::put_int2(_buf, nfields);
+		}
+
+		void null(void) { pgbinary::put_int4(_buf, -1); }
+
+		void int2(int16_t v)
+		{
+			pgbinary::put_int4(_buf, 2);
+			pgbinary::put_int2(_buf, v);
+		}
+
+		void int8(int64_t v)
+		{
+			pgbinary::put_int4(_buf, 8);
+			pgbinary::put_int8(_buf, v);
+		}
+
+		void text(const std::string& str)
+		{
+			pgbinary::put_int4(_buf, str.size());
+			_buf += str;
+		}
+
+		void int8_array(const std::vector<UUID>& vec)
+		{
+			pgbinary::put_int8_array(_field, vec);
+			put_field();
+		}
+
+		void float8_array(const std::vector<double>& vec)
+		{
+			pgbinary::put_float8_array(_field, vec);
+			put_field();
+		}
+
+		void text_array(const std::vector<std::string>& vec)
+		{
+			pgbinary::put_text_array(_field, vec);
+			put_field();
+		}
+
+		void finish(void)
+		{
+			pgbinary::put_int2(_buf, -1);
+			flush();
+			_open = false;
+			_conn->copy_end();
+		}
+};
+
+/* ================================================================ */
+
+/**
+ * Store all of the atoms in the table, and all of their values,
+ * streaming them to the database with COPY, instead of sending one
+ * INSERT for each.
+ *
+ * This is valid only when none of these atoms are in the database
+ * yet, i.e. when bulk_store is set: COPY cannot skip the rows that
+ * are already there, and a single duplicate fails the entire COPY.
+ *
+ * Returns false, having done nothing, if the driver cannot COPY.
+ */
+bool SQLAtomStorage::copy_store(const AtomTable& table)
+{
+	CopyWriter atoms(conn_pool);
+	if (not atoms.begin("COPY Atoms (uuid, space, type, height, name, outgoing) "
+	                    "FROM STDIN WITH (FORMAT binary);"))
+		return false;
+
+	// One pass finds the height of every atom in the table, and of
+	// the keys of its values. Everything is checked before the
+	// first UUID is issued.
+	std::unordered_map<Handle, int> heights;
+	table.foreachHandleByType(
+		[&](const Handle& h)->void
+		{
+			atom_height(h, heights);
+			for (const Handle& key : h->getKeys())
+				atom_height(key, heights);
+		},
+		ATOM, true);
+
+	// The atoms that are already in the database (e.g. tvpred)
+	// are not copied; all of the others get UUID's, in blocks.
+	HandleSeq fresh;
+	HandleSeq stored;
+	for (const auto& pr : heights)
+	{
+		if (TLB::INVALID_UUID == _tlbuf.getUUID(pr.first))
+			fresh.push_back(pr.first);
+		else
+			stored.push_back(pr.first);
+	}
+
+	// The UUID's go into the TLB only once the COPY has succeeded;
+	// if it fails, none of the atoms are in the database, and no one
+	// may be handed their UUID's.
+	std::unordered_map<Handle, UUID> uuids;
+	std::vector<UUID> blocks = _uuid_manager.get_blocks(fresh.size());
+	size_t i = 0;
+	for (UUID uuid : blocks)
+	{
+		UUID top = uuid + _uuid_manager._uuid_pool_increment;
+		for (; uuid < top and i < fresh.size(); uuid++, i++)
+			uuids.emplace(fresh[i], uuid);
+	}
+
+	for (const Handle& h : fresh)
+	{
+		int hei = heights[h];
+		atoms.row(6);
+		atoms.int8(uuids[h]);
+
+		// See do_store_single_atom() for the atomspace.
+		atoms.int8(h->getAtomSpace() ? 1 : 0);
+		atoms.int2(storing_typemap[h->get_type()]);
+		atoms.int2(hei);
+
+		if (h->is_node())
+		{
+			atoms.text(h->get_name());
+			atoms.null();
+			_num_node_inserts++;
+		}
+		else
+		{
+			std::vector<UUID> oset;
+			for (const Handle& ho : h->getOutgoingSet())
+			{
+				auto it = uuids.find(ho);
+				oset.push_back(uuids.end() != it ?
+					it->second : _tlbuf.getUUID(ho));
+			}
+			atoms.null();
+			atoms.int8_array(oset);
+			_num_link_inserts++;
+			if (max_height < hei) max_height = hei;
+		}
+
+		_store_count ++;
+		if (_store_count%100000 == 0)
+		{
+			time_t secs = time(0) - bulk_start;
+			double rate = ((double) _store_count) / secs;
+			unsigned long kays = ((unsigned long) _store_count) / 1000;
+			printf("\tCopied %luK atoms in %d seconds (%d per second)\n",
+				kays, (int) secs, (int) rate);
+		}
+	}
+	atoms.finish();
+
+	for (const auto& pr : uuids)
+		_tlbuf.addAtom(pr.first, pr.second);
+
+	// The atoms must all be there, before the valuations that
+	// refer to them.
+	CopyWriter vals(conn_pool);
+	vals.begin("COPY Valuations (key, atom, type, "
+	           "floatvalue, stringvalue, linkvalue) "
+	           "FROM STDIN WITH (FORMAT binary);");
+
+	for (const Handle& h : fresh)
+	{
+		UUID auid = _tlbuf.getUUID(h);
+		for (const Handle& key : h->getKeys())
+		{
+			ValuePtr pap = h->getValue(key);
+			Type vtype = pap->get_type();
+
+			// Default TV's are not stored; see store_atom_values().
+			if (nameserver().isA(vtype, TRUTH_VALUE) and
+			    TruthValueCast(pap)->isDefaultTV())
+				continue;
+
+			vals.row(6);
+			vals.int8(_tlbuf.getUUID(key));
+			vals.int8(auid);
+			vals.int2(storing_typemap[vtype]);
+
+			if (nameserver().isA(vtype, FLOAT_VALUE))
+			{
+				vals.float8_array(FloatValueCast(pap)->value());
+				vals.null();
+				vals.null();
+			}
+			else
+			if (nameserver().isA(vtype, STRING_VALUE))
+			{
+				vals.null();
+				vals.text_array(StringValueCast(pap)->value());
+				vals.null();
+			}
+			else
+			if (nameserver().isA(vtype, LINK_VALUE))
+			{
+				// The members go to the Values table, one at a time,
+				// on some other connection.
+				std::vector<UUID> vuids;
+				for (const ValuePtr& v : LinkValueCast(pap)->value())
+					vuids.push_back(storeValue(v));
+				vals.null();
+				vals.null();
+				vals.int8_array(vuids);
+			}
+			else
+			{
+				vals.null();
+				vals.null();
+				vals.null();
+			}
+			_valuation_stores++;
+		}
+	}
+	vals.finish();
+
+	// Whatever was already there might have valuations there too;
+	// these are replaced, the usual way.
+	for (const Handle& h : stored)
+		store_atom_values(h);
+
+	return true;
+}
+
+/* ============================= END OF FILE ================= */
@@ -70,6 +70,9 @@ void SQLPersistSCM::init(void)
     define_scheme_primitive("sql-clear-stats", &SQLPersistSCM::do_clear_stats, this, "persist-sql");
     define_scheme_primitive("sql-set-hilo-watermarks!", &SQLPersistSCM::do_set_hilo, this, "persist-sql");
     define_scheme_primitive("sql-set-stall-writers!", &SQLPersistSCM::do_set_stall, this, "persist-sql");
+    define_scheme_primitive("sql-set-copy-store!", &SQLPersistSCM::do_set_copy, this, "persist-sql");
+    define_scheme_primitive("sql-set-write-batch!", &SQLPersistSCM::do_set_batch, this, "persist-sql");
+    define_scheme_primitive("sql-set-binary-params!", &SQLPersistSCM::do_set_binary, this, "persist-sql");
 }
 
 SQLPersistSCM::~SQLPersistSCM()
@@ -200,6 +203,36 @@ void SQLPersistSCM::do_set_stall(bool stall)
     _backing->set_stall_writers(stall);
 }
 
+void SQLPersistSCM::do_set_copy(bool copy)
+{
+    if (nullptr == _backing) {
+        printf("sql-stats: Database not open\n");
+        return;
+    }
+
+    _backing->set_copy_store(copy);
+}
+
+void SQLPersistSCM::do_set_batch(int size, int msec)
+{
+    if (nullptr == _backing) {
+        printf("sql-stats: Database not open\n");
+        return;
+    }
+
+    _backing->set_write_batch(size, msec);
+}
+
+void SQLPersistSCM::do_set_binary(bool binary)
+{
+    if (nullptr == _backing) {
+        printf("sql-stats: Database not open\n");
+        return;
+    }
+
+    _backing->set_binary_params(binary);
+}
+
 void opencog_persist_sql_init(void)
 {
     static SQLPersistSCM patty(NULL);
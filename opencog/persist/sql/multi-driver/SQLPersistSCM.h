@@ -64,6 +64,9 @@ public:
 
     void do_set_hilo(int, int);
     void do_set_stall(bool);
+    void do_set_copy(bool);
+    void do_set_batch(int, int);
+    void do_set_binary(bool);
 
 }; // class
 
@@ -26,13 +26,17 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <map>
+
 #include <opencog/atoms/base/Atom.h>
 #include <opencog/atomspace/AtomSpace.h>
 #include <opencog/atomspaceutils/TLB.h>
 
 #include "llapi.h"
+#include "ll-pg-binary.h"
 #include "SQLAtomStorage.h"
 
 using namespace opencog;
@@ -55,7 +59,7 @@ class SQLAtomStorage::Response
 		UUID uuid;
 		Type itype;
 		const char* name;
-		const char* outlist;
+		std::vector<UUID> outlist;
 		int height;
 
 		// Values
@@ -72,7 +76,6 @@ class SQLAtomStorage::Response
 		    rs(nullptr),
 		    itype(0),
 		    name(nullptr),
-		    outlist(nullptr),
 		    height(0),
 		    floatval(0),
 		    stringval(nullptr),
@@ -84,9 +87,7 @@ class SQLAtomStorage::Response
 		    pvec(nullptr),
 		    uvec(nullptr),
 		    tname(""),
-		    fltval(0),
-		    strval(nullptr),
-		    lnkval(nullptr),
+		    lnkvals(nullptr),
 		    get_all_values(false),
 		    intval(0)
 		{}
@@ -122,6 +123,97 @@ class SQLAtomStorage::Response
 		{
 			exec(str.c_str());
 		}
+
+		// A prepared statement; see LLConnection::exec_prepared().
+		void exec(const char * name, const char * stmt,
+		          const LLParams& params)
+		{
+			if (rs) rs->release();
+			if (nullptr == _conn) _conn = _pool.pop();
+			rs = _conn->exec_prepared(name, stmt, params, false);
+		}
+
+		// Column values --------------------------------------------
+		// Results are either text, or, from prepared statements on
+		// drivers that can, binary: integers, and arrays in the format
+		// of ll-pg-binary.h, with a NULL as a null pointer. Text arrays
+		// are of the form {1.1,2.2,3.3}; an empty string is a NULL.
+		int int2_val(const char * colvalue)
+		{
+			if (not rs->is_binary()) return atoi(colvalue);
+			return colvalue ? pgbinary::get_int2(colvalue) : 0;
+		}
+
+		UUID int8_val(const char * colvalue)
+		{
+			if (not rs->is_binary()) return strtoul(colvalue, NULL, 10);
+			return colvalue ? pgbinary::get_int8(colvalue) : 0;
+		}
+
+		std::vector<UUID> int8_array(const char * colvalue)
+		{
+			if (rs->is_binary()) return pgbinary::get_int8_array(colvalue);
+
+			std::vector<UUID> vec;
+			char *p = (char *) colvalue;
+			while (p)
+			{
+				// Break if there are no more elements,
+				// or if the array is empty in the first place.
+				if (*p == '}' or *p == '\0') break;
+				vec.emplace_back(strtoul(p+1, &p, 10));
+			}
+			return vec;
+		}
+
+		std::vector<double> float8_array(const char * colvalue)
+		{
+			if (rs->is_binary()) return pgbinary::get_float8_array(colvalue);
+
+			std::vector<double> vec;
+			char *p = (char *) colvalue;
+			if (p and *p == '{') p++;
+			while (p)
+			{
+				if (*p == '}' or *p == '\0') break;
+				vec.emplace_back(strtod(p, &p));
+				p++; // skip over  comma
+			}
+			return vec;
+		}
+
+		// We expect the text to be of the form
+		// {aaa,"bb bb bb","ccc ccc ccc"}
+		// Split it along the commas.
+		std::vector<std::string> text_array(const char * colvalue)
+		{
+			if (rs->is_binary()) return pgbinary::get_text_array(colvalue);
+
+			std::vector<std::string> vec;
+			if (nullptr == colvalue) return vec;
+			char *s = strdup(colvalue);
+			char *p = s;
+			if (p and *p == '{') p++;
+			while (p)
+			{
+				if (*p == '}' or *p == '\0') break;
+				// String terminates at comma or close-brace.
+				char * c = strchr(p, ',');
+				if (c) *c = 0;
+				else c = strchr(p, '}');
+				if (c) *c = 0;
+
+				// Wipe out quote marks
+				if (*p == '"') p++;
+				if (c and *(c-1) == '"') *(c-1) = 0;
+
+				vec.emplace_back(p);
+				p = c;
+				p++;
+			}
+			free(s);
+			return vec;
+		}
 		void try_exec(const std::string& str)
 		{
 			try_exec(str.c_str());
@@ -134,7 +226,7 @@ class SQLAtomStorage::Response
 			// if (!strcmp(colname, "type"))
 			if ('t' == colname[0])
 			{
-				itype = atoi(colvalue);
+				itype = int2_val(colvalue);
 			}
 			// else if (!strcmp(colname, "name"))
 			else if ('n' == colname[0])
@@ -144,12 +236,12 @@ class SQLAtomStorage::Response
 			// else if (!strcmp(colname, "outgoing"))
 			else if ('o' == colname[0])
 			{
-				outlist = colvalue;
+				outlist = int8_array(colvalue);
 			}
 			// else if (!strcmp(colname, "uuid"))
 			else if ('u' == colname[0])
 			{
-				uuid = strtoul(colvalue, NULL, 10);
+				uuid = int8_val(colvalue);
 			}
 			return false;
 		}
@@ -240,7 +332,7 @@ class SQLAtomStorage::Response
 			// The column name will be either "uuid" or "key".
 			// Since there will be only one column,
 			// don't bother checking the column name...
-			uuid = strtoul(colvalue, NULL, 10);
+			uuid = int8_val(colvalue);
 			return false;
 		}
 
@@ -282,9 +374,9 @@ class SQLAtomStorage::Response
 		// identical, so we use common code for both.
 		VUID vuid;
 		Type vtype;
-		const char * fltval;
-		const char * strval;
-		const char * lnkval;
+		std::vector<double> fltval;
+		std::vector<std::string> strval;
+		std::vector<VUID> lnkval;
 		UUID key;
 		bool get_value_cb(void)
 		{
@@ -299,35 +391,44 @@ class SQLAtomStorage::Response
 			// if (!strcmp(colname, "floatvalue"))
 			if ('f' == colname[0])
 			{
-				fltval = colvalue;
+				fltval = float8_array(colvalue);
 			}
 			// else if (!strcmp(colname, "stringvalue"))
 			else if ('s' == colname[0])
 			{
-				strval = colvalue;
+				strval = text_array(colvalue);
 			}
 			// else if (!strcmp(colname, "linkvalue"))
 			else if ('l' == colname[0])
 			{
-				lnkval = colvalue;
+				lnkval = int8_array(colvalue);
 			}
 			// else if (!strcmp(colname, "type"))
 			else if ('t' == colname[0])
 			{
-				vtype = atoi(colvalue);
+				vtype = int2_val(colvalue);
 			}
 			// else if (!strcmp(colname, "key"))
 			else if ('k' == colname[0])
 			{
-				key = atol(colvalue);
+				key = int8_val(colvalue);
 			}
 			// else if (!strcmp(colname, "atom"))
 			else if ('a' == colname[0])
 			{
-				uuid = atol(colvalue);
+				uuid = int8_val(colvalue);
 			}
 			return false;
 		}
+		// The link values of several valuations, by (key, atom).
+		std::map<std::pair<UUID, UUID>, std::vector<VUID>> *lnkvals;
+		bool get_link_values_cb(void)
+		{
+			rs->foreach_column(&Response::get_value_column_cb, this);
+			(*lnkvals)[std::make_pair(key, uuid)] = lnkval;
+			return false;
+		}
+
 		Handle atom;
 		bool get_all_values_cb(void)
 		{
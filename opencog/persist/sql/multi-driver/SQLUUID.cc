@@ -236,4 +236,24 @@ void SQLAtomStorage::UUID_manager::refill_uuid_pool(void)
 	_uuid_pool_top = rp.intval + _uuid_pool_increment - 1;
 }
 
+/// Obtain enough blocks of unused UUID's from the SQL Sequence to
+/// issue n of them, all with one query. Returned is the first UUID
+/// of each block; each block holds _uuid_pool_increment of them.
+/// These are not issued by get_uuid(); the caller hands them out.
+std::vector<UUID> SQLAtomStorage::UUID_manager::get_blocks(size_t n)
+{
+	std::vector<UUID> blocks;
+	if (0 == n) return blocks;
+
+	size_t nblocks = (n + _uuid_pool_increment - 1) / _uuid_pool_increment;
+	std::string qry = "SELECT nextval('" + poolname + "') "
+		"FROM generate_series(1, " + std::to_string(nblocks) + ");";
+
+	Response rp(that->conn_pool);
+	rp.uvec = &blocks;
+	rp.exec(qry.c_str());
+	rp.rs->foreach_row(&Response::get_uuid_cb, &rp);
+	return blocks;
+}
+
 /* ============================= END OF FILE ================= */
@@ -52,71 +52,45 @@ std::string SQLAtomStorage::oset_to_string(const HandleSeq& out)
 	return str;
 }
 
-std::string SQLAtomStorage::float_to_string(const FloatValuePtr& fvle)
+/// Add the type and the three value columns of the Valuations and
+/// Values tables to the parameters. Only one of the three columns is
+/// ever used; the other two are NULL. The members of a LinkValue are
+/// stored first, so that their VUID's can be put into the link column.
+void SQLAtomStorage::value_params(LLParams& params, const ValuePtr& pap)
 {
-	bool not_first = false;
-	std::string str = "\'{";
-	for (double v : fvle->value())
-	{
-		if (not_first) str += ", ";
-		not_first = true;
+	Type vtype = pap->get_type();
+	params.add_int2(storing_typemap[vtype]);
 
-		char buf[40];
-		snprintf(buf, 40, "%20.17g", v);
-		str += buf;
+	if (nameserver().isA(vtype, FLOAT_VALUE))
+	{
+		params.add_float8_array(FloatValueCast(pap)->value());
+		params.add_null(LLParams::TEXT_ARRAY);
+		params.add_null(LLParams::INT8_ARRAY);
 	}
-	str += "}\'";
-	return str;
-}
-
-std::string SQLAtomStorage::string_to_string(const StringValuePtr& svle)
-{
-	bool not_first = false;
-	std::string str = "\'{";
-	for (const std::string& v : svle->value())
+	else
+	if (nameserver().isA(vtype, STRING_VALUE))
 	{
-		if (not_first) str += ", ";
-		not_first = true;
-		str += v;
+		params.add_null(LLParams::FLOAT8_ARRAY);
+		params.add_text_array(StringValueCast(pap)->value());
+		params.add_null(LLParams::INT8_ARRAY);
 	}
-	str += "}\'";
-	return str;
-}
+	else
+	if (nameserver().isA(vtype, LINK_VALUE))
+	{
+		std::vector<uint64_t> vuids;
+		for (const ValuePtr& v : LinkValueCast(pap)->value())
+			vuids.push_back(storeValue(v));
 
-std::string SQLAtomStorage::link_to_string(const LinkValuePtr& lvle)
-{
-	bool not_first = false;
-	std::string str = "\'{";
-	for (const ValuePtr& pap : lvle->value())
+		params.add_null(LLParams::FLOAT8_ARRAY);
+		params.add_null(LLParams::TEXT_ARRAY);
+		params.add_int8_array(vuids);
+	}
+	else
 	{
-		if (not_first) str += ", ";
-		not_first = true;
-		VUID vuid = storeValue(pap);
-		str += std::to_string(vuid);
+		params.add_null(LLParams::FLOAT8_ARRAY);
+		params.add_null(LLParams::TEXT_ARRAY);
+		params.add_null(LLParams::INT8_ARRAY);
 	}
-	str += "}\'";
-	return str;
-}
-
-/* ================================================================ */
-#define BUFSZ 250
-
-#define STMT(colname,val) { \
-	if (notfirst) { cols += ", "; vals += ", "; } else notfirst = true; \
-	cols += colname; \
-	vals += val; \
-}
-
-#define STMTI(colname,ival) { \
-	char buff[BUFSZ]; \
-	snprintf(buff, BUFSZ, "%d", ival); \
-	STMT(colname, buff); \
-}
-
-#define STMTF(colname,fval) { \
-	char buff[BUFSZ]; \
-	snprintf(buff, BUFSZ, "%22.16g", fval); \
-	STMT(colname, buff); \
 }
 
 /* ================================================================ */
@@ -132,36 +106,26 @@ void SQLAtomStorage::deleteValuation(const Handle& key, const Handle& atom)
 
 void SQLAtomStorage::deleteValuation(Response& rp, UUID key_uid, UUID atom_uid)
 {
-	char buff[BUFSZ];
-	snprintf(buff, BUFSZ,
-		"SELECT * FROM Valuations WHERE key = %lu AND atom = %lu;",
-		key_uid, atom_uid);
+	LLParams params;
+	params.add_int8(key_uid).add_int8(atom_uid);
 
 	rp.vtype = 0;
-	rp.exec(buff);
+	rp.lnkval.clear();
+	rp.exec("get_valuation",
+		"SELECT * FROM Valuations WHERE key = $1 AND atom = $2;", params);
 	rp.rs->foreach_row(&Response::get_value_cb, &rp);
 
 	if (LINK_VALUE == rp.vtype)
 	{
-		const char *p = rp.lnkval;
-		if (p and *p == '{') p++;
-		while (p)
-		{
-			if (*p == '}' or *p == '\0') break;
-			VUID vu = atol(p);
+		std::vector<VUID> vuids(rp.lnkval);
+		for (VUID vu : vuids)
 			deleteValue(vu);
-			p = strchr(p, ',');
-			if (p) p++;
-		}
 	}
 
 	if (0 != rp.vtype)
 	{
-		snprintf(buff, BUFSZ,
-			"DELETE FROM Valuations WHERE key = %lu AND atom = %lu;",
-			key_uid, atom_uid);
-
-		rp.exec(buff);
+		rp.exec("delete_valuation",
+			"DELETE FROM Valuations WHERE key = $1 AND atom = $2;", params);
 	}
 }
 
@@ -178,11 +142,6 @@ void SQLAtomStorage::storeValuation(const Handle& key,
                                     const Handle& atom,
                                     const ValuePtr& pap)
 {
-	bool notfirst = false;
-	std::string cols;
-	std::string vals;
-	std::string coda;
-
 	// Get UUID from the TLB.
 	UUID kuid;
 	{
@@ -200,47 +159,14 @@ void SQLAtomStorage::storeValuation(const Handle& key,
 		}
 	}
 
-	char kidbuff[BUFSZ];
-	snprintf(kidbuff, BUFSZ, "%lu", kuid);
-
-	char aidbuff[BUFSZ];
 	UUID auid = get_uuid(atom);
-	snprintf(aidbuff, BUFSZ, "%lu", auid);
 
 	// The prior valuation, if any, will be deleted first,
 	// and so an INSERT is sufficient to cover everything.
 	// During races, the second user looses.
-	cols = "INSERT INTO Valuations (";
-	vals = ") VALUES (";
-	coda = ") ON CONFLICT DO NOTHING;";
-	STMT("key", kidbuff);
-	STMT("atom", aidbuff);
-
-	Type vtype = pap->get_type();
-	STMTI("type", storing_typemap[vtype]);
-
-	if (nameserver().isA(vtype, FLOAT_VALUE))
-	{
-		FloatValuePtr fvp = FloatValueCast(pap);
-		std::string fstr = float_to_string(fvp);
-		STMT("floatvalue", fstr);
-	}
-	else
-	if (nameserver().isA(vtype, STRING_VALUE))
-	{
-		StringValuePtr fvp = StringValueCast(pap);
-		std::string sstr = string_to_string(fvp);
-		STMT("stringvalue", sstr);
-	}
-	else
-	if (nameserver().isA(vtype, LINK_VALUE))
-	{
-		LinkValuePtr fvp = LinkValueCast(pap);
-		std::string lstr = link_to_string(fvp);
-		STMT("linkvalue", lstr);
-	}
-
-	std::string insert = cols + vals + coda;
+	LLParams params;
+	params.add_int8(kuid).add_int8(auid);
+	value_params(params, pap);
 
 	std::lock_guard<std::mutex> lck(_value_mutex[auid%NUMVMUT]);
 	// Use a transaction, so that other threads/users see the
@@ -254,7 +180,10 @@ void SQLAtomStorage::storeValuation(const Handle& key,
 	// If there's an existing valuation, delete it.
 	deleteValuation(rp, kuid, auid);
 
-	rp.exec(insert.c_str());
+	rp.exec("store_valuation",
+		"INSERT INTO Valuations (key, atom, type, "
+		"floatvalue, stringvalue, linkvalue) "
+		"VALUES ($1, $2, $3, $4, $5, $6) ON CONFLICT DO NOTHING;", params);
 	rp.exec("COMMIT;");
 
 	_valuation_stores++;
@@ -265,43 +194,15 @@ SQLAtomStorage::VUID SQLAtomStorage::storeValue(const ValuePtr& pap)
 {
 	VUID vuid = _vuid_manager.get_uuid();
 
-	bool notfirst = false;
-	std::string cols;
-	std::string vals;
-	std::string coda;
-
-	cols = "INSERT INTO Values (";
-	vals = ") VALUES (";
-	coda = ") ON CONFLICT DO NOTHING;";
-	STMT("vuid", std::to_string(vuid));
-
-	Type vtype = pap->get_type();
-	STMTI("type", storing_typemap[vtype]);
+	LLParams params;
+	params.add_int8(vuid);
+	value_params(params, pap);
 
-	if (nameserver().isA(vtype, FLOAT_VALUE))
-	{
-		FloatValuePtr fvp = FloatValueCast(pap);
-		std::string fstr = float_to_string(fvp);
-		STMT("floatvalue", fstr);
-	}
-	else
-	if (nameserver().isA(vtype, STRING_VALUE))
-	{
-		StringValuePtr fvp = StringValueCast(pap);
-		std::string sstr = string_to_string(fvp);
-		STMT("stringvalue", sstr);
-	}
-	else
-	if (nameserver().isA(vtype, LINK_VALUE))
-	{
-		LinkValuePtr fvp = LinkValueCast(pap);
-		std::string lstr = link_to_string(fvp);
-		STMT("linkvalue", lstr);
-	}
-
-	std::string qry = cols + vals + coda;
 	Response rp(conn_pool);
-	rp.exec(qry.c_str());
+	rp.exec("store_value",
+		"INSERT INTO Values (vuid, type, "
+		"floatvalue, stringvalue, linkvalue) "
+		"VALUES ($1, $2, $3, $4, $5) ON CONFLICT DO NOTHING;", params);
 
 	_value_stores++;
 	return vuid;
@@ -312,9 +213,9 @@ SQLAtomStorage::VUID SQLAtomStorage::storeValue(const ValuePtr& pap)
 /// fetch is performed.
 ValuePtr SQLAtomStorage::getValue(VUID vuid)
 {
-	char buff[BUFSZ];
-	snprintf(buff, BUFSZ, "SELECT * FROM Values WHERE vuid = %lu;", vuid);
-	return doGetValue(buff);
+	return doGetValue("get_value",
+		"SELECT * FROM Values WHERE vuid = $1;",
+		LLParams().add_int8(vuid));
 }
 
 /// Return a value, given by the key-atom pair.
@@ -323,22 +224,19 @@ ValuePtr SQLAtomStorage::getValue(VUID vuid)
 ValuePtr SQLAtomStorage::getValuation(const Handle& key,
                                       const Handle& atom)
 {
-	char buff[BUFSZ];
-	snprintf(buff, BUFSZ,
-		"SELECT * FROM Valuations WHERE key = %lu AND atom = %lu;",
-		get_uuid(key),
-		get_uuid(atom));
-
-	return doGetValue(buff);
+	return doGetValue("get_valuation",
+		"SELECT * FROM Valuations WHERE key = $1 AND atom = $2;",
+		LLParams().add_int8(get_uuid(key)).add_int8(get_uuid(atom)));
 }
 
-/// Return a value, given by indicated query buffer.
+/// Return a value, given by the indicated prepared statement.
 /// If the value type is a link, then the full recursive
 /// fetch is performed.
-ValuePtr SQLAtomStorage::doGetValue(const char * buff)
+ValuePtr SQLAtomStorage::doGetValue(const char * name, const char * stmt,
+                                    const LLParams& params)
 {
 	Response rp(conn_pool);
-	rp.exec(buff);
+	rp.exec(name, stmt, params);
 	rp.rs->foreach_row(&Response::get_value_cb, &rp);
    return doUnpackValue(rp);
 }
@@ -351,73 +249,21 @@ ValuePtr SQLAtomStorage::doUnpackValue(Response& rp)
 	// Convert from databasse type to C++ runtime type
 	Type vtype = loading_typemap[rp.vtype];
 
-	// We expect rp.strval to be of the form
-	// {aaa,"bb bb bb","ccc ccc ccc"}
-	// Split it along the commas.
 	if (vtype == STRING_VALUE)
-	{
-		std::vector<std::string> strarr;
-		char *s = strdup(rp.strval);
-		char *p = s;
-		if (p and *p == '{') p++;
-		while (p)
-		{
-			if (*p == '}' or *p == '\0') break;
-			// String terminates at comma or close-brace.
-			char * c = strchr(p, ',');
-			if (c) *c = 0;
-			else c = strchr(p, '}');
-			if (c) *c = 0;
-
-			// Wipe out quote marks
-			if (*p == '"') p++;
-			if (c and *(c-1) == '"') *(c-1) = 0;
-
-			strarr.emplace_back(p);
-			p = c;
-			p++;
-		}
-		free(s);
-		return createStringValue(strarr);
-	}
+		return createStringValue(rp.strval);
 
-	// We expect rp.fltval to be of the form
-	// {1.1,2.2,3.3}
-	if ((vtype == FLOAT_VALUE)
-	    or nameserver().isA(vtype, TRUTH_VALUE))
-	{
-		std::vector<double> fltarr;
-		char *p = (char *) rp.fltval;
-		if (p and *p == '{') p++;
-		while (p)
-		{
-			if (*p == '}' or *p == '\0') break;
-			double flt = strtod(p, &p);
-			fltarr.emplace_back(flt);
-			p++; // skip over  comma
-		}
-		if (vtype == FLOAT_VALUE)
-			return createFloatValue(fltarr);
-		else
-			return ValueCast(TruthValue::factory(vtype, fltarr));
-	}
+	if (vtype == FLOAT_VALUE)
+		return createFloatValue(rp.fltval);
+
+	if (nameserver().isA(vtype, TRUTH_VALUE))
+		return ValueCast(TruthValue::factory(vtype, rp.fltval));
 
-	// We expect rp.lnkval to be a comma-separated list of
-	// vuid's, which we then fetch recursively.
+	// The link values are fetched recursively.
 	if (vtype == LINK_VALUE)
 	{
 		std::vector<ValuePtr> lnkarr;
-		const char *p = rp.lnkval;
-		if (p and *p == '{') p++;
-		while (p)
-		{
-			if (*p == '}' or *p == '\0') break;
-			VUID vu = atol(p);
-			ValuePtr pap = getValue(vu);
-			lnkarr.emplace_back(pap);
-			p = strchr(p, ',');
-			if (p) p++;
-		}
+		for (VUID vu : rp.lnkval)
+			lnkarr.emplace_back(getValue(vu));
 		return createLinkValue(lnkarr);
 	}
 
@@ -427,32 +273,21 @@ ValuePtr SQLAtomStorage::doUnpackValue(Response& rp)
 
 void SQLAtomStorage::deleteValue(VUID vuid)
 {
-	char buff[BUFSZ];
-	snprintf(buff, BUFSZ, "SELECT * FROM Values WHERE vuid = %lu;", vuid);
+	LLParams params;
+	params.add_int8(vuid);
 
 	Response rp(conn_pool);
-	rp.exec(buff);
+	rp.exec("get_value", "SELECT * FROM Values WHERE vuid = $1;", params);
 	rp.rs->foreach_row(&Response::get_value_cb, &rp);
 
 	// Perform a recursive delete, if necessary.
-	// We expect rp.strval to be of the form
-	// {81,82,83} -- Split it along the commas.
 	if (rp.vtype == LINK_VALUE)
 	{
-		const char *p = rp.lnkval;
-		if (p and *p == '{') p++;
-		while (p)
-		{
-			if (*p == '}' or *p == '\0') break;
-			VUID vu = atol(p);
+		for (VUID vu : rp.lnkval)
 			deleteValue(vu);
-			p = strchr(p, ',');
-			if (p) p++;
-		}
 	}
 
-	snprintf(buff, BUFSZ, "DELETE FROM Values WHERE vuid = %lu;", vuid);
-	rp.exec(buff);
+	rp.exec("delete_value", "DELETE FROM Values WHERE vuid = $1;", params);
 }
 
 /// Store ALL of the values associated with the atom.
@@ -476,13 +311,10 @@ void SQLAtomStorage::get_atom_values(Handle& atom)
 {
 	if (nullptr == atom) return;
 
-	char buff[BUFSZ];
-	snprintf(buff, BUFSZ,
-		"SELECT * FROM Valuations WHERE atom = %lu;",
-		get_uuid(atom));
-
 	Response rp(conn_pool);
-	rp.exec(buff);
+	rp.exec("get_atom_values",
+		"SELECT * FROM Valuations WHERE atom = $1;",
+		LLParams().add_int8(get_uuid(atom)));
 
 	rp.store = this;
 	rp.atom = atom;
@@ -503,16 +335,14 @@ void SQLAtomStorage::getValuations(AtomTable& table,
 	UUID kuid = check_uuid(key);
 	if (TLB::INVALID_UUID == kuid) return;
 
-	char buff[BUFSZ];
-	snprintf(buff, BUFSZ,
-		"SELECT * FROM Valuations WHERE key=%lu;", kuid);
-
 	Response rp(conn_pool);
 	rp.store = this;
 	rp.table = &table;
 	rp.katom = key;
 	rp.get_all_values = get_all_values;
-	rp.exec(buff);
+	rp.exec("get_valuations",
+		"SELECT * FROM Valuations WHERE key = $1;",
+		LLParams().add_int8(kuid));
 	rp.rs->foreach_row(&Response::get_valuations_cb, &rp);
 	rp.katom = nullptr;
 }
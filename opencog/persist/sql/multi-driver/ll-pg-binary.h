@@ -0,0 +1,173 @@
+/*
+ * FUNCTION:
+ * Postgres binary formats --
+ *
+ * The binary forms of the column types used in the tables, as sent
+ * and received by COPY and by prepared statements. All integers are
+ * in network byte order. An array is a header (the number of
+ * dimensions, a flags word, and the element type) followed, if it is
+ * not empty, by the size and lower bound of its one dimension, and
+ * then by the elements, each one a byte length and the bytes.
+ *
+ * HISTORY:
+ * Copyright (c) 2019 OpenCog Foundation
+ *
+ * LICENSE:
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_PERSISTENT_PG_BINARY_H
+#define _OPENCOG_PERSISTENT_PG_BINARY_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+/** \addtogroup grp_persist
+ *  @{
+ */
+
+namespace pgbinary
+{
+
+// Type OID's, from the postgres pg_type table.
+#define PG_INT2_OID 21
+#define PG_INT8_OID 20
+#define PG_TEXT_OID 25
+#define PG_FLOAT8_OID 701
+#define PG_TEXT_ARRAY_OID 1009
+#define PG_INT8_ARRAY_OID 1016
+#define PG_FLOAT8_ARRAY_OID 1022
+
+// Writing -------------------------------------------------------
+
+inline void put(std::string& buf, uint64_t v, int nbytes)
+{
+	for (int i = nbytes-1; 0 <= i; i--)
+		buf += (char) ((v >> (8*i)) & 0xff);
+}
+inline void put_int2(std::string& buf, int16_t v) { put(buf, (uint16_t) v, 2); }
+inline void put_int4(std::string& buf, int32_t v) { put(buf, (uint32_t) v, 4); }
+inline void put_int8(std::string& buf, int64_t v) { put(buf, (uint64_t) v, 8); }
+
+inline void put_float8(std::string& buf, double d)
+{
+	uint64_t v;
+	memcpy(&v, &d, sizeof(v));
+	put(buf, v, 8);
+}
+
+inline void put_array_head(std::string& buf, size_t nelts, int32_t oid)
+{
+	put_int4(buf, nelts ? 1 : 0);
+	put_int4(buf, 0);
+	put_int4(buf, oid);
+	if (0 == nelts) return;
+	put_int4(buf, nelts);
+	put_int4(buf, 1);
+}
+
+inline void put_int8_array(std::string& buf, const std::vector<uint64_t>& vec)
+{
+	put_array_head(buf, vec.size(), PG_INT8_OID);
+	for (uint64_t v : vec) { put_int4(buf, 8); put_int8(buf, v); }
+}
+
+inline void put_float8_array(std::string& buf, const std::vector<double>& vec)
+{
+	put_array_head(buf, vec.size(), PG_FLOAT8_OID);
+	for (double d : vec) { put_int4(buf, 8); put_float8(buf, d); }
+}
+
+inline void put_text_array(std::string& buf, const std::vector<std::string>& vec)
+{
+	put_array_head(buf, vec.size(), PG_TEXT_OID);
+	for (const std::string& str : vec)
+	{
+		put_int4(buf, str.size());
+		buf += str;
+	}
+}
+
+// Reading -------------------------------------------------------
+
+inline uint64_t get(const char* p, int nbytes)
+{
+	uint64_t v = 0;
+	for (int i = 0; i < nbytes; i++)
+		v = (v << 8) | (uint8_t) p[i];
+	return v;
+}
+inline int16_t get_int2(const char* p) { return (int16_t) get(p, 2); }
+inline int32_t get_int4(const char* p) { return (int32_t) get(p, 4); }
+inline int64_t get_int8(const char* p) { return (int64_t) get(p, 8); }
+
+inline double get_float8(const char* p)
+{
+	uint64_t v = get(p, 8);
+	double d;
+	memcpy(&d, &v, sizeof(d));
+	return d;
+}
+
+/// Call f(element, length) for each element of a one-dimensional
+/// array; NULL elements are skipped.
+template<typename F> void foreach_element(const char* p, F f)
+{
+	if (nullptr == p or 0 == get_int4(p)) return;
+	int32_t nelts = get_int4(p+12);
+	p += 20;
+	for (int32_t i = 0; i < nelts; i++)
+	{
+		int32_t len = get_int4(p);
+		p += 4;
+		if (len < 0) continue;
+		f(p, len);
+		p += len;
+	}
+}
+
+inline std::vector<uint64_t> get_int8_array(const char* p)
+{
+	std::vector<uint64_t> vec;
+	foreach_element(p, [&](const char* e, int32_t) {
+		vec.push_back(get_int8(e)); });
+	return vec;
+}
+
+inline std::vector<double> get_float8_array(const char* p)
+{
+	std::vector<double> vec;
+	foreach_element(p, [&](const char* e, int32_t) {
+		vec.push_back(get_float8(e)); });
+	return vec;
+}
+
+inline std::vector<std::string> get_text_array(const char* p)
+{
+	std::vector<std::string> vec;
+	foreach_element(p, [&](const char* e, int32_t len) {
+		vec.emplace_back(e, len); });
+	return vec;
+}
+
+} // namespace pgbinary
+
+/** @}*/
+
+#endif // _OPENCOG_PERSISTENT_PG_BINARY_H
@@ -37,6 +37,7 @@
 #include <opencog/util/Logger.h>
 #include <opencog/util/platform.h>
 
+#include "ll-pg-binary.h"
 #include "ll-pg-cxx.h"
 
 /* =========================================================== */
@@ -98,7 +99,14 @@ LLPGConnection::exec(const char * buff, bool trial_run)
 	LLPGRecordSet* rs = get_record_set();
 
 	rs->_result = PQexec(_pgconn, buff);
+	rs->binary = false;
+	return check_result(rs, buff, trial_run);
+}
 
+LLRecordSet *
+LLPGConnection::check_result(LLPGRecordSet* rs, const char * buff,
+                             bool trial_run)
+{
 	ExecStatusType rest = PQresultStatus(rs->_result);
 	if (rest != PGRES_COMMAND_OK and
 	    rest != PGRES_EMPTY_QUERY and
@@ -139,6 +147,151 @@ LLPGConnection::exec(const char * buff, bool trial_run)
 
 /* =========================================================== */
 
+static Oid param_type(LLParams::Kind kind)
+{
+	switch (kind)
+	{
+		case LLParams::INT2: return PG_INT2_OID;
+		case LLParams::INT8: return PG_INT8_OID;
+		case LLParams::TEXT: return PG_TEXT_OID;
+		case LLParams::INT8_ARRAY: return PG_INT8_ARRAY_OID;
+		case LLParams::FLOAT8_ARRAY: return PG_FLOAT8_ARRAY_OID;
+		case LLParams::TEXT_ARRAY: return PG_TEXT_ARRAY_OID;
+	}
+	return 0;
+}
+
+/// Run the statement, preparing it first, if this is the first time
+/// it is used on this connection. The parameters are sent, and the
+/// results received, in binary; this avoids both the planning of the
+/// statement each time, and the printing and parsing of the numbers.
+LLRecordSet *
+LLPGConnection::exec_prepared(const char * name, const char * stmt,
+                              const LLParams& params, bool trial_run)
+{
+	if (!is_connected) return NULL;
+	if (not binary_params)
+		return LLConnection::exec_prepared(name, stmt, params, trial_run);
+
+	int nparams = params.params.size();
+	if (0 == _prepared.count(name))
+	{
+		std::vector<Oid> types;
+		for (const LLParams::Param& p : params.params)
+			types.push_back(param_type(p.kind));
+
+		PGresult* res = PQprepare(_pgconn, name, stmt, nparams, types.data());
+		ExecStatusType rest = PQresultStatus(res);
+		std::string msg = PQresultErrorMessage(res);
+		PQclear(res);
+		if (rest != PGRES_COMMAND_OK)
+		{
+			msg += "\nPQ statement was: ";
+			msg += stmt;
+			opencog::logger().warn("%s", msg.c_str());
+			throw opencog::RuntimeException(TRACE_INFO,
+				"Failed to prepare SQL statement!\n%s", msg.c_str());
+		}
+		_prepared.insert(name);
+	}
+
+	std::vector<std::string> bufs(nparams);
+	std::vector<const char *> values(nparams);
+	std::vector<int> lengths(nparams);
+	std::vector<int> formats(nparams, 1);
+	for (int i=0; i<nparams; i++)
+	{
+		const LLParams::Param& p = params.params[i];
+		std::string& buf = bufs[i];
+		switch (p.kind)
+		{
+			case LLParams::INT2: pgbinary::put_int2(buf, p.ival); break;
+			case LLParams::INT8: pgbinary::put_int8(buf, p.ival); break;
+			case LLParams::TEXT: buf = p.sval; break;
+			case LLParams::INT8_ARRAY:
+				pgbinary::put_int8_array(buf, p.ivec); break;
+			case LLParams::FLOAT8_ARRAY:
+				pgbinary::put_float8_array(buf, p.fvec); break;
+			case LLParams::TEXT_ARRAY:
+				pgbinary::put_text_array(buf, p.svec); break;
+		}
+		values[i] = p.null ? nullptr : buf.data();
+		lengths[i] = buf.size();
+	}
+
+	LLPGRecordSet* rs = get_record_set();
+	rs->_result = PQexecPrepared(_pgconn, name, nparams,
+	                             values.data(), lengths.data(),
+	                             formats.data(), 1);
+	rs->binary = true;
+	return check_result(rs, stmt, trial_run);
+}
+
+/* =========================================================== */
+
+static void copy_fail(PGconn* pgconn, const char * what)
+{
+	std::string msg = what;
+	msg += PQerrorMessage(pgconn);
+	opencog::logger().warn("%s", msg.c_str());
+	throw opencog::RuntimeException(TRACE_INFO,
+		"Failed to copy to the database!\n%s", msg.c_str());
+}
+
+bool
+LLPGConnection::copy_begin(const char * buff)
+{
+	if (!is_connected) return false;
+
+	PGresult* res = PQexec(_pgconn, buff);
+	ExecStatusType rest = PQresultStatus(res);
+	PQclear(res);
+	if (rest != PGRES_COPY_IN)
+	{
+		std::string what = "PQ copy was: ";
+		what += buff;
+		what += "\n";
+		copy_fail(_pgconn, what.c_str());
+	}
+	return true;
+}
+
+void
+LLPGConnection::copy_put(const char * buff, size_t len)
+{
+	// The connection is blocking, so this only returns once the
+	// data is queued.
+	if (1 != PQputCopyData(_pgconn, buff, (int) len))
+		copy_fail(_pgconn, "PQputCopyData: ");
+}
+
+void
+LLPGConnection::copy_end(bool abort)
+{
+	if (1 != PQputCopyEnd(_pgconn, abort ? "aborted by client" : nullptr))
+		copy_fail(_pgconn, "PQputCopyEnd: ");
+
+	// Collect the result of the COPY; it reports any rows that
+	// were rejected.
+	std::string msg;
+	PGresult* res;
+	while ((res = PQgetResult(_pgconn)))
+	{
+		if (PQresultStatus(res) != PGRES_COMMAND_OK and msg.empty())
+			msg = PQresultErrorMessage(res);
+		PQclear(res);
+	}
+
+	if (not abort and not msg.empty())
+	{
+		opencog::logger().warn("%s", msg.c_str());
+		throw opencog::RuntimeException(TRACE_INFO,
+			"Failed to copy to the database!\n%s", msg.c_str());
+	}
+}
+
+/* =========================================================== */
+
 void
 LLPGRecordSet::setup_cols(int new_ncols)
 {
@@ -227,7 +380,10 @@ LLPGRecordSet::fetch_row(void)
 
 	for (int i=0; i< ncols; i++)
 	{
-		values[i] = PQgetvalue(_result, _curr_row, i);
+		if (binary and PQgetisnull(_result, _curr_row, i))
+			values[i] = nullptr;
+		else
+			values[i] = PQgetvalue(_result, _curr_row, i);
 	}
 	_curr_row++;
 	return true;
@@ -27,6 +27,9 @@
 
 #ifdef HAVE_PGSQL_STORAGE
 
+#include <set>
+#include <string>
+
 #include <libpq-fe.h>
 
 #include "llapi.h"
@@ -43,12 +46,22 @@ class LLPGConnection : public LLConnection
 	private:
 		PGconn* _pgconn;
 		LLPGRecordSet* get_record_set(void);
+		LLRecordSet* check_result(LLPGRecordSet*, const char *, bool);
+
+		// The statements prepared on this connection, by name.
+		std::set<std::string> _prepared;
 
 	public:
 		LLPGConnection(const char * uri);
 		~LLPGConnection();
 
 		LLRecordSet *exec(const char *, bool);
+		LLRecordSet *exec_prepared(const char *, const char *,
+		                           const LLParams&, bool);
+
+		bool copy_begin(const char *);
+		void copy_put(const char *, size_t);
+		void copy_end(bool abort=false);
 };
 
 class LLPGRecordSet : public LLRecordSet
@@ -37,7 +37,9 @@
 #include <stack>
 #include <string>
 
+#include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <opencog/util/exceptions.h>
 #include <opencog/util/Logger.h>
@@ -50,6 +52,7 @@
 LLConnection::LLConnection(void)
 {
     is_connected = false;
+    binary_params = false;
 }
 
 /* =========================================================== */
@@ -64,6 +67,82 @@ LLConnection::~LLConnection()
     }
 }
 
+/* =========================================================== */
+
+std::string
+LLParams::to_literal(size_t i) const
+{
+    const Param& p = params[i];
+    if (p.null) return "NULL";
+
+    std::string str;
+    switch (p.kind)
+    {
+        case INT2:
+        case INT8:
+            return std::to_string(p.ival);
+        case TEXT:
+            str = p.sval;
+            escape_single_quotes(str);
+            return "'" + str + "'";
+        case INT8_ARRAY:
+            for (uint64_t v : p.ivec)
+            {
+                if (not str.empty()) str += ", ";
+                str += std::to_string(v);
+            }
+            break;
+        case FLOAT8_ARRAY:
+            for (double v : p.fvec)
+            {
+                if (not str.empty()) str += ", ";
+                char buf[40];
+                snprintf(buf, 40, "%20.17g", v);
+                str += buf;
+            }
+            break;
+        case TEXT_ARRAY:
+            // Quote each element, so that commas and braces in it
+            // survive.
+            for (const std::string& v : p.svec)
+            {
+                if (not str.empty()) str += ", ";
+                str += '"';
+                for (char c : v)
+                {
+                    if ('"' == c or '\\' == c) str += '\\';
+                    str += c;
+                }
+                str += '"';
+            }
+            escape_single_quotes(str);
+            break;
+    }
+    return "'{" + str + "}'";
+}
+
+/* =========================================================== */
+
+LLRecordSet *
+LLConnection::exec_prepared(const char *name, const char *stmt,
+                            const LLParams& params, bool trial_run)
+{
+    std::string sql;
+    for (const char *p = stmt; *p; p++)
+    {
+        if ('$' == *p and isdigit(p[1]))
+        {
+            char *end;
+            size_t i = strtoul(p+1, &end, 10);
+            sql += params.to_literal(i-1);
+            p = end - 1;
+            continue;
+        }
+        sql += *p;
+    }
+    return exec(sql.c_str(), trial_run);
+}
+
 /* =========================================================== */
 /* pseudo-private routine */
 
@@ -76,6 +155,7 @@ LLRecordSet::LLRecordSet(LLConnection *_conn)
     column_datatype = nullptr;
     values = nullptr;
     vsizes = nullptr;
+    binary = false;
 }
 
 /* =========================================================== */
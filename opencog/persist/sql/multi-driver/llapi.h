@@ -28,8 +28,10 @@
 #ifndef _OPENCOG_PERSISTENT_LL_DRIVER_H
 #define _OPENCOG_PERSISTENT_LL_DRIVER_H
 
+#include <stdint.h>
 #include <stack>
 #include <string>
+#include <vector>
 
 /** \addtogroup grp_persist
  *  @{
@@ -37,11 +39,72 @@
 
 class LLRecordSet;
 
+/**
+ * The parameters of a prepared statement, in order: $1, $2, ...
+ * Each one is a NULL, an integer, a string, or an array of these
+ * or of doubles.
+ */
+class LLParams
+{
+    public:
+        enum Kind { INT2, INT8, TEXT,
+                    INT8_ARRAY, FLOAT8_ARRAY, TEXT_ARRAY };
+
+        struct Param
+        {
+            Kind kind;
+            bool null;
+            int64_t ival;
+            std::string sval;
+            std::vector<uint64_t> ivec;
+            std::vector<double> fvec;
+            std::vector<std::string> svec;
+        };
+        std::vector<Param> params;
+
+        LLParams& add_null(Kind k) { add(k).null = true; return *this; }
+        LLParams& add_int2(int v) { add(INT2).ival = v; return *this; }
+        LLParams& add_int8(int64_t v) { add(INT8).ival = v; return *this; }
+        LLParams& add_text(const std::string& v)
+        {
+            add(TEXT).sval = v;
+            return *this;
+        }
+        LLParams& add_int8_array(const std::vector<uint64_t>& v)
+        {
+            add(INT8_ARRAY).ivec = v;
+            return *this;
+        }
+        LLParams& add_float8_array(const std::vector<double>& v)
+        {
+            add(FLOAT8_ARRAY).fvec = v;
+            return *this;
+        }
+        LLParams& add_text_array(const std::vector<std::string>& v)
+        {
+            add(TEXT_ARRAY).svec = v;
+            return *this;
+        }
+
+        // The parameter as an SQL literal.
+        std::string to_literal(size_t i) const;
+
+    private:
+        Param& add(Kind k)
+        {
+            params.emplace_back();
+            params.back().kind = k;
+            params.back().null = false;
+            return params.back();
+        }
+};
+
 class LLConnection
 {
     friend class LLRecordSet;
     protected:
         bool is_connected;
+        bool binary_params;
         std::stack<LLRecordSet *> free_pool;
 
     public:
@@ -50,8 +113,29 @@ class LLConnection
 
         // No future version of this must ever throw!
         bool connected(void) const { return is_connected; }
+        void set_binary_params(bool b) { binary_params = b; }
 
         virtual LLRecordSet *exec(const char *, bool=false) = 0;
+
+        // Run a statement with parameters $1, $2, ... If binary_params
+        // is set, drivers that can, prepare the statement once, under
+        // the given name, and send the parameters and get the results
+        // in binary form; see LLRecordSet::is_binary(). Otherwise, and
+        // by default, the parameters are put into the text of the
+        // statement, and it is exec()'ed.
+        virtual LLRecordSet *exec_prepared(const char *name,
+                                           const char *stmt,
+                                           const LLParams&,
+                                           bool trial_run=false);
+
+        // Bulk copy, with COPY ... FROM STDIN. The statement is begun
+        // with copy_begin(), the data sent with copy_put(), and the
+        // copy completed (or, if abort is set, abandoned) with
+        // copy_end(). Drivers that cannot do this return false from
+        // copy_begin(); the caller must then INSERT instead.
+        virtual bool copy_begin(const char *) { return false; }
+        virtual void copy_put(const char *, size_t) {}
+        virtual void copy_end(bool abort=false) {}
 };
 
 class LLRecordSet
@@ -67,6 +151,9 @@ class LLRecordSet
         char **values;
         int  *vsizes;
 
+        // The values are in binary form, and a NULL is a null pointer.
+        bool binary;
+
         LLRecordSet(LLConnection *);
         virtual ~LLRecordSet();
 
@@ -80,6 +167,7 @@ class LLRecordSet
         const char * get_value(const char * fieldname);
         int get_column_count();
         const char * get_column_value(int column);
+        bool is_binary(void) const { return binary; }
 
         // call this, instead of the destructor,
         // when done with this instance.
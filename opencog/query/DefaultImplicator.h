@@ -24,6 +24,8 @@
 #ifndef _OPENCOG_DEFAULT_IMPLICATOR_H
 #define _OPENCOG_DEFAULT_IMPLICATOR_H
 
+#include <typeinfo>
+
 #include "DefaultPatternMatchCB.h"
 #include "Implicator.h"
 #include "InitiateSearchCB.h"
@@ -49,6 +51,14 @@ class DefaultImplicator:
 		InitiateSearchCB::set_pattern(vars, pat);
 		DefaultPatternMatchCB::set_pattern(vars, pat);
 	}
+
+	// Derived classes may override the matching callbacks.
+	virtual bool strict_match(void)
+	{ return typeid(*this) == typeid(DefaultImplicator); }
+
+	protected:
+	virtual bool parallel_ok(void) const
+	{ return typeid(*this) == typeid(DefaultImplicator); }
 };
 
 }; // namespace opencog
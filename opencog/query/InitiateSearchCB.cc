@@ -21,6 +21,13 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <typeinfo>
+
+#include <opencog/util/oc_omp.h>
 #include <opencog/atomspace/AtomSpace.h>
 
 #include <opencog/atoms/core/DefineLink.h>
@@ -29,6 +36,7 @@
 #include <opencog/atoms/pattern/PatternLink.h>
 #include <opencog/atoms/core/FindUtils.h>
 
+#include "DefaultPatternMatchCB.h"
 #include "InitiateSearchCB.h"
 #include "PatternMatchEngine.h"
 #include "Substitutor.h"
@@ -44,6 +52,8 @@ using namespace opencog;
 
 /* ======================================================== */
 
+std::atomic<unsigned> InitiateSearchCB::_default_search_threads(1);
+
 InitiateSearchCB::InitiateSearchCB(AtomSpace* as) :
 	_nameserver(nameserver())
 {
@@ -58,6 +68,9 @@ InitiateSearchCB::InitiateSearchCB(AtomSpace* as) :
 	_curr_clause = 0;
 	_choices.clear();
  	_search_fail = false;
+	_search_threads = _default_search_threads;
+	_budget = nullptr;
+	_profile = nullptr;
 	_as = as;
 }
 
@@ -69,6 +82,26 @@ void InitiateSearchCB::set_pattern(const Variables& vars,
 	_variables = &vars;
 	_pattern = &pat;
 	_dynamic = &pat.evaluatable_terms;
+	_plan = SearchPlan::get(pat);
+}
+
+/* ======================================================== */
+
+// True if the starting points saved in the plan were chosen by this
+// class of callback, for this atomspace, at about its present size.
+// Must be called with the plan locked.
+bool InitiateSearchCB::plan_fresh(void) const
+{
+	size_t size = _as ? _as->get_size() : 0;
+	return _plan->fresh(_as, size, typeid(*this));
+}
+
+// Forget the saved starting points, so that new ones are chosen.
+// Must be called with the plan locked.
+void InitiateSearchCB::plan_reset(void)
+{
+	size_t size = _as ? _as->get_size() : 0;
+	_plan->reset(_as, size, typeid(*this));
 }
 
 
@@ -170,8 +203,10 @@ InitiateSearchCB::find_starter_recursive(const Handle& h, size_t& depth,
 	Handle hdeepest(Handle::UNDEFINED);
 	size_t thinnest = SIZE_MAX;
 
-	for (Handle hunt : h->getOutgoingSet())
+	const HandleSeq& oset = h->getOutgoingSet();
+	for (size_t pos = 0; pos < oset.size(); pos++)
 	{
+		Handle hunt(oset[pos]);
 		size_t brdepth = depth + 1;
 		size_t brwid = SIZE_MAX;
 
@@ -187,6 +222,24 @@ InitiateSearchCB::find_starter_recursive(const Handle& h, size_t& depth,
 
 		Handle s(find_starter_recursive(hunt, brdepth, sbr, brwid));
 
+		// The width is the estimated number of links of this type
+		// that will be looked at, when starting from `s`: the number
+		// of them that hold `s` itself, if it is directly below; else
+		// the number of links below, times the fan-out of this type.
+		// If the atomspace has no fan-out for this type, the width
+		// from below is used as it is.
+		if (s and CHOICE_LINK != t and _as)
+		{
+			if (s == hunt)
+				brwid = s->getIncomingSetSizeHint(t);
+			else if (SIZE_MAX != brwid)
+			{
+				double fan = _as->get_fan_out(t, pos);
+				double est = 0.0 < fan ? brwid * fan : brwid;
+				brwid = est < SIZE_MAX ? (size_t) est : SIZE_MAX - 1;
+			}
+		}
+
 		if (s)
 		{
 			// Each ChoiceLink is potentially disconnected from the rest
@@ -319,39 +372,60 @@ bool InitiateSearchCB::neighbor_search(PatternMatchEngine *pme)
 	// Note also: the user is allowed to specify patterns that have
 	// no constants in them at all.  In this case, the search is
 	// performed by looping over all links of the given types.
-	size_t bestclause;
-	Handle best_start = find_thinnest(clauses, _pattern->evaluatable_holders,
-	                                  _starter_term, bestclause);
-
-	// Cannot find a starting point! This can happen if:
-	// 1) all of the clauses contain nothing but variables,
-	// 2) all of the clauses are evaluatable(!),
-	// Somewhat unusual, but it can happen.  For this, we need
-	// some other, alternative search strategy.
-	if (nullptr == best_start and 0 == _choices.size())
-	{
-		_search_fail = true;
-		return false;
-	}
-
-	// If only a single choice, fake it for the loop below.
-	if (0 == _choices.size())
+	//
+	// If this pattern was run before, on an atomspace of about the
+	// same size, then the choice made then is used again.
+	std::unique_lock<std::mutex> lck(_plan->mtx);
+	bool cached = _plan->have_neighbor and plan_fresh();
+	if (cached)
 	{
-		Choice ch;
-		ch.clause = bestclause;
-		ch.best_start = best_start;
-		ch.start_term = _starter_term;
-		_choices.push_back(ch);
+		_choices = _plan->choices;
+		_search_fail = _plan->neighbor_fail;
 	}
 	else
 	{
-		// TODO -- weed out duplicates!
+		lck.unlock();
+		size_t bestclause;
+		Handle best_start = find_thinnest(clauses,
+		                                  _pattern->evaluatable_holders,
+		                                  _starter_term, bestclause);
+
+		// Cannot find a starting point! This can happen if:
+		// 1) all of the clauses contain nothing but variables,
+		// 2) all of the clauses are evaluatable(!),
+		// Somewhat unusual, but it can happen.  For this, we need
+		// some other, alternative search strategy.
+		if (nullptr == best_start and 0 == _choices.size())
+			_search_fail = true;
+
+		// If only a single choice, fake it for the loop below.
+		else if (0 == _choices.size())
+		{
+			Choice ch;
+			ch.clause = bestclause;
+			ch.best_start = best_start;
+			ch.start_term = _starter_term;
+			_choices.push_back(ch);
+		}
+		else
+		{
+			// TODO -- weed out duplicates!
+		}
+
+		lck.lock();
+		if (not plan_fresh()) plan_reset();
+		_plan->have_neighbor = true;
+		_plan->neighbor_fail = _search_fail;
+		_plan->choices = _choices;
 	}
+	lck.unlock();
+
+	if (_search_fail) return false;
 
 	for (const Choice& ch : _choices)
 	{
-		bestclause = ch.clause;
-		best_start = ch.best_start;
+		size_t bestclause = ch.clause;
+		const Handle& best_start = ch.best_start;
 		_starter_term = ch.start_term;
 
 		_root = clauses[bestclause];
@@ -366,6 +440,15 @@ bool InitiateSearchCB::neighbor_search(PatternMatchEngine *pme)
 		// focus in the AttentionalFocusCB class...
 		IncomingSet iset = get_incoming_set(best_start);
 		size_t sz = iset.size();
+		if (_profile)
+			_profile->start("neighbor search", cached,
+			                _root, _starter_term, sz);
+		if (parallel_search(sz))
+		{
+			HandleSeq cands(iset.begin(), iset.end());
+			if (parallel_explore(pme, cands)) return true;
+			continue;
+		}
 		for (size_t i = 0; i < sz; i++)
 		{
 			Handle h(iset[i]);
@@ -385,6 +468,29 @@ bool InitiateSearchCB::neighbor_search(PatternMatchEngine *pme)
 }
 
 /* ======================================================== */
+
+namespace {
+
+// Adds the time from its creation to its destruction to the search
+// time of the profile, if there is one.
+class SearchTimer
+{
+	QueryProfile* _prof;
+	QueryProfile::Clock::time_point _start;
+
+public:
+	SearchTimer(QueryProfile* prof) : _prof(prof)
+	{
+		if (_prof) _start = QueryProfile::Clock::now();
+	}
+	~SearchTimer()
+	{
+		if (_prof) _prof->search_time += QueryProfile::Clock::now() - _start;
+	}
+};
+
+} // anonymous namespace
+
 /**
  * Search for solutions/groundings over all of the AtomSpace, using
  * the standard, canonical assumptions about the structure of the search
@@ -475,6 +581,7 @@ bool InitiateSearchCB::neighbor_search(PatternMatchEngine *pme)
  */
 bool InitiateSearchCB::initiate_search(PatternMatchEngine *pme)
 {
+	SearchTimer timer(_profile);
 	jit_analyze(pme);
 
 	DO_LOG({logger().fine("Attempt to use node-neighbor search");})
@@ -565,20 +672,38 @@ bool InitiateSearchCB::link_type_search(PatternMatchEngine *pme)
 
 	_root = Handle::UNDEFINED;
 	_starter_term = Handle::UNDEFINED;
-	size_t count = SIZE_MAX;
 
-	for (const Handle& cl: clauses)
+	std::unique_lock<std::mutex> lck(_plan->mtx);
+	bool cached = _plan->have_link_type and plan_fresh();
+	if (cached)
 	{
-		// Evaluatables don't exist in the atomspace, in general.
-		// Cannot start a search with them.
-		if (0 < _pattern->evaluatable_holders.count(cl)) continue;
-		const size_t prev = count;
-		find_rarest(cl, _starter_term, count);
-		if (count < prev)
+		_root = _plan->root;
+		_starter_term = _plan->starter_term;
+	}
+	else
+	{
+		lck.unlock();
+		size_t count = SIZE_MAX;
+		for (const Handle& cl: clauses)
 		{
-			_root = cl;
+			// Evaluatables don't exist in the atomspace, in general.
+			// Cannot start a search with them.
+			if (0 < _pattern->evaluatable_holders.count(cl)) continue;
+			const size_t prev = count;
+			find_rarest(cl, _starter_term, count);
+			if (count < prev)
+			{
+				_root = cl;
+			}
 		}
+
+		lck.lock();
+		if (not plan_fresh()) plan_reset();
+		_plan->have_link_type = true;
+		_plan->root = _root;
+		_plan->starter_term = _starter_term;
 	}
+	lck.unlock();
 
 	// The URE Reasoning case: if we found nothing, then there are no
 	// links!  Ergo, every clause must be a lone variable, all by
@@ -603,6 +728,13 @@ bool InitiateSearchCB::link_type_search(PatternMatchEngine *pme)
 	HandleSeq handle_set;
 	_as->get_handles_by_type(handle_set, ptype);
 
+	if (_profile)
+		_profile->start("link-type search", cached,
+		                _root, _starter_term, handle_set.size());
+
+	if (parallel_search(handle_set.size()))
+		return parallel_explore(pme, handle_set);
+
 #ifdef DEBUG
 	size_t i = 0, hsz = handle_set.size();
 #endif
@@ -617,6 +749,147 @@ bool InitiateSearchCB::link_type_search(PatternMatchEngine *pme)
 	return false;
 }
 
+/* ======================================================== */
+
+// Fewer candidates than this are not worth handing out to workers.
+static const size_t MIN_PARALLEL_CANDIDATES = 16;
+
+namespace {
+
+// Matching callbacks for one worker thread of parallel_explore().
+// The per-search state of DefaultPatternMatchCB (bound variables,
+// the temporary atomspace) is private to each worker. Groundings
+// are passed on, one at a time, to the callback of the engine that
+// started the search; once it asks to stop, all workers stop. Each
+// worker records into its own profile, if profiling.
+class ParallelSearchCB : public DefaultPatternMatchCB
+{
+	PatternMatchCallback& _master;
+	std::mutex& _mtx;
+	std::atomic<bool>& _halt;
+	QueryProfile* _profile;
+
+public:
+	ParallelSearchCB(AtomSpace* as, PatternMatchCallback& master,
+	                 std::mutex& mtx, std::atomic<bool>& halt,
+	                 QueryProfile* profile) :
+		DefaultPatternMatchCB(as),
+		_master(master), _mtx(mtx), _halt(halt), _profile(profile) {}
+
+	bool initiate_search(PatternMatchEngine*) { return false; }
+
+	bool grounding(const HandleMap& var_soln, const HandleMap& term_soln)
+	{
+		if (_halt) return true;
+		std::lock_guard<std::mutex> lck(_mtx);
+		if (_halt) return true;
+		if (_master.grounding(var_soln, term_soln)) _halt = true;
+		return _halt;
+	}
+
+	QueryBudget* get_budget(void) { return _master.get_budget(); }
+	QueryProfile* get_profile(void) { return _profile; }
+
+	// Only used for callbacks that are parallel_ok(), and so exact.
+	bool strict_match(void) { return true; }
+};
+
+} // anonymous namespace
+
+/**
+ * Return true if the given number of candidate starting points
+ * should be explored in parallel. Optional (absent) clauses are not
+ * supported, as whether they were seen is tracked across the whole
+ * search; nor are black-box clauses, as these may call into code
+ * that is not thread-safe.
+ */
+bool InitiateSearchCB::parallel_search(size_t ncands) const
+{
+	if (_search_threads <= 1 or ncands < MIN_PARALLEL_CANDIDATES)
+		return false;
+	if (not parallel_ok()) return false;
+	if (not _pattern->optionals.empty()) return false;
+	if (not _pattern->black.empty()) return false;
+	return true;
+}
+
+/**
+ * Explore the neighborhoods of the candidates in parallel. Each
+ * thread takes the next unexplored candidate, until there are none
+ * left, or until the grounding callback has asked to stop; so the
+ * max_results of the callback are honored, although a few extra
+ * groundings may be explored (but not reported) before the workers
+ * notice. Returns true if the search was halted by the callback,
+ * just as the serial loop does. The first exception thrown by a
+ * worker is re-thrown here, after all of them have stopped.
+ */
+bool InitiateSearchCB::parallel_explore(PatternMatchEngine *pme,
+                                        const HandleSeq& cands)
+{
+	PatternMatchCallback& master = pme->get_callback();
+	QueryProfile* profile = master.get_profile();
+	std::mutex mtx;
+	std::atomic<bool> halt(false);
+	std::atomic<size_t> next(0);
+	std::exception_ptr error;
+
+	// The callbacks, and so their temporary atomspaces, are created
+	// here, before the workers start: neither the transient cache
+	// nor the AtomSpace constructor may be used from several threads
+	// at once.
+	size_t nthreads = std::min<size_t>(_search_threads, cands.size());
+	std::vector<QueryProfile> wprof(nthreads);
+	std::vector<std::unique_ptr<ParallelSearchCB>> wcb;
+	for (size_t t = 0; t < nthreads; t++)
+	{
+		wcb.emplace_back(new ParallelSearchCB(_as, master, mtx, halt,
+		                 profile ? &wprof[t] : nullptr));
+		wcb.back()->set_pattern(*_variables, *_pattern);
+	}
+
+	auto work = [&](size_t t)
+	{
+		try
+		{
+			PatternMatchEngine wpme(*wcb[t]);
+			wpme.set_pattern(*_variables, *_pattern);
+
+			size_t i;
+			while (not halt and (i = next++) < cands.size())
+			{
+				if (wpme.explore_neighborhood(_root, _starter_term, cands[i]))
+					halt = true;
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lck(mtx);
+			if (not error) error = std::current_exception();
+			halt = true;
+		}
+	};
+
+	DO_LOG({LAZY_LOG_FINE << "Parallel search over " << cands.size()
+	              << " candidates";})
+
+	// One task per worker; the OpenMP runtime keeps its threads
+	// around between searches, so none are started here.
+	std::vector<size_t> workers(nthreads);
+	for (size_t t = 0; t < nthreads; t++) workers[t] = t;
+
+	opencog::setting_omp(nthreads, 1);
+	OMP_ALGO::for_each(workers.begin(), workers.end(), work);
+
+	// Reset to default.
+	opencog::setting_omp(opencog::num_threads());
+
+	if (profile)
+		for (const QueryProfile& wp : wprof) profile->merge(wp);
+
+	if (error) std::rethrow_exception(error);
+	return halt;
+}
+
 /* ======================================================== */
 /**
  * Initiate a search by looping over all atoms of the allowed
@@ -742,7 +1015,8 @@ bool InitiateSearchCB::variable_search(PatternMatchEngine *pme)
 
 			// Terrible, terrible hack for detecting infinite loops.
 			// When the world is ready for us, we should instead just
-			// throw the hard error, as ifdef'ed above.
+			// throw the hard error, as ifdef'ed above. Callers that
+			// need a firm bound should set a QueryBudget instead.
 			static const Pattern* prev = nullptr;
 			static unsigned int count = 0;
 			if (prev != _pattern) { prev = _pattern; count = 0; }
@@ -797,6 +1071,10 @@ bool InitiateSearchCB::variable_search(PatternMatchEngine *pme)
 
 	DO_LOG({LAZY_LOG_FINE << "Atomspace reported " << handle_set.size() << " atoms";})
 
+	if (_profile)
+		_profile->start("variable search", false,
+		                _root, _starter_term, handle_set.size());
+
 #ifdef DEBUG
 	size_t i = 0, hsz = handle_set.size();
 #endif
@@ -832,6 +1110,10 @@ bool InitiateSearchCB::no_search(PatternMatchEngine *pme)
 		return false;
 	}
 
+	if (_profile)
+		_profile->start("no search", false, Handle::UNDEFINED,
+		                Handle::UNDEFINED, 0);
+
 	// Evaluate all evaluatable clauses
 	return pme->explore_constant_evaluatables(_pattern->mandatory);
 }
@@ -859,11 +1141,30 @@ void InitiateSearchCB::jit_analyze(PatternMatchEngine* pme)
 	// of this code should probably be moved to PatternLink::jit_expand()
 	while (0 < _pattern->defined_terms.size())
 	{
+		// If the definitions are the same as on the last run of this
+		// pattern, then so is the expansion.
+		HandleMap definitions;
+		for (const Handle& name : _pattern->defined_terms)
+			definitions[name] = DefineLink::get_definition(name);
+
+		std::unique_lock<std::mutex> lck(_plan->mtx);
+		if (_plan->expanded and _plan->definitions == definitions)
+		{
+			_pl = _plan->expanded;
+			lck.unlock();
+			_variables = &_pl->get_variables();
+			_pattern = &_pl->get_pattern();
+			_plan = SearchPlan::get(*_pattern);
+			continue;
+		}
+		lck.unlock();
+
 		Variables vset;
 		HandleMap defnmap;
-		for (const Handle& name : _pattern->defined_terms)
+		for (const auto& nd : definitions)
 		{
-			Handle defn = DefineLink::get_definition(name);
+			const Handle& name = nd.first;
+			Handle defn = nd.second;
 			if (not defn) continue;
 
 			// Extract the variables in the definition.
@@ -897,8 +1198,15 @@ void InitiateSearchCB::jit_analyze(PatternMatchEngine* pme)
 		vset.extend(*_variables);
 
 		_pl = createPatternLink(vset, newbody);
+
+		lck.lock();
+		_plan->expanded = _pl;
+		_plan->definitions = definitions;
+		lck.unlock();
+
 		_variables = &_pl->get_variables();
 		_pattern = &_pl->get_pattern();
+		_plan = SearchPlan::get(*_pattern);
 	}
 
 	_dynamic = &_pattern->evaluatable_terms;
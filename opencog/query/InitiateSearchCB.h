@@ -25,12 +25,15 @@
 #ifndef _OPENCOG_INITIATE_SEARCH_H
 #define _OPENCOG_INITIATE_SEARCH_H
 
+#include <atomic>
+
 #include <opencog/util/empty_string.h>
 #include <opencog/atoms/atom_types/types.h>
 #include <opencog/atoms/core/Quotation.h>
 #include <opencog/atoms/pattern/PatternLink.h>
 #include <opencog/query/PatternMatchCallback.h>
 #include <opencog/query/PatternMatchEngine.h>
+#include <opencog/query/SearchPlan.h>
 
 namespace opencog {
 
@@ -56,6 +59,34 @@ public:
 	virtual void set_pattern(const Variables&, const Pattern&);
 	virtual bool initiate_search(PatternMatchEngine *);
 
+	/**
+	 * Number of threads used to explore the candidate starting points
+	 * found by neighbor_search() and link_type_search(). With more
+	 * than one, the candidates are split across the threads, each
+	 * running its own PatternMatchEngine, and the groundings are
+	 * handed to grounding() one at a time. The default is one thread,
+	 * unless changed with set_default_search_threads().
+	 */
+	void set_search_threads(unsigned n) { _search_threads = n; }
+	static void set_default_search_threads(unsigned n)
+	{ _default_search_threads = n; }
+
+	/**
+	 * Limit the resources that the search may use, or cancel it from
+	 * another thread; see QueryBudget. The budget is not owned, and
+	 * must outlive the search. Null, the default, means no limits.
+	 */
+	void set_budget(QueryBudget* b) { _budget = b; }
+	virtual QueryBudget* get_budget(void) { return _budget; }
+
+	/**
+	 * Record the search strategy and the work done by the search; see
+	 * QueryProfile. The profile is not owned, and must outlive the
+	 * search. Null, the default, means nothing is recorded.
+	 */
+	void set_profile(QueryProfile* p) { _profile = p; }
+	virtual QueryProfile* get_profile(void) { return _profile; }
+
 	std::string to_string(const std::string& indent=empty_string) const;
 
 protected:
@@ -69,15 +100,17 @@ protected:
 	PatternLinkPtr _pl;
 	void jit_analyze(PatternMatchEngine *);
 
+	// The plan kept with the current pattern. The analysis done by
+	// jit_analyze(), neighbor_search() and link_type_search() is
+	// saved there, and reused on the next run of the same pattern.
+	std::shared_ptr<SearchPlan> _plan;
+	bool plan_fresh(void) const;
+	void plan_reset(void);
+
 	Handle _root;
 	Handle _starter_term;
 
-	struct Choice
-	{
-		size_t clause;
-		Handle best_start;
-		Handle start_term;
-	};
+	typedef SearchPlan::Choice Choice;
 	size_t _curr_clause;
 	std::vector<Choice> _choices;
 
@@ -96,6 +129,18 @@ protected:
 	virtual bool variable_search(PatternMatchEngine *);
 	virtual bool no_search(PatternMatchEngine *);
 
+	// Parallel search. The worker threads use the matching callbacks
+	// of DefaultPatternMatchCB, and not those of this class, so only
+	// classes that do not override them may return true here.
+	virtual bool parallel_ok(void) const { return false; }
+	bool parallel_search(size_t) const;
+	bool parallel_explore(PatternMatchEngine *, const HandleSeq&);
+	unsigned _search_threads;
+	static std::atomic<unsigned> _default_search_threads;
+
+	QueryBudget* _budget;
+	QueryProfile* _profile;
+
 	AtomSpace *_as;
 };
 
@@ -21,8 +21,12 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
+#include <unordered_map>
+
 #include <opencog/util/Logger.h>
 
+#include <opencog/atoms/core/FindUtils.h>
 #include <opencog/atoms/pattern/BindLink.h>
 
 #include <opencog/atomspace/AtomSpace.h>
@@ -69,6 +73,9 @@ class PMCGroundings : public PatternMatchCallback
 		bool fuzzy_match(const Handle& h1, const Handle& h2) {
 			return _cb.fuzzy_match(h1, h2);
 		}
+		bool strict_match(void) {
+			return _cb.strict_match();
+		}
 		bool evaluate_sentence(const Handle& link_h,
 		                       const HandleMap &gnds)
 		{
@@ -107,6 +114,9 @@ class PMCGroundings : public PatternMatchCallback
 			return _cb.search_finished(done);
 		}
 
+		QueryBudget* get_budget(void) { return _cb.get_budget(); }
+		QueryProfile* get_profile(void) { return _cb.get_profile(); }
+
 		// This one we don't pass through. Instead, we collect the
 		// groundings.
 		bool grounding(const HandleMap &var_soln,
@@ -122,37 +132,180 @@ class PMCGroundings : public PatternMatchCallback
 };
 
 /**
- * Recursive evaluator/grounder/unifier of virtual link types.
- * The virtual links are in 'virtuals', a partial set of groundings
- * are in 'var_gnds' and 'term_gnds', and a collection of possible
- * groundings for disconnected graph components are in 'comp_var_gnds'
- * and 'comp_term_gnds'.
- *
- * Notes below explain the recursive step: how the various disconnected
- * components are brought together into a candidate grounding. That
- * candidate is then run through each of the virtual links.  If these
- * accept the grounding, then the callback is called to make the final
- * determination.
+ * One step of joining the groundings of disconnected components: the
+ * groundings of the component joined at this step, the virtual
+ * clauses that can be evaluated once it has been joined (because all
+ * of their variables are then grounded), and, if one of those is an
+ * IdenticalLink between a variable of this component and one joined
+ * earlier, a hash index of the groundings of this component by that
+ * variable.
+ */
+struct JoinStep
+{
+	const HandleMapSeq* var_gnds;
+	const HandleMapSeq* term_gnds;
+	HandleSeq virtuals;
+
+	// The variable joined earlier, and the index of our groundings
+	// by the grounding of the variable it must be identical to.
+	Handle probe;
+	std::unordered_map<Handle, std::vector<size_t>> index;
+};
+
+typedef std::vector<JoinStep> JoinPlan;
+
+/**
+ * Decide in what order to join the components, and where to evaluate
+ * each virtual clause. The next component is, by preference, one that
+ * can be hash-joined to those already joined; else one that lets some
+ * virtual clause be evaluated; else one that appears in some virtual
+ * clause; and, among equals, the smallest. Components that appear in
+ * no virtual clause come last, since nothing prunes them. Each virtual clause is evaluated at
+ * the first step at which all of its variables are grounded, so that
+ * the combinations it rejects are not extended any further.
+ */
+static JoinPlan make_join_plan(const HandleSet& varset,
+                               const HandleSeq& virtuals,
+                               const HandleMapSeqSeq& comp_var_gnds,
+                               const HandleMapSeqSeq& comp_term_gnds)
+{
+	size_t ncomps = comp_var_gnds.size();
+
+	// The variables grounded by each component.
+	std::vector<HandleSet> comp_vars(ncomps);
+	for (size_t c = 0; c < ncomps; c++)
+		for (const HandleMap& gnds : comp_var_gnds[c])
+			for (const auto& pr : gnds)
+				if (varset.count(pr.first)) comp_vars[c].insert(pr.first);
+
+	// The variables appearing in each virtual clause.
+	std::vector<HandleSet> virt_vars(virtuals.size());
+	for (size_t v = 0; v < virtuals.size(); v++)
+		for (const Handle& var : varset)
+			if (is_unquoted_in_tree(virtuals[v], var))
+				virt_vars[v].insert(var);
+
+	// Return the variable of an IdenticalLink between two variables,
+	// one in `joined` and the other one in component c, that is in
+	// component c; and set `probe` to the other one.
+	auto equi_join = [&](size_t v, const HandleSet& joined, size_t c,
+	                     Handle& probe) -> Handle
+	{
+		const Handle& virt = virtuals[v];
+		if (IDENTICAL_LINK != virt->get_type() or 2 != virt->get_arity())
+			return Handle::UNDEFINED;
+		const Handle& a = virt->getOutgoingAtom(0);
+		const Handle& b = virt->getOutgoingAtom(1);
+		if (joined.count(a) and comp_vars[c].count(b))
+		{
+			probe = a;
+			return b;
+		}
+		if (joined.count(b) and comp_vars[c].count(a))
+		{
+			probe = b;
+			return a;
+		}
+		return Handle::UNDEFINED;
+	};
+
+	auto covered = [&](size_t v, const HandleSet& joined, size_t c)
+	{
+		for (const Handle& var : virt_vars[v])
+			if (0 == joined.count(var) and 0 == comp_vars[c].count(var))
+				return false;
+		return true;
+	};
+
+	JoinPlan plan;
+	HandleSet joined;
+	std::vector<bool> comp_done(ncomps, false);
+	std::vector<bool> virt_done(virtuals.size(), false);
+	for (size_t step = 0; step < ncomps; step++)
+	{
+		// Pick the next component. Those that no virtual clause
+		// constrains are only multiplied in; leave them for last.
+		size_t best = SIZE_MAX;
+		int best_rank = -2;
+		for (size_t c = 0; c < ncomps; c++)
+		{
+			if (comp_done[c]) continue;
+			int rank = -1;
+			for (size_t v = 0; v < virtuals.size(); v++)
+			{
+				if (virt_done[v]) continue;
+				for (const Handle& var : virt_vars[v])
+					if (comp_vars[c].count(var)) rank = std::max(rank, 0);
+				if (not covered(v, joined, c)) continue;
+				Handle probe;
+				rank = std::max(rank, equi_join(v, joined, c, probe) ? 2 : 1);
+			}
+			if (best_rank < rank or (best_rank == rank and
+			    comp_var_gnds[c].size() < comp_var_gnds[best].size()))
+			{
+				best = c;
+				best_rank = rank;
+			}
+		}
+
+		JoinStep js;
+		js.var_gnds = &comp_var_gnds[best];
+		js.term_gnds = &comp_term_gnds[best];
+		Handle build;
+		for (size_t v = 0; v < virtuals.size(); v++)
+		{
+			if (virt_done[v] or not covered(v, joined, best)) continue;
+			if (nullptr == build)
+				build = equi_join(v, joined, best, js.probe);
+			js.virtuals.push_back(virtuals[v]);
+			virt_done[v] = true;
+		}
+
+		if (build)
+		{
+			const HandleMapSeq& gnds = comp_var_gnds[best];
+			for (size_t i = 0; i < gnds.size(); i++)
+			{
+				auto g = gnds[i].find(build);
+				if (gnds[i].end() != g) js.index[g->second].push_back(i);
+			}
+		}
+
+		plan.emplace_back(std::move(js));
+		comp_done[best] = true;
+		joined.insert(comp_vars[best].begin(), comp_vars[best].end());
+	}
+
+	// Virtual clauses without any variables in them, if any.
+	for (size_t v = 0; v < virtuals.size(); v++)
+		if (not virt_done[v] and not plan.empty())
+			plan[0].virtuals.push_back(virtuals[v]);
+
+	return plan;
+}
+
+/**
+ * Join the groundings of the disconnected components, according to
+ * the plan: extend the partial grounding in 'var_gnds' and 'term_gnds'
+ * with each grounding of the component of this step (or only with
+ * those found through the hash index), check it against the virtual
+ * clauses of the step, and recurse to the next step. Once every
+ * component has been joined, the grounding is complete; the callback
+ * makes the final determination.
  *
- * The recursion step terminates when comp_var_gnds, comp_term_gnds
- * are empty, at which point the actual unification is done.
+ * The combinations are explored depth-first, so that only one of
+ * them is held at a time; and those rejected by a virtual clause are
+ * not extended any further.
  *
  * Return false if no solution is found, true otherwise.
  */
-static bool recursive_virtual(PatternMatchCallback& cb,
-            const HandleSeq& virtuals,
-            const HandleSeq& optionals,
-            const HandleMap& var_gnds,
-            const HandleMap& term_gnds,
-            // copies, NOT references!
-            HandleMapSeqSeq comp_var_gnds,
-            HandleMapSeqSeq comp_term_gnds)
+static bool join_components(PatternMatchCallback& cb,
+                            const JoinPlan& plan, size_t step,
+                            const HandleSeq& optionals,
+                            HandleMap& var_gnds,
+                            HandleMap& term_gnds)
 {
-	// If we are done with the recursive step, then we have one of the
-	// many combinatoric possibilities in the var_gnds and term_gnds
-	// maps. Submit this grounding map to the virtual links, and see
-	// what they've got to say about it.
-	if (0 == comp_var_gnds.size())
+	if (plan.size() == step)
 	{
 #ifdef DEBUG
 		if (logger().is_fine_enabled())
@@ -163,39 +316,6 @@ static bool recursive_virtual(PatternMatchCallback& cb,
 			PatternMatchEngine::log_solution(var_gnds, term_gnds);
 		}
 #endif
-
-		// Note, FYI, that if there are no virtual clauses at all,
-		// then this loop falls straight-through, and the grounding
-		// is reported as a match to the callback.  That is, the
-		// virtuals only serve to reject possibilities.
-		for (const Handle& virt : virtuals)
-		{
-			// At this time, we expect all virtual links to be in
-			// one of two forms: either EvaluationLink's or
-			// GreaterThanLink's. The EvaluationLinks should have
-			// the structure
-			//
-			//   EvaluationLink
-			//       GroundedPredicateNode "scm:blah"
-			//       ListLink
-			//           Arg1Atom
-			//           Arg2Atom
-			//
-			// The GreaterThanLink's should have the "obvious" structure
-			//
-			//   GreaterThanLink
-			//       Arg1Atom
-			//       Arg2Atom
-			//
-			// In either case, one or more VariableNodes should appear
-			// in the Arg atoms. So, we ground the args, and pass that
-			// to the callback.
-
-			bool match = cb.evaluate_sentence(virt, var_gnds);
-
-			if (not match) return false;
-		}
-
 		Handle empty;
 		for (const Handle& opt: optionals)
 		{
@@ -207,40 +327,62 @@ static bool recursive_virtual(PatternMatchCallback& cb,
 		// pattern! See what the callback thinks of it.
 		return cb.grounding(var_gnds, term_gnds);
 	}
-#ifdef DEBUG
-	LAZY_LOG_FINE << "Component recursion: num comp=" << comp_var_gnds.size();
-#endif
 
-	// Recurse over all components. If component k has N_k groundings,
-	// and there are m components, then we have to explore all
-	// N_0 * N_1 * N_2 * ... N_m possible combinations of groundings.
-	// We do this recursively, by poping N_m off the back, and calling
-	// ourselves.
-	//
-	// vg and vp will be the collection of all of the different possible
-	// groundings for one of the components (well, its for component m,
-	// in the above notation.) So the loop below tries every possibility.
-	HandleMapSeq vg = comp_var_gnds.back();
-	comp_var_gnds.pop_back();
-	HandleMapSeq pg = comp_term_gnds.back();
-	comp_term_gnds.pop_back();
-
-	size_t ngnds = vg.size();
-	for (size_t i=0; i<ngnds; i++)
+	const JoinStep& js = plan[step];
+	const HandleMapSeq& vg = *js.var_gnds;
+	const HandleMapSeq& pg = *js.term_gnds;
+
+	// With a hash join, only the groundings having the same atom as
+	// the probe variable are candidates.
+	static const std::vector<size_t> none;
+	const std::vector<size_t>* cands = nullptr;
+	if (js.probe)
 	{
-		// Given a set of groundings, tack on those for this component,
-		// and recurse, with one less component. We need to make a copy,
-		// of course.
-		HandleMap rvg(var_gnds);
-		HandleMap rpg(term_gnds);
+		auto pv = var_gnds.find(js.probe);
+		auto ix = (var_gnds.end() == pv) ?
+			js.index.end() : js.index.find(pv->second);
+		cands = (js.index.end() == ix) ? &none : &ix->second;
+	}
+	size_t ncands = cands ? cands->size() : vg.size();
 
-		const HandleMap& cand_vg(vg[i]);
-		const HandleMap& cand_pg(pg[i]);
-		rvg.insert(cand_vg.begin(), cand_vg.end());
-		rpg.insert(cand_pg.begin(), cand_pg.end());
+	QueryBudget* budget = cb.get_budget();
+	HandleSeq added_vars, added_terms;
+	for (size_t n = 0; n < ncands; n++)
+	{
+		// Each combination is a candidate, as far as the budget goes.
+		if (budget and not budget->charge_candidate(0))
+			return true;
+
+		size_t i = cands ? (*cands)[n] : n;
+
+		// Tack on the groundings of this component. The components
+		// share no variables, so nothing is overwritten; remember
+		// what was added, to take it off again.
+		added_vars.clear();
+		added_terms.clear();
+		for (const auto& pr : vg[i])
+			if (var_gnds.insert(pr).second) added_vars.push_back(pr.first);
+		for (const auto& pr : pg[i])
+			if (term_gnds.insert(pr).second) added_terms.push_back(pr.first);
+
+		// At this time, we expect all virtual links to be in
+		// one of two forms: either EvaluationLink's or
+		// GreaterThanLink's (or other such relations). In either
+		// case, one or more VariableNodes appear in the arguments.
+		// So, we ground the args, and pass that to the callback.
+		bool accept = false;
+		bool match = true;
+		for (const Handle& virt : js.virtuals)
+		{
+			match = cb.evaluate_sentence(virt, var_gnds);
+			if (not match) break;
+		}
+		if (match)
+			accept = join_components(cb, plan, step+1, optionals,
+			                         var_gnds, term_gnds);
 
-		bool accept = recursive_virtual(cb, virtuals, optionals, rvg, rpg,
-		                                comp_var_gnds, comp_term_gnds);
+		for (const Handle& h : added_vars) var_gnds.erase(h);
+		for (const Handle& h : added_terms) term_gnds.erase(h);
 
 		// Halt recursion immediately if match is accepted.
 		if (accept) return true;
@@ -383,6 +525,11 @@ bool PatternLink::satisfy(PatternMatchCallback& pmcb) const
 		PMCGroundings gcb(pmcb);
 		clp->satisfy(gcb);
 
+		// If the budget ran out, then the groundings of this component
+		// are incomplete; halt here.
+		QueryBudget* budget = pmcb.get_budget();
+		if (budget and budget->is_halted()) return true;
+
 		// Special handling for disconnected pure optionals -- Returns false to
 		// end the search if this disconnected pure optional is found
 		if (is_pure_optional)
@@ -404,23 +551,25 @@ bool PatternLink::satisfy(PatternMatchCallback& pmcb) const
 				return false;
 			}
 
-			comp_var_gnds.push_back(gcb._var_groundings);
-			comp_term_gnds.push_back(gcb._term_groundings);
+			comp_var_gnds.push_back(std::move(gcb._var_groundings));
+			comp_term_gnds.push_back(std::move(gcb._term_groundings));
 		}
 	}
 
-	// And now, try grounding each of the virtual clauses.
+	// And now, join the components, evaluating the virtual clauses
+	// along the way.
 #ifdef DEBUG
-	LAZY_LOG_FINE << "BEGIN component recursion: ====================== "
+	LAZY_LOG_FINE << "BEGIN component join: ====================== "
 	              << "num comp=" << comp_var_gnds.size()
 	              << " num virts=" << _virtual.size();
 #endif
-	HandleMap empty_vg;
-	HandleMap empty_pg;
+	JoinPlan plan(make_join_plan(_varlist.varset, _virtual,
+	                             comp_var_gnds, comp_term_gnds));
+	HandleMap var_gnds;
+	HandleMap term_gnds;
 	pmcb.set_pattern(_varlist, _pat);
-	return recursive_virtual(pmcb, _virtual, _pat.optionals,
-	                         empty_vg, empty_pg,
-	                         comp_var_gnds, comp_term_gnds);
+	return join_components(pmcb, plan, 0, _pat.optionals,
+	                       var_gnds, term_gnds);
 }
 
 /* ===================== END OF FILE ===================== */
@@ -31,6 +31,8 @@
 #include <opencog/atoms/core/VariableList.h> // for VariableTypeMap
 #include <opencog/atoms/pattern/Pattern.h> // for VariableTypeMap
 #include <opencog/atoms/pattern/PatternTerm.h> // for pattern context
+#include <opencog/query/QueryBudget.h>
+#include <opencog/query/QueryProfile.h>
 
 namespace opencog {
 class PatternMatchEngine;
@@ -158,6 +160,19 @@ class PatternMatchCallback
 			return false;
 		}
 
+		/**
+		 * Return true if the callbacks above match no more loosely than
+		 * those of DefaultPatternMatchCB: a node matches only itself, a
+		 * link only a link of the same type and arity, a VariableNode
+		 * only an atom of a type that it allows, and fuzzy_match() is
+		 * always false. The engine may then skip over those
+		 * permutations of an unordered link that cannot match.
+		 * Off by default, as a class derived from one of the default
+		 * callbacks may match more loosely; the callbacks that are
+		 * known to be exact turn it on.
+		 */
+		virtual bool strict_match(void) { return false; }
+
 		/**
 		 * Invoked to confirm or deny a candidate grounding for term that
 		 * consistes entirely of connectives and evaluatable terms.
@@ -335,6 +350,21 @@ class PatternMatchCallback
 		 */
 		virtual void set_pattern(const Variables& vars,
 		                         const Pattern& pat) = 0;
+
+		/**
+		 * The resource limits of the search, if any; see QueryBudget.
+		 * The engine charges the budget as it explores, and halts the
+		 * search once it is used up. Callbacks that wrap another
+		 * callback should pass this through.
+		 */
+		virtual QueryBudget* get_budget(void) { return nullptr; }
+
+		/**
+		 * Where to record what the search did, if anywhere; see
+		 * QueryProfile. Callbacks that wrap another callback should
+		 * pass this through.
+		 */
+		virtual QueryProfile* get_profile(void) { return nullptr; }
 };
 
 } // namespace opencog
@@ -21,6 +21,9 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
+#include <cfloat>
+
 #include <opencog/util/algorithm.h>
 #include <opencog/util/oc_assert.h>
 #include <opencog/util/Logger.h>
@@ -133,7 +136,7 @@ bool PatternMatchEngine::variable_compare(const Handle& hp,
 		DO_LOG({LAZY_LOG_FINE << "Found grounding of variable:";})
 		logmsg("$$ variable:", hp);
 		logmsg("$$ ground term:", hg);
-		var_grounding[hp] = hg;
+		var_grounding.set(hp, hg);
 	}
 	return true;
 }
@@ -149,7 +152,7 @@ bool PatternMatchEngine::variable_compare(const Handle& hp,
 bool PatternMatchEngine::self_compare(const PatternTermPtr& ptm)
 {
 	const Handle& hp = ptm->getHandle();
-	if (not ptm->isQuoted()) var_grounding[hp] = hp;
+	if (not ptm->isQuoted()) var_grounding.set(hp, hp);
 
 	logmsg("Compare atom to itself:", hp);
 	return true;
@@ -168,7 +171,7 @@ bool PatternMatchEngine::node_compare(const Handle& hp,
 		DO_LOG({LAZY_LOG_FINE << "Found matching nodes";})
 		logmsg("# pattern:", hp);
 		logmsg("# match:", hg);
-		if (hp != hg) var_grounding[hp] = hg;
+		if (hp != hg) var_grounding.set(hp, hg);
 	}
 	return match;
 }
@@ -310,7 +313,7 @@ bool PatternMatchEngine::choice_compare(const PatternTermPtr& ptm,
 				// If the grounding is accepted, record it.
 				record_grounding(ptm, hg);
 
-				_choice_state[GndChoice(ptm, hg)] = icurr;
+				_choice_state.set(GndChoice(ptm, hg), icurr);
 				return true;
 			}
 		}
@@ -350,6 +353,93 @@ bool PatternMatchEngine::have_choice(const PatternTermPtr& ptm,
 }
 
 /* ======================================================== */
+
+/// A quick test of whether the pattern term might be grounded by the
+/// atom, in the current state: false only if tree_compare() would
+/// certainly fail. Nothing is recorded. This follows tree_compare(),
+/// assuming the strict matching of the default callbacks; it gives up
+/// (returns true) at anything that it cannot judge cheaply.
+bool PatternMatchEngine::may_match(const PatternTermPtr& ptm,
+                                   const Handle& hg)
+{
+	const Handle& hp = ptm->getHandle();
+
+	auto gnd = var_grounding.find(hp);
+	if (gnd != var_grounding.end()) return (gnd->second == hg);
+
+	Type tp = hp->get_type();
+	if (not ptm->isQuoted())
+	{
+		if (_varlist->varset.end() != _varlist->varset.find(hp))
+			return VARIABLE_NODE != tp or _varlist->is_type(hp, hg);
+		if (VARIABLE_NODE == tp) return true;
+	}
+
+	if (hp == hg) return true;
+	if (hp->is_node()) return false;
+	if (CHOICE_LINK == tp) return true;
+	if (not hg->is_link() or tp != hg->get_type()) return false;
+
+	if (is_evaluatable(hp)) return true;
+	if (0 < _pat->globby_terms.count(hp)) return true;
+	if (hp->get_arity() != hg->get_arity()) return false;
+
+	// Scoped links are compared up to alpha-conversion, and unordered
+	// links in any order; leave these to tree_compare().
+	if (_nameserver.isA(tp, SCOPE_LINK)) return true;
+	if (1 < hp->get_arity() and not _nameserver.isA(tp, ORDERED_LINK))
+		return true;
+
+	const HandleSeq& osg = hg->getOutgoingSet();
+	PatternTermSeq osp = ptm->getOutgoingSet();
+	for (size_t i = 0; i < osp.size(); i++)
+		if (not may_match(osp[i], osg[i])) return false;
+	return true;
+}
+
+/// Augmenting-path step of the bipartite matching below.
+static bool augment(size_t term, size_t arity, const std::vector<char>& compat,
+                    std::vector<size_t>& owner, std::vector<char>& seen)
+{
+	for (size_t j = 0; j < arity; j++)
+	{
+		if (not compat[term * arity + j] or seen[j]) continue;
+		seen[j] = true;
+		if (SIZE_MAX == owner[j] or augment(owner[j], arity, compat, owner, seen))
+		{
+			owner[j] = term;
+			return true;
+		}
+	}
+	return false;
+}
+
+/// Fill in `compat`, so that compat[i * arity + j] is false only if
+/// the i'th pattern term cannot be grounded by the j'th atom. Then
+/// return false if there is no way to pair up every term with an
+/// atom it might match, that is, if no permutation can match.
+bool PatternMatchEngine::unorder_compat(const PatternTermSeq& osp,
+                                        const HandleSeq& osg,
+                                        std::vector<char>& compat)
+{
+	size_t arity = osp.size();
+	compat.resize(arity * arity);
+	for (size_t i = 0; i < arity; i++)
+		for (size_t j = 0; j < arity; j++)
+			compat[i * arity + j] = may_match(osp[i], osg[j]);
+
+	std::vector<size_t> owner(arity, SIZE_MAX);
+	for (size_t i = 0; i < arity; i++)
+	{
+		std::vector<char> seen(arity, false);
+		if (not augment(i, arity, compat, owner, seen)) return false;
+	}
+	return true;
+}
+
+// Unordered links with fewer children than this are not pruned.
+static const size_t MIN_PRUNE_ARITY = 3;
+
 static int facto (int n) { return (n==1)? 1 : n * facto(n-1); };
 
 /// Unordered link comparison
@@ -517,6 +607,26 @@ bool PatternMatchEngine::unorder_compare(const PatternTermPtr& ptm,
 	Permutation mutation = curr_perm(ptm, hg, fresh);
 	if (fresh) take_step = false; // took a step, clear the flag.
 
+	// Find out which terms might go with which atoms, and give up
+	// at once if there is no way to pair them all up. Otherwise,
+	// permutations that pair some term with an atom that it cannot
+	// match are skipped below, without being compared.
+	bool prune = _strict and not has_glob and MIN_PRUNE_ARITY <= arity;
+	std::vector<char> compat;
+	if (prune and not unorder_compat(osp, osg, compat))
+	{
+		DO_LOG({LAZY_LOG_FINE << "No pairing of terms can match term="
+		              << ptm->to_string();})
+		_pmc.post_link_mismatch(hp, hg);
+		_perm_state.erase(Unorder(ptm, hg));
+		have_more = false;
+		return false;
+	}
+
+	// The permutation we resume at matched last time; compare it
+	// again, as described above, even if it no longer could.
+	bool resumed = not fresh;
+
 	// Cases C and D fall through.
 	// If we are here, we've got possibilities to explore.
 #ifdef DEBUG
@@ -532,6 +642,30 @@ bool PatternMatchEngine::unorder_compare(const PatternTermPtr& ptm,
 #endif
 	do
 	{
+		if (prune and not resumed)
+		{
+			// Find the first position that cannot match. Every
+			// permutation that starts out the same way fails there
+			// too; so arrange the rest in descending order, so that
+			// the next permutation changes that position.
+			size_t bad = 0;
+			for (; bad < arity; bad++)
+			{
+				size_t i = std::find(osp.begin(), osp.end(), mutation[bad])
+					- osp.begin();
+				if (not compat[i * arity + bad]) break;
+			}
+			if (bad < arity)
+			{
+				std::sort(mutation.begin() + bad + 1, mutation.end());
+				std::reverse(mutation.begin() + bad + 1, mutation.end());
+				take_step = false;
+				have_more = false;
+				continue;
+			}
+		}
+		resumed = false;
+
 		DO_LOG({LAZY_LOG_FINE << "tree_comp explore unordered perm "
 		              << perm_count[Unorder(ptm, hg)] << " of " << num_perms
 		              << " of term=" << ptm->to_string();})
@@ -600,7 +734,7 @@ bool PatternMatchEngine::unorder_compare(const PatternTermPtr& ptm,
 				              << perm_count[Unorder(ptm, hg)]
 				              << " for term=" << ptm->to_string()
 				              << " have_more=" << have_more;})
-				_perm_state[Unorder(ptm, hg)] = mutation;
+				_perm_state.set(Unorder(ptm, hg), mutation);
 				return true;
 			}
 		}
@@ -618,6 +752,12 @@ take_next_step:
 		solution_pop();
 		if (logger().is_fine_enabled())
 			perm_count[Unorder(ptm, hg)] ++;
+		if (_profile) _profile->permutations++;
+
+		// Each step is charged to the budget; if it runs out, give
+		// up on this link, as if all permutations had been tried.
+		if (_budget and not _budget->charge_permutation(footprint()))
+			break;
 	} while (std::next_permutation(mutation.begin(), mutation.end()));
 
 	// If we are here, we've explored all the possibilities already
@@ -671,14 +811,14 @@ bool PatternMatchEngine::have_perm(const PatternTermPtr& ptm,
 
 void PatternMatchEngine::perm_push(void)
 {
-	perm_stack.push(_perm_state);
+	_perm_state.push();
 	if (logger().is_fine_enabled())
 		perm_count_stack.push(perm_count);
 }
 
 void PatternMatchEngine::perm_pop(void)
 {
-	POPSTK(perm_stack, _perm_state);
+	_perm_state.pop();
 	if (logger().is_fine_enabled())
 		POPSTK(perm_count_stack, perm_count);
 }
@@ -745,7 +885,7 @@ bool PatternMatchEngine::glob_compare(const PatternTermSeq& osp,
 		_glob_state[gp] = {glob_grd, glob_pos_stack};
 
 		Handle glp(createLink(glob_seq, LIST_LINK));
-		var_grounding[glob->getHandle()] = glp;
+		var_grounding.set(glob->getHandle(), glp);
 
 		DO_LOG({LAZY_LOG_FINE << "Found grounding of glob:";})
 		logmsg("$$ glob:", glob->getHandle());
@@ -1327,6 +1467,13 @@ bool PatternMatchEngine::explore_link_branches(const PatternTermPtr& ptm,
 {
 	const Handle& hp = ptm->getHandle();
 
+	// Every candidate is charged to the budget, if there is one.
+	// Once it is used up, halt the search, just as if the callback
+	// had accepted a grounding.
+	if (_budget and not _budget->charge_candidate(footprint()))
+		return true;
+	if (_profile) _profile->candidates++;
+
 	// If its not an unordered link, then don't try to iterate over
 	// all permutations.
 	Type tp = hp->get_type();
@@ -1345,6 +1492,11 @@ bool PatternMatchEngine::explore_link_branches(const PatternTermPtr& ptm,
 		have_more = false;
 	} while (have_perm(ptm, hg));
 
+	// If the budget ran out while stepping through the permutations,
+	// then halt.
+	if (_budget and _budget->is_halted())
+		return true;
+
 	DO_LOG({logger().fine("No more unordered permutations");})
 
 	return false;
@@ -1364,13 +1516,15 @@ bool PatternMatchEngine::explore_choice_branches(const PatternTermPtr& ptm,
 
 	DO_LOG({logger().fine("Begin choice branchpoint iteration loop");})
 	do {
-		// XXX This `need_choice_push` thing is probably wrong; it probably
-		// should resemble the perm_push() used for unordered links.
-		// However, currently, no test case trips this up. so .. OK.
-		// Whatever. This still probably needs fixing.
-		if (_need_choice_push) choice_stack.push(_choice_state);
+		// A ChoiceLink below the clause root, that we hopped over on
+		// the way up, asks for the choice state to be saved. The
+		// branch explored below may set or clear the flag again, for
+		// ChoiceLinks of its own; so remember whether we pushed, and
+		// pop only if we did.
+		bool pushed = _need_choice_push;
+		if (pushed) _choice_state.push();
 		bool match = explore_single_branch(ptm, hg, clause_root);
-		if (_need_choice_push) POPSTK(choice_stack, _choice_state);
+		if (pushed) _choice_state.pop();
 		_need_choice_push = false;
 
 		// If the pattern was satisfied, then we are done for good.
@@ -1419,6 +1573,7 @@ bool PatternMatchEngine::explore_single_branch(const PatternTermPtr& ptm,
 	{
 		DO_LOG({LAZY_LOG_FINE << "Pattern term=" << ptm->to_string()
 		              << " NOT solved by " << hg.value();})
+		if (_profile) _profile->backtracks++;
 		solution_pop();
 		return false;
 	}
@@ -1554,7 +1709,7 @@ bool PatternMatchEngine::do_term_up(const PatternTermPtr& ptm,
 			// the evaluation for the callback.
 // XXX TODO count the number of ungrounded vars !!! (make sure its zero)
 
-			bool found = _pmc.evaluate_sentence(clause_root, var_grounding);
+			bool found = evaluate(clause_root, var_grounding);
 			DO_LOG({logger().fine("After evaluating clause, found = %d", found);})
 			if (found)
 				return clause_accept(clause_root, hg);
@@ -1625,11 +1780,16 @@ bool PatternMatchEngine::clause_accept(const Handle& clause_root,
 		match = _pmc.clause_match(clause_root, hg, var_grounding);
 		DO_LOG({logger().fine("clause match callback match=%d", match);})
 	}
+	if (_profile)
+	{
+		if (match) _profile->clauses[clause_root].successes++;
+		else _profile->backtracks++;
+	}
 	if (not match) return false;
 
 	if (not is_evaluatable(clause_root))
 	{
-		clause_grounding[clause_root] = hg;
+		clause_grounding.set(clause_root, hg);
 		logmsg("---------------------\nclause:", clause_root);
 		logmsg("ground:", hg);
 	}
@@ -1652,7 +1812,7 @@ bool PatternMatchEngine::do_next_clause(void)
 	bool found = false;
 	if (nullptr == curr_root)
 	{
-		found = _pmc.grounding(var_grounding, clause_grounding);
+		found = report_grounding(var_grounding, clause_grounding);
 		DO_LOG(logger().fine("==================== FINITO! accepted=%d", found);)
 		DO_LOG(log_solution(var_grounding, clause_grounding);)
 	}
@@ -1665,7 +1825,7 @@ bool PatternMatchEngine::do_next_clause(void)
 		              << (is_evaluatable(curr_root)?
 		                  "dynamically evaluatable" : "non-dynamic");
 		logmsg("Joining variable is", joiner);
-		logmsg("Joining grounding is", var_grounding[joiner]); })
+		logmsg("Joining grounding is", var_grounding.get(joiner)); })
 
 		// Start solving the next unsolved clause. Note: this is a
 		// recursive call, and not a loop. Recursion is halted when
@@ -1676,7 +1836,7 @@ bool PatternMatchEngine::do_next_clause(void)
 		// and this clause.
 
 		clause_accepted = false;
-		Handle hgnd(var_grounding[joiner]);
+		Handle hgnd(var_grounding.get(joiner));
 		OC_ASSERT(nullptr != hgnd, "Error: joining handle has not been grounded yet!");
 		found = explore_clause(joiner, hgnd, curr_root);
 
@@ -1704,7 +1864,7 @@ bool PatternMatchEngine::do_next_clause(void)
 			}
 
 			// XXX Maybe should push n pop here? No, maybe not ...
-			clause_grounding[curr_root] = Handle::UNDEFINED;
+			clause_grounding.set(curr_root, Handle::UNDEFINED);
 			get_next_untried_clause();
 			joiner = next_joint;
 			curr_root = next_clause;
@@ -1714,7 +1874,7 @@ bool PatternMatchEngine::do_next_clause(void)
 			{
 				DO_LOG({logger().fine("==================== FINITO BANDITO!");
 				log_solution(var_grounding, clause_grounding);})
-				found = _pmc.grounding(var_grounding, clause_grounding);
+				found = report_grounding(var_grounding, clause_grounding);
 			}
 			else
 			{
@@ -1722,7 +1882,8 @@ bool PatternMatchEngine::do_next_clause(void)
 				// or not. If it does, we'll recurse. If it does not,
 				// we'll loop around back to here again.
 				clause_accepted = false;
-				Handle hgnd = var_grounding[joiner];
+				Handle hgnd = var_grounding.get(joiner);
+				if (_profile) _profile->clauses[curr_root].attempts++;
 				found = explore_term_branches(joiner, hgnd, curr_root);
 			}
 		}
@@ -1844,6 +2005,102 @@ unsigned int PatternMatchEngine::thickness(const Handle& clause,
 	return count;
 }
 
+// The clause_cost() of a clause for which there is no estimate.
+static const double UNKNOWN_COST = -1.0;
+
+// Position of the child term in the outgoing set of the term.
+static size_t term_position(const PatternTermPtr& term,
+                            const PatternTermPtr& child)
+{
+	const HandleSeq& oset = term->getHandle()->getOutgoingSet();
+	for (size_t i = 0; i < oset.size(); i++)
+	{
+		if (oset[i] == child->getHandle() or oset[i] == child->getQuote())
+			return i;
+	}
+	return 0;
+}
+
+// Estimate the cost of grounding the clause `root` next, by pursuing
+// the grounding of `joint`: the number of candidate groundings that
+// will have to be looked at. That is the number of links that hold
+// the grounding of the joint, and are of the type of the term holding
+// the joint, times the fan-out of each of the terms above that, on the
+// way up to the root of the clause. The fan-out comes from the
+// statistics kept by the atomspace of the grounding, and its parents.
+//
+// Evaluatable and black-box clauses are not in the atomspace; for
+// these, and for joints held by a ChoiceLink, the cost is taken to be
+// the size of the whole incoming set of the grounding, as before.
+//
+// The cost is not known, and UNKNOWN_COST is returned, if the joint
+// is the whole clause, or if the atomspaces hold no links of the type
+// of one of the terms on the way up, and so have no fan-out for it.
+//
+// The estimate is given up on as soon as it exceeds `bound`; some
+// number above `bound` is returned, then. The fan-outs are at least
+// one, so the estimate only grows on the way up.
+//
+double PatternMatchEngine::clause_cost(const Handle& joint,
+                                       const Handle& root,
+                                       double bound)
+{
+	Handle gnd(var_grounding.get(joint));
+	double cost = gnd->getIncomingSetSize();
+	if (is_evaluatable(root) or is_black(root)) return cost;
+
+	const auto& ptms = _pat->connected_terms_map.find({joint, root});
+	if (_pat->connected_terms_map.end() == ptms) return cost;
+
+	AtomSpace* as = gnd->getAtomSpace();
+	if (nullptr == as) return UNKNOWN_COST;
+
+	double cheapest = cost;
+	for (const PatternTermPtr& ptm : ptms->second)
+	{
+		// The term trees hang off of a root term with no atom in it.
+		PatternTermPtr term(ptm->getParent());
+		if (nullptr == term->getHandle()) return UNKNOWN_COST;
+
+		Type t = term->getHandle()->get_type();
+		if (CHOICE_LINK == t) continue;
+
+		cost = gnd->getIncomingSetSizeHint(t);
+		PatternTermPtr child(term);
+		term = term->getParent();
+		while (nullptr != term->getHandle() and cost < cheapest
+		       and cost <= bound)
+		{
+			t = term->getHandle()->get_type();
+			if (CHOICE_LINK != t)
+			{
+				double fan = fan_out(as, t, term_position(term, child));
+				if (0.0 == fan) return UNKNOWN_COST;
+				cost *= fan;
+			}
+			child = term;
+			term = term->getParent();
+		}
+		if (cost < cheapest) cheapest = cost;
+	}
+	return cheapest;
+}
+
+// The fan-out of links of type `t` at position `pos`, over `as` and
+// its parents. Reading it from the atomspace costs a lock per parent,
+// and the estimates change little during one search; so each is read
+// only once.
+double PatternMatchEngine::fan_out(const AtomSpace* as, Type t, size_t pos)
+{
+	FanOutKey key(as, t, pos);
+	auto it = _fan_outs.find(key);
+	if (_fan_outs.end() != it) return it->second;
+
+	double fan = as->get_fan_out(t, pos);
+	_fan_outs.emplace(key, fan);
+	return fan;
+}
+
 /// get_glob_embedding() -- given glob node, return term that it grounds.
 ///
 /// If a GlobNode has a grounding, then there is always some
@@ -1910,10 +2167,18 @@ bool PatternMatchEngine::get_next_thinnest_clause(bool search_virtual,
 	// the root is grounded.  If its not, start working on that.
 	Handle joint(Handle::UNDEFINED);
 	Handle unsolved_clause(Handle::UNDEFINED);
-	unsigned int thinnest_joint = UINT_MAX;
+	double cheapest = DBL_MAX;
 	unsigned int thinnest_clause = UINT_MAX;
 	bool unsolved = false;
 
+	// The choice made without the cost estimates, for when some of
+	// them are not known.
+	Handle thin_joint(Handle::UNDEFINED);
+	Handle thin_clause(Handle::UNDEFINED);
+	std::size_t thinnest_joint = SIZE_MAX;
+	unsigned int thin_thickness = UINT_MAX;
+	bool known = true;
+
 	// Make a list of the as-yet ungrounded variables.
 	HandleSet ungrounded_vars;
 
@@ -1932,7 +2197,7 @@ bool PatternMatchEngine::get_next_thinnest_clause(bool search_virtual,
 			if (GLOB_NODE == v->get_type())
 			{
 				Handle embed = get_glob_embedding(v);
-				const Handle& tg = var_grounding[embed];
+				Handle tg(var_grounding.get(embed));
 				std::size_t incoming_set_size = tg->getIncomingSetSize();
 				thick_vars.insert(std::make_pair(incoming_set_size, embed));
 			}
@@ -1948,16 +2213,25 @@ bool PatternMatchEngine::get_next_thinnest_clause(bool search_virtual,
 	// We are looking for a joining atom, one that is shared in common
 	// with the a fully grounded clause, and an as-yet ungrounded clause.
 	// The joint is called "pursue", and the unsolved clause that it
-	// joins will become our next untried clause. We choose joining atom
-	// with smallest size of its incoming set. If there are many such
-	// atoms we choose one from clauses with minimal number of ungrounded
-	// yet variables.
+	// joins will become our next untried clause. We choose the joint
+	// and clause with the smallest estimated cost; see clause_cost().
+	// If there are many such, we choose the clause with the fewest
+	// ungrounded variables, and then the joint with the smallest
+	// incoming set. If the cost of some clause is not known, the
+	// estimates cannot be compared, and we choose as if there were
+	// none: the joint with the smallest incoming set, and then the
+	// clause with the fewest ungrounded variables.
 	for (auto tckvar : thick_vars)
 	{
 		std::size_t pursue_thickness = tckvar.first;
 		const Handle& pursue = tckvar.second;
 
-		if (pursue_thickness > thinnest_joint) break;
+		// Once a cost is not known, only the thinnest joints matter,
+		// and the joints come thinnest first. With known costs, there
+		// is nothing cheaper than a cost of zero, for a clause with
+		// no ungrounded variables.
+		if (not known and pursue_thickness > thinnest_joint) break;
+		if (known and 0.0 == cheapest and 0 == thinnest_clause) break;
 
 		auto root_list = _pat->connectivity_map.equal_range(pursue);
 
@@ -1970,18 +2244,43 @@ bool PatternMatchEngine::get_next_thinnest_clause(bool search_virtual,
 			        and (search_optionals or not is_optional(root)))
 			{
 				unsigned int root_thickness = thickness(root, ungrounded_vars);
-				if (root_thickness < thinnest_clause)
+				if (pursue_thickness < thinnest_joint or
+				    (pursue_thickness == thinnest_joint and
+				     root_thickness < thin_thickness))
 				{
-					thinnest_clause = root_thickness;
 					thinnest_joint = pursue_thickness;
+					thin_thickness = root_thickness;
+					thin_clause = root;
+					thin_joint = pursue;
+				}
+				unsolved = true;
+
+				if (not known) continue;
+				double cost = clause_cost(pursue, root, cheapest);
+				if (UNKNOWN_COST == cost)
+				{
+					known = false;
+					continue;
+				}
+				if (cheapest < cost) continue;
+
+				if (cost < cheapest or root_thickness < thinnest_clause)
+				{
+					cheapest = cost;
+					thinnest_clause = root_thickness;
 					unsolved_clause = root;
 					joint = pursue;
-					unsolved = true;
 				}
 			}
 		}
 	}
 
+	if (unsolved and not known)
+	{
+		unsolved_clause = thin_clause;
+		joint = thin_joint;
+	}
+
 	if (unsolved)
 	{
 		// Joint is a (variable) node that's shared between several
@@ -2022,11 +2321,11 @@ void PatternMatchEngine::clause_stacks_push(void)
 	DO_LOG({logger().fine("--- That's it, now push to stack depth=%d",
 	              _clause_stack_depth);})
 
-	var_solutn_stack.push(var_grounding);
-	_clause_solutn_stack.push(clause_grounding);
+	var_grounding.push();
+	clause_grounding.push();
 
-	issued_stack.push(issued);
-	choice_stack.push(_choice_state);
+	issued.push();
+	_choice_state.push();
 
 	perm_push();
 
@@ -2043,12 +2342,11 @@ void PatternMatchEngine::clause_stacks_pop(void)
 {
 	_pmc.pop();
 
-	// The grounding stacks are handled differently.
-	POPSTK(_clause_solutn_stack, clause_grounding);
-	POPSTK(var_solutn_stack, var_grounding);
-	POPSTK(issued_stack, issued);
+	clause_grounding.pop();
+	var_grounding.pop();
+	issued.pop();
 
-	POPSTK(choice_stack, _choice_state);
+	_choice_state.pop();
 
 	perm_pop();
 
@@ -2067,37 +2365,30 @@ void PatternMatchEngine::clause_stacks_pop(void)
 void PatternMatchEngine::clause_stacks_clear(void)
 {
 	_clause_stack_depth = 0;
-#if 0
-	OC_ASSERT(0 == _clause_solutn_stack.size());
-	OC_ASSERT(0 == var_solutn_stack.size());
-	OC_ASSERT(0 == issued_stack.size());
-	OC_ASSERT(0 == choice_stack.size());
-	OC_ASSERT(0 == perm_stack.size());
-#else
-	while (!_clause_solutn_stack.empty()) _clause_solutn_stack.pop();
-	while (!var_solutn_stack.empty()) var_solutn_stack.pop();
-	while (!issued_stack.empty()) issued_stack.pop();
-	while (!choice_stack.empty()) choice_stack.pop();
-	while (!perm_stack.empty()) perm_stack.pop();
-#endif
+	clause_grounding.forget();
+	var_grounding.forget();
+	issued.forget();
+	_choice_state.forget();
+	_perm_state.forget();
+	while (!perm_count_stack.empty()) perm_count_stack.pop();
 }
 
 void PatternMatchEngine::solution_push(void)
 {
-	var_solutn_stack.push(var_grounding);
-	_clause_solutn_stack.push(clause_grounding);
+	var_grounding.push();
+	clause_grounding.push();
 }
 
 void PatternMatchEngine::solution_pop(void)
 {
-	POPSTK(var_solutn_stack, var_grounding);
-	POPSTK(_clause_solutn_stack, clause_grounding);
+	var_grounding.pop();
+	clause_grounding.pop();
 }
 
 void PatternMatchEngine::solution_drop(void)
 {
-	var_solutn_stack.pop();
-	_clause_solutn_stack.pop();
+	var_grounding.drop();
+	clause_grounding.drop();
 }
 
 /* ======================================================== */
@@ -2131,6 +2422,7 @@ bool PatternMatchEngine::explore_neighborhood(const Handle& do_clause,
                                               const Handle& term,
                                               const Handle& grnd)
 {
+	if (_profile) _profile->start_candidates++;
 	clause_stacks_clear();
 	return explore_redex(term, grnd, do_clause);
 }
@@ -2166,6 +2458,8 @@ bool PatternMatchEngine::explore_clause(const Handle& term,
                                         const Handle& grnd,
                                         const Handle& clause)
 {
+	if (_profile) _profile->clauses[clause].attempts++;
+
 	// If we are looking for a pattern to match, then ... look for it.
 	// Evaluatable clauses are not patterns; they are clauses that
 	// evaluate to true or false.
@@ -2202,9 +2496,9 @@ bool PatternMatchEngine::explore_clause(const Handle& term,
 	// happy, and record the suggested grounding. There's nowhere
 	// else to do this, so we do it here.
 	if (term->get_type() == VARIABLE_NODE)
-		var_grounding[term] = grnd;
+		var_grounding.set(term, grnd);
 
-	bool found = _pmc.evaluate_sentence(clause, var_grounding);
+	bool found = evaluate(clause, var_grounding);
 	DO_LOG({logger().fine("Post evaluating clause, found = %d", found);})
 	if (found)
 		return clause_accept(clause, grnd);
@@ -2225,11 +2519,11 @@ void PatternMatchEngine::record_grounding(const PatternTermPtr& ptm,
 	// Only record if the pattern is not quoted, otherwise the pattern
 	// is not completely self-contained.
 	if (not ptm->isQuoted())
-		var_grounding[hp] = hg;
+		var_grounding.set(hp, hg);
 	// If quoted, try one last chance by checking if the quote is
 	// hidden in ptm.
 	else if (const Handle& quote = ptm->getQuote())
-		var_grounding[quote] = hg;
+		var_grounding.set(quote, hg);
 }
 
 /**
@@ -2265,20 +2559,51 @@ bool PatternMatchEngine::explore_constant_evaluatables(const HandleSeq& clauses)
 	bool found = true;
 	for (const Handle& clause : clauses) {
 		if (is_in(clause, _pat->evaluatable_holders)) {
-			found = _pmc.evaluate_sentence(clause, HandleMap());
+			found = evaluate(clause, HandleMap());
 			if (not found)
 				break;
 		}
 	}
 	if (found)
-		_pmc.grounding(HandleMap(), HandleMap());
+		report_grounding(HandleMap(), HandleMap());
+
+	return found;
+}
+
+/// Pass the grounding to the callback, timing it if profiling.
+bool PatternMatchEngine::report_grounding(const HandleMap& var_soln,
+                                          const HandleMap& term_soln)
+{
+	if (nullptr == _profile)
+		return _pmc.grounding(var_soln, term_soln);
+
+	QueryProfile::Clock::time_point start = QueryProfile::Clock::now();
+	bool found = _pmc.grounding(var_soln, term_soln);
+	_profile->grounding_time += QueryProfile::Clock::now() - start;
+	_profile->groundings++;
+	return found;
+}
+
+/// Evaluate the clause with the callback, timing it if profiling.
+bool PatternMatchEngine::evaluate(const Handle& clause,
+                                  const HandleMap& gnds)
+{
+	if (nullptr == _profile)
+		return _pmc.evaluate_sentence(clause, gnds);
 
+	QueryProfile::Clock::time_point start = QueryProfile::Clock::now();
+	bool found = _pmc.evaluate_sentence(clause, gnds);
+	_profile->evaluation_time += QueryProfile::Clock::now() - start;
+	_profile->evaluations++;
 	return found;
 }
 
 PatternMatchEngine::PatternMatchEngine(PatternMatchCallback& pmcb)
 	: _pmc(pmcb),
 	_nameserver(nameserver()),
+	_budget(nullptr),
+	_strict(false),
+	_profile(nullptr),
 	_varlist(nullptr),
 	_pat(nullptr),
 	clause_accepted(false)
@@ -2303,6 +2628,22 @@ void PatternMatchEngine::set_pattern(const Variables& v,
 {
 	_varlist = &v;
 	_pat = &p;
+	_budget = _pmc.get_budget();
+	_strict = _pmc.strict_match();
+	_profile = _pmc.get_profile();
+	_fan_outs.clear();
+}
+
+/// Rough number of bytes held by the traversal state, for the
+/// memory limit of the budget.
+size_t PatternMatchEngine::footprint(void) const
+{
+	return var_grounding.footprint()
+		+ clause_grounding.footprint()
+		+ _choice_state.footprint()
+		+ _perm_state.footprint()
+		+ issued.footprint()
+		+ _glob_state.size() * sizeof(*_glob_state.begin());
 }
 
 /* ======================================================== */
@@ -27,15 +27,19 @@
 #include <map>
 #include <set>
 #include <stack>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
 #include <opencog/atoms/atom_types/NameServer.h>
 #include <opencog/atoms/pattern/Pattern.h>
 #include <opencog/query/PatternMatchCallback.h>
+#include <opencog/query/UndoMap.h>
 
 namespace opencog {
 
+class AtomSpace;
+
 class PatternMatchEngine
 {
 	// -------------------------------------------
@@ -43,6 +47,19 @@ class PatternMatchEngine
 	PatternMatchCallback &_pmc;
 	NameServer& _nameserver;
 
+	// Resource limits of the search, taken from the callback; or null.
+	QueryBudget* _budget;
+	size_t footprint(void) const;
+
+	// True if the callback matches strictly; see strict_match().
+	bool _strict;
+
+	// Where to record what the search does, taken from the callback;
+	// or null. The callbacks below are timed only if there is one.
+	QueryProfile* _profile;
+	bool report_grounding(const HandleMap&, const HandleMap&);
+	bool evaluate(const Handle&, const HandleMap&);
+
 	// Private, locally scoped typedefs, not used outside of this class.
 
 private:
@@ -84,13 +101,17 @@ private:
 	// Note, though, that these are cumulative: so e.g. the
 	// var_grounding map accumulates variable groundings for this
 	// clause, and all previous clauses so far.
+	//
+	// These, and the other traversal state below, are UndoMaps: a
+	// push saves only a mark, and a pop undoes just the changes made
+	// since then, instead of copying and restoring the whole map.
 
 	// Map of current groundings of variables to their grounds
 	// Also contains grounds of subclauses (not sure why, this seems
 	// to be needed)
-	HandleMap var_grounding;
+	UndoMap<HandleMap> var_grounding;
 	// Map of clauses to their current groundings
-	HandleMap clause_grounding;
+	UndoMap<HandleMap> clause_grounding;
 
 	// Insert association between pattern ptm and its grounding hg into
 	// var_grounding.
@@ -109,7 +130,7 @@ private:
 	typedef std::pair<PatternTermPtr, Handle> GndChoice;
 	typedef std::map<GndChoice, size_t> ChoiceState;
 
-	ChoiceState _choice_state;
+	UndoMap<ChoiceState> _choice_state;
 	bool _need_choice_push;
 
 	size_t curr_choice(const PatternTermPtr&, const Handle&, bool&);
@@ -125,7 +146,7 @@ private:
 	typedef PatternTermSeq Permutation;
 	typedef std::map<Unorder, Permutation> PermState; // ChoiceState
 
-	PermState _perm_state;
+	UndoMap<PermState> _perm_state;
 	Permutation curr_perm(const PatternTermPtr&, const Handle&, bool&);
 	bool have_perm(const PatternTermPtr&, const Handle&);
 
@@ -161,31 +182,28 @@ private:
 	Handle get_glob_embedding(const Handle&);
 	bool get_next_thinnest_clause(bool, bool, bool);
 	unsigned int thickness(const Handle&, const HandleSet&);
+	double clause_cost(const Handle&, const Handle&, double);
+
+	// The fan-outs used by clause_cost(), looked up once per search.
+	typedef std::tuple<const AtomSpace*, Type, size_t> FanOutKey;
+	std::map<FanOutKey, double> _fan_outs;
+	double fan_out(const AtomSpace*, Type, size_t);
 	Handle next_clause;
 	Handle next_joint;
 	// Set of clauses for which a grounding is currently being attempted.
 	typedef HandleSet IssuedSet;
-	IssuedSet issued;     // stacked on issued_stack
+	UndoSet<IssuedSet> issued;
 
 	// -------------------------------------------
-	// Stack used to store current traversal state for a single
-	// clause. These are pushed when a clause is fully grounded,
-	// and a new clause is about to be started. These are popped
+	// Save and restore the current traversal state for a single
+	// clause. This is pushed when a clause is fully grounded,
+	// and a new clause is about to be started. It is popped
 	// in order to get back to the original clause, and resume
 	// traversal of that clause, where it was last left off.
 	void solution_push(void);
 	void solution_pop(void);
 	void solution_drop(void);
 
-	// Stacks containing partial groundings.
-	typedef HandleMap SolnMap;
-	std::stack<SolnMap> var_solutn_stack;
-	std::stack<SolnMap> _clause_solutn_stack;
-
-	std::stack<IssuedSet> issued_stack;
-	std::stack<ChoiceState> choice_stack;
-
-	std::stack<PermState> perm_stack;
 	void perm_push(void);
 	void perm_pop(void);
 
@@ -215,6 +233,9 @@ private:
 	bool choice_compare(const PatternTermPtr&, const Handle&);
 	bool ordered_compare(const PatternTermPtr&, const Handle&);
 	bool unorder_compare(const PatternTermPtr&, const Handle&);
+	bool may_match(const PatternTermPtr&, const Handle&);
+	bool unorder_compat(const PatternTermSeq&, const HandleSeq&,
+	                    std::vector<char>&);
 	bool clause_compare(const PatternTermPtr&, const Handle&);
 	bool glob_compare(const PatternTermSeq&, const HandleSeq&);
 
@@ -243,6 +264,7 @@ private:
 public:
 	PatternMatchEngine(PatternMatchCallback&);
 	void set_pattern(const Variables&, const Pattern&);
+	PatternMatchCallback& get_callback(void) { return _pmc; }
 
 	// Examine the locally connected neighborhood for possible
 	// matches.
@@ -0,0 +1,161 @@
+/*
+ * QueryBudget.h
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_QUERY_BUDGET_H
+#define _OPENCOG_QUERY_BUDGET_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace opencog {
+
+/**
+ * Resource limits for a single search, and a way to cancel it.
+ *
+ * A budget is given to the search callback with
+ * InitiateSearchCB::set_budget(). The PatternMatchEngine charges it
+ * for every candidate grounding it explores, and for every
+ * permutation of an unordered link that it tries; once any limit is
+ * passed, or once cancel() has been called, the search halts, just as
+ * if the grounding callback had asked it to stop. The groundings
+ * reported before that are kept by the callback, as usual, and so are
+ * the partial results of the search. Why it halted is told by
+ * get_reason().
+ *
+ * The limits are:
+ * -- a wall-clock deadline;
+ * -- the number of candidates explored: that is, the number of atoms
+ *    proposed as groundings for some term of the pattern;
+ * -- the number of permutations of unordered links tried;
+ * -- the memory, in bytes, used by the traversal state of the engine.
+ *    This is an estimate, and it does not count the results.
+ *
+ * The clock and the memory are looked at only every so many charges,
+ * so these limits may be overrun by a little. A search that spends
+ * its time in a black-box predicate, rather than in the engine, is
+ * not stopped until that returns.
+ *
+ * A budget may be shared by the threads of a parallel search, and
+ * cancel() may be called from any thread. To reuse a budget for
+ * another search, call reset().
+ */
+class QueryBudget
+{
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+		enum Reason
+		{
+			NOT_HALTED = 0,
+			CANCELLED,
+			DEADLINE,
+			CANDIDATES,
+			PERMUTATIONS,
+			MEMORY
+		};
+
+		Clock::time_point deadline = Clock::time_point::max();
+		size_t max_candidates = SIZE_MAX;
+		size_t max_permutations = SIZE_MAX;
+		size_t max_memory = SIZE_MAX;
+
+		/// Set the deadline to the given time from now.
+		void set_timeout(std::chrono::milliseconds ms)
+		{ deadline = Clock::now() + ms; }
+
+		/// Ask the search to stop as soon as it can.
+		void cancel(void) { halt(CANCELLED); }
+
+		bool is_halted(void) const { return NOT_HALTED != _reason; }
+		Reason get_reason(void) const { return (Reason) _reason.load(); }
+
+		size_t get_candidates(void) const { return _candidates; }
+		size_t get_permutations(void) const { return _permutations; }
+
+		/// Clear the counts and the reason; the limits are kept.
+		void reset(void)
+		{
+			_candidates = 0;
+			_permutations = 0;
+			_reason = NOT_HALTED;
+		}
+
+		/// Called by the engine, with its current memory use. Return
+		/// false if the search is to halt.
+		bool charge_candidate(size_t bytes)
+		{
+			if (is_halted()) return false;
+			size_t n = ++_candidates;
+			if (max_candidates < n) return halt(CANDIDATES);
+			return check(n, bytes);
+		}
+
+		bool charge_permutation(size_t bytes)
+		{
+			if (is_halted()) return false;
+			size_t n = ++_permutations;
+			if (max_permutations < n) return halt(PERMUTATIONS);
+			return check(n, bytes);
+		}
+
+		static const char* reason_name(Reason r)
+		{
+			switch (r)
+			{
+				case CANCELLED: return "cancelled";
+				case DEADLINE: return "deadline";
+				case CANDIDATES: return "candidates";
+				case PERMUTATIONS: return "permutations";
+				case MEMORY: return "memory";
+				default: return "not halted";
+			}
+		}
+
+	private:
+		// Look at the clock and the memory every this many charges.
+		static const size_t CHECK_EVERY = 64;
+
+		std::atomic<size_t> _candidates{0};
+		std::atomic<size_t> _permutations{0};
+		std::atomic<int> _reason{NOT_HALTED};
+
+		// Record the first reason only. Always returns false.
+		bool halt(Reason r)
+		{
+			int none = NOT_HALTED;
+			_reason.compare_exchange_strong(none, r);
+			return false;
+		}
+
+		bool check(size_t n, size_t bytes)
+		{
+			if (n % CHECK_EVERY) return true;
+			if (max_memory < bytes) return halt(MEMORY);
+			if (deadline < Clock::now()) return halt(DEADLINE);
+			return true;
+		}
+};
+
+} // namespace opencog
+
+#endif // _OPENCOG_QUERY_BUDGET_H
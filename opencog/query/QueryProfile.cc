@@ -0,0 +1,169 @@
+/*
+ * QueryProfile.cc
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <cctype>
+#include <iomanip>
+#include <sstream>
+
+#include <opencog/atoms/pattern/QueryLink.h>
+
+#include "DefaultImplicator.h"
+#include "QueryProfile.h"
+#include "Satisfier.h"
+
+using namespace opencog;
+
+void QueryProfile::reset(void)
+{
+	*this = QueryProfile();
+}
+
+void QueryProfile::merge(const QueryProfile& other)
+{
+	starts.insert(starts.end(), other.starts.begin(), other.starts.end());
+	for (const auto& cs : other.clauses)
+	{
+		ClauseStats& mine = clauses[cs.first];
+		mine.attempts += cs.second.attempts;
+		mine.successes += cs.second.successes;
+	}
+
+	start_candidates += other.start_candidates;
+	candidates += other.candidates;
+	backtracks += other.backtracks;
+	permutations += other.permutations;
+	groundings += other.groundings;
+	evaluations += other.evaluations;
+
+	search_time += other.search_time;
+	grounding_time += other.grounding_time;
+	evaluation_time += other.evaluation_time;
+}
+
+/* ================================================================= */
+
+static std::string msecs(QueryProfile::Clock::duration d)
+{
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(3)
+	   << std::chrono::duration<double, std::milli>(d).count() << " ms";
+	return ss.str();
+}
+
+// The atom, on one line.
+static std::string brief(const Handle& h)
+{
+	if (nullptr == h) return "(none)";
+
+	std::string str;
+	bool space = false;
+	for (char c : h->to_short_string())
+	{
+		if (std::isspace(c)) { space = true; continue; }
+		if (space and not str.empty() and ')' != c) str += ' ';
+		space = false;
+		str += c;
+	}
+	return str;
+}
+
+std::string QueryProfile::to_string(const std::string& indent) const
+{
+	std::stringstream ss;
+	for (size_t i = 0; i < starts.size(); i++)
+	{
+		const Start& st = starts[i];
+		ss << indent << "start " << i+1 << ": " << st.strategy;
+		if (st.cached) ss << " (cached plan)";
+		ss << std::endl;
+		ss << indent << "  root clause: " << brief(st.root) << std::endl;
+		ss << indent << "  start term: " << brief(st.starter) << std::endl;
+		ss << indent << "  possible starts: " << st.candidates << std::endl;
+	}
+
+	ss << indent << "starts explored: " << start_candidates << std::endl;
+	ss << indent << "candidates: " << candidates << std::endl;
+	ss << indent << "backtracks: " << backtracks << std::endl;
+	ss << indent << "permutations: " << permutations << std::endl;
+	ss << indent << "groundings: " << groundings
+	   << " (" << msecs(grounding_time) << " in callback)" << std::endl;
+	ss << indent << "evaluations: " << evaluations
+	   << " (" << msecs(evaluation_time) << ")" << std::endl;
+	ss << indent << "search time: " << msecs(search_time) << std::endl;
+
+	for (const auto& cs : clauses)
+	{
+		ss << indent << "clause: " << brief(cs.first) << std::endl;
+		ss << indent << "  attempts: " << cs.second.attempts
+		   << ", accepted: " << cs.second.successes << std::endl;
+	}
+	return ss.str();
+}
+
+std::string opencog::oc_to_string(const QueryProfile& prof,
+                                  const std::string& indent)
+{
+	return prof.to_string(indent);
+}
+
+/* ================================================================= */
+
+std::string opencog::explain_query(AtomSpace* as, const Handle& query)
+{
+	PatternLinkPtr plp(PatternLinkCast(query));
+	if (nullptr == plp)
+		throw InvalidParamException(TRACE_INFO,
+			"Expecting a PatternLink, got %s",
+			query ? query->to_string().c_str() : "(null)");
+
+	QueryProfile prof;
+	size_t nresults;
+
+	// Run it the way it is run when executed; see
+	// QueryLink::do_execute() and GetLink::do_execute().
+	QueryLinkPtr qlp(QueryLinkCast(query));
+	if (qlp)
+	{
+		DefaultImplicator impl(as);
+		impl.implicand = qlp->get_implicand();
+		impl.set_profile(&prof);
+		qlp->satisfy(impl);
+		nresults = impl.get_result_set().size();
+	}
+	else
+	{
+		SatisfyingSet sater(as);
+		sater.set_profile(&prof);
+		plp->satisfy(sater);
+		nresults = sater._satisfying_set.size();
+	}
+
+	std::stringstream ss;
+	ss << "query: " << brief(query) << std::endl;
+	ss << "components: " << plp->get_components().size()
+	   << ", virtual clauses: " << plp->get_virtual().size() << std::endl;
+	ss << "results: " << nresults << std::endl;
+	ss << prof.to_string();
+	return ss.str();
+}
+
+/* ===================== END OF FILE ===================== */
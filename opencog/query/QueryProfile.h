@@ -0,0 +1,140 @@
+/*
+ * QueryProfile.h
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_QUERY_PROFILE_H
+#define _OPENCOG_QUERY_PROFILE_H
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <opencog/util/empty_string.h>
+#include <opencog/atoms/base/Handle.h>
+
+namespace opencog {
+
+class AtomSpace;
+
+/**
+ * What a search did, and where its time went.
+ *
+ * A profile is given to the search callback with
+ * InitiateSearchCB::set_profile(). The callback records how it
+ * started the search: the strategy used, the clause and the term it
+ * started at, and how many candidate starting points there were. The
+ * PatternMatchEngine counts:
+ * -- the candidate starting points explored;
+ * -- the candidates explored: the atoms proposed as groundings for
+ *    some term of the pattern (the same as charged to a QueryBudget);
+ * -- the backtracks: the candidates that did not match, and the
+ *    clause groundings rejected by the callback;
+ * -- the permutations of unordered links tried;
+ * -- for each clause, the number of times a grounding was looked for,
+ *    and the number of groundings accepted;
+ * -- the groundings of the whole pattern reported to the callback,
+ *    and the time spent in the callback doing so;
+ * -- the evaluatable clauses evaluated, and the time spent on that.
+ *
+ * A pattern with several components is searched one component at a
+ * time, so there is one start for each; the groundings are those of
+ * the components.
+ *
+ * Nothing is counted without a profile, and the engine looks at the
+ * clock only when it has one. A profile is not thread-safe; in a
+ * parallel search, each thread keeps its own, and these are merged
+ * at the end. To reuse a profile for another search, call reset().
+ */
+class QueryProfile
+{
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+		/// How the search was started.
+		struct Start
+		{
+			std::string strategy;
+			bool cached = false;    // The saved search plan was used.
+			Handle root;            // The clause started at,
+			Handle starter;         // and the term in it.
+			size_t candidates = 0;  // The possible starting points.
+		};
+
+		struct ClauseStats
+		{
+			size_t attempts = 0;
+			size_t successes = 0;
+		};
+
+		std::vector<Start> starts;
+		std::map<Handle, ClauseStats> clauses;
+
+		size_t start_candidates = 0;
+		size_t candidates = 0;
+		size_t backtracks = 0;
+		size_t permutations = 0;
+		size_t groundings = 0;
+		size_t evaluations = 0;
+
+		Clock::duration search_time = Clock::duration::zero();
+		Clock::duration grounding_time = Clock::duration::zero();
+		Clock::duration evaluation_time = Clock::duration::zero();
+
+		/// Called by the search callback, as it starts the search.
+		void start(const std::string& strategy, bool cached,
+		           const Handle& root, const Handle& starter,
+		           size_t ncandidates)
+		{
+			Start st;
+			st.strategy = strategy;
+			st.cached = cached;
+			st.root = root;
+			st.starter = starter;
+			st.candidates = ncandidates;
+			starts.push_back(st);
+		}
+
+		/// Forget everything recorded so far.
+		void reset(void);
+
+		/// Add the counts and times of another profile to this one;
+		/// used for the threads of a parallel search.
+		void merge(const QueryProfile&);
+
+		/// A report, one item per line.
+		std::string to_string(const std::string& indent=empty_string) const;
+};
+
+/**
+ * Run the query, and return the report of its profile; this is like
+ * the EXPLAIN ANALYZE of SQL. The query is run as it would be when
+ * executed, so a BindLink adds its results to the atomspace; these
+ * are not returned.
+ */
+std::string explain_query(AtomSpace*, const Handle& query);
+
+std::string oc_to_string(const QueryProfile& prof,
+                         const std::string& indent=empty_string);
+
+} // namespace opencog
+
+#endif // _OPENCOG_QUERY_PROFILE_H
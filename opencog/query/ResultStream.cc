@@ -0,0 +1,292 @@
+/*
+ * ResultStream.cc
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <opencog/atoms/base/Link.h>
+#include <opencog/atoms/pattern/GetLink.h>
+#include <opencog/atoms/pattern/QueryLink.h>
+#include <opencog/atomspace/AtomSpace.h>
+
+#include "DefaultImplicator.h"
+#include "ResultStream.h"
+#include "Satisfier.h"
+
+namespace opencog {
+
+/**
+ * Implicator that hands each new grounded implicand to the stream,
+ * instead of collecting them. The stream decides which of them are
+ * repeats. Once the stream has been cancelled, every candidate is
+ * rejected, so that the search unwinds as quickly as it can.
+ */
+class StreamingImplicator : public DefaultImplicator
+{
+	ResultStream& _stream;
+
+	public:
+		StreamingImplicator(AtomSpace* as, ResultStream& rs) :
+			Implicator(as),
+			InitiateSearchCB(as),
+			DefaultPatternMatchCB(as),
+			DefaultImplicator(as),
+			_stream(rs) {}
+
+		bool delivered = false;
+
+		virtual bool grounding(const HandleMap &var_soln,
+		                       const HandleMap &term_soln)
+		{
+			if (_stream.is_cancelled()) return true;
+
+			// See Implicator::grounding() about the SilentException.
+			ValuePtr v;
+			try {
+				v = inst.instantiate(implicand, var_soln, true);
+			} catch (const SilentException& ex) {}
+			if (nullptr == v) return false;
+
+			if (v->is_atom()) v = Implicator::_as->add_atom(HandleCast(v));
+			if (not _stream.is_new(v)) return false;
+			delivered = true;
+			return not _stream.push(v);
+		}
+
+		virtual bool link_match(const PatternTermPtr& ptm, const Handle& h)
+		{
+			if (_stream.is_cancelled()) return false;
+			return DefaultPatternMatchCB::link_match(ptm, h);
+		}
+
+		virtual bool variable_match(const Handle& npat, const Handle& nsoln)
+		{
+			if (_stream.is_cancelled()) return false;
+			return DefaultPatternMatchCB::variable_match(npat, nsoln);
+		}
+
+		// The matches above are only ever stricter than the defaults.
+		virtual bool strict_match(void) { return true; }
+};
+
+/**
+ * Same as above, for the groundings of the variables of a GetLink.
+ */
+class StreamingSatisfyingSet : public SatisfyingSet
+{
+	ResultStream& _stream;
+
+	public:
+		StreamingSatisfyingSet(AtomSpace* as, ResultStream& rs) :
+			InitiateSearchCB(as),
+			DefaultPatternMatchCB(as),
+			SatisfyingSet(as),
+			_stream(rs) {}
+
+		virtual bool grounding(const HandleMap &var_soln,
+		                       const HandleMap &term_soln)
+		{
+			if (_stream.is_cancelled()) return true;
+
+			Handle ground;
+			if (1 == _varseq.size())
+				ground = var_soln.at(_varseq[0]);
+			else
+			{
+				HandleSeq vargnds;
+				for (const Handle& hv : _varseq)
+					vargnds.push_back(var_soln.at(hv));
+				ground = createLink(vargnds, LIST_LINK);
+				ground = InitiateSearchCB::_as->add_atom(ground);
+			}
+
+			if (not _stream.is_new(ground)) return false;
+			return not _stream.push(ground);
+		}
+
+		virtual bool link_match(const PatternTermPtr& ptm, const Handle& h)
+		{
+			if (_stream.is_cancelled()) return false;
+			return DefaultPatternMatchCB::link_match(ptm, h);
+		}
+
+		virtual bool variable_match(const Handle& npat, const Handle& nsoln)
+		{
+			if (_stream.is_cancelled()) return false;
+			return DefaultPatternMatchCB::variable_match(npat, nsoln);
+		}
+
+		// The matches above are only ever stricter than the defaults.
+		virtual bool strict_match(void) { return true; }
+};
+
+} // namespace opencog
+
+using namespace opencog;
+
+/* ================================================================= */
+
+ResultStream::ResultStream(AtomSpace* as, const Handle& query,
+                           size_t capacity, QueryBudget* budget,
+                           size_t remember) :
+	_as(as),
+	_query(query),
+	_capacity(0 < capacity ? capacity : 1),
+	_budget(budget),
+	_remember(remember),
+	_cancelled(false),
+	_done(false),
+	_delivered(0)
+{
+	if (nullptr == QueryLinkCast(query) and nullptr == GetLinkCast(query))
+		throw InvalidParamException(TRACE_INFO,
+			"Expecting a GetLink or a QueryLink, got %s",
+			query ? query->to_string().c_str() : "(null)");
+
+	_searcher = std::thread(&ResultStream::search, this);
+}
+
+ResultStream::~ResultStream()
+{
+	cancel();
+	if (_searcher.joinable()) _searcher.join();
+}
+
+/* ================================================================= */
+
+void ResultStream::search(void)
+{
+	try
+	{
+		QueryLinkPtr qlp(QueryLinkCast(_query));
+		if (qlp)
+		{
+			StreamingImplicator impl(_as, *this);
+			impl.implicand = qlp->get_implicand();
+			impl.set_budget(_budget);
+			qlp->satisfy(impl);
+
+			// If there were no groundings, and the query was only
+			// checking for absent clauses, then the implicand is run
+			// once; see QueryLink::do_execute().
+			const Pattern& pat = qlp->get_pattern();
+			if (not impl.delivered and not is_cancelled()
+			    and not (_budget and _budget->is_halted())
+			    and 0 == pat.mandatory.size() and 0 < pat.optionals.size()
+			    and not impl.optionals_present())
+			{
+				ValuePtr v(impl.inst.execute(impl.implicand, true));
+				if (v) push(v);
+			}
+		}
+		else
+		{
+			StreamingSatisfyingSet sater(_as, *this);
+			sater.set_budget(_budget);
+			GetLinkCast(_query)->satisfy(sater);
+		}
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lck(_mtx);
+		_error = std::current_exception();
+	}
+	finish();
+}
+
+void ResultStream::finish(void)
+{
+	std::lock_guard<std::mutex> lck(_mtx);
+	_done = true;
+	_not_empty.notify_all();
+}
+
+bool ResultStream::is_new(const ValuePtr& v)
+{
+	if (0 == _remember) return true;
+	if (not _seen.insert(v).second) return false;
+	if (SIZE_MAX == _remember) return true;
+
+	// Forget the oldest, to make room.
+	_seen_order.push_back(v);
+	if (_remember < _seen_order.size())
+	{
+		_seen.erase(_seen_order.front());
+		_seen_order.pop_front();
+	}
+	return true;
+}
+
+bool ResultStream::push(const ValuePtr& v)
+{
+	std::unique_lock<std::mutex> lck(_mtx);
+	_not_full.wait(lck, [&] {
+		return _queue.size() < _capacity or _cancelled; });
+	if (_cancelled) return false;
+
+	_queue.push_back(v);
+	_not_empty.notify_one();
+	return true;
+}
+
+/* ================================================================= */
+
+bool ResultStream::next(ValuePtr& v)
+{
+	std::unique_lock<std::mutex> lck(_mtx);
+	_not_empty.wait(lck, [&] {
+		return not _queue.empty() or _done or _cancelled; });
+	if (_cancelled) return false;
+
+	if (_queue.empty())
+	{
+		// The search is done. Report its failure, if any, only once.
+		if (_error)
+		{
+			std::exception_ptr err(_error);
+			_error = nullptr;
+			std::rethrow_exception(err);
+		}
+		return false;
+	}
+
+	v = _queue.front();
+	_queue.pop_front();
+	_delivered++;
+	_not_full.notify_one();
+	return true;
+}
+
+ValuePtr ResultStream::next(void)
+{
+	ValuePtr v;
+	if (next(v)) return v;
+	return nullptr;
+}
+
+void ResultStream::cancel(void)
+{
+	std::lock_guard<std::mutex> lck(_mtx);
+	_cancelled = true;
+	_queue.clear();
+	_not_full.notify_all();
+	_not_empty.notify_all();
+}
+
+/* ===================== END OF FILE ===================== */
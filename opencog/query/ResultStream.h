@@ -0,0 +1,157 @@
+/*
+ * ResultStream.h
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_RESULT_STREAM_H
+#define _OPENCOG_RESULT_STREAM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include <opencog/atoms/base/Handle.h>
+#include <opencog/atoms/value/Value.h>
+#include <opencog/query/QueryBudget.h>
+
+namespace opencog {
+
+class AtomSpace;
+
+/**
+ * class ResultStream -- deliver the results of a query as they are found.
+ *
+ * Executing a GetLink or a BindLink (or any other QueryLink) runs the
+ * search to the end, and only then returns the set of all results. A
+ * ResultStream instead runs the search in a thread of its own, and
+ * hands over each result as soon as it has been found, through a
+ * queue of bounded size. The consumer pulls results off the queue
+ * with next(). When the queue is full, the search blocks until the
+ * consumer has caught up; so a slow consumer throttles the search,
+ * and at most `capacity` results are ever waiting.
+ *
+ * The results are the same as those of executing the query: for a
+ * GetLink, the grounding of its variable (or a ListLink holding the
+ * groundings of its variables, in order); for a QueryLink, the
+ * grounded implicand, added to the atomspace. The order of the
+ * results is that in which the search finds them, which is not
+ * specified.
+ *
+ * The search may find the same result more than once. To skip the
+ * repeats, the stream remembers the results found so far (only the
+ * pointers; the atoms are in the atomspace anyway). By default, it
+ * remembers all of them, so that each result is delivered only once;
+ * the memory used then grows with the number of results. For long
+ * or endless streams, the `remember` argument limits this to the
+ * most recent results: a repeat found after that many other results
+ * is delivered again. With `remember` set to zero, nothing is
+ * remembered, and every grounding is delivered, repeats included.
+ *
+ * The consumer can stop the search at any time with cancel(), or by
+ * destroying the stream; the search halts at the next candidate atom
+ * that it looks at. The atomspace must outlive the stream.
+ *
+ * Errors thrown by the search are passed on to the consumer: next()
+ * throws them, once the results found before the error have all
+ * been taken.
+ *
+ * The search may be given a QueryBudget; when it runs out, the stream
+ * ends early, as if the search had found no more results.
+ */
+class ResultStream
+{
+	public:
+		ResultStream(AtomSpace*, const Handle& query, size_t capacity = 64,
+		             QueryBudget* budget = nullptr,
+		             size_t remember = SIZE_MAX);
+		~ResultStream();
+
+		ResultStream(const ResultStream&) = delete;
+		ResultStream& operator=(const ResultStream&) = delete;
+
+		/// Wait for the next result. Return false if there are no more
+		/// results, because the search is done or has been cancelled.
+		bool next(ValuePtr&);
+
+		/// Same as above, returning nullptr when there are no more.
+		ValuePtr next(void);
+
+		/// Stop the search, and drop the results still in the queue.
+		/// Safe to call from any thread, and more than once.
+		void cancel(void);
+
+		/// True once the search has finished, whether by running out of
+		/// candidates or by being cancelled. There may still be results
+		/// in the queue.
+		bool is_done(void) const { return _done; }
+
+		/// The number of results delivered so far.
+		size_t get_num_results(void) const { return _delivered; }
+
+	protected:
+		friend class StreamingImplicator;
+		friend class StreamingSatisfyingSet;
+
+		/// Called by the search, with each new result. Blocks while the
+		/// queue is full. Returns false if the consumer is no longer
+		/// interested in results.
+		bool push(const ValuePtr&);
+
+		bool is_cancelled(void) const { return _cancelled; }
+
+		/// Called by the search, with each result, before pushing it.
+		/// Returns false if it is a repeat of a remembered result.
+		bool is_new(const ValuePtr&);
+
+	private:
+		AtomSpace* _as;
+		Handle _query;
+		size_t _capacity;
+		QueryBudget* _budget;
+
+		// The results found so far; used by the search thread only.
+		// The order is kept only if the number remembered is bounded.
+		size_t _remember;
+		std::unordered_set<ValuePtr> _seen;
+		std::deque<ValuePtr> _seen_order;
+
+		std::mutex _mtx;
+		std::condition_variable _not_full;
+		std::condition_variable _not_empty;
+		std::deque<ValuePtr> _queue;
+
+		std::atomic<bool> _cancelled;
+		std::atomic<bool> _done;
+		std::atomic<size_t> _delivered;
+		std::exception_ptr _error;
+
+		std::thread _searcher;
+		void search(void);
+		void finish(void);
+};
+
+} // namespace opencog
+
+#endif // _OPENCOG_RESULT_STREAM_H
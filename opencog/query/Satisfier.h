@@ -24,6 +24,7 @@
 #ifndef _OPENCOG_SATISFIER_H
 #define _OPENCOG_SATISFIER_H
 
+#include <typeinfo>
 #include <vector>
 
 #include <opencog/atoms/truthvalue/TruthValue.h>
@@ -77,6 +78,10 @@ class Satisfier :
 
 		// Final pass, if no grounding was found.
 		virtual bool search_finished(bool);
+
+		// Derived classes may override the matching callbacks.
+		virtual bool strict_match(void)
+		{ return typeid(*this) == typeid(Satisfier); }
 };
 
 /**
@@ -119,6 +124,14 @@ class SatisfyingSet :
 		// groundings.
 		virtual bool grounding(const HandleMap &var_soln,
 		                       const HandleMap &term_soln);
+
+		// Derived classes may override the matching callbacks.
+		virtual bool strict_match(void)
+		{ return typeid(*this) == typeid(SatisfyingSet); }
+
+	protected:
+		virtual bool parallel_ok(void) const
+		{ return typeid(*this) == typeid(SatisfyingSet); }
 };
 
 }; // namespace opencog
@@ -0,0 +1,132 @@
+/*
+ * SearchPlan.h
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_SEARCH_PLAN_H
+#define _OPENCOG_SEARCH_PLAN_H
+
+#include <memory>
+#include <mutex>
+#include <typeindex>
+#include <vector>
+
+#include <opencog/atoms/base/Handle.h>
+#include <opencog/atoms/pattern/PatternLink.h>
+
+namespace opencog {
+
+class AtomSpace;
+
+/**
+ * The results of the analysis that InitiateSearchCB performs before
+ * it can start a search: the expansion of the defined terms, and the
+ * choice of the atoms at which to start. These depend only on the
+ * pattern, on the definitions, and on the sizes of the incoming sets
+ * and of the type populations in the atomspace. A plan is kept with
+ * the Pattern of the PatternLink that it was made for, so that when
+ * the same PatternLink is run again, the analysis can be skipped.
+ *
+ * A starting point that is no longer the best one still gives the
+ * same groundings, only more slowly; so the starting points are
+ * re-chosen only when the atomspace has changed size by more than
+ * a fraction of what it was when they were chosen, as a cheap proxy
+ * for the drift of the incoming-set sizes and type counts.
+ */
+struct SearchPlan
+{
+	struct Choice
+	{
+		size_t clause;
+		Handle best_start;
+		Handle start_term;
+	};
+
+	std::mutex mtx;
+
+	/// The callback class that made the plan. A class that overrides
+	/// the search methods may choose differently.
+	std::type_index maker = typeid(void);
+
+	/// The expansion made by jit_analyze(), and the definitions of
+	/// the defined terms that it was made with.
+	PatternLinkPtr expanded;
+	HandleMap definitions;
+
+	/// The atomspace, and its size, at the time the starting points
+	/// below were chosen.
+	const AtomSpace* as = nullptr;
+	size_t size = 0;
+
+	/// Starting points for neighbor_search().
+	bool have_neighbor = false;
+	bool neighbor_fail = false;
+	std::vector<Choice> choices;
+
+	/// Starting point for link_type_search().
+	bool have_link_type = false;
+	Handle root;
+	Handle starter_term;
+
+	/// Re-plan when the atomspace has grown or shrunk by more than
+	/// 1/DRIFT of its size at the time of planning.
+	static const size_t DRIFT = 8;
+
+	/// True if the starting points can be used in the atomspace
+	/// of the given size, by the given callback class.
+	bool fresh(const AtomSpace* a, size_t sz, std::type_index who) const
+	{
+		if (a != as or who != maker) return false;
+		size_t diff = sz < size ? size - sz : sz - size;
+		return diff * DRIFT <= size;
+	}
+
+	/// Forget the starting points, and start over for the atomspace
+	/// of the given size.
+	void reset(const AtomSpace* a, size_t sz, std::type_index who)
+	{
+		as = a;
+		size = sz;
+		maker = who;
+		have_neighbor = false;
+		neighbor_fail = false;
+		choices.clear();
+		have_link_type = false;
+		root = Handle::UNDEFINED;
+		starter_term = Handle::UNDEFINED;
+	}
+
+	/// The plan for the pattern, created if there is none yet.
+	static std::shared_ptr<SearchPlan> get(const Pattern& pat)
+	{
+		std::shared_ptr<SearchPlan> plan(std::atomic_load(&pat.search_plan));
+		if (plan) return plan;
+
+		std::shared_ptr<SearchPlan> fresh_plan(std::make_shared<SearchPlan>());
+		if (std::atomic_compare_exchange_strong(&pat.search_plan,
+		                                        &plan, fresh_plan))
+			return fresh_plan;
+		return plan;
+	}
+};
+
+} // namespace opencog
+
+#endif // _OPENCOG_SEARCH_PLAN_H
@@ -0,0 +1,322 @@
+/*
+ * StandingQuery.cc
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <opencog/atoms/base/Link.h>
+#include <opencog/atoms/pattern/QueryLink.h>
+#include <opencog/atomspace/AtomSpace.h>
+
+#include "DefaultPatternMatchCB.h"
+#include "InitiateSearchCB.h"
+#include "PatternMatchEngine.h"
+#include "StandingQuery.h"
+
+namespace opencog {
+
+/**
+ * Hands every grounding over to the standing query, and keeps on
+ * looking for more. The InitiateSearchCB is used only for the first,
+ * full search; after that, the query starts the search itself, at
+ * each new atom.
+ */
+class StandingQueryCB :
+	public virtual InitiateSearchCB,
+	public virtual DefaultPatternMatchCB
+{
+	StandingQuery& _sq;
+
+	public:
+		StandingQueryCB(AtomSpace* as, StandingQuery& sq) :
+			InitiateSearchCB(as), DefaultPatternMatchCB(as), _sq(sq) {}
+
+		virtual void set_pattern(const Variables& vars, const Pattern& pat)
+		{
+			InitiateSearchCB::set_pattern(vars, pat);
+			DefaultPatternMatchCB::set_pattern(vars, pat);
+		}
+
+		virtual bool grounding(const HandleMap& var_soln,
+		                       const HandleMap& term_soln)
+		{
+			_sq.record(var_soln, term_soln);
+			return false;
+		}
+
+		virtual bool strict_match(void) { return true; }
+};
+
+} // namespace opencog
+
+using namespace opencog;
+
+/* ================================================================= */
+
+StandingQuery::StandingQuery(AtomSpace* as, const Handle& query,
+                             DeltaCallback on_delta) :
+	_as(as),
+	_plp(PatternLinkCast(query)),
+	_inst(as),
+	_on_delta(on_delta),
+	_busy(true)
+{
+	if (nullptr == _plp)
+		throw InvalidParamException(TRACE_INFO,
+			"Expecting a PatternLink, got %s",
+			query ? query->to_string().c_str() : "(null)");
+
+	const Pattern& pat = _plp->get_pattern();
+	bool supported = _plp->get_components().size() <= 1
+		and _plp->get_virtual().empty()
+		and pat.black.empty()
+		and pat.optionals.empty();
+	for (const Handle& clause : pat.mandatory)
+		if (0 < pat.evaluatable_holders.count(clause)) supported = false;
+	if (not supported)
+		throw InvalidParamException(TRACE_INFO,
+			"A standing query must be a single component, without "
+			"evaluatable or optional clauses; got %s",
+			query->to_string().c_str());
+
+	QueryLinkPtr qlp(QueryLinkCast(query));
+	if (qlp) _implicand = qlp->get_implicand();
+
+	_cb.reset(new StandingQueryCB(as, *this));
+	_pme.reset(new PatternMatchEngine(*_cb));
+	_pme->set_pattern(_plp->get_variables(), pat);
+
+	// Listen before searching, so that no change is missed. The
+	// changes made meanwhile are queued, since we are busy, and are
+	// processed right after the search.
+	_added_conn = _as->atomAddedSignal().connect(
+		std::bind(&StandingQuery::atom_added, this,
+			std::placeholders::_1));
+	_removed_conn = _as->atomRemovedSignal().connect(
+		std::bind(&StandingQuery::atom_removed, this,
+			std::placeholders::_1));
+
+	try
+	{
+		_plp->satisfy(*_cb);
+		notify();
+		drain();
+	}
+	catch (...)
+	{
+		_as->atomAddedSignal().disconnect(_added_conn);
+		_as->atomRemovedSignal().disconnect(_removed_conn);
+		throw;
+	}
+}
+
+StandingQuery::~StandingQuery()
+{
+	_as->atomAddedSignal().disconnect(_added_conn);
+	_as->atomRemovedSignal().disconnect(_removed_conn);
+}
+
+/* ================================================================= */
+
+void StandingQuery::atom_added(const Handle& h)
+{
+	enqueue(h, true);
+}
+
+void StandingQuery::atom_removed(const AtomPtr& atom)
+{
+	enqueue(Handle(atom), false);
+}
+
+/// Queue the change; if no one is processing changes yet, then do
+/// so, until none are left.
+void StandingQuery::enqueue(const Handle& h, bool added)
+{
+	{
+		std::lock_guard<std::mutex> lck(_mtx);
+		_pending.emplace_back(h, added);
+		if (_busy) return;
+		_busy = true;
+	}
+	drain();
+}
+
+void StandingQuery::drain(void)
+{
+	while (true)
+	{
+		std::pair<Handle, bool> change;
+		{
+			std::lock_guard<std::mutex> lck(_mtx);
+			if (_pending.empty())
+			{
+				_busy = false;
+				return;
+			}
+			change = _pending.front();
+			_pending.pop_front();
+		}
+
+		try
+		{
+			update(change.first, change.second);
+		}
+		catch (...)
+		{
+			// The changes still queued are processed next time.
+			std::lock_guard<std::mutex> lck(_mtx);
+			_busy = false;
+			throw;
+		}
+		notify();
+	}
+}
+
+/// Bring the groundings up to date with one change.
+void StandingQuery::update(const Handle& h, bool added)
+{
+	if (added)
+	{
+		// Ground each clause with the new atom, and the rest of the
+		// pattern around it. Clauses that cannot be grounded by it
+		// fail at once, on the type. Each update is a search of its
+		// own, planned with the statistics as they are now.
+		_pme->set_pattern(_plp->get_variables(), _plp->get_pattern());
+		for (const Handle& clause : _plp->get_pattern().mandatory)
+			_pme->explore_neighborhood(clause, clause, h);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lck(_results_mtx);
+	auto bc = _by_clause.find(h);
+	if (_by_clause.end() == bc) return;
+
+	std::set<HandleSeq> gone;
+	gone.swap(bc->second);
+	_by_clause.erase(bc);
+	for (const HandleSeq& key : gone)
+	{
+		auto gr = _groundings.find(key);
+		if (_groundings.end() == gr) continue;
+
+		// Unlink the grounding from its other clauses.
+		for (const Handle& cg : gr->second.clauses)
+		{
+			if (cg == h) continue;
+			auto other = _by_clause.find(cg);
+			if (_by_clause.end() == other) continue;
+			other->second.erase(key);
+			if (other->second.empty()) _by_clause.erase(other);
+		}
+
+		const Handle& result = gr->second.result;
+		if (result)
+		{
+			auto rc = _results.find(result);
+			if (0 == --rc->second)
+			{
+				_results.erase(rc);
+				_deltas.emplace_back(result, false);
+			}
+		}
+		_groundings.erase(gr);
+	}
+}
+
+/* ================================================================= */
+
+void StandingQuery::record(const HandleMap& var_soln,
+                           const HandleMap& term_soln)
+{
+	const HandleSeq& varseq = _plp->get_variables().varseq;
+	HandleSeq key;
+	for (const Handle& var : varseq)
+		key.push_back(var_soln.at(var));
+
+	{
+		std::lock_guard<std::mutex> lck(_results_mtx);
+		if (_groundings.end() != _groundings.find(key)) return;
+	}
+
+	// Make the result outside of the lock: a BindLink adds atoms to
+	// the atomspace, which are queued, and matched later.
+	Handle result;
+	if (_implicand)
+	{
+		// See Implicator::grounding() about the SilentException.
+		try
+		{
+			ValuePtr v(_inst.instantiate(_implicand, var_soln, true));
+			if (v and v->is_atom()) result = _as->add_atom(HandleCast(v));
+		}
+		catch (const SilentException& ex) {}
+	}
+	else if (1 == key.size())
+		result = key[0];
+	else
+		result = createLink(key, LIST_LINK);
+
+	Grounding gnd;
+	gnd.result = result;
+	for (const Handle& clause : _plp->get_pattern().mandatory)
+	{
+		auto cg = term_soln.find(clause);
+		if (term_soln.end() != cg) gnd.clauses.push_back(cg->second);
+	}
+
+	std::lock_guard<std::mutex> lck(_results_mtx);
+	for (const Handle& cg : gnd.clauses)
+		_by_clause[cg].insert(key);
+	if (result and 1 == ++_results[result])
+		_deltas.emplace_back(result, true);
+	_groundings.emplace(key, gnd);
+}
+
+/// Tell the callback about the changes to the results, outside of
+/// any lock, so that it may change the atomspace in turn.
+void StandingQuery::notify(void)
+{
+	std::vector<std::pair<Handle, bool>> deltas;
+	{
+		std::lock_guard<std::mutex> lck(_results_mtx);
+		deltas.swap(_deltas);
+	}
+	if (not _on_delta) return;
+	for (const auto& d : deltas)
+		_on_delta(d.first, d.second);
+}
+
+/* ================================================================= */
+
+HandleSet StandingQuery::get_results(void) const
+{
+	std::lock_guard<std::mutex> lck(_results_mtx);
+	HandleSet results;
+	for (const auto& r : _results)
+		results.insert(r.first);
+	return results;
+}
+
+size_t StandingQuery::get_num_groundings(void) const
+{
+	std::lock_guard<std::mutex> lck(_results_mtx);
+	return _groundings.size();
+}
+
+/* ===================== END OF FILE ===================== */
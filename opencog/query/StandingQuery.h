@@ -0,0 +1,156 @@
+/*
+ * StandingQuery.h
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_STANDING_QUERY_H
+#define _OPENCOG_STANDING_QUERY_H
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+
+#include <opencog/atoms/base/Handle.h>
+#include <opencog/atoms/execution/Instantiator.h>
+#include <opencog/atoms/pattern/PatternLink.h>
+
+namespace opencog {
+
+class AtomSpace;
+class PatternMatchEngine;
+class StandingQueryCB;
+
+/**
+ * class StandingQuery -- keep the results of a query up to date, as
+ * the atomspace changes.
+ *
+ * Running the same query over and over, to see what has changed,
+ * searches the whole atomspace every time. A StandingQuery runs the
+ * query once, when it is created, and then listens to the atomspace:
+ * every time an atom is added, it looks only for those groundings
+ * that use the new atom; every time an atom is removed, it drops the
+ * groundings that used it. The work done is thus proportional to the
+ * size of the change, and not to that of the atomspace.
+ *
+ * This works because atoms are never modified: a new grounding must
+ * ground some clause with the new atom itself (any link holding the
+ * new atom can only be added after it). So it is enough to ground
+ * each clause with the new atom, and then the rest of the pattern
+ * around it, with PatternMatchEngine::explore_neighborhood().
+ * Likewise, a removed atom takes away exactly those groundings in
+ * which it grounds a clause.
+ *
+ * The results are the same as those of executing the query: for a
+ * GetLink (or any other PatternLink), the grounding of its variable,
+ * or a ListLink (not in the atomspace) holding the groundings of its
+ * variables, in order; for a BindLink (or any other QueryLink), the
+ * grounded implicand, which is added to the atomspace. The atoms that
+ * a BindLink creates are matched in turn, as any other new atom.
+ * A result made by several groundings is removed only once all of
+ * them are gone; the atoms made by a BindLink are never removed from
+ * the atomspace, just as when it is executed.
+ *
+ * An optional callback is told about every change to the results:
+ * it is called with the result, and with true if it was added, or
+ * false if it was removed.
+ *
+ * Only patterns whose groundings depend on nothing but the clauses
+ * grounded are supported: those with a single component, and without
+ * evaluatable, black-box, optional or absent clauses. Others throw an
+ * InvalidParamException.
+ *
+ * The changes are processed one at a time. A change made while the
+ * results are being updated (by the callback, by a BindLink, or by
+ * another thread) is queued, and processed by the thread that is
+ * already updating, before it returns. The query must not be
+ * destroyed while atoms are being added or removed in other threads.
+ */
+class StandingQuery
+{
+	public:
+		typedef std::function<void(const Handle&, bool)> DeltaCallback;
+
+		StandingQuery(AtomSpace*, const Handle& query,
+		              DeltaCallback = nullptr);
+		~StandingQuery();
+
+		StandingQuery(const StandingQuery&) = delete;
+		StandingQuery& operator=(const StandingQuery&) = delete;
+
+		/// The current results.
+		HandleSet get_results(void) const;
+
+		/// The number of distinct groundings behind the results.
+		size_t get_num_groundings(void) const;
+
+	protected:
+		friend class StandingQueryCB;
+
+		/// Called by the search, with each grounding found.
+		void record(const HandleMap& var_soln, const HandleMap& term_soln);
+
+	private:
+		AtomSpace* _as;
+		PatternLinkPtr _plp;
+		Handle _implicand;
+		Instantiator _inst;
+		DeltaCallback _on_delta;
+
+		std::unique_ptr<StandingQueryCB> _cb;
+		std::unique_ptr<PatternMatchEngine> _pme;
+
+		int _added_conn;
+		int _removed_conn;
+
+		// Changes not processed yet: the atom, and true if added.
+		std::mutex _mtx;
+		std::deque<std::pair<Handle, bool>> _pending;
+		bool _busy;
+
+		void atom_added(const Handle&);
+		void atom_removed(const AtomPtr&);
+		void enqueue(const Handle&, bool);
+		void drain(void);
+		void update(const Handle&, bool);
+
+		// A grounding is known by the groundings of the variables, in
+		// order. It is kept with its result, and the atoms grounding
+		// its clauses. The atoms are indexed, for removal.
+		struct Grounding
+		{
+			Handle result;
+			HandleSeq clauses;
+		};
+		mutable std::mutex _results_mtx;
+		std::map<HandleSeq, Grounding> _groundings;
+		std::map<Handle, std::set<HandleSeq>> _by_clause;
+		std::map<Handle, size_t> _results;
+
+		// Changes to the results, to be told to the callback.
+		std::vector<std::pair<Handle, bool>> _deltas;
+		void notify(void);
+};
+
+} // namespace opencog
+
+#endif // _OPENCOG_STANDING_QUERY_H
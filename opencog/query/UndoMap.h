@@ -0,0 +1,224 @@
+/*
+ * UndoMap.h
+ *
+ * Copyright (C) 2019 OpenCog Foundation
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _OPENCOG_UNDO_MAP_H
+#define _OPENCOG_UNDO_MAP_H
+
+#include <vector>
+
+#include <opencog/util/oc_assert.h>
+
+namespace opencog {
+
+/**
+ * A map (or set) whose changes can be rolled back.
+ *
+ * Every change made while a mark is set is recorded on an undo trail.
+ * push() sets a mark at the current end of the trail; pop() undoes
+ * all of the changes made since the matching push(), and removes the
+ * mark; drop() removes the mark, but keeps the changes. A dropped
+ * change is still undone by the pop() of any enclosing mark. Thus,
+ * a push()/pop() pair restores the map exactly as a copy taken at
+ * the push() would, but costs only as much as the changes made in
+ * between, and not as much as the whole map.
+ */
+template<typename Map>
+class UndoMap
+{
+	typedef typename Map::key_type Key;
+	typedef typename Map::mapped_type Value;
+
+	// The key, and the value it had before the change, if any.
+	struct Change
+	{
+		Key key;
+		bool present;
+		Value old;
+	};
+
+	Map _map;
+	std::vector<Change> _trail;
+	std::vector<size_t> _marks;
+
+	void record(const Key& k, bool present, const Value& old)
+	{
+		if (not _marks.empty()) _trail.push_back({k, present, old});
+	}
+
+public:
+	typedef typename Map::const_iterator const_iterator;
+
+	operator const Map&() const { return _map; }
+
+	const_iterator begin() const { return _map.begin(); }
+	const_iterator end() const { return _map.end(); }
+	const_iterator find(const Key& k) const { return _map.find(k); }
+	size_t count(const Key& k) const { return _map.count(k); }
+	size_t size() const { return _map.size(); }
+	bool empty() const { return _map.empty(); }
+
+	/// Rough number of bytes held by the map and the undo trail,
+	/// counting a tree node as the entry plus four pointers.
+	size_t footprint() const
+	{
+		return _map.size() * (sizeof(typename Map::value_type) + 4 * sizeof(void*))
+			+ _trail.capacity() * sizeof(Change);
+	}
+
+	/// The value for the key, or a default-constructed value if the
+	/// key is absent. Unlike std::map::operator[], this never inserts.
+	Value get(const Key& k) const
+	{
+		auto it = _map.find(k);
+		if (_map.end() == it) return Value();
+		return it->second;
+	}
+
+	void set(const Key& k, const Value& v)
+	{
+		auto it = _map.find(k);
+		if (_map.end() == it)
+		{
+			record(k, false, Value());
+			_map.emplace(k, v);
+			return;
+		}
+		if (it->second == v) return;
+		record(k, true, it->second);
+		it->second = v;
+	}
+
+	void erase(const Key& k)
+	{
+		auto it = _map.find(k);
+		if (_map.end() == it) return;
+		record(k, true, it->second);
+		_map.erase(it);
+	}
+
+	void push() { _marks.push_back(_trail.size()); }
+
+	void pop()
+	{
+		OC_ASSERT(not _marks.empty(), "pop() without a matching push()");
+		size_t mark = _marks.back();
+		_marks.pop_back();
+		while (mark < _trail.size())
+		{
+			Change& c = _trail.back();
+			if (c.present) _map[c.key] = c.old;
+			else _map.erase(c.key);
+			_trail.pop_back();
+		}
+	}
+
+	void drop()
+	{
+		OC_ASSERT(not _marks.empty(), "drop() without a matching push()");
+		_marks.pop_back();
+		if (_marks.empty()) _trail.clear();
+	}
+
+	/// Remove all marks, keeping the current contents.
+	void forget() { _marks.clear(); _trail.clear(); }
+
+	/// Remove all marks and all contents.
+	void clear() { forget(); _map.clear(); }
+};
+
+/// As above, for a set.
+template<typename Set>
+class UndoSet
+{
+	typedef typename Set::key_type Key;
+
+	struct Change
+	{
+		Key key;
+		bool present;
+	};
+
+	Set _set;
+	std::vector<Change> _trail;
+	std::vector<size_t> _marks;
+
+public:
+	typedef typename Set::const_iterator const_iterator;
+
+	operator const Set&() const { return _set; }
+
+	const_iterator begin() const { return _set.begin(); }
+	const_iterator end() const { return _set.end(); }
+	const_iterator find(const Key& k) const { return _set.find(k); }
+	size_t count(const Key& k) const { return _set.count(k); }
+	size_t size() const { return _set.size(); }
+	bool empty() const { return _set.empty(); }
+
+	/// As for UndoMap, above.
+	size_t footprint() const
+	{
+		return _set.size() * (sizeof(Key) + 4 * sizeof(void*))
+			+ _trail.capacity() * sizeof(Change);
+	}
+
+	void insert(const Key& k)
+	{
+		if (not _set.insert(k).second) return;
+		if (not _marks.empty()) _trail.push_back({k, false});
+	}
+
+	void erase(const Key& k)
+	{
+		if (0 == _set.erase(k)) return;
+		if (not _marks.empty()) _trail.push_back({k, true});
+	}
+
+	void push() { _marks.push_back(_trail.size()); }
+
+	void pop()
+	{
+		OC_ASSERT(not _marks.empty(), "pop() without a matching push()");
+		size_t mark = _marks.back();
+		_marks.pop_back();
+		while (mark < _trail.size())
+		{
+			Change& c = _trail.back();
+			if (c.present) _set.insert(c.key);
+			else _set.erase(c.key);
+			_trail.pop_back();
+		}
+	}
+
+	void drop()
+	{
+		OC_ASSERT(not _marks.empty(), "drop() without a matching push()");
+		_marks.pop_back();
+		if (_marks.empty()) _trail.clear();
+	}
+
+	void forget() { _marks.clear(); _trail.clear(); }
+	void clear() { forget(); _set.clear(); }
+};
+
+} // namespace opencog
+
+#endif // _OPENCOG_UNDO_MAP_H
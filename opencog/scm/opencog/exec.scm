@@ -7,4 +7,5 @@
 (use-modules (opencog as-config))
 (load-extension (string-append opencog-ext-path-exec "libexec") "opencog_exec_init")
 
-(export cog-evaluate! cog-execute!)
+(export cog-evaluate! cog-execute! cog-explain!
+	cog-stream-open! cog-stream-next! cog-stream-close!)
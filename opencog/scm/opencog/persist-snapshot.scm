@@ -0,0 +1,100 @@
+;
+; OpenCog AtomSpace snapshot module
+;
+
+(define-module (opencog persist-snapshot))
+
+
+(use-modules (opencog))
+(use-modules (opencog as-config))
+(load-extension (string-append opencog-ext-path-persist-snapshot "libpersist-snapshot") "opencog_persist_snapshot_init")
+
+(export snapshot-close snapshot-load snapshot-open snapshot-store
+	changelog-close changelog-compact changelog-open changelog-stats
+	changelog-sync)
+
+(set-procedure-property! changelog-close 'documentation
+"
+ changelog-close - stop logging changes.
+    Write out all of the changes logged so far, and close the change
+    log.
+")
+
+(set-procedure-property! changelog-compact 'documentation
+"
+ changelog-compact - write a snapshot, and empty the change log.
+    This writes the ENTIRE atomspace to the open snapshot, just as
+    `snapshot-store` does, and then drops the changes that the
+    snapshot now holds from the change log. Both a snapshot and a
+    change log must be open.
+")
+
+(set-procedure-property! changelog-open 'documentation
+"
+ changelog-open PATH - Replay, and then log changes to, PATH.
+    First, the changes in the change log PATH, if any, are made to the
+    atomspace. From then on, all atoms that are added to or removed
+    from the atomspace, and all truth values that are set, are
+    appended to the change log. The changes are written out, and
+    synced to disk, every 10 milliseconds; a crash loses no more than
+    that. Values other than truth values, set after the atom is added,
+    are not logged; use `changelog-compact` to save them.
+
+    To restore an atomspace, load its snapshot first:
+
+  Example:
+     (snapshot-open \"/tmp/atomspace.snap\")
+     (snapshot-load)
+     (changelog-open \"/tmp/atomspace.log\")
+     ...
+     (changelog-compact)
+")
+
+(set-procedure-property! changelog-stats 'documentation
+"
+ changelog-stats - report change log statistics.
+    Print how many changes were logged, and how many commits they
+    took.
+")
+
+(set-procedure-property! changelog-sync 'documentation
+"
+ changelog-sync - wait until all logged changes are on disk.
+")
+
+(set-procedure-property! snapshot-close 'documentation
+"
+ snapshot-close - close the currently open snapshot.
+    Detach the snapshot from the atomspace. Nothing is written; use
+    `snapshot-store` first, to save the atomspace.
+")
+
+(set-procedure-property! snapshot-load 'documentation
+"
+ snapshot-load - load all atoms in the snapshot.
+    This maps the snapshot file into memory, and adds all of the atoms
+    in it, and their values, to the atomspace. The atoms of each height
+    are reconstructed in parallel, and so this is much faster than
+    loading the same atoms from a database.
+")
+
+(set-procedure-property! snapshot-open 'documentation
+"
+ snapshot-open PATH - Attach the snapshot file PATH to the atomspace.
+    The file need not exist until it is loaded from or fetched from.
+    Once attached, atoms can be fetched from the snapshot with
+    `fetch-atom`, `fetch-incoming-set` and so on, just as from a
+    database. Atoms cannot be stored one at a time; a snapshot is
+    always written whole, with `snapshot-store`.
+
+  Example:
+     (snapshot-open \"/tmp/atomspace.snap\")
+")
+
+(set-procedure-property! snapshot-store 'documentation
+"
+ snapshot-store - Write all atoms in the atomspace to the snapshot.
+    This writes the ENTIRE contents of the atomspace to a new file, in
+    one pass, and then replaces the old snapshot with it. The old
+    snapshot is left intact, if the write fails.
+")
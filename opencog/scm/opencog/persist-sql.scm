@@ -10,7 +10,8 @@
 (load-extension (string-append opencog-ext-path-persist-sql "libpersist-sql") "opencog_persist_sql_init")
 
 (export sql-clear-cache sql-clear-stats sql-close sql-load sql-open
-	sql-store sql-stats sql-set-hilo-watermarks! sql-set-stall-writers!)
+	sql-store sql-stats sql-set-hilo-watermarks! sql-set-stall-writers!
+	sql-set-copy-store! sql-set-write-batch! sql-set-binary-params!)
 
 (set-procedure-property! sql-clear-cache 'documentation
 "
@@ -90,6 +91,35 @@
     at least the low-watermark pending writes in them.
 ")
 
+(set-procedure-property! sql-set-copy-store! 'documentation
+"
+ sql-set-copy-store! BOOL - Use COPY for bulk stores. If the flag is
+    set, then `sql-store` into an empty Postgres database streams all
+    of the atoms and their values to it with COPY, instead of storing
+    them one at a time. If the flag is not set (the default), or the
+    database is not empty, the atoms are stored one at a time.
+")
+
+(set-procedure-property! sql-set-write-batch! 'documentation
+"
+ sql-set-write-batch! SIZE MSEC - Set the size of the batches in which
+    the writeback queues store atoms, and how long an atom may wait
+    for its batch to fill up. Each batch is stored with a few multi-row
+    INSERT's, instead of one INSERT for each atom and for each of its
+    values. A SIZE of 1 stores each atom as soon as it is dequeued.
+    The default is a SIZE of 1, that is, no batching, and a wait of
+    50 milliseconds. A few hundred atoms is a reasonable SIZE.
+")
+
+(set-procedure-property! sql-set-binary-params! 'documentation
+"
+ sql-set-binary-params! BOOL - Send the parameters of the most-used
+    queries, and get their results, in binary, with statements that
+    are prepared once per connection. If the flag is not set (the
+    default), the parameters are written into the text of each query.
+    Only the Postgres driver has a binary mode; ODBC always uses text.
+")
+
 (set-procedure-property! sql-store 'documentation
 "
  sql-store - Store all atoms in the atomspace to the database.
@@ -0,0 +1,85 @@
+/*
+ * tests/benchmark/AtomSizeBenchmark.cc
+ *
+ * Report the size of the Node and Link objects, and the resident
+ * memory used per atom by an AtomSpace of nodes and binary links,
+ * with and without a truth value on each atom.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+#include <opencog/atoms/base/Link.h>
+#include <opencog/atoms/base/Node.h>
+#include <opencog/atoms/truthvalue/SimpleTruthValue.h>
+#include <opencog/atomspace/AtomSpace.h>
+
+using namespace opencog;
+
+// Resident set size, in bytes.
+static size_t rss(void)
+{
+	size_t pages = 0, resident = 0;
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (nullptr == f) return 0;
+	if (2 != fscanf(f, "%zu %zu", &pages, &resident)) resident = 0;
+	fclose(f);
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Bytes of RSS per atom, for a space of nnodes nodes and as many
+// links, each link joining two of the nodes. Freed memory is kept by
+// the allocator, so only one space is measured per run.
+static double per_atom(size_t nnodes, bool with_tv)
+{
+	size_t before = rss();
+	AtomSpace as;
+	TruthValuePtr tv = SimpleTruthValue::createTV(0.5, 0.5);
+	HandleSeq nodes;
+	nodes.reserve(nnodes);
+	for (size_t i = 0; i < nnodes; i++)
+	{
+		nodes.push_back(as.add_node(CONCEPT_NODE, std::to_string(i)));
+		if (with_tv) nodes.back()->setTruthValue(tv);
+	}
+	for (size_t i = 0; i < nnodes; i++)
+	{
+		Handle h = as.add_link(LIST_LINK,
+		                       nodes[i], nodes[(i * 7 + 1) % nnodes]);
+		if (with_tv) h->setTruthValue(tv);
+	}
+	return (double) (rss() - before) / (2 * nnodes);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t nnodes = 1000000;
+	bool with_tv = true;
+	if (1 < argc) nnodes = atoll(argv[1]);
+	if (2 < argc) with_tv = (std::string("notv") != argv[2]);
+
+	printf("# sizeof(Node): %zu  sizeof(Link): %zu\n",
+	       sizeof(Node), sizeof(Link));
+	printf("# %zu nodes, %zu links, %s TVs\n", nnodes, nnodes,
+	       with_tv ? "with" : "without");
+	printf("# bytes per atom: %8.1f\n", per_atom(nnodes, with_tv));
+	return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * tests/benchmark/BulkLoadBenchmark.cc
+ *
+ * Load the same set of nodes and links into an AtomSpace three ways:
+ * one atom at a time, with async adds, and in a bulk-load session;
+ * report the atoms added per second for each.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencog/atoms/base/Link.h>
+#include <opencog/atoms/base/Node.h>
+#include <opencog/atomspace/AtomSpace.h>
+
+using namespace opencog;
+
+typedef std::chrono::steady_clock Clock;
+
+enum Mode { SYNC, ASYNC, BULK };
+
+// Every tenth link is a duplicate, to exercise de-duplication.
+static double load(Mode mode, const std::vector<std::string>& names,
+                   const std::vector<std::pair<size_t, size_t>>& edges)
+{
+	AtomSpace as;
+	size_t nadded = 0;
+	as.atomAddedSignal().connect([&](const Handle&) { nadded++; });
+
+	bool async = (ASYNC == mode);
+	auto start = Clock::now();
+	if (BULK == mode) as.begin_bulk(names.size() + edges.size());
+
+	HandleSeq nodes;
+	nodes.reserve(names.size());
+	for (const std::string& n : names)
+		nodes.push_back(as.add_node(CONCEPT_NODE, n, async));
+
+	for (const auto& e : edges)
+		as.add_link(LIST_LINK, {nodes[e.first], nodes[e.second]}, async);
+
+	if (BULK == mode) as.end_bulk();
+	as.barrier();
+	std::chrono::duration<double> secs = Clock::now() - start;
+
+	size_t natoms = as.get_size();
+	if (natoms != nadded)
+		fprintf(stderr, "Error: %zu atoms but %zu signals\n", natoms, nadded);
+	return natoms / secs.count();
+}
+
+int main(int argc, char* argv[])
+{
+	size_t nlinks = 2000000;
+	if (1 < argc) nlinks = atoll(argv[1]);
+
+	size_t nnodes = nlinks / 10 + 1;
+	std::vector<std::string> names;
+	for (size_t i = 0; i < nnodes; i++)
+		names.push_back(std::to_string(i));
+
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<size_t> pick(0, nnodes - 1);
+	std::vector<std::pair<size_t, size_t>> edges;
+	for (size_t i = 0; i < nlinks; i++)
+	{
+		if (0 < i and 0 == i % 10) edges.push_back(edges[i / 2]);
+		else edges.push_back({pick(rng), pick(rng)});
+	}
+
+	printf("# %zu nodes, %zu links (10%% duplicates)\n", nnodes, nlinks);
+	printf("# one at a time: %12.0f atoms/sec\n", load(SYNC, names, edges));
+	printf("# async:         %12.0f atoms/sec\n", load(ASYNC, names, edges));
+	printf("# bulk:          %12.0f atoms/sec\n", load(BULK, names, edges));
+	return 0;
+}
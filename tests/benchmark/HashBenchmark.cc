@@ -0,0 +1,119 @@
+/*
+ * tests/benchmark/HashBenchmark.cc
+ *
+ * Time the content hashing of nodes and links, and count hash
+ * collisions: in the full 64 bits, where there should be none, and
+ * in the low 32 bits, where there should be about as many as the
+ * birthday bound predicts for a uniform hash.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <opencog/atoms/base/Link.h>
+#include <opencog/atoms/base/Node.h>
+
+using namespace opencog;
+
+typedef std::chrono::steady_clock Clock;
+
+// Hash each atom for the first time, and return the hashes per second.
+// The hash is cached in the atom, so each atom is hashed only once.
+static double hash_all(const HandleSeq& hs, std::vector<ContentHash>& out)
+{
+	out.clear();
+	out.reserve(hs.size());
+	auto start = Clock::now();
+	for (const Handle& h : hs) out.push_back(h->get_hash());
+	std::chrono::duration<double> secs = Clock::now() - start;
+	return hs.size() / secs.count();
+}
+
+static void report(const char* what, const HandleSeq& hs)
+{
+	std::vector<ContentHash> hashes;
+	double rate = hash_all(hs, hashes);
+
+	size_t n = hashes.size();
+	std::sort(hashes.begin(), hashes.end());
+	size_t full = 0;
+	for (size_t i = 1; i < n; i++)
+		if (hashes[i] == hashes[i-1]) full++;
+
+	for (ContentHash& h : hashes) h &= 0xffffffff;
+	std::sort(hashes.begin(), hashes.end());
+	size_t low = 0;
+	for (size_t i = 1; i < n; i++)
+		if (hashes[i] == hashes[i-1]) low++;
+	double expect = (double) n * (n - 1) / 2 / 4294967296.0;
+
+	printf("# %-8s %12.0f hashes/sec  collisions: %zu (64 bit)"
+	       "  %zu (low 32 bits; %.0f expected)\n",
+	       what, rate, full, low, expect);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t natoms = 2000000;
+	if (1 < argc) natoms = atoll(argv[1]);
+
+	// Short, similar names are the common case, and the hard one.
+	HandleSeq nodes;
+	nodes.reserve(natoms);
+	for (size_t i = 0; i < natoms; i++)
+		nodes.push_back(createNode(CONCEPT_NODE, std::to_string(i)));
+	report("nodes", nodes);
+
+	HandleSeq names;
+	for (size_t i = 0; i < natoms; i++)
+		names.push_back(createNode(CONCEPT_NODE,
+			"http://example.org/ontology/concept#" + std::to_string(i)));
+	report("urls", names);
+	names.clear();
+
+	// Binary links over a few nodes give many near-identical
+	// outgoing sets.
+	size_t side = 1;
+	while (side * side < natoms) side++;
+	HandleSeq links;
+	links.reserve(natoms);
+	for (size_t i = 0; i < natoms; i++)
+		links.push_back(createLink(LIST_LINK,
+			nodes[i / side], nodes[i % side]));
+	report("links", links);
+	links.clear();
+
+	// Longer outgoing sets.
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<size_t> pick(0, natoms - 1);
+	for (size_t i = 0; i < natoms / 8; i++)
+	{
+		HandleSeq oset;
+		for (size_t j = 0; j < 8; j++)
+			oset.push_back(nodes[pick(rng)]);
+		links.push_back(createLink(oset, LIST_LINK));
+	}
+	report("arity 8", links);
+	return 0;
+}
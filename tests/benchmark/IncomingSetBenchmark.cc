@@ -0,0 +1,163 @@
+/*
+ * tests/benchmark/IncomingSetBenchmark.cc
+ *
+ * Build a graph of binary links between random nodes, and report the
+ * memory used per link and per incoming-set edge, and how fast the
+ * incoming sets can be walked, in total and by type.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <string>
+
+#include <unistd.h>
+
+#include <opencog/atoms/base/Link.h>
+#include <opencog/atomspace/AtomSpace.h>
+
+using namespace opencog;
+
+typedef std::chrono::steady_clock Clock;
+
+static double rate(size_t n, Clock::time_point start)
+{
+	std::chrono::duration<double> secs = Clock::now() - start;
+	return n / secs.count();
+}
+
+// Resident set size, in bytes.
+static size_t rss(void)
+{
+	size_t pages = 0, resident = 0;
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (nullptr == f) return 0;
+	if (2 != fscanf(f, "%zu %zu", &pages, &resident)) resident = 0;
+	fclose(f);
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t nlinks = 10000000;
+	int nscans = 3;
+	if (1 < argc) nlinks = atoll(argv[1]);
+	if (2 < argc) nscans = atoi(argv[2]);
+
+	// Ten links per node, on average, so twenty incoming edges per
+	// node, spread over four link types.
+	size_t nnodes = nlinks / 10 + 1;
+	const Type types[] = {
+		LIST_LINK, MEMBER_LINK, INHERITANCE_LINK, EVALUATION_LINK };
+
+	AtomSpace as;
+	HandleSeq nodes;
+	nodes.reserve(nnodes);
+	for (size_t i = 0; i < nnodes; i++)
+		nodes.push_back(as.add_node(CONCEPT_NODE, std::to_string(i)));
+
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<size_t> pick(0, nnodes - 1);
+
+	size_t before = rss();
+	auto start = Clock::now();
+	for (size_t i = 0; i < nlinks; i++)
+	{
+		Handle a(nodes[pick(rng)]);
+		Handle b(nodes[pick(rng)]);
+		as.add_link(types[i % 4], a, b);
+	}
+	double add = rate(nlinks, start);
+	size_t after = rss();
+
+	size_t nedges = 0;
+	for (const Handle& h : nodes) nedges += h->getIncomingSetSize();
+
+	printf("# %zu nodes, %zu links, %zu incoming edges\n",
+	       nnodes, as.get_num_links(), nedges);
+	printf("# link adds per second:     %12.0f\n", add);
+	printf("# bytes per link:           %12.1f\n",
+	       (double) (after - before) / nlinks);
+	printf("# bytes per edge (all):     %12.1f\n",
+	       (double) (after - before) / nedges);
+
+	// Sum the pointers, so that the loops are not optimized away.
+	uintptr_t sum = 0;
+
+	size_t cnt = 0;
+	start = Clock::now();
+	for (int i = 0; i < nscans; i++)
+		for (const Handle& h : nodes)
+			for (const LinkPtr& l : h->getIncomingSet())
+				{ sum += (uintptr_t) l.get(); cnt++; }
+	printf("# getIncomingSet:           %12.0f edges/sec\n", rate(cnt, start));
+
+	cnt = 0;
+	start = Clock::now();
+	for (int i = 0; i < nscans; i++)
+		for (const Handle& h : nodes)
+		{
+			HandleSeq hs;
+			h->getIncomingSet(std::back_inserter(hs));
+			for (const Handle& l : hs) sum += (uintptr_t) l.operator->();
+			cnt += hs.size();
+		}
+	printf("# getIncomingSet(iterator): %12.0f edges/sec\n", rate(cnt, start));
+
+	cnt = 0;
+	start = Clock::now();
+	for (int i = 0; i < nscans; i++)
+		for (const Handle& h : nodes)
+			for (Type t : types)
+				for (const LinkPtr& l : h->getIncomingSetByType(t))
+					{ sum += (uintptr_t) l.get(); cnt++; }
+	printf("# getIncomingSetByType:     %12.0f edges/sec\n", rate(cnt, start));
+
+	// Walk in place, looking for links that point back at the node
+	// in their second slot; most of them are rejected.
+	cnt = 0;
+	start = Clock::now();
+	for (int i = 0; i < nscans; i++)
+		for (const Handle& h : nodes)
+			h->foreach_incoming([&](Link* l) {
+				cnt++;
+				if (l->getOutgoingAtom(1) == h) sum += (uintptr_t) l;
+				return false; });
+	printf("# foreach_incoming:         %12.0f edges/sec\n", rate(cnt, start));
+
+	// Remove a quarter of the links, and walk again.
+	HandleSeq links;
+	as.get_handles_by_type(links, LIST_LINK);
+	start = Clock::now();
+	for (const Handle& h : links) as.remove_atom(h);
+	printf("# link removes per second:  %12.0f\n", rate(links.size(), start));
+	links.clear();
+
+	cnt = 0;
+	start = Clock::now();
+	for (int i = 0; i < nscans; i++)
+		for (const Handle& h : nodes)
+			for (const LinkPtr& l : h->getIncomingSet())
+				{ sum += (uintptr_t) l.get(); cnt++; }
+	printf("# getIncomingSet, after:    %12.0f edges/sec  (%lx)\n",
+	       rate(cnt, start), (unsigned long) (sum & 0xf));
+	return 0;
+}
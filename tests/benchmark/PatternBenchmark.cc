@@ -0,0 +1,307 @@
+/*
+ * tests/benchmark/PatternBenchmark.cc
+ *
+ * Time the pattern matcher on scaled-up versions of the patterns in
+ * BigPatternUTest (two clauses, sharing a variable) and EinsteinUTest
+ * (many clauses, chained through many variables, some of them in
+ * unordered links), on skewed data, where grounding the clauses
+ * in the wrong order costs a great deal, and on wide unordered links,
+ * where only a few of the many permutations of the outgoing set can
+ * match, and on disconnected components, tied together by a virtual
+ * clause. Groundings are counted, not instantiated, so that the time
+ * is that of the search itself; the first pattern is also timed with
+ * a QueryProfile, to see what profiling costs. Last, compare polling
+ * a query after every change to the atomspace with keeping it as a
+ * StandingQuery.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <opencog/atoms/pattern/PatternLink.h>
+#include <opencog/atomspace/AtomSpace.h>
+#include <opencog/query/DefaultPatternMatchCB.h>
+#include <opencog/query/InitiateSearchCB.h>
+#include <opencog/query/QueryProfile.h>
+#include <opencog/query/StandingQuery.h>
+
+using namespace opencog;
+
+typedef std::chrono::steady_clock Clock;
+
+#define an as.add_node
+#define al as.add_link
+
+// Count the groundings, and keep looking for more.
+class CountingCB :
+	public virtual InitiateSearchCB,
+	public virtual DefaultPatternMatchCB
+{
+public:
+	size_t count = 0;
+	CountingCB(AtomSpace* as) : InitiateSearchCB(as), DefaultPatternMatchCB(as) {}
+
+	void set_pattern(const Variables& vars, const Pattern& pat)
+	{
+		InitiateSearchCB::set_pattern(vars, pat);
+		DefaultPatternMatchCB::set_pattern(vars, pat);
+	}
+	bool grounding(const HandleMap&, const HandleMap&)
+	{
+		count++;
+		return false;
+	}
+};
+
+static void run(const char* what, AtomSpace& as, const Handle& vars,
+                const Handle& body, int reps, bool profile=false)
+{
+	PatternLinkPtr pl(createPatternLink(vars, body));
+	size_t count = 0;
+	auto start = Clock::now();
+	for (int i = 0; i < reps; i++)
+	{
+		QueryProfile prof;
+		CountingCB cb(&as);
+		if (profile) cb.set_profile(&prof);
+		pl->satisfy(cb);
+		count = cb.count;
+	}
+	std::chrono::duration<double> secs = Clock::now() - start;
+	printf("# %-8s %8zu groundings  %10.3f ms/search  %10.0f groundings/sec\n",
+	       what, count, 1000 * secs.count() / reps, count * reps / secs.count());
+}
+
+// BigPatternUTest: _obj($verb, $var1) ^ from($verb, $var2),
+// over many verbs.
+static void prep(int nverbs, int reps, bool profile=false)
+{
+	AtomSpace as;
+	Handle obj = an(PREDICATE_NODE, "_obj");
+	Handle from = an(PREDICATE_NODE, "from");
+	for (int i = 0; i < nverbs; i++)
+	{
+		Handle verb = an(CONCEPT_NODE, "verb-" + std::to_string(i));
+		for (int j = 0; j < 4; j++)
+		{
+			al(EVALUATION_LINK, obj, al(LIST_LINK, verb,
+				an(CONCEPT_NODE, "obj-" + std::to_string(j))));
+			al(EVALUATION_LINK, from, al(LIST_LINK, verb,
+				an(CONCEPT_NODE, "src-" + std::to_string(j))));
+		}
+	}
+
+	Handle verb = an(VARIABLE_NODE, "$verb");
+	Handle var1 = an(VARIABLE_NODE, "$var1");
+	Handle var2 = an(VARIABLE_NODE, "$var2");
+	Handle body = al(AND_LINK,
+		al(EVALUATION_LINK, obj, al(LIST_LINK, verb, var1)),
+		al(EVALUATION_LINK, from, al(LIST_LINK, verb, var2)));
+	run(profile ? "prep+prof" : "prep", as,
+	    al(VARIABLE_LIST, verb, var1, var2), body, reps, profile);
+}
+
+// EinsteinUTest-style: a chain of nclauses clauses, through
+// nclauses+1 variables, over a layered graph in which every
+// member of one layer is joined to two of the next. If the links
+// are unordered, each clause also has two permutations to try.
+static void chain(const char* what, Type link, int nclauses, int width,
+                  int reps)
+{
+	AtomSpace as;
+	Handle next = an(PREDICATE_NODE, "next-to");
+	for (int l = 0; l < nclauses; l++)
+	{
+		for (int i = 0; i < width; i++)
+		{
+			Handle a = an(CONCEPT_NODE,
+				"house-" + std::to_string(l) + "-" + std::to_string(i));
+			for (int k = 1; k <= 2; k++)
+			{
+				Handle b = an(CONCEPT_NODE, "house-" + std::to_string(l+1)
+					+ "-" + std::to_string((i + k) % width));
+				al(EVALUATION_LINK, next, al(link, a, b));
+			}
+		}
+	}
+
+	HandleSeq vars, clauses;
+	for (int l = 0; l <= nclauses; l++)
+		vars.push_back(an(VARIABLE_NODE, "$h" + std::to_string(l)));
+	for (int l = 0; l < nclauses; l++)
+		clauses.push_back(al(EVALUATION_LINK, next,
+			al(link, vars[l], vars[l+1])));
+
+	run(what, as, al(VARIABLE_LIST, vars), al(AND_LINK, clauses), reps);
+}
+
+// Skewed data: every $x has many InheritanceLinks, but only one
+// SubsetLink, leading to a $z that is rarely special. Grounding the
+// Inheritance clause before the Subset and the second Member clause
+// explores every $y of every $x, only to throw nearly all of them away.
+static void skew(int nx, int fan, int reps)
+{
+	AtomSpace as;
+	Handle anchor = an(CONCEPT_NODE, "anchor");
+	Handle special = an(CONCEPT_NODE, "special");
+	for (int i = 0; i < nx; i++)
+	{
+		std::string n = std::to_string(i);
+		Handle x = an(CONCEPT_NODE, "x-" + n);
+		al(MEMBER_LINK, x, anchor);
+		for (int j = 0; j < fan; j++)
+			al(INHERITANCE_LINK, x,
+				an(CONCEPT_NODE, "y-" + n + "-" + std::to_string(j)));
+		Handle z = an(CONCEPT_NODE, "z-" + n);
+		al(SUBSET_LINK, x, z);
+		if (0 == i % 10) al(MEMBER_LINK, z, special);
+	}
+	// Many other special things, so that the search starts at anchor.
+	for (int k = 0; k < 5 * nx; k++)
+		al(MEMBER_LINK, an(CONCEPT_NODE, "other-" + std::to_string(k)),
+			special);
+
+	Handle x = an(VARIABLE_NODE, "$x");
+	Handle y = an(VARIABLE_NODE, "$y");
+	Handle z = an(VARIABLE_NODE, "$z");
+	Handle body = al(AND_LINK,
+		al(MEMBER_LINK, x, anchor),
+		al(INHERITANCE_LINK, x, y),
+		al(SUBSET_LINK, x, z),
+		al(MEMBER_LINK, z, special));
+	run("skew", as, al(VARIABLE_LIST, x, y, z), body, reps);
+}
+
+// Wide unordered links: SetLinks holding arity/2 constants, the same
+// in every set, and arity/2 MemberLinks, each with a tag of its own.
+// The pattern leaves the members of the MemberLinks variable. Only one
+// of the arity! permutations of a set matches; the others fail on the
+// constants or on the tags, sooner or later.
+static void wide(int arity, int nsets, int reps)
+{
+	AtomSpace as;
+	int half = arity / 2;
+	HandleSeq consts, tags;
+	for (int j = 0; j < half; j++)
+	{
+		consts.push_back(an(CONCEPT_NODE, "const-" + std::to_string(j)));
+		tags.push_back(an(CONCEPT_NODE, "tag-" + std::to_string(j)));
+	}
+	for (int i = 0; i < nsets; i++)
+	{
+		HandleSeq oset(consts);
+		for (int j = 0; j < half; j++)
+			oset.push_back(al(MEMBER_LINK, an(CONCEPT_NODE,
+				"item-" + std::to_string(i) + "-" + std::to_string(j)),
+				tags[j]));
+		al(SET_LINK, oset);
+	}
+
+	HandleSeq vars, oset(consts);
+	for (int j = 0; j < half; j++)
+	{
+		vars.push_back(an(VARIABLE_NODE, "$m" + std::to_string(j)));
+		oset.push_back(al(MEMBER_LINK, vars[j], tags[j]));
+	}
+	std::string what = "wide-" + std::to_string(arity);
+	run(what.c_str(), as, al(VARIABLE_LIST, vars), al(SET_LINK, oset), reps);
+}
+
+// Two components, of n groundings each, joined on the identity of
+// their numbers; each number is shared by n/width of each.
+static void join(int n, int width, int reps)
+{
+	AtomSpace as;
+	Handle size = an(PREDICATE_NODE, "size");
+	Handle weight = an(PREDICATE_NODE, "weight");
+	for (int i = 0; i < n; i++)
+	{
+		std::string s = std::to_string(i);
+		Handle num = an(NUMBER_NODE, std::to_string(i % width));
+		al(EVALUATION_LINK, size,
+			al(LIST_LINK, an(CONCEPT_NODE, "box-" + s), num));
+		al(EVALUATION_LINK, weight,
+			al(LIST_LINK, an(CONCEPT_NODE, "rock-" + s), num));
+	}
+
+	Handle b = an(VARIABLE_NODE, "$b");
+	Handle r = an(VARIABLE_NODE, "$r");
+	Handle x = an(VARIABLE_NODE, "$x");
+	Handle y = an(VARIABLE_NODE, "$y");
+	Handle body = al(AND_LINK,
+		al(EVALUATION_LINK, size, al(LIST_LINK, b, x)),
+		al(EVALUATION_LINK, weight, al(LIST_LINK, r, y)),
+		al(IDENTICAL_LINK, x, y));
+	run("join", as, al(VARIABLE_LIST, b, r, x, y), body, reps);
+}
+
+// An atomspace of nx members of a set, to which nadd more are added,
+// one at a time. Time rerunning the query after each addition, and
+// keeping a standing query up to date instead.
+static void standing(int nx, int nadd)
+{
+	AtomSpace as;
+	Handle set = an(CONCEPT_NODE, "set");
+	for (int i = 0; i < nx; i++)
+		al(MEMBER_LINK, an(CONCEPT_NODE, "old-" + std::to_string(i)), set);
+
+	Handle x = an(VARIABLE_NODE, "$x");
+	Handle body = al(MEMBER_LINK, x, set);
+	PatternLinkPtr pl(createPatternLink(x, body));
+
+	size_t count = 0;
+	auto start = Clock::now();
+	for (int i = 0; i < nadd; i++)
+	{
+		al(MEMBER_LINK, an(CONCEPT_NODE, "poll-" + std::to_string(i)), set);
+		CountingCB cb(&as);
+		pl->satisfy(cb);
+		count = cb.count;
+	}
+	std::chrono::duration<double> secs = Clock::now() - start;
+	printf("# %-8s %8zu groundings  %10.3f ms/change\n",
+	       "poll", count, 1000 * secs.count() / nadd);
+
+	start = Clock::now();
+	StandingQuery sq(&as, al(GET_LINK, body));
+	for (int i = 0; i < nadd; i++)
+		al(MEMBER_LINK, an(CONCEPT_NODE, "standing-" + std::to_string(i)), set);
+	secs = Clock::now() - start;
+	printf("# %-8s %8zu groundings  %10.3f ms/change (with setup)\n",
+	       "standing", sq.get_num_groundings(), 1000 * secs.count() / nadd);
+}
+
+int main(int argc, char* argv[])
+{
+	int reps = 3;
+	if (1 < argc) reps = atoi(argv[1]);
+
+	prep(20000, reps);
+	prep(20000, reps, true);
+	chain("chain", LIST_LINK, 10, 20, reps);
+	chain("unorder", SIMILARITY_LINK, 6, 10, reps);
+	skew(1000, 200, reps);
+	wide(6, 200, reps);
+	wide(8, 20, reps);
+	wide(10, 2, reps);
+	join(2000, 100, reps);
+	standing(20000, 200);
+	return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * tests/benchmark/ThreadedAddBenchmark.cc
+ *
+ * Measure AtomSpace insertion throughput as a function of the
+ * number of writer threads.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencog/atomspace/AtomSpace.h>
+
+using namespace opencog;
+
+// Each thread adds `nlinks` ListLinks, each holding two fresh
+// ConceptNodes; none of the atoms are shared between threads.
+static void add_atoms(AtomSpace* as, int thread_id, int nlinks)
+{
+	std::string pfx = "thr-" + std::to_string(thread_id) + "-";
+	for (int i = 0; i < nlinks; i++)
+	{
+		Handle a = as->add_node(CONCEPT_NODE, pfx + std::to_string(2*i));
+		Handle b = as->add_node(CONCEPT_NODE, pfx + std::to_string(2*i+1));
+		as->add_link(LIST_LINK, a, b);
+	}
+}
+
+static double run(int nthreads, int nlinks)
+{
+	AtomSpace as;
+	std::vector<std::thread> thrs;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int t = 0; t < nthreads; t++)
+		thrs.push_back(std::thread(add_atoms, &as, t, nlinks));
+	for (std::thread& th : thrs) th.join();
+	auto end = std::chrono::steady_clock::now();
+
+	std::chrono::duration<double> secs = end - start;
+	return 3.0 * nthreads * nlinks / secs.count();
+}
+
+int main(int argc, char* argv[])
+{
+	int max_threads = std::thread::hardware_concurrency();
+	int nlinks = 200000;
+	if (1 < argc) max_threads = atoi(argv[1]);
+	if (2 < argc) nlinks = atoi(argv[2]);
+
+	printf("# Atoms added per second, vs. number of writer threads.\n");
+	printf("# Each thread adds %d links and %d nodes.\n", nlinks, 2*nlinks);
+	printf("# threads  atoms/sec   speedup\n");
+
+	double base = 0.0;
+	for (int n = 1; n <= max_threads; n *= 2)
+	{
+		double rate = run(n, nlinks);
+		if (1 == n) base = rate;
+		printf("%8d  %10.0f  %8.2f\n", n, rate, rate / base);
+		fflush(stdout);
+	}
+	return 0;
+}
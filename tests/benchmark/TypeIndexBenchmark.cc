@@ -0,0 +1,121 @@
+/*
+ * tests/benchmark/TypeIndexBenchmark.cc
+ *
+ * Compare the dense AtomSlots container, used by the TypeIndex, with
+ * the per-type hash sets that it replaced: insert, scan and remove
+ * throughput.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <opencog/atoms/base/Node.h>
+#include <opencog/atomspace/AtomSlots.h>
+#include <opencog/atomspace/TypeIndex.h>
+
+using namespace opencog;
+
+typedef std::chrono::steady_clock Clock;
+
+static double rate(size_t n, Clock::time_point start)
+{
+	std::chrono::duration<double> secs = Clock::now() - start;
+	return n / secs.count();
+}
+
+// Insert all of the atoms, scan them `nscans` times, then remove
+// every other atom (in random order), and scan again.
+template<typename Container>
+static void run(const char* name, const std::vector<Atom*>& atoms,
+                int nscans)
+{
+	Container c;
+	size_t n = atoms.size();
+
+	auto start = Clock::now();
+	for (Atom* a : atoms) c.insert(a);
+	double ins = rate(n, start);
+
+	// Sum the pointers, so that the loop is not optimized away.
+	uintptr_t sum = 0;
+	start = Clock::now();
+	for (int i = 0; i < nscans; i++)
+		for (Atom* a : c) sum += (uintptr_t) a;
+	double scan = rate(n * nscans, start);
+
+	std::vector<Atom*> doomed;
+	for (size_t i = 0; i < n; i += 2) doomed.push_back(atoms[i]);
+	std::shuffle(doomed.begin(), doomed.end(), std::mt19937(42));
+
+	start = Clock::now();
+	for (Atom* a : doomed) c.erase(a);
+	double rem = rate(doomed.size(), start);
+
+	start = Clock::now();
+	for (int i = 0; i < nscans; i++)
+		for (Atom* a : c) sum += (uintptr_t) a;
+	double rescan = rate(c.size() * nscans, start);
+
+	printf("%-14s %12.0f %12.0f %12.0f %12.0f  (%lx)\n",
+	       name, ins, scan, rem, rescan, (unsigned long) (sum & 0xf));
+}
+
+int main(int argc, char* argv[])
+{
+	size_t natoms = 1000000;
+	int nscans = 20;
+	if (1 < argc) natoms = atoll(argv[1]);
+	if (2 < argc) nscans = atoi(argv[2]);
+
+	HandleSeq hs;
+	std::vector<Atom*> atoms;
+	for (size_t i = 0; i < natoms; i++)
+	{
+		hs.push_back(createNode(CONCEPT_NODE, std::to_string(i)));
+		atoms.push_back(hs.back().operator->());
+	}
+
+	printf("# Operations per second on %lu atoms of one type.\n", natoms);
+	printf("# The re-scan is done after half the atoms were removed.\n");
+	printf("# container      insert       scan         remove       re-scan\n");
+	run<std::unordered_set<Atom*>>("unordered_set", atoms, nscans);
+	run<AtomSlots>("AtomSlots", atoms, nscans);
+
+	// A subclass scan through the whole index: all atoms, of any type.
+	TypeIndex tidx;
+	for (Atom* a : atoms) tidx.insertAtom(a);
+	std::lock_guard<TypeIndex> lck(tidx);
+	auto start = Clock::now();
+	size_t cnt = 0;
+	for (int i = 0; i < nscans; i++)
+	{
+		auto it = tidx.begin(ATOM, true);
+		auto end = tidx.end();
+		for (; it != end; it++) cnt++;
+	}
+	printf("# TypeIndex subclass scan of ATOM: %.0f atoms/sec\n",
+	       rate(cnt, start));
+	return 0;
+}
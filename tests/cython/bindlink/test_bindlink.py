@@ -2,7 +2,7 @@ import unittest
 import os
 
 from opencog.atomspace import AtomSpace, TruthValue, Atom, types
-from opencog.bindlink import execute_atom, evaluate_atom
+from opencog.bindlink import execute_atom, evaluate_atom, ResultStream
 
 from opencog.type_constructors import *
 from opencog.utilities import initialize_opencog, finalize_opencog
@@ -133,6 +133,19 @@ class BindlinkTest(unittest.TestCase):
         self.assertEquals(green_count(), 2)
         self.assertEquals(red_count(), 1)
 
+    def test_result_stream(self):
+        stream = ResultStream(self.atomspace, self.getlink_atom)
+        found = set(stream)
+        self.assertEquals(found, set([ConceptNode("Frog"),
+                                      ConceptNode("Zebra"),
+                                      ConceptNode("Deer")]))
+        self.assertEquals(stream.num_results, 3)
+
+        stream = ResultStream(self.atomspace, self.bindlink_atom, 1)
+        self.assertTrue(next(stream) is not None)
+        stream.cancel()
+        self.assertEquals(list(stream), [])
+
     def test_execute_atom(self):
         result = execute_atom(self.atomspace,
                 ExecutionOutputLink(
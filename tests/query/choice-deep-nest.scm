@@ -0,0 +1,103 @@
+;
+; Unit testing for ChoiceLinks nested below other ChoiceLinks, with
+; other links in between, in the pattern matcher.
+;
+(use-modules (opencog))
+(use-modules (opencog exec))
+
+(MemberLink (ConceptNode "Tom") (ConceptNode "ways and means"))
+(MemberLink (ConceptNode "Joe") (ConceptNode "ways and means"))
+(MemberLink (ConceptNode "Hank") (ConceptNode "ways and means"))
+(MemberLink (ConceptNode "Mary") (ConceptNode "ways and means"))
+(MemberLink (ConceptNode "Ann") (ConceptNode "ways and means"))
+(MemberLink (ConceptNode "Bob") (ConceptNode "ways and means"))
+
+(ListLink (MemberLink (ConceptNode "Tom") (ConceptNode "Senator")))
+(ListLink (MemberLink (ConceptNode "Joe") (ConceptNode "Representative")))
+
+;; We should NOT find Hank!
+(ListLink (MemberLink (ConceptNode "Hank") (ConceptNode "CEO")))
+
+;; Nor Mary; she is not nested deep enough.
+(ListLink (MemberLink (ConceptNode "Mary") (ConceptNode "Page")))
+
+(ListLink (ListLink (MemberLink (ConceptNode "Ann") (ConceptNode "Page"))))
+(ListLink (ListLink (MemberLink (ConceptNode "Bob") (ConceptNode "Secretary"))))
+
+;; A ChoiceLink in a ListLink in a ChoiceLink in a ListLink.
+(define (deep-nest)
+	(BindLink
+		(AndLink
+			(MemberLink
+				(VariableNode "$x")
+				(ConceptNode "ways and means")
+			)
+			(ListLink
+				(ChoiceLink
+					(MemberLink
+						(VariableNode "$x")
+						(ConceptNode "Senator")
+					)
+					(MemberLink
+						(VariableNode "$x")
+						(ConceptNode "Representative")
+					)
+					(ListLink
+						(ChoiceLink
+							(MemberLink
+								(VariableNode "$x")
+								(ConceptNode "Page")
+							)
+							(MemberLink
+								(VariableNode "$x")
+								(ConceptNode "Secretary")
+							)
+						)
+					)
+				)
+			)
+		)
+		(VariableNode "$x")
+	)
+)
+
+;; As above, with the outer ChoiceLink at the clause root.
+(define (top-deep-nest)
+	(BindLink
+		(AndLink
+			(MemberLink
+				(VariableNode "$x")
+				(ConceptNode "ways and means")
+			)
+			(ChoiceLink
+				(ListLink
+					(MemberLink
+						(VariableNode "$x")
+						(ConceptNode "Senator")
+					)
+				)
+				(ListLink
+					(MemberLink
+						(VariableNode "$x")
+						(ConceptNode "Representative")
+					)
+				)
+				(ListLink
+					(ListLink
+						(ChoiceLink
+							(MemberLink
+								(VariableNode "$x")
+								(ConceptNode "Page")
+							)
+							(MemberLink
+								(VariableNode "$x")
+								(ConceptNode "Secretary")
+							)
+						)
+					)
+				)
+			)
+		)
+		(VariableNode "$x")
+	)
+)